@@ -36,6 +36,11 @@ int main()
             return generator::file(examples_doc_root, "index.html");
         });
 
+        // Add a route to an existing file honoring Range requests (the response might hold a file range body)
+        router.add(method::get, "/file_ranges", [](const auto& req) {
+            return generator::file(req, examples_doc_root, "index.html");
+        });
+
         // Add a route to a non-existing file
         router.add(method::get, "/file_nonexist", [](const auto& req) {
             return generator::file(examples_doc_root, "/some_nonexisting_file.xzy");
@@ -49,6 +49,8 @@ int main()
         // Add a preflight for the above endpoints
         preflight_config preflight_cfg;
         preflight_cfg.origin = "http://127.0.0.1:8080";
+        preflight_cfg.allowed_headers = { "Content-Type" };
+        preflight_cfg.max_age = std::chrono::minutes(10);
         router.add_preflight("/foo", preflight_cfg);
     }
 
@@ -60,6 +60,18 @@ int main()
             return resp;
         });
 
+        // A regex route with a capturing group converted to a number
+        router.add(method::get, "^/double/(\\d+)$", [](const auto& req, const malloy::server::route_captures& captures) {
+            const auto value = captures.get<int>(0);
+            if (!value)
+                return generator::bad_request("not a number");
+
+            response resp{ status::ok };
+            resp.body() = std::to_string(*value * 2);
+
+            return resp;
+        });
+
         // A regex route with two capturing groups
         router.add(method::get, R"(^/regex\?one=(\w+)&two=(\w+)$)", [](const auto& req, const std::vector<std::string>& captures) {
             std::string body;
@@ -108,6 +108,18 @@ namespace malloy::detail
             m_io_ctx->run();
         }
 
+        /**
+         * Get the controlled object (e.g. the listener of a server).
+         *
+         * @return The controlled object.
+         */
+        [[nodiscard]]
+        const T&
+        ctrl() const noexcept
+        {
+            return m_ctrl;
+        }
+
     private:
         using workguard_t = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
 
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+namespace malloy::detail
+{
+
+    /**
+     * @class locked_pool_resource
+     * @brief A pool resource serializing access with a mutex
+     * @details Unlike `std::pmr::synchronized_pool_resource`, this doesn't maintain pools per thread: The objects of
+     *          a connection are allocated on its strand, only the occasional release happens on another thread (e.g.
+     *          an offloaded handler dropping its request). An uncontended mutex is cheaper than the bookkeeping of
+     *          per-thread pools.
+     */
+    class locked_pool_resource :
+        public std::pmr::memory_resource
+    {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param options The options of the pool
+         */
+        explicit
+        locked_pool_resource(const std::pmr::pool_options& options) :
+            m_pool{options}
+        {
+        }
+
+    private:
+        std::mutex m_lock;
+        std::pmr::unsynchronized_pool_resource m_pool;
+
+        void*
+        do_allocate(const std::size_t bytes, const std::size_t alignment) override
+        {
+            // Acquire mutex
+            std::lock_guard lock(m_lock);
+
+            return m_pool.allocate(bytes, alignment);
+        }
+
+        void
+        do_deallocate(void* const p, const std::size_t bytes, const std::size_t alignment) override
+        {
+            // Acquire mutex
+            std::lock_guard lock(m_lock);
+
+            m_pool.deallocate(p, bytes, alignment);
+        }
+
+        [[nodiscard]]
+        bool
+        do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    /**
+     * @class pool_allocator
+     * @brief An allocator sharing ownership of its memory resource
+     * @details Unlike `std::pmr::polymorphic_allocator`, this keeps the memory resource alive for as long as any copy
+     *          of the allocator exists. Objects allocated with `std::allocate_shared()` can therefore safely outlive
+     *          the owner of the memory resource (e.g. a connection).
+     * @tparam T The value type
+     */
+    template<typename T>
+    class pool_allocator
+    {
+        template<typename>
+        friend class pool_allocator;
+
+    public:
+        using value_type = T;
+
+        /**
+         * @brief Constructor
+         *
+         * @param resource The memory resource
+         */
+        explicit
+        pool_allocator(std::shared_ptr<std::pmr::memory_resource> resource) noexcept :
+            m_resource{std::move(resource)}
+        {
+        }
+
+        /**
+         * @brief Rebinding constructor
+         */
+        template<typename U>
+        pool_allocator(const pool_allocator<U>& other) noexcept :
+            m_resource{other.m_resource}
+        {
+        }
+
+        [[nodiscard]]
+        T*
+        allocate(const std::size_t n)
+        {
+            return static_cast<T*>(m_resource->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void
+        deallocate(T* const p, const std::size_t n) noexcept
+        {
+            m_resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        template<typename U>
+        [[nodiscard]]
+        bool
+        operator==(const pool_allocator<U>& rhs) const noexcept
+        {
+            return m_resource == rhs.m_resource;
+        }
+
+    private:
+        std::shared_ptr<std::pmr::memory_resource> m_resource;
+    };
+
+}
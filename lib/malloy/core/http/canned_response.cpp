@@ -0,0 +1,42 @@
+#include "canned_response.hpp"
+
+#include <sstream>
+
+using namespace malloy::http;
+
+std::shared_ptr<const canned_response>
+canned_response::make(response<> resp)
+{
+    return std::make_shared<const canned_response>(token{ }, std::move(resp));
+}
+
+std::shared_ptr<const canned_response>
+canned_response::make(std::shared_ptr<const canned_response> base, const std::string_view fields)
+{
+    return std::make_shared<const canned_response>(token{ }, std::move(base), fields);
+}
+
+canned_response::canned_response(token, response<>&& resp) :
+    m_status{ resp.result_int() }
+{
+    resp.version(11);
+    resp.prepare_payload();
+
+    std::ostringstream ss;
+    ss << resp.base();
+    m_header = std::move(ss).str();
+    m_body = std::move(resp.body());
+}
+
+canned_response::canned_response(token, std::shared_ptr<const canned_response>&& base, const std::string_view fields) :
+    m_status{ base->m_status }
+{
+    // Refer to the response holding the serialized message
+    if (base->m_base) {
+        m_fields = base->fields();
+        base = base->m_base;
+    }
+    m_fields += fields;
+    m_fields += "\r\n";
+    m_base = std::move(base);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "response.hpp"
+
+#include <boost/asio/buffer.hpp>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace malloy::http
+{
+
+    /**
+     * A pre-serialized response.
+     *
+     * @details This holds the complete wire representation (header and body) of a response. It is meant for responses
+     *          which never change (e.g. health checks, fixed error responses or static JSON documents): The response is
+     *          prepared and serialized once and then shared by all connections sending it. Sending it is a single
+     *          gather write of two buffers, with no further processing.
+     *
+     *          The response is serialized as HTTP/1.1 and must therefore contain all headers it is supposed to carry
+     *          (e.g. the `Server` header) when it is created.
+     */
+    class canned_response
+    {
+        struct token { };
+
+    public:
+        /**
+         * Creates a canned response.
+         *
+         * @param resp The response. Its payload is prepared before serializing.
+         * @return The canned response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<const canned_response>
+        make(response<> resp);
+
+        /**
+         * Creates a canned response with additional header fields.
+         *
+         * @details The header & body of the base response are shared rather than copied. The fields are written after
+         *          the fields of the base response (e.g. the `Age` field of a cached response).
+         *
+         * @param base The base response.
+         * @param fields The serialized fields, each terminated by CRLF (e.g. `"Age: 5\r\n"`).
+         * @return The canned response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<const canned_response>
+        make(std::shared_ptr<const canned_response> base, std::string_view fields);
+
+        /**
+         * Constructor.
+         *
+         * @note Use @ref make() instead.
+         */
+        canned_response(token, response<>&& resp);
+
+        /**
+         * Constructor.
+         *
+         * @note Use @ref make() instead.
+         */
+        canned_response(token, std::shared_ptr<const canned_response>&& base, std::string_view fields);
+
+        /**
+         * Gets the response status.
+         *
+         * @return The status.
+         */
+        [[nodiscard]]
+        unsigned
+        status() const noexcept
+        {
+            return m_status;
+        }
+
+        /**
+         * Gets the serialized header (including the terminating empty line).
+         *
+         * @note This excludes the additional fields (see @ref fields()).
+         *
+         * @return The header.
+         */
+        [[nodiscard]]
+        std::string_view
+        header() const noexcept
+        {
+            return m_base ? m_base->m_header : m_header;
+        }
+
+        /**
+         * Gets the additional header fields.
+         *
+         * @return The serialized fields (empty unless created from a base response).
+         */
+        [[nodiscard]]
+        std::string_view
+        fields() const noexcept
+        {
+            return std::string_view{ m_fields }.substr(0, m_fields.empty() ? 0 : m_fields.size() - 2);
+        }
+
+        /**
+         * Gets the body.
+         *
+         * @return The body.
+         */
+        [[nodiscard]]
+        std::string_view
+        body() const noexcept
+        {
+            return m_base ? m_base->m_body : m_body;
+        }
+
+        /**
+         * Gets the buffers to write.
+         *
+         * @param head Whether the response answers a `HEAD` request (i.e. the body is omitted).
+         * @return The buffers.
+         */
+        [[nodiscard]]
+        std::array<boost::asio::const_buffer, 3>
+        buffers(bool head) const noexcept
+        {
+            if (!m_base) {
+                return {
+                    boost::asio::buffer(m_header),
+                    head ? boost::asio::const_buffer{ } : boost::asio::buffer(m_body),
+                    boost::asio::const_buffer{ }
+                };
+            }
+
+            // The additional fields (followed by the empty line) replace the empty line of the base header
+            const std::string_view header = m_base->m_header;
+            return {
+                boost::asio::buffer(header.substr(0, header.size() - 2)),
+                boost::asio::buffer(m_fields),
+                head ? boost::asio::const_buffer{ } : boost::asio::buffer(m_base->m_body)
+            };
+        }
+
+    private:
+        unsigned m_status;
+        std::string m_header;
+        std::string m_body;
+        std::shared_ptr<const canned_response> m_base;
+        std::string m_fields;               // Additional fields followed by the empty line
+    };
+
+}
@@ -0,0 +1,275 @@
+#include "compression.hpp"
+#include "utils.hpp"
+#include "../utils.hpp"
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <stdexcept>
+
+using namespace malloy::http;
+
+namespace
+{
+
+    /**
+     * Compresses data into the raw deflate format (RFC 1951) and appends it to a string.
+     */
+    void
+    raw_deflate(const std::string_view data, const int level, std::string& out)
+    {
+        boost::beast::zlib::deflate_stream ds;
+        ds.reset(std::clamp(level, 1, 9), 15, 8, boost::beast::zlib::Strategy::normal);
+
+        const std::size_t offset = out.size();
+        out.resize(offset + ds.upper_bound(data.size()));
+
+        boost::beast::zlib::z_params zs;
+        zs.next_in = data.data();
+        zs.avail_in = data.size();
+        zs.next_out = out.data() + offset;
+        zs.avail_out = out.size() - offset;
+
+        boost::beast::error_code ec;
+        ds.write(zs, boost::beast::zlib::Flush::finish, ec);
+        if (ec && ec != boost::beast::zlib::error::end_of_stream)
+            throw std::runtime_error("deflate failed: " + ec.message());
+
+        out.resize(offset + zs.total_out);
+    }
+
+    void
+    append_le32(std::string& out, const std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    void
+    append_be32(std::string& out, const std::uint32_t value)
+    {
+        for (int i = 3; i >= 0; --i)
+            out += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+
+    [[nodiscard]]
+    std::uint32_t
+    adler32(const std::string_view data)
+    {
+        constexpr std::uint32_t mod = 65521;
+        std::uint32_t a = 1;
+        std::uint32_t b = 0;
+        for (const char c : data) {
+            a = (a + static_cast<unsigned char>(c)) % mod;
+            b = (b + a) % mod;
+        }
+
+        return (b << 16) | a;
+    }
+
+    [[nodiscard]]
+    bool
+    iequals(const std::string_view a, const std::string_view b)
+    {
+        return std::ranges::equal(a, b, [](const char x, const char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    /**
+     * Parses the quality value of an element of a header value (e.g. `gzip;q=0.5`).
+     *
+     * @return The quality value (in thousandths).
+     */
+    [[nodiscard]]
+    int
+    quality(std::string_view params)
+    {
+        for (;;) {
+            const auto sep = params.find(';');
+            if (sep == std::string_view::npos)
+                return 1000;
+            params.remove_prefix(sep + 1);
+
+            const std::string_view param = trim_ows(params.substr(0, params.find(';')));
+            if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=')
+                continue;
+
+            // qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+            const std::string_view value = param.substr(2);
+            int q = (!value.empty() && value[0] == '1') ? 1000 : 0;
+            if (value.size() > 2 && value[1] == '.') {
+                int scale = 100;
+                for (const char c : value.substr(2, 3)) {
+                    if (c < '0' || c > '9')
+                        break;
+                    q += (c - '0') * scale;
+                    scale /= 10;
+                }
+            }
+
+            return std::min(q, 1000);
+        }
+    }
+
+}
+
+std::string
+compression::coded_etag(std::string_view etag, const coding c)
+{
+    if (c == coding::identity)
+        return std::string{ etag };
+
+    const std::string_view name = to_string(c);
+    const bool quoted = etag.size() >= 2 && etag.back() == '"';
+    if (quoted)
+        etag.remove_suffix(1);
+
+    std::string str;
+    str.reserve(etag.size() + 1 + name.size() + 1);
+    str += etag;
+    str += '-';
+    str += name;
+    if (quoted)
+        str += '"';
+
+    return str;
+}
+
+std::string
+compression::gzip(const std::string_view data, const int level)
+{
+    std::string out;
+    out.reserve(18 + data.size() / 2);
+
+    // Header (no file name, no modification time)
+    out.append({ '\x1f', '\x8b', '\x08', '\x00', '\x00', '\x00', '\x00', '\x00', (level >= 9 ? '\x02' : '\x00'), '\xff' });
+
+    raw_deflate(data, level, out);
+
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    append_le32(out, crc.checksum());
+    append_le32(out, static_cast<std::uint32_t>(data.size()));
+
+    return out;
+}
+
+std::string
+compression::deflate(const std::string_view data, const int level)
+{
+    std::string out;
+    out.reserve(6 + data.size() / 2);
+
+    // Header: 32K window, FLEVEL matching the level, FCHECK making the header a multiple of 31
+    const std::uint8_t cmf = 0x78;
+    const std::uint8_t flevel = level >= 9 ? 3 : (level >= 6 ? 2 : (level >= 2 ? 1 : 0));
+    std::uint8_t flg = static_cast<std::uint8_t>(flevel << 6);
+    flg += static_cast<std::uint8_t>(31 - ((cmf * 256 + flg) % 31)) % 31;
+    out += static_cast<char>(cmf);
+    out += static_cast<char>(flg);
+
+    raw_deflate(data, level, out);
+
+    append_be32(out, adler32(data));
+
+    return out;
+}
+
+compression::coding
+compression::negotiate(const std::string_view accept_encoding, const bool gzip, const bool deflate)
+{
+    if (accept_encoding.empty())
+        return coding::identity;
+
+    int q_gzip = -1;
+    int q_deflate = -1;
+    int q_identity = -1;
+    int q_any = -1;
+
+    std::string_view rest = accept_encoding;
+    while (!rest.empty()) {
+        const auto sep = rest.find(',');
+        const std::string_view element = rest.substr(0, sep);
+        rest = (sep == std::string_view::npos) ? std::string_view{ } : rest.substr(sep + 1);
+
+        const std::string_view name = trim_ows(element.substr(0, element.find(';')));
+        const int q = quality(element);
+        if (iequals(name, "gzip") || iequals(name, "x-gzip"))
+            q_gzip = q;
+        else if (iequals(name, "deflate"))
+            q_deflate = q;
+        else if (iequals(name, "identity"))
+            q_identity = q;
+        else if (name == "*")
+            q_any = q;
+    }
+
+    // Codings not listed are covered by "*", identity is acceptable (with the lowest preference) unless excluded
+    if (q_gzip < 0)
+        q_gzip = std::max(q_any, 0);
+    if (q_deflate < 0)
+        q_deflate = std::max(q_any, 0);
+    if (q_identity < 0)
+        q_identity = q_any < 0 ? 1 : q_any;
+
+    coding best = coding::identity;
+    int best_q = q_identity;
+    if (deflate && q_deflate > 0 && q_deflate >= best_q) {
+        best = coding::deflate;
+        best_q = q_deflate;
+    }
+    if (gzip && q_gzip > 0 && q_gzip >= best_q)
+        best = coding::gzip;
+
+    return best;
+}
+
+compression::precompressed
+compression::precompress(const std::filesystem::path& path, const std::string_view content, const std::size_t min_compress_size)
+{
+    precompressed p;
+    p.mime_type = malloy::mime_type(path);
+    p.etag = make_etag(content);
+
+    if (content.size() >= min_compress_size && is_compressible(p.mime_type)) {
+        // Only worth it if smaller
+        p.gzip = gzip(content);
+        if (p.gzip.size() >= content.size())
+            p.gzip.clear();
+
+        p.deflate = deflate(content);
+        if (p.deflate.size() >= content.size())
+            p.deflate.clear();
+    }
+
+    return p;
+}
+
+bool
+compression::is_compressible(const std::string_view mime_type)
+{
+    if (mime_type.starts_with("text/"))
+        return true;
+
+    constexpr std::array compressible{
+        std::string_view{ "application/javascript" },
+        std::string_view{ "application/json" },
+        std::string_view{ "application/xml" },
+        std::string_view{ "application/xhtml+xml" },
+        std::string_view{ "application/rtf" },
+        std::string_view{ "application/x-sh" },
+        std::string_view{ "application/x-csh" },
+        std::string_view{ "application/vnd.ms-fontobject" },
+        std::string_view{ "image/svg+xml" },
+        std::string_view{ "image/bmp" },
+        std::string_view{ "image/vnd.microsoft.icon" },
+        std::string_view{ "font/otf" },
+        std::string_view{ "font/ttf" },
+    };
+
+    return std::ranges::find(compressible, mime_type.substr(0, mime_type.find(';'))) != std::end(compressible);
+}
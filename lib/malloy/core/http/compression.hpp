@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace malloy::http::compression
+{
+
+    /**
+     * A content coding.
+     */
+    enum class coding
+    {
+        identity,
+        gzip,
+        deflate,
+    };
+
+    /**
+     * Gets the name of a content coding (as used in the `Content-Encoding` header).
+     *
+     * @param c The coding.
+     * @return The name.
+     */
+    [[nodiscard]]
+    constexpr
+    std::string_view
+    to_string(const coding c) noexcept
+    {
+        switch (c) {
+            case coding::gzip:      return "gzip";
+            case coding::deflate:   return "deflate";
+            default:                return "identity";
+        }
+    }
+
+    /**
+     * Derives the entity tag of a coded representation from the tag of the identity representation.
+     *
+     * @details The coding is appended to the opaque tag (e.g. `"<hash>-<size>"` becomes `"<hash>-<size>-gzip"`), so
+     *          that every representation has a distinct strong tag.
+     *
+     * @param etag The entity tag of the identity representation (including the quotes).
+     * @param c The coding.
+     * @return The entity tag of the coded representation (including the quotes).
+     */
+    [[nodiscard]]
+    std::string
+    coded_etag(std::string_view etag, coding c);
+
+    /**
+     * Compresses data into the gzip format (RFC 1952).
+     *
+     * @param data The data.
+     * @param level The compression level (1 - 9).
+     * @return The compressed data.
+     */
+    [[nodiscard]]
+    std::string
+    gzip(std::string_view data, int level = 9);
+
+    /**
+     * Compresses data into the zlib format (RFC 1950) as used by the `deflate` content coding.
+     *
+     * @param data The data.
+     * @param level The compression level (1 - 9).
+     * @return The compressed data.
+     */
+    [[nodiscard]]
+    std::string
+    deflate(std::string_view data, int level = 9);
+
+    /**
+     * Picks the content coding of a response.
+     *
+     * @details The acceptable coding with the highest quality value is picked. On a tie, compressed codings are
+     *          preferred (gzip over deflate). Unless listed, identity is only picked if no acceptable compressed
+     *          representation is available.
+     *
+     * @param accept_encoding The value of the `Accept-Encoding` request header (empty if absent).
+     * @param gzip Whether a gzip coded representation is available.
+     * @param deflate Whether a deflate coded representation is available.
+     * @return The coding.
+     */
+    [[nodiscard]]
+    coding
+    negotiate(std::string_view accept_encoding, bool gzip, bool deflate);
+
+    /**
+     * A static representation prepared for serving.
+     */
+    struct precompressed
+    {
+        std::string_view mime_type;     ///< The MIME type.
+        std::string etag;               ///< The strong entity tag of the content (including the quotes).
+        std::string gzip;               ///< The gzip compressed content (empty if not worth it).
+        std::string deflate;            ///< The deflate compressed content (empty if not worth it).
+    };
+
+    /**
+     * Prepares the content of a static file for serving.
+     *
+     * @details The MIME type is derived from the file extension, the entity tag from the content
+     *          (see @ref malloy::http::make_etag()). Compressible types (see @ref is_compressible()) of at least the
+     *          minimum size are compressed. A compressed variant is only kept if it is smaller than the content.
+     *
+     * @param path The path of the file.
+     * @param content The content of the file.
+     * @param min_compress_size Smaller contents are not compressed.
+     * @return The prepared representation.
+     */
+    [[nodiscard]]
+    precompressed
+    precompress(const std::filesystem::path& path, std::string_view content, std::size_t min_compress_size);
+
+    /**
+     * Checks whether a MIME type is worth compressing.
+     *
+     * @details Textual formats are, already compressed formats (images, videos, archives, ...) are not.
+     *
+     * @param mime_type The MIME type.
+     * @return Whether to compress.
+     */
+    [[nodiscard]]
+    bool
+    is_compressible(std::string_view mime_type);
+
+}
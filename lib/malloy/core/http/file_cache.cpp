@@ -0,0 +1,307 @@
+#include "file_cache.hpp"
+#include "../utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+using namespace malloy::http;
+
+namespace
+{
+
+    /**
+     * Normalizes a relative path into a key.
+     *
+     * @return The key (empty if the path was rejected).
+     */
+    [[nodiscard]]
+    std::string_view
+    normalize(std::string_view rel_path)
+    {
+        if (rel_path.find("..") != std::string_view::npos)
+            return { };
+
+        while (rel_path.starts_with('/'))
+            rel_path.remove_prefix(1);
+
+        return rel_path;
+    }
+
+    /**
+     * Gets the directory of a key.
+     */
+    [[nodiscard]]
+    std::string_view
+    parent_of(const std::string_view key)
+    {
+        const auto pos = key.rfind('/');
+        return pos == std::string_view::npos ? std::string_view{ } : key.substr(0, pos);
+    }
+
+#if defined(__linux__)
+    constexpr std::uint32_t watch_mask =
+        IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_DELETE_SELF |
+        IN_MODIFY | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+#endif
+
+}
+
+file_cache::file_cache(std::filesystem::path base_path) :
+    file_cache{ std::move(base_path), config{ } }
+{
+}
+
+file_cache::file_cache(std::filesystem::path base_path, config cfg) :
+    m_base_path{ std::move(base_path) },
+    m_cfg{ std::move(cfg) }
+{
+#if defined(__linux__)
+    if (m_cfg.watch)
+        m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+file_cache::~file_cache()
+{
+#if defined(__linux__)
+    if (m_inotify >= 0)
+        ::close(m_inotify);
+#endif
+}
+
+std::shared_ptr<const file_cache::entry>
+file_cache::get(const std::string_view rel_path, const clock::time_point now)
+{
+    const std::string_view key = normalize(rel_path);
+    if (key.empty())
+        return std::make_shared<const entry>();
+
+    // Valid entry (unless changes are to be processed first)
+    if (!events_due(now)) {
+        // Acquire mutex
+        std::shared_lock lock(m_lock);
+
+        if (const auto it = m_index.find(key); it != std::end(m_index) && now < it->second->expires) {
+            it->second->referenced.store(true, std::memory_order_relaxed);
+            return it->second->value;
+        }
+    }
+
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    process_events(now);
+
+    if (const auto it = m_index.find(key); it != std::end(m_index)) {
+        if (now < it->second->expires) {
+            it->second->referenced.store(true, std::memory_order_relaxed);
+            return it->second->value;
+        }
+
+        erase(it->second);
+    }
+
+    // Evict (before inserting so that the new entry isn't a candidate)
+    while (!m_items.empty() && m_items.size() >= std::max<std::size_t>(m_cfg.max_entries, 1)) {
+        const auto victim = std::prev(std::end(m_items));
+        if (victim->referenced.exchange(false, std::memory_order_relaxed))
+            m_items.splice(std::begin(m_items), m_items, victim);
+        else
+            erase(victim);
+    }
+
+    // Watch the directory before checking the file so that no change goes unnoticed
+    watch(key);
+
+    item& i = m_items.emplace_front();
+    i.key = key;
+    i.value = load(i.key);
+    i.expires = now + m_cfg.ttl;
+    m_index.emplace(i.key, std::begin(m_items));
+
+    return i.value;
+}
+
+bool
+file_cache::invalidate(const std::string_view rel_path)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    const auto it = m_index.find(normalize(rel_path));
+    if (it == std::end(m_index))
+        return false;
+
+    erase(it->second);
+
+    return true;
+}
+
+void
+file_cache::clear()
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    m_index.clear();
+    m_items.clear();
+}
+
+std::size_t
+file_cache::size() const
+{
+    // Acquire mutex
+    std::shared_lock lock(m_lock);
+
+    return m_items.size();
+}
+
+std::shared_ptr<const file_cache::entry>
+file_cache::load(const std::string& key) const
+{
+    const std::filesystem::path path = m_base_path / key;
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return std::make_shared<const entry>();
+
+    auto file = std::make_shared<boost::beast::file>();
+    malloy::error_code bec;
+    file->open(path.string().c_str(), boost::beast::file_mode::scan, bec);
+    if (bec)
+        return std::make_shared<const entry>();
+
+    auto e = std::make_shared<entry>();
+    e->size = file->size(bec);
+    e->mtime = std::filesystem::last_write_time(path, ec);
+    e->mime_type = malloy::mime_type(path);
+    if (bec || ec)
+        return std::make_shared<const entry>();
+
+    e->file = std::move(file);
+
+    return e;
+}
+
+void
+file_cache::watch([[maybe_unused]] const std::string_view key)
+{
+#if defined(__linux__)
+    if (m_inotify < 0)
+        return;
+
+    const std::string_view dir = parent_of(key);
+    if (m_watched_dirs.contains(dir))
+        return;
+
+    // A directory which doesn't exist (yet) can't be watched, its negative entries are subject to the TTL only
+    const int wd = ::inotify_add_watch(m_inotify, (m_base_path / dir).c_str(), watch_mask);
+    if (wd < 0)
+        return;
+
+    // The same directory might be reached through different paths (e.g. symlinks)
+    if (const auto it = m_watches.find(wd); it != std::end(m_watches))
+        m_watched_dirs.erase(it->second);
+
+    m_watches.insert_or_assign(wd, std::string{ dir });
+    m_watched_dirs.emplace(std::string{ dir }, wd);
+#endif
+}
+
+bool
+file_cache::events_due([[maybe_unused]] const clock::time_point now) const noexcept
+{
+#if defined(__linux__)
+    return m_inotify >= 0 && now.time_since_epoch().count() >= m_next_events.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+void
+file_cache::process_events(const clock::time_point now)
+{
+#if defined(__linux__)
+    if (!events_due(now))
+        return;
+    m_next_events.store((now + m_cfg.watch_interval).time_since_epoch().count(), std::memory_order_relaxed);
+
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    for (;;) {
+        const ssize_t n = ::read(m_inotify, buffer.data(), buffer.size());
+        if (n <= 0)
+            return;
+
+        for (ssize_t offset = 0; offset < n; ) {
+            inotify_event event;
+            std::memcpy(&event, buffer.data() + offset, sizeof(event));
+            const std::string_view name{ buffer.data() + offset + sizeof(event), ::strnlen(buffer.data() + offset + sizeof(event), event.len) };
+            offset += static_cast<ssize_t>(sizeof(event) + event.len);
+
+            // Events were lost
+            if (event.mask & IN_Q_OVERFLOW) {
+                m_index.clear();
+                m_items.clear();
+                continue;
+            }
+
+            const auto it = m_watches.find(event.wd);
+            if (it == std::end(m_watches))
+                continue;
+
+            // The directory itself is gone
+            if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                invalidate_tree(it->second);
+                if (event.mask & IN_IGNORED) {
+                    m_watched_dirs.erase(it->second);
+                    m_watches.erase(it);
+                }
+                continue;
+            }
+
+            if (name.empty())
+                continue;
+
+            std::string key = it->second;
+            if (!key.empty())
+                key += '/';
+            key += name;
+
+            if (event.mask & IN_ISDIR)
+                invalidate_tree(key);
+            else if (const auto entry = m_index.find(key); entry != std::end(m_index))
+                erase(entry->second);
+        }
+    }
+#endif
+}
+
+void
+file_cache::invalidate_tree(const std::string_view key)
+{
+    if (const auto it = m_index.find(key); it != std::end(m_index))
+        erase(it->second);
+
+    // Entries below the directory
+    for (auto it = std::begin(m_items); it != std::end(m_items); ) {
+        const std::string_view k = it->key;
+        const auto next = std::next(it);
+        if (key.empty() || (k.size() > key.size() && k.starts_with(key) && k[key.size()] == '/'))
+            erase(it);
+        it = next;
+    }
+}
+
+void
+file_cache::erase(const items_t::iterator it)
+{
+    m_index.erase(it->key);
+    m_items.erase(it);
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "shared_file.hpp"
+
+#include <boost/beast/core/file.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace malloy::http
+{
+
+    /**
+     * A cache of open files.
+     *
+     * @details Files below a base path are looked up by their path relative to the base path. A lookup which misses
+     *          checks the file, opens it and caches the descriptor together with the size, modification time & MIME
+     *          type of the file. Files which don't exist are cached as well (negative entries), so that repeated
+     *          requests for them don't hit the filesystem either.
+     *
+     *          Entries are looked up again once their TTL expired. On Linux, the directories of cached entries are
+     *          watched with inotify so that entries are invalidated shortly after their file changed (the changes are
+     *          processed at most once per watch interval). Entries are evicted in approximately least-recently-used
+     *          order once the cache grows beyond its size limit: Entries used since they were last considered for
+     *          eviction get a second chance.
+     *
+     *          Lookups hitting a valid entry only take a shared lock.
+     *
+     *          The descriptors are shared by all responses served from them (see @ref shared_file).
+     *
+     *          The cache is thread-safe.
+     *
+     * @sa generator::file()
+     */
+    class file_cache
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * Cache configuration.
+         */
+        struct config
+        {
+            std::size_t max_entries = 1024;                     ///< The maximum number of entries (including negative ones).
+            clock::duration ttl = std::chrono::seconds{5};      ///< How long an entry is used before the file is looked up again.
+            bool watch = true;                                  ///< Whether to invalidate entries on changes reported by inotify (Linux only).
+            clock::duration watch_interval = std::chrono::milliseconds{100};    ///< How often changes reported by inotify are processed (at most).
+        };
+
+        /**
+         * A cached file.
+         */
+        struct entry
+        {
+            std::shared_ptr<const boost::beast::file> file;     ///< The open file (empty if the file doesn't exist).
+            std::uint64_t size = 0;                             ///< The size of the file.
+            std::filesystem::file_time_type mtime;              ///< The modification time of the file.
+            std::string_view mime_type;                         ///< The MIME type of the file.
+
+            /**
+             * Checks whether the file exists.
+             *
+             * @return Whether the file exists.
+             */
+            [[nodiscard]]
+            bool
+            exists() const noexcept
+            {
+                return file != nullptr;
+            }
+
+            /**
+             * Creates a file sharing the descriptor of the entry.
+             *
+             * @return The file.
+             */
+            [[nodiscard]]
+            shared_file
+            open() const
+            {
+                return shared_file{ file, size };
+            }
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param base_path The base path of the files.
+         */
+        explicit
+        file_cache(std::filesystem::path base_path);
+
+        /**
+         * Constructor.
+         *
+         * @param base_path The base path of the files.
+         * @param cfg The configuration.
+         */
+        file_cache(std::filesystem::path base_path, config cfg);
+
+        file_cache(const file_cache& other) = delete;
+        file_cache(file_cache&& other) noexcept = delete;
+        ~file_cache();
+
+        file_cache& operator=(const file_cache& rhs) = delete;
+        file_cache& operator=(file_cache&& rhs) noexcept = delete;
+
+        /**
+         * Looks up a file.
+         *
+         * @param rel_path The path of the file relative to the base path. Paths containing `..` are rejected.
+         * @param now The current time.
+         * @return The entry (a negative one if the file doesn't exist or the path was rejected).
+         */
+        [[nodiscard]]
+        std::shared_ptr<const entry>
+        get(std::string_view rel_path, clock::time_point now = clock::now());
+
+        /**
+         * Removes an entry.
+         *
+         * @param rel_path The path of the file relative to the base path.
+         * @return Whether an entry was removed.
+         */
+        bool
+        invalidate(std::string_view rel_path);
+
+        /**
+         * Removes all entries.
+         */
+        void
+        clear();
+
+        /**
+         * Gets the number of entries.
+         *
+         * @return The number of entries.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const;
+
+        /**
+         * Gets the base path.
+         *
+         * @return The base path.
+         */
+        [[nodiscard]]
+        const std::filesystem::path&
+        base_path() const noexcept
+        {
+            return m_base_path;
+        }
+
+    private:
+        struct item
+        {
+            std::string key;
+            std::shared_ptr<const entry> value;
+            clock::time_point expires;
+            mutable std::atomic<bool> referenced = false;       // Used since last considered for eviction
+        };
+
+        struct key_hash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]]
+            std::size_t
+            operator()(std::string_view str) const noexcept
+            {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        using items_t = std::list<item>;        // Most recently inserted (or given a second chance) first
+
+        const std::filesystem::path m_base_path;
+        const config m_cfg;
+        mutable std::shared_mutex m_lock;       // protects everything below (except m_next_events)
+        items_t m_items;
+        std::unordered_map<std::string, items_t::iterator, key_hash, std::equal_to<>> m_index;
+
+        // inotify instance & watched directories (relative to the base path)
+        int m_inotify = -1;
+        std::unordered_map<int, std::string> m_watches;
+        std::unordered_map<std::string, int, key_hash, std::equal_to<>> m_watched_dirs;
+        std::atomic<clock::rep> m_next_events{0};      // When changes are processed next (time since epoch)
+
+        [[nodiscard]]
+        std::shared_ptr<const entry>
+        load(const std::string& key) const;
+
+        void
+        watch(std::string_view key);
+
+        /**
+         * Checks whether the changes reported by inotify are due to be processed.
+         */
+        [[nodiscard]]
+        bool
+        events_due(clock::time_point now) const noexcept;
+
+        /**
+         * Invalidates the entries of the changes reported by inotify (if due).
+         */
+        void
+        process_events(clock::time_point now);
+
+        /**
+         * Removes an entry and all entries below it.
+         */
+        void
+        invalidate_tree(std::string_view key);
+
+        void
+        erase(items_t::iterator it);
+    };
+
+}
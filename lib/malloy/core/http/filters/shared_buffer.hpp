@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../response.hpp"
+#include "../request.hpp"
+#include "../shared_buffer_body.hpp"
+
+#include <variant>
+
+namespace malloy::http::filters
+{
+
+    /**
+     * @brief Receives the contents of a message into a shared buffer
+     * @details The received body can be handed on (e.g. sent as a response to many clients) without being copied.
+     */
+    template<bool isRequest>
+    struct basic_shared_buffer
+    {
+        using response_type = malloy::http::response<shared_buffer_body>;
+        using request_type = malloy::http::request<shared_buffer_body>;
+        using value_type = shared_buffer_body::value_type;
+        using header_type = boost::beast::http::header<isRequest>;
+
+        [[nodiscard]]
+        std::variant<shared_buffer_body>
+        body_for(const header_type&) const
+        {
+            return { };
+        }
+
+        void
+        setup_body(const header_type&, value_type&) const
+        {
+        }
+    };
+
+    using shared_buffer_request = basic_shared_buffer<true>;
+    using shared_buffer_response = basic_shared_buffer<false>;
+
+}
@@ -3,8 +3,279 @@
 #include "request.hpp"
 #include <boost/beast/core/file_base.hpp>
 
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
 using namespace malloy::http;
 
+namespace
+{
+
+    /**
+     * A file response: the whole file, a single range of it or an in-memory response (multipart or error).
+     */
+    template<class File>
+    using file_response_t = std::variant<
+        response<boost::beast::http::basic_file_body<File>>,
+        response<boost::beast::http::basic_file_body<file_range<File>>>,
+        response<boost::beast::http::string_body>
+    >;
+
+    /**
+     * Narrows a file response to a request without ranges (i.e. the whole file or an in-memory response).
+     */
+    template<class File>
+    [[nodiscard]]
+    std::variant<response<boost::beast::http::basic_file_body<File>>, response<boost::beast::http::string_body>>
+    whole_file(file_response_t<File>&& resp)
+    {
+        if (auto* str = std::get_if<response<boost::beast::http::string_body>>(&resp))
+            return std::move(*str);
+
+        return std::move(std::get<response<boost::beast::http::basic_file_body<File>>>(resp));
+    }
+
+    [[nodiscard]]
+    std::string
+    last_modified(const std::filesystem::file_time_type mtime)
+    {
+#if defined(_MSC_VER)
+        const auto tp = std::chrono::clock_cast<std::chrono::system_clock>(mtime);
+#else
+        const auto tp = std::chrono::file_clock::to_sys(mtime);
+#endif
+
+        return to_http_date(std::chrono::time_point_cast<std::chrono::system_clock::duration>(tp));
+    }
+
+    [[nodiscard]]
+    std::string
+    content_range(const byte_range range, const std::uint64_t size)
+    {
+        return "bytes " + std::to_string(range.first) + "-" + std::to_string(range.last) + "/" + std::to_string(size);
+    }
+
+    [[nodiscard]]
+    std::string
+    make_boundary()
+    {
+        thread_local std::mt19937_64 rng{ std::random_device{ }() };
+
+        constexpr std::string_view digits = "0123456789abcdef";
+        std::string boundary = "malloy-";
+        std::uint64_t value = rng();
+        for (int i = 0; i < 16; ++i, value >>= 4)
+            boundary += digits[value & 0xf];
+
+        return boundary;
+    }
+
+    /**
+     * Reads ranges of a file into a `multipart/byteranges` body (RFC 9110, 14.6).
+     */
+    template<class File>
+    [[nodiscard]]
+    std::string
+    multipart_body(File& file, const std::vector<byte_range>& ranges, const std::uint64_t size, const std::string_view boundary, const std::string_view mime_type, malloy::error_code& ec)
+    {
+        std::uint64_t total = 0;
+        for (const byte_range& r : ranges)
+            total += r.length();
+
+        std::string body;
+        body.reserve(static_cast<std::size_t>(total) + ranges.size() * (boundary.size() + mime_type.size() + 80));
+
+        for (const byte_range& r : ranges) {
+            body += "--";
+            body += boundary;
+            body += "\r\nContent-Type: ";
+            body += mime_type;
+            body += "\r\nContent-Range: ";
+            body += content_range(r, size);
+            body += "\r\n\r\n";
+
+            file.seek(r.first, ec);
+            if (ec)
+                return { };
+
+            const std::size_t offset = body.size();
+            body.resize(offset + static_cast<std::size_t>(r.length()));
+            std::size_t n = 0;
+            while (n < r.length()) {
+                const std::size_t read = file.read(body.data() + offset + n, static_cast<std::size_t>(r.length()) - n, ec);
+                if (ec)
+                    return { };
+                if (read == 0) {
+                    ec = boost::beast::http::error::short_read;
+                    return { };
+                }
+                n += read;
+            }
+
+            body += "\r\n";
+        }
+
+        body += "--";
+        body += boundary;
+        body += "--\r\n";
+
+        return body;
+    }
+
+    /**
+     * Creates the response serving a file (or ranges of it).
+     *
+     * @param req The request header (if any).
+     * @param file The open file.
+     * @param mime_type The MIME type of the file.
+     * @param modified The value of the Last-Modified header.
+     */
+    template<class File>
+    [[nodiscard]]
+    file_response_t<File>
+    make_file_response(const boost::beast::http::request_header<>* req, File&& file, const std::string_view mime_type, const std::string& modified)
+    {
+        malloy::error_code ec;
+        const std::uint64_t size = file.size(ec);
+        if (ec)
+            return generator::server_error(ec.message());
+
+        const auto set_common = [&modified](auto& resp) {
+            resp.set(field::accept_ranges, "bytes");
+            resp.set(field::last_modified, modified);
+        };
+
+        // Requested ranges (if any and still valid)
+        std::optional<std::vector<byte_range>> ranges;
+        if (req && req->method() == method::get) {
+            if (const auto range = req->find(field::range); range != std::end(*req)) {
+                const auto if_range = req->find(field::if_range);
+                if (if_range == std::end(*req) || if_range_matches(if_range->value(), { }, modified))
+                    ranges = parse_range(range->value(), size);
+            }
+        }
+
+        // Unsatisfiable
+        if (ranges && ranges->empty()) {
+            response<> resp{ status::range_not_satisfiable };
+            set_common(resp);
+            resp.set(field::content_range, "bytes */" + std::to_string(size));
+
+            return resp;
+        }
+
+        // Single range
+        if (ranges && ranges->size() == 1) {
+            const byte_range r = ranges->front();
+
+            response<boost::beast::http::basic_file_body<file_range<File>>> resp{ status::partial_content };
+            set_common(resp);
+            resp.set(field::content_type, mime_type);
+            resp.set(field::content_range, content_range(r, size));
+
+            file_range<File> range{ std::move(file), r, ec };
+            if (!ec)
+                resp.body().reset(std::move(range), ec);
+            if (ec)
+                return generator::server_error(ec.message());
+
+            return resp;
+        }
+
+        // Multiple ranges
+        if (ranges) {
+            std::uint64_t total = 0;
+            for (const byte_range& r : *ranges)
+                total += r.length();
+
+            if (total <= generator::max_multipart_size) {
+                const std::string boundary = make_boundary();
+
+                response<> resp{ status::partial_content };
+                set_common(resp);
+                resp.set(field::content_type, "multipart/byteranges; boundary=" + boundary);
+                resp.body() = multipart_body(file, *ranges, size, boundary, mime_type, ec);
+                if (ec)
+                    return generator::server_error(ec.message());
+
+                return resp;
+            }
+        }
+
+        // Whole file
+        response<boost::beast::http::basic_file_body<File>> resp{ status::ok };
+        set_common(resp);
+        resp.set(field::content_type, mime_type);
+
+        resp.body().reset(std::move(file), ec);
+        if (ec)
+            return generator::server_error(ec.message());
+
+        return resp;
+    }
+
+    [[nodiscard]]
+    file_response_t<boost::beast::file>
+    serve_file(const boost::beast::http::request_header<>* req, const std::filesystem::path& storage_base_path, std::string_view rel_path)
+    {
+        // Sanitize rel_path
+        {
+            // Check for relative paths
+            if (rel_path.find("..") != std::string::npos)
+                return generator::bad_request("resource path must not contain \"..\"");
+
+            // Drop leading slash, if any
+            if (rel_path.starts_with("/"))
+                rel_path = rel_path.substr(1);
+        }
+
+        const std::filesystem::path& path = storage_base_path / rel_path;
+
+        // Check whether this is a valid file path
+        if (!std::filesystem::is_regular_file(path))
+            return generator::not_found(rel_path);
+
+        // Get mime type
+        const std::string_view& mime_type = malloy::mime_type(path);
+
+        std::error_code fs_ec;
+        const auto mtime = std::filesystem::last_write_time(path, fs_ec);
+        if (fs_ec)
+            return generator::server_error(fs_ec.message());
+
+        boost::beast::error_code ec;
+        boost::beast::file file;
+        file.open(path.string().c_str(), boost::beast::file_mode::scan, ec);
+        if (ec)
+            return generator::server_error(ec.message());
+
+        return make_file_response(req, std::move(file), mime_type, last_modified(mtime));
+    }
+
+    [[nodiscard]]
+    file_response_t<shared_file>
+    serve_file(const boost::beast::http::request_header<>* req, file_cache& cache, std::string_view rel_path)
+    {
+        // Check for relative paths
+        if (rel_path.find("..") != std::string::npos)
+            return generator::bad_request("resource path must not contain \"..\"");
+
+        const auto entry = cache.get(rel_path);
+        if (!entry->exists()) {
+            if (rel_path.starts_with("/"))
+                rel_path = rel_path.substr(1);
+
+            return generator::not_found(rel_path);
+        }
+
+        return make_file_response(req, entry->open(), entry->mime_type, last_modified(entry->mtime));
+    }
+
+}
+
 response<>
 generator::ok()
 {
@@ -13,6 +284,17 @@ generator::ok()
     return resp;
 }
 
+response<shared_buffer_body>
+generator::ok(shared_buffer_body::value_type body, const std::string_view content_type)
+{
+    response<shared_buffer_body> resp{ status::ok };
+    resp.set(field::content_type, content_type);
+    resp.body() = std::move(body);
+    resp.prepare_payload();
+
+    return resp;
+}
+
 response<>
 generator::redirect(const status code, const std::string_view location)
 {
@@ -54,36 +336,25 @@ generator::server_error(std::string_view what)
 }
 
 generator::file_response
-generator::file(const std::filesystem::path& storage_base_path, std::string_view rel_path)
+generator::file(const std::filesystem::path& storage_path, const std::string_view rel_path)
 {
-    // Sanitize rel_path
-    {
-        // Check for relative paths
-        if (rel_path.find("..") != std::string::npos)
-            return bad_request("resource path must not contain \"..\"");
-
-        // Drop leading slash, if any
-        if (rel_path.starts_with("/"))
-            rel_path = rel_path.substr(1);
-    }
-
-    const std::filesystem::path& path = storage_base_path / rel_path;
-
-    // Check whether this is a valid file path
-    if (!std::filesystem::is_regular_file(path))
-        return not_found(rel_path);
-
-    // Get mime type
-    const std::string_view& mime_type = malloy::mime_type(path);
+    return whole_file(serve_file(nullptr, storage_path, rel_path));
+}
 
-    // Create response
-    response<boost::beast::http::file_body> resp{status::ok};
-    resp.set(field::content_type, mime_type);
+generator::ranged_file_response
+generator::file(const boost::beast::http::request_header<>& req, const std::filesystem::path& storage_path, const std::string_view rel_path)
+{
+    return serve_file(&req, storage_path, rel_path);
+}
 
-    boost::beast::error_code ec;
-    resp.body().open(path.string().c_str(), boost::beast::file_mode::scan, ec);
-    if (ec)
-        return server_error(ec.message());
+generator::cached_file_response
+generator::file(file_cache& cache, const std::string_view rel_path)
+{
+    return whole_file(serve_file(nullptr, cache, rel_path));
+}
 
-    return resp;
+generator::ranged_cached_file_response
+generator::file(const boost::beast::http::request_header<>& req, file_cache& cache, const std::string_view rel_path)
+{
+    return serve_file(&req, cache, rel_path);
 }
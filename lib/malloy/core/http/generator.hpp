@@ -1,11 +1,16 @@
 #pragma once
 
+#include "file_cache.hpp"
+#include "range.hpp"
 #include "response.hpp"
 #include "request.hpp"
+#include "shared_buffer_body.hpp"
+#include "shared_file.hpp"
 #include "type_traits.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
+#include <cstdint>
 #include <filesystem>
 #include <string_view>
 #include <variant>
@@ -28,7 +33,31 @@ namespace malloy::http
          */
         using file_response = std::variant<response<boost::beast::http::file_body>, response<boost::beast::http::string_body>>;
 
+        /**
+         * A file response to a request which might ask for ranges.
+         *
+         * In addition to a @ref file_response, a file range body serves a single range of a file (`206 Partial Content`).
+         */
+        using ranged_file_response = std::variant<response<boost::beast::http::file_body>, response<file_range_body>, response<boost::beast::http::string_body>>;
+
+        /**
+         * A file response served from a @ref file_cache (or an error response).
+         */
+        using cached_file_response = std::variant<response<shared_file_body>, response<boost::beast::http::string_body>>;
+
+        /**
+         * A file response to a request which might ask for ranges served from a @ref file_cache (or an error response).
+         */
+        using ranged_cached_file_response = std::variant<response<shared_file_body>, response<shared_file_range_body>, response<boost::beast::http::string_body>>;
+
     public:
+        /**
+         * The maximum total size of the ranges of a `multipart/byteranges` response.
+         *
+         * @details The parts are assembled in memory.
+         */
+        static constexpr std::uint64_t max_multipart_size = 1024 * 1024;
+
         /**
          * Default constructor.
          */
@@ -55,6 +84,20 @@ namespace malloy::http
         response<>
         ok();
 
+        /**
+         * Construct a 200 response with a shared body.
+         *
+         * @details The body is not copied. This allows sending the same payload to many clients.
+         *
+         * @param body The body.
+         * @param content_type The content type.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        response<shared_buffer_body>
+        ok(shared_buffer_body::value_type body, std::string_view content_type);
+
         /**
          * Construct a 3xx response.
          *
@@ -103,6 +146,8 @@ namespace malloy::http
         /**
          * Construct a file response.
          *
+         * @details `Range` requests are honored (see @ref file(const boost::beast::http::request_header<>&, const std::filesystem::path&, std::string_view)).
+         *
          * @param req The request to be responded to.
          * @param storage_base_path The base path to the local filesystem.
          * @return The response.
@@ -110,12 +155,30 @@ namespace malloy::http
         template<malloy::http::concepts::body Body>
         [[nodiscard]]
         static
-        file_response
+        ranged_file_response
         file(const request<Body>& req, const std::filesystem::path& storage_base_path)
         {
-	        return file(storage_base_path, malloy::http::resource_string(req));
+	        return file(req.base(), storage_base_path, malloy::http::resource_string(req));
         }
 
+        /**
+         * Construct a file response to a request.
+         *
+         * @details Single `Range`s are served with `206 Partial Content` from the file directly, multiple ranges as
+         *          `multipart/byteranges` (unless they exceed @ref max_multipart_size in total, in which case the
+         *          whole file is sent). Unsatisfiable ranges yield `416 Range Not Satisfiable`. `If-Range` is
+         *          validated against the `Last-Modified` header of the response.
+         *
+         * @param req The request header.
+         * @param storage_path The base path to the local filesystem.
+         * @param rel_path The file being requested relative to the storage_path.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        ranged_file_response
+        file(const boost::beast::http::request_header<>& req, const std::filesystem::path& storage_path, std::string_view rel_path);
+
         /**
          * Construct a file response.
          *
@@ -127,6 +190,52 @@ namespace malloy::http
         static
         file_response
         file(const std::filesystem::path& storage_path, std::string_view rel_path);
+
+        /**
+         * Construct a file response from a file cache.
+         *
+         * @param req The request to be responded to.
+         * @param cache The cache of the files.
+         * @return The response.
+         */
+        template<malloy::http::concepts::body Body>
+        [[nodiscard]]
+        static
+        ranged_cached_file_response
+        file(const request<Body>& req, file_cache& cache)
+        {
+            return file(req.base(), cache, malloy::http::resource_string(req));
+        }
+
+        /**
+         * Construct a file response to a request from a file cache.
+         *
+         * @details `Range` requests are honored like for files which are not cached.
+         *
+         * @param req The request header.
+         * @param cache The cache of the files.
+         * @param rel_path The file being requested relative to the base path of the cache.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        ranged_cached_file_response
+        file(const boost::beast::http::request_header<>& req, file_cache& cache, std::string_view rel_path);
+
+        /**
+         * Construct a file response from a file cache.
+         *
+         * @details The response is served from the descriptor kept open by the cache, the filesystem is only accessed
+         *          if the file is not cached yet.
+         *
+         * @param cache The cache of the files.
+         * @param rel_path The file being requested relative to the base path of the cache.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        cached_file_response
+        file(file_cache& cache, std::string_view rel_path);
     };
 
 }
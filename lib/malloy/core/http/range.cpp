@@ -0,0 +1,120 @@
+#include "range.hpp"
+#include "utils.hpp"
+
+#include <charconv>
+
+using namespace malloy::http;
+
+namespace
+{
+
+    /**
+     * Parses a non-empty sequence of digits.
+     */
+    [[nodiscard]]
+    std::optional<std::uint64_t>
+    parse_number(const std::string_view str)
+    {
+        std::uint64_t value = 0;
+        const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+        if (str.empty() || ec != std::errc{ } || ptr != str.data() + str.size())
+            return std::nullopt;
+
+        return value;
+    }
+
+}
+
+std::optional<std::vector<byte_range>>
+malloy::http::parse_range(std::string_view value, const std::uint64_t size, const std::size_t max_ranges)
+{
+    // Unit
+    value = trim_ows(value);
+    const auto eq = value.find('=');
+    if (eq == std::string_view::npos)
+        return std::nullopt;
+    const std::string_view unit = trim_ows(value.substr(0, eq));
+    if (unit.size() != 5 || !std::ranges::equal(unit, std::string_view{ "bytes" }, [](const char a, const char b) { return (a | 0x20) == b; }))
+        return std::nullopt;
+    value.remove_prefix(eq + 1);
+
+    std::vector<byte_range> ranges;
+    std::size_t count = 0;
+    while (!value.empty()) {
+        const auto sep = value.find(',');
+        const std::string_view spec = trim_ows(value.substr(0, sep));
+        value = (sep == std::string_view::npos) ? std::string_view{ } : value.substr(sep + 1);
+
+        // Empty list elements are allowed
+        if (spec.empty())
+            continue;
+
+        if (++count > max_ranges)
+            return std::nullopt;
+
+        const auto dash = spec.find('-');
+        if (dash == std::string_view::npos)
+            return std::nullopt;
+
+        // Suffix range (the last n bytes)
+        if (dash == 0) {
+            const auto n = parse_number(spec.substr(1));
+            if (!n)
+                return std::nullopt;
+            if (*n > 0 && size > 0)
+                ranges.push_back({ .first = size - std::min(*n, size), .last = size - 1 });
+            continue;
+        }
+
+        const auto first = parse_number(spec.substr(0, dash));
+        if (!first)
+            return std::nullopt;
+
+        std::uint64_t last = size > 0 ? size - 1 : 0;
+        if (dash + 1 < spec.size()) {
+            const auto l = parse_number(spec.substr(dash + 1));
+            if (!l || *l < *first)
+                return std::nullopt;
+            last = std::min(*l, last);
+        }
+
+        // Unsatisfiable
+        if (*first >= size)
+            continue;
+
+        ranges.push_back({ .first = *first, .last = last });
+    }
+
+    if (count == 0)
+        return std::nullopt;
+
+    // Coalesce
+    std::ranges::sort(ranges, {}, &byte_range::first);
+    std::vector<byte_range> coalesced;
+    coalesced.reserve(ranges.size());
+    for (const byte_range& r : ranges) {
+        if (!coalesced.empty() && r.first <= coalesced.back().last + 1)
+            coalesced.back().last = std::max(coalesced.back().last, r.last);
+        else
+            coalesced.push_back(r);
+    }
+
+    return coalesced;
+}
+
+bool
+malloy::http::if_range_matches(std::string_view if_range, const std::string_view etag, const std::string_view last_modified)
+{
+    if_range = trim_ows(if_range);
+
+    // Weak entity tags never match
+    if (if_range.starts_with("W/"))
+        return false;
+
+    // Entity tag
+    if (if_range.starts_with('"'))
+        return !etag.empty() && !etag.starts_with("W/") && if_range == etag;
+
+    // Date
+    return !last_modified.empty() && if_range == last_modified;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "shared_file.hpp"
+#include "../error.hpp"
+
+#include <boost/asio/error.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/basic_file_body.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace malloy::http
+{
+
+    /**
+     * A range of bytes (as used in `Range` & `Content-Range` headers).
+     */
+    struct byte_range
+    {
+        std::uint64_t first = 0;    ///< The position of the first byte.
+        std::uint64_t last = 0;     ///< The position of the last byte (inclusive).
+
+        /**
+         * Gets the number of bytes.
+         *
+         * @return The number of bytes.
+         */
+        [[nodiscard]]
+        constexpr
+        std::uint64_t
+        length() const noexcept
+        {
+            return last - first + 1;
+        }
+
+        [[nodiscard]]
+        constexpr
+        bool
+        operator==(const byte_range&) const noexcept = default;
+    };
+
+    /**
+     * Parses the value of a `Range` header (RFC 9110, 14.2).
+     *
+     * @details Ranges are clamped to the size of the representation, unsatisfiable ranges are dropped. The
+     *          remaining ranges are sorted; overlapping and adjacent ones are coalesced.
+     *
+     * @param value The value of the header.
+     * @param size The size of the representation.
+     * @param max_ranges The maximum number of ranges. Requests with more ranges are ignored.
+     * @return The ranges. Empty if none of them is satisfiable, `std::nullopt` if the header is to be ignored
+     *         (because it is malformed, uses another unit than bytes or has too many ranges).
+     */
+    [[nodiscard]]
+    std::optional<std::vector<byte_range>>
+    parse_range(std::string_view value, std::uint64_t size, std::size_t max_ranges = 32);
+
+    /**
+     * Checks whether the value of an `If-Range` header matches a representation.
+     *
+     * @details Entity tags are compared strongly (i.e. weak tags never match), dates must be equal to the
+     *          `Last-Modified` header of the representation.
+     *
+     * @param if_range The value of the header.
+     * @param etag The entity tag of the representation (if any).
+     * @param last_modified The value of the `Last-Modified` header of the representation (if any).
+     * @return Whether the range request is to be served.
+     */
+    [[nodiscard]]
+    bool
+    if_range_matches(std::string_view if_range, std::string_view etag, std::string_view last_modified);
+
+    /**
+     * A range of a file.
+     *
+     * @details This satisfies beast's File concept and exposes a range of an underlying file as if it was the whole
+     *          file, i.e. sizes and positions are relative to the beginning of the range.
+     *
+     * @tparam File The underlying file type.
+     */
+    template<class File>
+    class file_range
+    {
+    public:
+        file_range() = default;
+
+        /**
+         * Constructor.
+         *
+         * @param file The open file.
+         * @param range The range of the file.
+         * @param ec The error (if seeking to the beginning of the range fails).
+         */
+        file_range(File&& file, const byte_range range, malloy::error_code& ec) :
+            m_file{ std::move(file) },
+            m_offset{ range.first },
+            m_size{ range.length() }
+        {
+            m_file.seek(m_offset, ec);
+        }
+
+        /**
+         * Gets the underlying file.
+         *
+         * @return The file.
+         */
+        [[nodiscard]]
+        const File&
+        file() const noexcept
+        {
+            return m_file;
+        }
+
+        /**
+         * Gets the native handle of the underlying file.
+         *
+         * @return The handle.
+         */
+        [[nodiscard]]
+        auto
+        native_handle() const
+            requires requires(const File& f) { f.native_handle(); }
+        {
+            return m_file.native_handle();
+        }
+
+        /**
+         * Gets the position within the underlying file.
+         *
+         * @param ec The error.
+         * @return The position.
+         */
+        [[nodiscard]]
+        std::uint64_t
+        native_pos(malloy::error_code& ec) const
+        {
+            return m_file.pos(ec);
+        }
+
+        [[nodiscard]]
+        bool
+        is_open() const
+        {
+            return m_file.is_open();
+        }
+
+        void
+        close(malloy::error_code& ec)
+        {
+            m_file.close(ec);
+            m_offset = 0;
+            m_size = 0;
+        }
+
+        /**
+         * Opens a file (the range spans the whole file).
+         */
+        void
+        open(const char* path, const boost::beast::file_mode mode, malloy::error_code& ec)
+        {
+            m_file.open(path, mode, ec);
+            if (ec)
+                return;
+
+            m_offset = 0;
+            m_size = m_file.size(ec);
+        }
+
+        [[nodiscard]]
+        std::uint64_t
+        size(malloy::error_code& ec) const
+        {
+            ec = { };
+            return m_size;
+        }
+
+        [[nodiscard]]
+        std::uint64_t
+        pos(malloy::error_code& ec) const
+        {
+            return m_file.pos(ec) - m_offset;
+        }
+
+        void
+        seek(const std::uint64_t offset, malloy::error_code& ec)
+        {
+            m_file.seek(m_offset + std::min(offset, m_size), ec);
+        }
+
+        std::size_t
+        read(void* buffer, std::size_t n, malloy::error_code& ec)
+        {
+            const std::uint64_t p = pos(ec);
+            if (ec)
+                return 0;
+
+            n = static_cast<std::size_t>(std::min<std::uint64_t>(n, m_size - std::min(p, m_size)));
+            if (n == 0)
+                return 0;
+
+            return m_file.read(buffer, n, ec);
+        }
+
+        /**
+         * Fails with `operation_not_supported`.
+         */
+        std::size_t
+        write(const void*, std::size_t, malloy::error_code& ec)
+        {
+            ec = boost::asio::error::operation_not_supported;
+            return 0;
+        }
+
+    private:
+        File m_file;
+        std::uint64_t m_offset = 0;
+        std::uint64_t m_size = 0;
+    };
+
+    /**
+     * A body served from a range of a file.
+     */
+    using file_range_body = boost::beast::http::basic_file_body<file_range<boost::beast::file>>;
+
+    /**
+     * A body served from a range of a @ref shared_file.
+     */
+    using shared_file_range_body = boost::beast::http::basic_file_body<file_range<shared_file>>;
+
+}
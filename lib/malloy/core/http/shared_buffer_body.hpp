@@ -0,0 +1,222 @@
+#pragma once
+
+#include "../error.hpp"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/buffers_range.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace malloy::http
+{
+
+    /**
+     * A body referring to an immutable, shared buffer.
+     *
+     * @details Copying the body (e.g. to send the same payload to many clients) only copies a reference. The buffer
+     *          is written directly from its memory without being copied.
+     *
+     *          Received bodies are collected into a new buffer which is shared once complete.
+     */
+    struct shared_buffer_body
+    {
+        /**
+         * The body.
+         *
+         * @details A view into memory kept alive by its owner.
+         */
+        class value_type
+        {
+        public:
+            value_type() = default;
+
+            /**
+             * Constructor.
+             *
+             * @param str The buffer.
+             */
+            value_type(std::shared_ptr<const std::string> str) :
+                m_data{ str ? std::string_view{ *str } : std::string_view{ } },
+                m_owner{ std::move(str) }
+            {
+            }
+
+            /**
+             * Constructor.
+             *
+             * @param owner Keeps the memory alive.
+             * @param data The buffer.
+             */
+            value_type(std::shared_ptr<const void> owner, const std::string_view data) :
+                m_data{ data },
+                m_owner{ std::move(owner) }
+            {
+            }
+
+            /**
+             * Constructor.
+             *
+             * @param owner Keeps the memory alive.
+             * @param data The buffer.
+             */
+            value_type(std::shared_ptr<const void> owner, const std::span<const std::byte> data) :
+                m_data{ reinterpret_cast<const char*>(data.data()), data.size() },
+                m_owner{ std::move(owner) }
+            {
+            }
+
+            /**
+             * Gets the buffer.
+             *
+             * @return The buffer.
+             */
+            [[nodiscard]]
+            std::string_view
+            view() const noexcept
+            {
+                return m_data;
+            }
+
+            [[nodiscard]]
+            const char*
+            data() const noexcept
+            {
+                return m_data.data();
+            }
+
+            [[nodiscard]]
+            std::size_t
+            size() const noexcept
+            {
+                return m_data.size();
+            }
+
+            [[nodiscard]]
+            bool
+            empty() const noexcept
+            {
+                return m_data.empty();
+            }
+
+            /**
+             * Gets the owner of the buffer.
+             *
+             * @return The owner.
+             */
+            [[nodiscard]]
+            const std::shared_ptr<const void>&
+            owner() const noexcept
+            {
+                return m_owner;
+            }
+
+        private:
+            std::string_view m_data;
+            std::shared_ptr<const void> m_owner;
+        };
+
+        [[nodiscard]]
+        static
+        std::uint64_t
+        size(const value_type& body) noexcept
+        {
+            return body.size();
+        }
+
+        /**
+         * Serializes the body.
+         */
+        class writer
+        {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template<bool isRequest, class Fields>
+            explicit
+            writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body) :
+                m_body{ body }
+            {
+            }
+
+            void
+            init(malloy::error_code& ec)
+            {
+                ec = { };
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>>
+            get(malloy::error_code& ec)
+            {
+                ec = { };
+                if (m_done)
+                    return boost::none;
+
+                m_done = true;
+                return std::pair<const_buffers_type, bool>{ boost::asio::buffer(m_body.data(), m_body.size()), false };
+            }
+
+        private:
+            const value_type& m_body;
+            bool m_done = false;
+        };
+
+        /**
+         * Parses the body.
+         */
+        class reader
+        {
+        public:
+            template<bool isRequest, class Fields>
+            explicit
+            reader(boost::beast::http::header<isRequest, Fields>&, value_type& body) :
+                m_body{ body }
+            {
+            }
+
+            void
+            init(const boost::optional<std::uint64_t>& length, malloy::error_code& ec)
+            {
+                ec = { };
+                m_buffer = std::make_shared<std::string>();
+                if (length)
+                    m_buffer->reserve(static_cast<std::size_t>(*length));
+            }
+
+            template<class ConstBufferSequence>
+            std::size_t
+            put(const ConstBufferSequence& buffers, malloy::error_code& ec)
+            {
+                ec = { };
+
+                std::size_t n = 0;
+                for (const auto b : boost::beast::buffers_range_ref(buffers)) {
+                    m_buffer->append(static_cast<const char*>(b.data()), b.size());
+                    n += b.size();
+                }
+
+                return n;
+            }
+
+            void
+            finish(malloy::error_code& ec)
+            {
+                ec = { };
+                m_body = value_type{ std::shared_ptr<const std::string>{ std::move(m_buffer) } };
+            }
+
+        private:
+            value_type& m_body;
+            std::shared_ptr<std::string> m_buffer;
+        };
+    };
+
+}
@@ -0,0 +1,125 @@
+#include "shared_file.hpp"
+
+#include <boost/asio/error.hpp>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <cerrno>
+    #include <unistd.h>
+#endif
+
+using namespace malloy::http;
+
+shared_file::shared_file(std::shared_ptr<const boost::beast::file> file, const std::uint64_t size) noexcept :
+    m_file{ std::move(file) },
+    m_size{ size }
+{
+}
+
+shared_file::native_handle_type
+shared_file::native_handle() const noexcept
+{
+    return m_file ? m_file->native_handle() : boost::beast::file{ }.native_handle();
+}
+
+void
+shared_file::close(malloy::error_code& ec)
+{
+    ec = { };
+    m_file.reset();
+    m_size = 0;
+    m_pos = 0;
+}
+
+void
+shared_file::open(const char* path, const boost::beast::file_mode mode, malloy::error_code& ec)
+{
+    if (mode != boost::beast::file_mode::read && mode != boost::beast::file_mode::scan) {
+        ec = boost::asio::error::operation_not_supported;
+        return;
+    }
+
+    auto file = std::make_shared<boost::beast::file>();
+    file->open(path, mode, ec);
+    if (ec)
+        return;
+
+    const std::uint64_t size = file->size(ec);
+    if (ec)
+        return;
+
+    *this = shared_file{ std::move(file), size };
+}
+
+std::uint64_t
+shared_file::size(malloy::error_code& ec) const
+{
+    ec = m_file ? malloy::error_code{ } : boost::asio::error::bad_descriptor;
+    return m_size;
+}
+
+std::uint64_t
+shared_file::pos(malloy::error_code& ec) const
+{
+    ec = m_file ? malloy::error_code{ } : boost::asio::error::bad_descriptor;
+    return m_pos;
+}
+
+void
+shared_file::seek(const std::uint64_t offset, malloy::error_code& ec)
+{
+    ec = m_file ? malloy::error_code{ } : boost::asio::error::bad_descriptor;
+    m_pos = offset;
+}
+
+std::size_t
+shared_file::read(void* buffer, std::size_t n, malloy::error_code& ec)
+{
+    ec = { };
+    if (!m_file) {
+        ec = boost::asio::error::bad_descriptor;
+        return 0;
+    }
+
+    // Read at our own position, leaving the one of the descriptor alone
+#if defined(_WIN32)
+    n = std::min<std::size_t>(n, std::numeric_limits<DWORD>::max());
+
+    OVERLAPPED ov{ };
+    ov.Offset = static_cast<DWORD>(m_pos);
+    ov.OffsetHigh = static_cast<DWORD>(m_pos >> 32);
+
+    DWORD bytes = 0;
+    if (!::ReadFile(m_file->native_handle(), buffer, static_cast<DWORD>(n), &bytes, &ov)) {
+        if (const DWORD err = ::GetLastError(); err != ERROR_HANDLE_EOF) {
+            ec = malloy::error_code{ static_cast<int>(err), boost::system::system_category() };
+            return 0;
+        }
+    }
+#else
+    ssize_t bytes = 0;
+    do {
+        bytes = ::pread(m_file->native_handle(), buffer, n, static_cast<off_t>(m_pos));
+    } while (bytes < 0 && errno == EINTR);
+
+    if (bytes < 0) {
+        ec = malloy::error_code{ errno, boost::system::system_category() };
+        return 0;
+    }
+#endif
+
+    m_pos += static_cast<std::uint64_t>(bytes);
+
+    return static_cast<std::size_t>(bytes);
+}
+
+std::size_t
+shared_file::write(const void*, std::size_t, malloy::error_code& ec)
+{
+    ec = boost::asio::error::operation_not_supported;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../error.hpp"
+
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/basic_file_body.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace malloy::http
+{
+
+    /**
+     * A file sharing an open descriptor with other instances.
+     *
+     * @details This satisfies beast's File concept. Every instance has its own position and reads at that position
+     *          without changing the position of the descriptor. Hence, many responses can be served concurrently from
+     *          the same descriptor (e.g. one kept open by a @ref file_cache).
+     *
+     *          The file is read-only.
+     */
+    class shared_file
+    {
+    public:
+        using native_handle_type = boost::beast::file::native_handle_type;
+
+        shared_file() = default;
+
+        /**
+         * Constructor.
+         *
+         * @param file The open file.
+         * @param size The size of the file.
+         */
+        shared_file(std::shared_ptr<const boost::beast::file> file, std::uint64_t size) noexcept;
+
+        /**
+         * Gets the native handle of the shared descriptor.
+         *
+         * @return The handle.
+         */
+        [[nodiscard]]
+        native_handle_type
+        native_handle() const noexcept;
+
+        [[nodiscard]]
+        bool
+        is_open() const noexcept
+        {
+            return m_file != nullptr;
+        }
+
+        /**
+         * Releases the shared descriptor.
+         *
+         * @note The descriptor is closed once no other instance refers to it.
+         */
+        void
+        close(malloy::error_code& ec);
+
+        /**
+         * Opens a file.
+         *
+         * @details The descriptor is not shared with other instances (unless copied).
+         *
+         * @param path The path.
+         * @param mode The mode. Only reading modes are supported.
+         * @param ec The error.
+         */
+        void
+        open(const char* path, boost::beast::file_mode mode, malloy::error_code& ec);
+
+        [[nodiscard]]
+        std::uint64_t
+        size(malloy::error_code& ec) const;
+
+        [[nodiscard]]
+        std::uint64_t
+        pos(malloy::error_code& ec) const;
+
+        void
+        seek(std::uint64_t offset, malloy::error_code& ec);
+
+        std::size_t
+        read(void* buffer, std::size_t n, malloy::error_code& ec);
+
+        /**
+         * Fails with `operation_not_supported`.
+         */
+        std::size_t
+        write(const void* buffer, std::size_t n, malloy::error_code& ec);
+
+    private:
+        std::shared_ptr<const boost::beast::file> m_file;
+        std::uint64_t m_size = 0;
+        std::uint64_t m_pos = 0;
+    };
+
+    /**
+     * A body served from a @ref shared_file.
+     */
+    using shared_file_body = boost::beast::http::basic_file_body<shared_file>;
+
+}
@@ -6,7 +6,13 @@
 #include <boost/beast/core/string.hpp>
 #include <boost/beast/http/message.hpp>
 
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <optional>
+#include <string>
+#include <string_view>
 
 namespace malloy::http
 {
@@ -106,4 +112,132 @@ namespace malloy::http
         return std::nullopt;
     }
 
+    /**
+     * Removes optional whitespace (spaces & horizontal tabs) from both ends of a string.
+     *
+     * @param str The string.
+     * @return The trimmed string.
+     */
+    [[nodiscard]]
+    constexpr
+    std::string_view
+    trim_ows(std::string_view str) noexcept
+    {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+            str.remove_prefix(1);
+        while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+            str.remove_suffix(1);
+
+        return str;
+    }
+
+    /**
+     * Formats a point in time as HTTP date (e.g. `Sun, 06 Nov 1994 08:49:37 GMT`).
+     *
+     * @param tp The point in time.
+     * @return The date.
+     */
+    [[nodiscard]]
+    inline
+    std::string
+    to_http_date(const std::chrono::system_clock::time_point tp)
+    {
+        static constexpr const char* day_names[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+        static constexpr const char* month_names[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+        const auto days = std::chrono::floor<std::chrono::days>(tp);
+        const std::chrono::year_month_day ymd{ days };
+        const std::chrono::hh_mm_ss hms{ std::chrono::floor<std::chrono::seconds>(tp - days) };
+
+        char buf[32];
+        const int len = std::snprintf(
+            buf, sizeof(buf),
+            "%s, %02u %s %04d %02d:%02d:%02d GMT",
+            day_names[std::chrono::weekday{ days }.c_encoding()],
+            static_cast<unsigned>(ymd.day()),
+            month_names[static_cast<unsigned>(ymd.month()) - 1],
+            static_cast<int>(ymd.year()),
+            static_cast<int>(hms.hours().count()),
+            static_cast<int>(hms.minutes().count()),
+            static_cast<int>(hms.seconds().count())
+        );
+
+        return { buf, static_cast<std::size_t>(len) };
+    }
+
+    /**
+     * Builds a strong entity tag from the content of a representation.
+     *
+     * @details The tag is derived from a 64-bit FNV-1a hash and the size of the content, hence it is stable across
+     *          restarts (and builds).
+     *
+     * @param data The content.
+     * @return The entity tag (including the quotes).
+     */
+    [[nodiscard]]
+    inline
+    std::string
+    make_etag(const std::string_view data)
+    {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (const char c : data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3;
+        }
+
+        std::string etag;
+        etag.reserve(2 + 16 + 1 + 16);
+
+        char buf[16];
+        const auto append_hex = [&](const std::uint64_t value, const std::size_t width) {
+            const auto len = static_cast<std::size_t>(std::to_chars(std::begin(buf), std::end(buf), value, 16).ptr - buf);
+            etag.append(width > len ? width - len : 0, '0');
+            etag.append(buf, len);
+        };
+
+        etag += '"';
+        append_hex(hash, 16);
+        etag += '-';
+        append_hex(data.size(), 0);
+        etag += '"';
+
+        return etag;
+    }
+
+    /**
+     * Checks whether an entity tag matches the value of an `If-None-Match` header.
+     *
+     * @details This uses the weak comparison (i.e. `W/` prefixes are ignored) as required for `If-None-Match`.
+     *
+     * @param if_none_match The value of the header.
+     * @param etag The entity tag.
+     * @return Whether the tag matches.
+     */
+    [[nodiscard]]
+    inline
+    bool
+    etag_matches(std::string_view if_none_match, std::string_view etag)
+    {
+        const auto opaque = [](std::string_view tag) {
+            tag = trim_ows(tag);
+            if (tag.starts_with("W/"))
+                tag.remove_prefix(2);
+            return tag;
+        };
+
+        etag = opaque(etag);
+        while (!if_none_match.empty()) {
+            const auto sep = if_none_match.find(',');
+            const std::string_view tag = opaque(if_none_match.substr(0, sep));
+            if (tag == "*" || tag == etag)
+                return true;
+
+            if (sep == std::string_view::npos)
+                break;
+            if_none_match.remove_prefix(sep + 1);
+        }
+
+        return false;
+    }
+
 }
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "../error.hpp"
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#if defined(__linux__)
+    #include <boost/asio/posix/stream_descriptor.hpp>
+
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/sendfile.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace malloy::tcp
+{
+
+    /**
+     * Whether async_sendfile() is supported on this platform.
+     */
+#if defined(__linux__)
+    inline constexpr bool sendfile_supported = true;
+#else
+    inline constexpr bool sendfile_supported = false;
+#endif
+
+#if defined(__linux__)
+
+    namespace detail
+    {
+
+        /**
+         * The state of async_sendfile().
+         */
+        template<typename Socket>
+        struct sendfile_op
+        {
+            // Bytes transferred before yielding so that other connections on the same thread get their turn
+            static constexpr std::uint64_t max_transfer = 1024 * 1024;
+
+            Socket& socket;
+            int fd;
+            off_t offset;
+            std::uint64_t remaining;
+            std::uint64_t sent = 0;
+            std::unique_ptr<boost::asio::posix::stream_descriptor> pipe;    // The source if it is a pipe (spliced)
+            bool started = false;
+
+            /**
+             * The deadline of a wait (shared with the timer's handler which may outlive the operation).
+             */
+            struct deadline
+            {
+                boost::asio::steady_timer timer;
+                std::size_t wait = 0;       // Identifies the wait the timer is armed for
+                bool expired = false;
+            };
+
+            std::chrono::steady_clock::duration idle;
+            std::shared_ptr<deadline> idle_deadline;                        // Null if there's no idle timeout
+
+            sendfile_op(Socket& socket_, const int fd_, const std::uint64_t offset_, const std::uint64_t count, const std::chrono::steady_clock::duration idle_) :
+                socket{ socket_ },
+                fd{ fd_ },
+                offset{ static_cast<off_t>(offset_) },
+                remaining{ count },
+                idle{ idle_ }
+            {
+                if (idle > std::chrono::steady_clock::duration::zero())
+                    idle_deadline = std::make_shared<deadline>(boost::asio::steady_timer{ socket.get_executor() });
+            }
+
+            template<typename Self>
+            void
+            operator()(Self& self, malloy::error_code ec = { })
+            {
+                // Every step (i.e. every wait) gets the whole idle timeout
+                if (idle_deadline) {
+                    idle_deadline->wait++;
+                    idle_deadline->timer.cancel();
+                    if (idle_deadline->expired)
+                        ec = boost::asio::error::timed_out;
+                }
+
+                // Never complete from within the initiating function
+                if (!started) {
+                    started = true;
+
+                    struct stat st{ };
+                    if (::fstat(fd, &st) != 0)
+                        ec = malloy::error_code{ errno, boost::system::system_category() };
+                    else if (S_ISFIFO(st.st_mode)) {
+                        const int dup_fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+                        if (dup_fd < 0)
+                            ec = malloy::error_code{ errno, boost::system::system_category() };
+                        else
+                            pipe = std::make_unique<boost::asio::posix::stream_descriptor>(socket.get_executor(), dup_fd);
+                    }
+
+                    if (!ec && !socket.native_non_blocking())
+                        socket.native_non_blocking(true, ec);
+
+                    if (!ec)
+                        return boost::asio::post(std::move(self));
+                }
+
+                std::uint64_t budget = max_transfer;
+                while (!ec && remaining > 0) {
+                    if (budget == 0)
+                        return boost::asio::post(std::move(self));
+
+                    const auto n = transfer(static_cast<std::size_t>(std::min(remaining, budget)));
+                    if (n > 0) {
+                        remaining -= n;
+                        sent += n;
+                        budget -= n;
+                        continue;
+                    }
+
+                    // The file was truncated (or the writer end of the pipe closed)
+                    if (n == 0) {
+                        ec = boost::asio::error::eof;
+                        break;
+                    }
+
+                    if (errno == EINTR)
+                        continue;
+
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        // Wait for the pipe if it is empty, otherwise for the socket
+                        if (pipe) {
+                            pollfd pfd{ .fd = fd, .events = POLLIN, .revents = 0 };
+                            if (::poll(&pfd, 1, 0) == 0) {
+                                arm_deadline(*pipe);
+                                return pipe->async_wait(boost::asio::posix::stream_descriptor::wait_read, std::move(self));
+                            }
+                        }
+
+                        arm_deadline(socket);
+                        return socket.async_wait(Socket::wait_write, std::move(self));
+                    }
+
+                    ec = malloy::error_code{ errno, boost::system::system_category() };
+                }
+
+                pipe.reset();
+                self.complete(ec, sent);
+            }
+
+        private:
+            /**
+             * Cancels the wait on the waitable if it doesn't complete within the idle timeout.
+             */
+            template<typename Waitable>
+            void
+            arm_deadline(Waitable& waitable)
+            {
+                if (!idle_deadline)
+                    return;
+
+                // The waitable outlives the wait, which is the only one matching the ID
+                idle_deadline->timer.expires_after(idle);
+                idle_deadline->timer.async_wait([d = idle_deadline, wait = idle_deadline->wait, &waitable](const malloy::error_code ec) {
+                    if (ec || d->wait != wait)
+                        return;
+
+                    d->expired = true;
+                    waitable.cancel();
+                });
+            }
+
+            [[nodiscard]]
+            ssize_t
+            transfer(const std::size_t count)
+            {
+                if (pipe)
+                    return ::splice(fd, nullptr, socket.native_handle(), nullptr, count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE);
+
+                return ::sendfile(socket.native_handle(), fd, &offset, count);
+            }
+        };
+
+    }
+
+    /**
+     * Transfers the contents of a file to a socket without copying them into userspace.
+     *
+     * @details Regular files are sent with `sendfile(2)`, pipes with `splice(2)` (the offset is ignored).
+     *
+     *          The socket is put into non-blocking mode. No other write must be performed on the socket while the
+     *          operation is in progress.
+     *
+     * @note This is only supported on Linux.
+     *
+     * @param socket The socket.
+     * @param fd The file descriptor of the file. The file must stay open until the operation completed.
+     * @param offset The offset into the file.
+     * @param count The number of bytes to transfer.
+     * @param idle_timeout The longest the operation waits for the socket (or the pipe) to become ready. The operation
+     *                     fails with `boost::asio::error::timed_out` once exceeded. Zero waits indefinitely.
+     * @param token The completion token. The completion signature is `void(malloy::error_code, std::uint64_t)`, the
+     *              second parameter being the number of bytes transferred.
+     */
+    template<typename Socket, typename CompletionToken>
+    auto
+    async_sendfile(Socket& socket, const int fd, const std::uint64_t offset, const std::uint64_t count, const std::chrono::steady_clock::duration idle_timeout, CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, void(malloy::error_code, std::uint64_t)>(
+            detail::sendfile_op<Socket>{ socket, fd, offset, count, idle_timeout },
+            token,
+            socket
+        );
+    }
+
+    /**
+     * Transfers the contents of a file to a socket without copying them into userspace.
+     *
+     * @details Waits indefinitely for the socket. See the overload taking an idle timeout.
+     */
+    template<typename Socket, typename CompletionToken>
+    auto
+    async_sendfile(Socket& socket, const int fd, const std::uint64_t offset, const std::uint64_t count, CompletionToken&& token)
+    {
+        return async_sendfile(socket, fd, offset, count, std::chrono::steady_clock::duration::zero(), std::forward<CompletionToken>(token));
+    }
+
+#endif
+
+}
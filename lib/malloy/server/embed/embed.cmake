@@ -0,0 +1,62 @@
+# Embeds the files of a directory into a target.
+#
+#   malloy_embed_resources(<target> DIR <directory> [NAME <name>] [MIN_COMPRESS_SIZE <bytes>])
+#
+# The files are compiled into constant arrays (including precompressed variants and ETags) at build time. They are
+# accessible through `malloy::embedded::<name>()` declared in `<malloy_embedded/<name>.hpp>`, which can be passed to
+# `malloy::server::router::add_file_serving()`. The name defaults to the name of the directory.
+function(malloy_embed_resources TARGET)
+    cmake_parse_arguments(PARSE_ARGV 1 ARG "" "DIR;NAME;MIN_COMPRESS_SIZE" "")
+    if (NOT ARG_DIR)
+        message(FATAL_ERROR "malloy_embed_resources(): DIR is required.")
+    endif()
+    if (NOT ARG_MIN_COMPRESS_SIZE)
+        set(ARG_MIN_COMPRESS_SIZE 256)
+    endif()
+
+    cmake_path(ABSOLUTE_PATH ARG_DIR BASE_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR} NORMALIZE OUTPUT_VARIABLE dir)
+    if (NOT ARG_NAME)
+        cmake_path(GET dir FILENAME ARG_NAME)
+    endif()
+    string(MAKE_C_IDENTIFIER ${ARG_NAME} name)
+
+    # The generator (imported when using an installed package)
+    if (TARGET malloy::malloy-embed)
+        set(generator malloy::malloy-embed)
+    else()
+        set(generator malloy-embed)
+    endif()
+
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/malloy_embedded/${TARGET})
+    set(source ${out_dir}/malloy_embedded/${name}.cpp)
+    set(header ${out_dir}/malloy_embedded/${name}.hpp)
+
+    # Re-run the generator when files are added, removed or modified
+    file(GLOB_RECURSE files CONFIGURE_DEPENDS ${dir}/*)
+
+    add_custom_command(
+        OUTPUT
+            ${source}
+            ${header}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${out_dir}/malloy_embedded
+        COMMAND ${generator} ${dir} ${source} ${header} ${name} ${ARG_MIN_COMPRESS_SIZE}
+        DEPENDS
+            ${generator}
+            ${files}
+        COMMENT "Embedding resources from ${dir}"
+        VERBATIM
+    )
+
+    target_sources(
+        ${TARGET}
+        PRIVATE
+            ${source}
+            ${header}
+    )
+
+    target_include_directories(
+        ${TARGET}
+        PRIVATE
+            ${out_dir}
+    )
+endfunction()
@@ -0,0 +1,266 @@
+/**
+ * Generates the sources embedding the files of a directory into a binary.
+ *
+ * Usage: malloy-embed <directory> <output source> <output header> <name> [<min. compress size>]
+ *
+ * The generated header declares `std::span<const malloy::server::embedded_resource> malloy::embedded::<name>()`.
+ * This is invoked by the `malloy_embed_resources()` CMake function.
+ */
+
+#include <malloy/core/http/compression.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+    struct resource
+    {
+        std::string path;
+        std::string mime_type;
+        std::string etag;
+        std::string identity;
+        std::string gzip;
+        std::string deflate;
+    };
+
+    [[nodiscard]]
+    std::string
+    read_file(const std::filesystem::path& path)
+    {
+        std::ifstream file{ path, std::ios::binary };
+        if (!file)
+            throw std::runtime_error("cannot open file " + path.string());
+
+        return { std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{ } };
+    }
+
+    /**
+     * Formats a string as C++ string literal.
+     */
+    [[nodiscard]]
+    std::string
+    literal(const std::string_view str)
+    {
+        std::string out = "\"";
+        for (const char c : str) {
+            const auto uc = static_cast<unsigned char>(c);
+            // '?' avoids trigraphs
+            if (c == '"' || c == '\\' || c == '?') {
+                out += '\\';
+                out += c;
+            }
+            else if (uc < 0x20 || uc >= 0x7f) {
+                // Octal escapes end after three digits (unlike hex escapes)
+                out += '\\';
+                out += static_cast<char>('0' + ((uc >> 6) & 7));
+                out += static_cast<char>('0' + ((uc >> 3) & 7));
+                out += static_cast<char>('0' + (uc & 7));
+            }
+            else
+                out += c;
+        }
+        out += '"';
+
+        return out;
+    }
+
+    /**
+     * Writes a constant array holding data.
+     *
+     * @details The data is written as string literal (split into one piece per line) which compilers parse a lot
+     *          faster than a list of characters. MSVC limits string literals to 64 KiB, larger data falls back to a list
+     *          of characters there.
+     */
+    void
+    write_array(std::ostream& os, const std::string_view name, const std::string_view data)
+    {
+        if (data.empty())
+            return;
+
+        constexpr std::size_t max_msvc_literal = 65'535;
+        const bool fallback = data.size() > max_msvc_literal;
+
+        if (fallback) {
+            os << "#if defined(_MSC_VER)\n"
+               << "    constexpr char " << name << "[] = {";
+            for (std::size_t i = 0; i < data.size(); ++i) {
+                if (i % 16 == 0)
+                    os << "\n        ";
+
+                char buf[2];
+                const auto uc = static_cast<unsigned char>(data[i]);
+                std::to_chars(std::begin(buf), std::end(buf), uc >> 4, 16);
+                std::to_chars(std::begin(buf) + 1, std::end(buf), uc & 0xf, 16);
+                os << "'\\x" << buf[0] << buf[1] << "',";
+            }
+            os << "\n    };\n"
+               << "#else\n";
+        }
+
+        os << "    constexpr char " << name << "[] =";
+        for (std::size_t i = 0; i < data.size(); i += 64)
+            os << "\n        " << literal(data.substr(i, 64));
+        os << ";\n";
+
+        if (fallback)
+            os << "#endif\n";
+
+        os << "\n";
+    }
+
+    /**
+     * Formats the view of an array written by write_array().
+     *
+     * @note The size is spelled out as the string literal has a terminating null character (unlike the fallback).
+     */
+    [[nodiscard]]
+    std::string
+    view(const std::string_view name, const std::string_view data)
+    {
+        if (data.empty())
+            return "{ }";
+
+        return "{ " + std::string{ name } + ", " + std::to_string(data.size()) + " }";
+    }
+
+    void
+    write_file(const std::filesystem::path& path, const std::string& content)
+    {
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        file << content;
+        if (!file)
+            throw std::runtime_error("cannot write file " + path.string());
+    }
+
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc < 5 || argc > 6) {
+        std::cerr << "usage: " << argv[0] << " <directory> <output source> <output header> <name> [<min. compress size>]\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path dir = argv[1];
+    const std::filesystem::path source_path = argv[2];
+    const std::filesystem::path header_path = argv[3];
+    const std::string name = argv[4];
+    std::size_t min_compress_size = 256;
+    if (argc == 6)
+        std::from_chars(argv[5], argv[5] + std::char_traits<char>::length(argv[5]), min_compress_size);
+
+    try {
+        // Load & compress
+        std::vector<resource> resources;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator{ dir, std::filesystem::directory_options::follow_directory_symlink }) {
+            if (!entry.is_regular_file())
+                continue;
+
+            resource res;
+            res.path = entry.path().lexically_relative(dir).generic_string();
+            res.identity = read_file(entry.path());
+
+            // Same as asset_bundle
+            auto prepared = malloy::http::compression::precompress(entry.path(), res.identity, min_compress_size);
+            res.mime_type = prepared.mime_type;
+            res.etag = std::move(prepared.etag);
+            res.gzip = std::move(prepared.gzip);
+            res.deflate = std::move(prepared.deflate);
+
+            resources.emplace_back(std::move(res));
+        }
+
+        // Sort for reproducible output
+        std::ranges::sort(resources, {}, &resource::path);
+
+        // Header
+        std::ostringstream header;
+        header << "// Generated by malloy-embed. Do not edit.\n"
+                  "\n"
+                  "#pragma once\n"
+                  "\n"
+                  "#include <malloy/server/routing/embedded_resource.hpp>\n"
+                  "\n"
+                  "#include <span>\n"
+                  "\n"
+                  "namespace malloy::embedded\n"
+                  "{\n"
+                  "\n"
+                  "    /**\n"
+                  "     * Gets the resources embedded from " << dir.generic_string() << ".\n"
+                  "     */\n"
+                  "    [[nodiscard]]\n"
+                  "    std::span<const malloy::server::embedded_resource>\n"
+                  "    " << name << "() noexcept;\n"
+                  "\n"
+                  "}\n";
+
+        // Source
+        std::ostringstream source;
+        source << "// Generated by malloy-embed. Do not edit.\n"
+                  "\n"
+                  "#include \"" << header_path.filename().generic_string() << "\"\n"
+                  "\n"
+                  "namespace\n"
+                  "{\n"
+                  "\n";
+
+        for (std::size_t i = 0; i < resources.size(); ++i) {
+            const auto prefix = "data_" + std::to_string(i);
+            write_array(source, prefix, resources[i].identity);
+            write_array(source, prefix + "_gzip", resources[i].gzip);
+            write_array(source, prefix + "_deflate", resources[i].deflate);
+        }
+
+        if (resources.empty())
+            source << "    constexpr std::span<const malloy::server::embedded_resource> resources;\n";
+        else {
+            source << "    constexpr malloy::server::embedded_resource resources[] = {\n";
+            for (std::size_t i = 0; i < resources.size(); ++i) {
+                const auto& res = resources[i];
+                const auto prefix = "data_" + std::to_string(i);
+                source << "        {\n"
+                       << "            " << literal(res.path) << ",\n"
+                       << "            " << literal(res.mime_type) << ",\n"
+                       << "            " << literal(res.etag) << ",\n"
+                       << "            " << view(prefix, res.identity) << ",\n"
+                       << "            " << view(prefix + "_gzip", res.gzip) << ",\n"
+                       << "            " << view(prefix + "_deflate", res.deflate) << ",\n"
+                       << "        },\n";
+            }
+            source << "    };\n";
+        }
+
+        source << "\n"
+                  "}\n"
+                  "\n"
+                  "std::span<const malloy::server::embedded_resource>\n"
+                  "malloy::embedded::" << name << "() noexcept\n"
+                  "{\n"
+                  "    return resources;\n"
+                  "}\n";
+
+        write_file(header_path, header.str());
+        write_file(source_path, source.str());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "malloy-embed: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
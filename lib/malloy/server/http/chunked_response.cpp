@@ -0,0 +1,114 @@
+#include "chunked_response.hpp"
+#include "connection_plain.hpp"
+#if MALLOY_FEATURE_TLS
+    #include "connection_tls.hpp"
+#endif
+#include "../../core/http/types.hpp"
+
+#include <boost/asio/error.hpp>
+#include <boost/beast/http/rfc7230.hpp>
+
+#include <charconv>
+#include <sstream>
+
+using namespace malloy::server::http;
+
+namespace
+{
+
+    /**
+     * The storage of a part of the response.
+     */
+    struct frame
+    {
+        std::string head;
+        std::string data;
+    };
+
+    constexpr std::string_view crlf = "\r\n";
+
+}
+
+std::shared_ptr<chunked_response>
+chunked_response::make(connection_t conn, const request_header_type& req, header_type header)
+{
+    return std::make_shared<chunked_response>(token{ }, std::move(conn), req, std::move(header));
+}
+
+chunked_response::chunked_response(token, connection_t conn, const request_header_type& req, header_type&& header) :
+    m_conn{ std::move(conn) },
+    m_status{ header.result_int() },
+    m_chunked{ req.version() >= 11 },
+    m_head{ req.method() == malloy::http::method::head }
+{
+    header.version(req.version());
+    header.erase(malloy::http::field::content_length);
+    if (m_chunked)
+        header.set(malloy::http::field::transfer_encoding, "chunked");
+    else {
+        // The end of the body is signaled by closing the connection
+        header.erase(malloy::http::field::transfer_encoding);
+        header.set(malloy::http::field::connection, "close");
+    }
+
+    boost::beast::http::token_list connection{ header[malloy::http::field::connection] };
+    m_close = connection.exists("close");
+
+    std::ostringstream ss;
+    ss << header;
+    m_header = std::move(ss).str();
+}
+
+void
+chunked_response::do_write(std::string&& chunk, handler_t&& handler, const bool last, fields_type&& trailers)
+{
+    if (m_finished)
+        return handler(boost::asio::error::operation_aborted);
+    m_finished = last;
+
+    auto f = std::make_shared<frame>();
+    f->head = std::move(m_header);
+    m_header.clear();
+
+    // Build the frame
+    if (!m_head) {
+        if (!last) {
+            if (m_chunked && !chunk.empty()) {
+                char size[16];
+                const auto res = std::to_chars(std::begin(size), std::end(size), chunk.size(), 16);
+                f->head.append(size, res.ptr);
+                f->head += crlf;
+            }
+            f->data = std::move(chunk);
+        }
+        else if (m_chunked) {
+            f->head += "0\r\n";
+            for (const auto& field : trailers) {
+                f->head += field.name_string();
+                f->head += ": ";
+                f->head += field.value();
+                f->head += crlf;
+            }
+            f->head += crlf;
+        }
+    }
+
+    response_part part;
+    part.buffers = {
+        boost::asio::buffer(f->head),
+        boost::asio::buffer(f->data),
+        (m_chunked && !f->data.empty()) ? boost::asio::buffer(crlf) : boost::asio::const_buffer{ }
+    };
+    part.storage = std::move(f);
+    part.status = m_status;
+    part.last = last;
+    part.close = last && m_close;
+    part.written = std::move(handler);
+
+    std::visit(
+        [&part](auto& c) {
+            c->do_write_part(std::move(part));
+        },
+        m_conn
+    );
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "connection_t.hpp"
+#include "../../core/error.hpp"
+
+#include <boost/asio/async_result.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/message.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace malloy::server::http
+{
+
+    /**
+     * A response whose body is written in chunks (`Transfer-Encoding: chunked`).
+     *
+     * @details The header is sent along with the first chunk. Every write completes once the connection accepted
+     *          the chunk, which naturally limits the number of chunks buffered per response. The response is
+     *          complete once @ref finish() was called (optionally sending trailer fields). Until then, no other
+     *          response is written on the connection.
+     *
+     *          HTTP/1.0 clients receive the body without chunk framing (and without trailers) and the connection is
+     *          closed after the response. Responses to `HEAD` requests consist of the header only.
+     *
+     * @note Only one write (or finish) may be outstanding at any time.
+     */
+    class chunked_response
+    {
+        struct token { };
+
+    public:
+        using header_type = boost::beast::http::response_header<>;
+        using request_header_type = boost::beast::http::request_header<>;
+        using fields_type = boost::beast::http::fields;
+        using handler_t = std::function<void(malloy::error_code)>;
+
+        /**
+         * Creates a chunked response.
+         *
+         * @param conn The connection to write to.
+         * @param req The request to which we're responding.
+         * @param header The response header. The transfer encoding is set accordingly.
+         * @return The chunked response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<chunked_response>
+        make(connection_t conn, const request_header_type& req, header_type header);
+
+        /**
+         * Constructor.
+         *
+         * @note Use @ref make() instead.
+         */
+        chunked_response(token, connection_t conn, const request_header_type& req, header_type&& header);
+
+        /**
+         * Writes a chunk.
+         *
+         * @details Empty chunks are ignored (they would terminate the body).
+         *
+         * @param chunk The chunk.
+         * @param token The completion token. The completion signature is `void(malloy::error_code)`.
+         */
+        template<boost::asio::completion_token_for<void(malloy::error_code)> CompletionToken>
+        auto
+        write(std::string chunk, CompletionToken&& token)
+        {
+            return boost::asio::async_initiate<CompletionToken, void(malloy::error_code)>(
+                [this, chunk = std::move(chunk)](auto handler) mutable {
+                    do_write(std::move(chunk), wrap(std::move(handler)), false, { });
+                },
+                token
+            );
+        }
+
+        /**
+         * Completes the response.
+         *
+         * @param trailers The trailer fields.
+         * @param token The completion token. The completion signature is `void(malloy::error_code)`.
+         */
+        template<boost::asio::completion_token_for<void(malloy::error_code)> CompletionToken>
+        auto
+        finish(fields_type trailers, CompletionToken&& token)
+        {
+            return boost::asio::async_initiate<CompletionToken, void(malloy::error_code)>(
+                [this, trailers = std::move(trailers)](auto handler) mutable {
+                    do_write({ }, wrap(std::move(handler)), true, std::move(trailers));
+                },
+                token
+            );
+        }
+
+        /**
+         * Completes the response.
+         *
+         * @param token The completion token. The completion signature is `void(malloy::error_code)`.
+         */
+        template<boost::asio::completion_token_for<void(malloy::error_code)> CompletionToken>
+        auto
+        finish(CompletionToken&& token)
+        {
+            return finish(fields_type{ }, std::forward<CompletionToken>(token));
+        }
+
+    private:
+        connection_t m_conn;
+        std::string m_header;       // Serialized header (until sent)
+        unsigned m_status;
+        bool m_chunked;
+        bool m_head;
+        bool m_close;
+        bool m_finished = false;
+
+        /**
+         * Wraps a (possibly move-only) completion handler.
+         */
+        template<typename Handler>
+        [[nodiscard]]
+        static
+        handler_t
+        wrap(Handler&& handler)
+        {
+            auto h = std::make_shared<std::decay_t<Handler>>(std::forward<Handler>(handler));
+            return [h](malloy::error_code ec) {
+                std::move(*h)(ec);
+            };
+        }
+
+        void
+        do_write(std::string&& chunk, handler_t&& handler, bool last, fields_type&& trailers);
+    };
+
+}
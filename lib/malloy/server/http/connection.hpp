@@ -2,22 +2,41 @@
 
 #include "connection_t.hpp"
 #include "../websocket/connection.hpp"
+#include "../../core/http/canned_response.hpp"
 #include "../../core/http/request.hpp"
 #include "../../core/http/generator.hpp"
+#include "../../core/detail/pool_allocator.hpp"
+#include "../../core/error.hpp"
+#include "../../core/tcp/sendfile.hpp"
 
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/cancellation_signal.hpp>
 #include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/http/detail/type_traits.hpp>
 #include <spdlog/logger.h>
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <stop_token>
 #include <string>
+#include <string_view>
 #include <concepts>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace spdlog
@@ -28,6 +47,36 @@ namespace spdlog
 namespace malloy::server::http
 {
 
+    namespace detail
+    {
+        template<typename Body>
+        struct is_file_body :
+            std::false_type
+        {
+        };
+
+        template<typename File>
+        struct is_file_body<boost::beast::http::basic_file_body<File>> :
+            std::true_type
+        {
+        };
+    }
+
+    /**
+     * A part of a response (e.g. a chunk of a chunked response).
+     *
+     * @sa connection::do_write_part()
+     */
+    struct response_part
+    {
+        std::shared_ptr<const void> storage;                    ///< Keeps the buffers alive until written.
+        std::array<boost::asio::const_buffer, 3> buffers;       ///< The serialized part.
+        unsigned status = 0;                                    ///< The status of the response.
+        bool last = false;                                      ///< Whether this completes the response.
+        bool close = false;                                     ///< Whether to close the connection after the response.
+        std::function<void(malloy::error_code)> written;        ///< Invoked once the part was written.
+    };
+
     /**
      * An HTTP server connection.
      *
@@ -45,8 +94,10 @@ namespace malloy::server::http
         {
             friend class connection;
 
+            struct token { };
+
         public:
-            using h_parser_t = std::unique_ptr<boost::beast::http::request_parser<boost::beast::http::empty_body>>;
+            using h_parser_t = std::shared_ptr<boost::beast::http::request_parser<boost::beast::http::empty_body>>;
             using header_t = boost::beast::http::request_header<>;
 
             [[nodiscard]]
@@ -57,29 +108,67 @@ namespace malloy::server::http
             const header_t&
             header() const { return m_header; }
 
+            /**
+             * Gets the stop token of the request.
+             *
+             * @details Stop is requested once the client disconnected while the request is outstanding.
+             *
+             * @return The stop token.
+             */
+            [[nodiscard]]
+            std::stop_token
+            stop_token() const noexcept
+            {
+                return m_stop.get_token();
+            }
+
+            /**
+             * Ties the lifetime of an object to the request.
+             *
+             * @details The object is kept alive for as long as this request generator is, i.e. until all work
+             *          performed on behalf of the request (body reads, coroutines, offloaded handlers) finished.
+             *          Objects retained later are destroyed first.
+             *
+             * @param obj The object.
+             */
+            void
+            retain(std::shared_ptr<const void> obj)
+            {
+                if (!m_retained) {
+                    m_retained = std::move(obj);
+                    return;
+                }
+
+                // Chain the objects (rarely more than one)
+                using chain_t = std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>>;
+                m_retained = std::allocate_shared<chain_t>(m_parent->allocator(), std::move(m_retained), std::move(obj));
+            }
+
+            /**
+             * Gets the cancellation slot of the request.
+             *
+             * @details Terminal cancellation is emitted (on the connection's strand) once the client disconnected
+             *          while the request is outstanding. Bind it to operations performed on behalf of the request.
+             *
+             * @return The cancellation slot.
+             */
+            [[nodiscard]]
+            boost::asio::cancellation_slot
+            cancellation_slot() noexcept
+            {
+                return m_cancel.slot();
+            }
+
             template<typename Body, std::invocable<malloy::http::request<Body>&&> Callback, typename SetupCb>
             auto
             body(Callback&& done, SetupCb&& setup)
             {
-                using namespace boost::beast::http;
-                using body_t = std::decay_t<Body>;
-                auto parser = std::make_shared<boost::beast::http::request_parser<body_t>>(std::move(*m_parser));
-                parser->get().base() = m_header;
-                std::invoke(setup, parser->get().body());
-
-                boost::beast::http::async_read(
-                    m_parent->derived().m_stream, m_buffer, *parser,
-                    [_ = m_parent,
-                        done = std::forward<Callback>(done),
-                        p = parser, this_ = this->shared_from_this(),
-                        this
-                    ](const auto& ec, auto) {
-                        if (ec && m_parent->m_logger) {    // TODO: see #40
-                            m_parent->m_logger->error("failed to read http request body: '{}'", ec.message());
-                            return;
-                        }
-                        done(malloy::http::request<Body>{p->release()});
-                    }
+                do_body<Body>(
+                    [done = std::forward<Callback>(done)](const malloy::error_code ec, malloy::http::request<Body>&& req) mutable {
+                        if (!ec)    // TODO: see #40
+                            done(std::move(req));
+                    },
+                    std::forward<SetupCb>(setup)
                 );
             }
 
@@ -90,9 +179,85 @@ namespace malloy::server::http
                 return body<Body>(std::forward<Callback>(done), [](auto){});
             }
 
-        private:
-            request_generator(h_parser_t hparser, header_t header, std::shared_ptr<connection> parent, boost::beast::flat_buffer buff) :
-                m_buffer{ std::move(buff) },
+            /**
+             * Reads the body.
+             *
+             * @param token The completion token (e.g. a callback or `boost::asio::use_awaitable`). The completion
+             *              signature is `void(malloy::error_code, malloy::http::request<Body>)`.
+             * @param setup Invoked with the body before reading it.
+             */
+            template<typename Body, typename CompletionToken, typename SetupCb>
+                requires (!std::invocable<CompletionToken, malloy::http::request<Body>&&>)
+            auto
+            body(CompletionToken&& token, SetupCb&& setup)
+            {
+                return boost::asio::async_initiate<CompletionToken, void(malloy::error_code, malloy::http::request<Body>)>(
+                    [this_ = this->shared_from_this()](auto handler, auto setup) {
+                        // The handler might call this from outside of the connection's strand
+                        auto& stream = this_->m_parent->derived().m_stream;
+                        boost::asio::dispatch(
+                            stream.get_executor(),
+                            [this_, handler = std::move(handler), setup = std::move(setup)]() mutable {
+                                this_->template do_body<Body>(std::move(handler), std::move(setup));
+                            }
+                        );
+                    },
+                    token,
+                    std::forward<SetupCb>(setup)
+                );
+            }
+
+            /**
+             * @copydoc body(CompletionToken&&, SetupCb&&)
+             */
+            template<typename Body, typename CompletionToken>
+                requires (!std::invocable<CompletionToken, malloy::http::request<Body>&&>)
+            auto
+            body(CompletionToken&& token)
+            {
+                return body<Body>(std::forward<CompletionToken>(token), [](auto&){});
+            }
+
+            /**
+             * Reads the next chunk of the body.
+             *
+             * @details Each call reads at most one chunk (of up to `config::request_body_chunk_size` bytes) from the
+             *          connection. Nothing is read until the next call, hence the memory used per request is bounded by
+             *          the chunk size no matter how large the body is.
+             *
+             *          The completion handler is invoked with the chunk. The chunk remains valid until the next call.
+             *          An empty chunk signals the end of the body.
+             *
+             * @note This must not be mixed with @ref body().
+             *
+             * @param token The completion token (e.g. a callback or `boost::asio::use_awaitable`). The completion
+             *              signature is `void(malloy::error_code, std::string_view)`.
+             */
+            template<boost::asio::completion_token_for<void(malloy::error_code, std::string_view)> CompletionToken>
+            auto
+            read_some(CompletionToken&& token)
+            {
+                return boost::asio::async_initiate<CompletionToken, void(malloy::error_code, std::string_view)>(
+                    [this_ = this->shared_from_this()](auto handler) {
+                        // The handler might call this from outside of the connection's strand
+                        auto& stream = this_->m_parent->derived().m_stream;
+                        boost::asio::dispatch(
+                            stream.get_executor(),
+                            [this_, handler = std::move(handler)]() mutable {
+                                this_->do_read_some(std::move(handler));
+                            }
+                        );
+                    },
+                    token
+                );
+            }
+
+            /**
+             * Constructor.
+             *
+             * @note This can only be called by the connection.
+             */
+            request_generator(token, h_parser_t hparser, header_t header, std::shared_ptr<connection> parent) :
                 m_parser{ std::move(hparser) },
                 m_header{ std::move(header) },
                 m_parent{ std::move(parent) }
@@ -100,10 +265,105 @@ namespace malloy::server::http
                 assert(m_parent); // ToDo: Should this be BOOST_ASSERT?
             }
 
-            boost::beast::flat_buffer m_buffer;
+        private:
+            using stream_parser_t = boost::beast::http::request_parser<boost::beast::http::buffer_body>;
+
             h_parser_t m_parser;
             header_t m_header;
             std::shared_ptr<connection> m_parent;
+            std::shared_ptr<stream_parser_t> m_stream_parser;       // Used by read_some()
+            std::vector<char> m_chunk;
+            std::stop_source m_stop;
+            boost::asio::cancellation_signal m_cancel;
+            std::shared_ptr<const void> m_retained;
+
+            /**
+             * Cancels the work performed on behalf of the request.
+             */
+            void
+            cancel()
+            {
+                m_stop.request_stop();
+                m_cancel.emit(boost::asio::cancellation_type::terminal);
+            }
+
+            template<typename Body, typename Handler, typename SetupCb>
+            void
+            do_body(Handler&& handler, SetupCb&& setup)
+            {
+                using body_t = std::decay_t<Body>;
+                auto parser = std::allocate_shared<boost::beast::http::request_parser<body_t>>(m_parent->allocator(), std::move(*m_parser));
+
+                // The header was taken from the parser. It has to be copied back as the header of the generator
+                // remains in use (captures refer to it).
+                parser->get().base() = m_header;
+                std::invoke(setup, parser->get().body());
+
+                // The connection does not read while the request is being handled, its buffer can therefore be used
+                boost::beast::http::async_read(
+                    m_parent->derived().m_stream, m_parent->m_buffer, *parser,
+                    boost::asio::bind_allocator(
+                        m_parent->allocator(),
+                        [handler = std::forward<Handler>(handler), p = parser, this_ = this->shared_from_this()](const malloy::error_code ec, std::size_t) mutable {
+                            if (ec && this_->m_parent->m_logger)
+                                this_->m_parent->m_logger->error("failed to read http request body: '{}'", ec.message());
+                            if (!ec)
+                                this_->m_parent->on_body_read();
+
+                            std::move(handler)(ec, malloy::http::request<Body>{p->release()});
+                        }
+                    )
+                );
+            }
+
+            template<typename Handler>
+            void
+            do_read_some(Handler&& handler)
+            {
+                if (!m_stream_parser) {
+                    m_stream_parser = std::allocate_shared<stream_parser_t>(m_parent->allocator(), std::move(*m_parser));
+                    m_chunk.resize(std::max<std::size_t>(m_parent->cfg.request_body_chunk_size, 1));
+
+                    // Beast sizes reads by the capacity of the buffer
+                    m_parent->m_buffer.reserve(m_chunk.size());
+                }
+
+                // End of body
+                if (m_stream_parser->is_done()) {
+                    return boost::asio::post(
+                        m_parent->derived().m_stream.get_executor(),
+                        [handler = std::forward<Handler>(handler)]() mutable {
+                            std::move(handler)(malloy::error_code{ }, std::string_view{ });
+                        }
+                    );
+                }
+
+                auto& body = m_stream_parser->get().body();
+                body.data = m_chunk.data();
+                body.size = m_chunk.size();
+                body.more = true;
+
+                boost::beast::http::async_read_some(
+                    m_parent->derived().m_stream, m_parent->m_buffer, *m_stream_parser,
+                    [this_ = this->shared_from_this(), handler = std::forward<Handler>(handler)](malloy::error_code ec, std::size_t) mutable {
+                        // A full chunk is not an error
+                        if (ec == boost::beast::http::error::need_buffer)
+                            ec = { };
+
+                        if (ec)
+                            return std::move(handler)(ec, std::string_view{ });
+
+                        // Reading might only have consumed framing (e.g. chunk headers)
+                        const std::size_t size = this_->m_chunk.size() - this_->m_stream_parser->get().body().size;
+                        if (size == 0 && !this_->m_stream_parser->is_done())
+                            return this_->do_read_some(std::move(handler));
+                        if (this_->m_stream_parser->is_done())
+                            this_->m_parent->on_body_read();
+
+                        std::move(handler)(ec, std::string_view{ this_->m_chunk.data(), size });
+                    }
+                );
+            }
         };
 
         /**
@@ -136,9 +396,20 @@ namespace malloy::server::http
         struct config
         {
             std::uint64_t request_body_limit = 100'000'000;    ///< The maximum allowed body request size in bytes.
+            std::size_t request_body_chunk_size = 16 * 1024;   ///< The maximum size of a body chunk read by request_generator::read_some().
             std::string agent_string;                          ///< Agent string to use, set by the controller
+            std::size_t pipeline_limit = 16;                   ///< The maximum number of queued responses before reading pauses.
+            bool cancel_on_half_close = true;                  ///< Whether the peer half-closing cancels the outstanding request.
         };
 
+        /**
+         * Observer of a completed response write.
+         *
+         * @details Invoked with the response status, the number of bytes written and the time elapsed since the
+         *          request header was received.
+         */
+        using write_observer_t = std::function<void(unsigned status, std::size_t bytes, std::chrono::steady_clock::duration latency)>;
+
         /**
          * The connection configuration.
          */
@@ -201,22 +472,106 @@ namespace malloy::server::http
             // The lifetime of the message has to extend
             // for the duration of the async operation so
             // we use a shared_ptr to manage it.
-            auto sp = std::make_shared<boost::beast::http::message<isRequest, Body, Fields>>(std::move(msg));
+            using message_t = boost::beast::http::message<isRequest, Body, Fields>;
+            auto sp = std::allocate_shared<message_t>(allocator(), std::move(msg));
 
-            // Store a type-erased version of the shared
-            // pointer in the class to keep it alive.
-            m_response = sp;
+            // The message is owned by the pending write (which is why a plain function pointer does for writing it)
+            pending_write w;
+            if constexpr (!isRequest)
+                w.status = sp->result_int();
+            w.close = sp->need_eof();
+            w.response = sp;
 
-            // Write the response
-            boost::beast::http::async_write(
-                derived().m_stream,
-                *sp,
-                boost::beast::bind_front_handler(
-                    &connection::on_write,
-                    derived().shared_from_this(),
-                    sp->need_eof()
-                )
-            );
+            // Send files straight from their descriptor on plain connections
+            if constexpr (!isRequest && detail::is_file_body<Body>::value && malloy::tcp::sendfile_supported) {
+                if constexpr (requires(Derived& d) { d.m_stream.socket().native_handle(); }) {
+                    if (sp->body().is_open() && !sp->chunked() && sp->payload_size()) {
+                        w.write = [](connection& c, const std::shared_ptr<const void>& msg) {
+                            c.do_write_file(std::static_pointer_cast<message_t>(std::const_pointer_cast<void>(msg)));
+                        };
+
+                        return queue_write(std::move(w));
+                    }
+                }
+            }
+
+            w.write = [](connection& c, const std::shared_ptr<const void>& msg) {
+                boost::beast::http::async_write(
+                    c.derived().m_stream,
+                    *std::static_pointer_cast<message_t>(std::const_pointer_cast<void>(msg)),
+                    boost::asio::bind_allocator(
+                        c.allocator(),
+                        boost::beast::bind_front_handler(
+                            &connection::on_write,
+                            c.derived().shared_from_this()
+                        )
+                    )
+                );
+            };
+
+            queue_write(std::move(w));
+        }
+
+        /**
+         * Perform an asynchronous write of a canned response.
+         *
+         * @details The pre-serialized header & body are sent with a single gather write (together with the other
+         *          canned responses queued by then).
+         *
+         * @param resp The response.
+         * @param req The request to which we're responding.
+         */
+        void
+        do_write(std::shared_ptr<const malloy::http::canned_response> resp, const boost::beast::http::request_header<>& req)
+        {
+            boost::beast::http::token_list connection{ req[malloy::http::field::connection] };
+
+            const auto buffers = resp->buffers(req.method() == malloy::http::method::head);
+
+            pending_write w;
+            w.buffers = buffers;
+            w.status = resp->status();
+            w.close = (req.version() < 11) ? !connection.exists("keep-alive") : connection.exists("close");
+
+            // Keep the response alive for the duration of the async operation
+            w.response = std::move(resp);
+
+            queue_write(std::move(w));
+        }
+
+        /**
+         * Perform an asynchronous write of a part of a response.
+         *
+         * @details The parts are written in order. No other response is written before the last part, hence the next
+         *          request is only handled once the last part was queued.
+         *
+         * @param part The part.
+         */
+        void
+        do_write_part(response_part&& part)
+        {
+            pending_write w;
+            w.buffers = part.buffers;
+            w.response = std::move(part.storage);
+            w.status = part.status;
+            w.close = part.close;
+            w.last = part.last;
+            w.written = std::move(part.written);
+
+            queue_write(std::move(w));
+        }
+
+        /**
+         * Observe the write of the response to the current request.
+         *
+         * @details The observer is invoked once (i.e. it is discarded after the next response was written).
+         *
+         * @param observer The observer.
+         */
+        void
+        observe_write(write_observer_t observer)
+        {
+            m_write_observer = std::move(observer);
         }
 
         void
@@ -224,8 +579,10 @@ namespace malloy::server::http
         {
             m_logger->trace("do_read()");
 
+            m_reading = true;
+
             // Construct a new parser for each message
-            m_parser = std::make_unique<std::decay_t<decltype(*m_parser)>>();
+            m_parser = std::allocate_shared<std::decay_t<decltype(*m_parser)>>(allocator());
 
             // Apply a reasonable limit to the allowed size
             // of the body in bytes to prevent abuse.
@@ -239,9 +596,12 @@ namespace malloy::server::http
                 derived().m_stream,
                 m_buffer,
                 *m_parser,
-                boost::beast::bind_front_handler(
-                    &connection::on_read,
-                    derived().shared_from_this()
+                boost::asio::bind_allocator(
+                    allocator(),
+                    boost::beast::bind_front_handler(
+                        &connection::on_read,
+                        derived().shared_from_this()
+                    )
                 )
             );
         }
@@ -258,14 +618,74 @@ namespace malloy::server::http
     private:
         friend class request_generator;
 
+        /**
+         * A response queued for writing.
+         */
+        struct pending_write
+        {
+            using write_t = void (*)(connection&, const std::shared_ptr<const void>&);
+
+            write_t write = nullptr;                                // Writes the message (null for serialized responses)
+            std::array<boost::asio::const_buffer, 3> buffers;       // The serialized response (or part thereof)
+            std::shared_ptr<const void> response;                   // The message or the serialized response
+            unsigned status = 0;
+            bool close = false;
+            bool last = true;                                       // Whether this completes the response
+            std::chrono::steady_clock::time_point request_time;
+            write_observer_t write_observer;
+            std::function<void(malloy::error_code)> written;
+        };
+
+        // The parsers, the request generator, response messages, the write queue and the handlers of the connection's
+        // operations are allocated from this pool. It recycles their memory across the requests of a keep-alive connection. Not pooled are header
+        // fields (beast's basic_fields uses the default allocator), bodies, and whatever route handlers allocate.
+        // Objects still referring to the pool keep it alive (and might release their memory on another thread).
+        std::shared_ptr<std::pmr::memory_resource> m_pool = std::make_shared<malloy::detail::locked_pool_resource>(
+            std::pmr::pool_options{ .max_blocks_per_chunk = 4, .largest_required_pool_block = 2048 }
+        );
         std::shared_ptr<spdlog::logger> m_logger;
         std::shared_ptr<const std::filesystem::path> m_doc_root;
         std::shared_ptr<handler> m_router;
-        std::shared_ptr<void> m_response;
+        std::chrono::steady_clock::time_point m_request_time;
+        write_observer_t m_write_observer;
+
+        // Requests are handled one at a time: The next request is read once the response to the current one was
+        // queued (or once the queue drained if the request has a body, which is read from m_buffer by the handler).
+        // Only writing is pipelined, i.e. the queued responses are written (in the order of the requests) while the
+        // next requests are read and handled.
+        std::deque<pending_write, malloy::detail::pool_allocator<pending_write>> m_writes{ allocator() };
+        std::size_t m_writing = 0;                                  // Number of queued responses being written
+        std::vector<boost::asio::const_buffer> m_write_buffers;
+        std::size_t m_partial_bytes = 0;                            // Bytes written of the parts of the current response so far
+        std::shared_ptr<request_generator> m_upgrade;               // WS upgrade deferred until the queue drained
+        bool m_reading = false;
+        bool m_handling = false;                                    // The current request's response was not queued yet
+        bool m_read_ahead = false;                                  // The current request has no body
+        bool m_keep_alive = true;
+        bool m_closing = false;
+
+        // While a request is outstanding (and its body was read) the socket is probed for the peer disconnecting so
+        // that the work performed on behalf of the request can be cancelled.
+        std::weak_ptr<request_generator> m_outstanding;
+        bool m_body_read = false;
+        bool m_probing = false;
+        bool m_peer_closed = false;
 
         // Pointer to allow handoff to generator since it cannot be copied or moved
         typename request_generator::h_parser_t m_parser;
 
+        /**
+         * Gets the allocator for per-request objects.
+         *
+         * @return The allocator.
+         */
+        [[nodiscard]]
+        malloy::detail::pool_allocator<std::byte>
+        allocator() const noexcept
+        {
+            return malloy::detail::pool_allocator<std::byte>{ m_pool };
+        }
+
         /**
          * Cast to derived class type.
          *
@@ -283,9 +703,16 @@ namespace malloy::server::http
         {
             m_logger->trace("on_read(): bytes read: {}", bytes_transferred);
 
+            m_reading = false;
+
             // This means the connection was closed
-            if (ec == boost::beast::http::error::end_of_stream || ec == boost::beast::error::timeout)
-                return do_close();
+            if (ec == boost::beast::http::error::end_of_stream || ec == boost::beast::error::timeout) {
+                // Finish writing the queued responses first
+                m_closing = true;
+                if (m_writes.empty())
+                    do_close();
+                return;
+            }
 
             // Check for errors
             if (ec) {
@@ -293,58 +720,412 @@ namespace malloy::server::http
                 return;
             }
 
-            // Get the header
-            auto header = m_parser->get().base();
+            m_request_time = std::chrono::steady_clock::now();
+            m_handling = true;
+
+            // The next request can only be read ahead if this one has no body
+            m_read_ahead = m_parser->is_done();
+            m_keep_alive = m_parser->keep_alive();
+            m_body_read = m_read_ahead;
+
+            // Take the header (the body parser only needs the state of the parser, not its message)
+            auto header = std::move(m_parser->get().base());
 
             // Parse the request into something more useful from hereon
-            auto gen = std::shared_ptr<request_generator>{new request_generator{  std::move(m_parser), std::move(header), derived().shared_from_this(), std::move(m_buffer) }}; // Private ctor
+            auto gen = std::allocate_shared<request_generator>(allocator(), typename request_generator::token{ }, std::move(m_parser), std::move(header), derived().shared_from_this());
 
             // Check if this is a WS request
             if (boost::beast::websocket::is_upgrade(gen->header())) {
-                m_logger->info("upgrading HTTP connection to WS connection");
-
-                // Create a websocket connection, transferring ownership
-                // of both the socket and the HTTP request.
-                boost::beast::get_lowest_layer(derived().stream()).expires_never();
-                auto ws_connection = server::websocket::connection::make(
-                    m_logger,
-                    malloy::websocket::stream{derived().release_stream()},
-                    cfg.agent_string
-                );
-
-                // Hand over to router
-                m_router->websocket(*m_doc_root, gen, ws_connection);
+                // The stream can only be handed over once the queued responses were written
+                if (m_writes.empty())
+                    do_upgrade(std::move(gen));
+                else
+                    m_upgrade = std::move(gen);
             }
 
             // This is an HTTP request
             else {
+                m_outstanding = gen;
+
                 // Hand over to router
                 m_router->http(*m_doc_root, std::move(gen), derived().shared_from_this());
+
+                // Watch out for the peer disconnecting while the response is being generated
+                maybe_probe();
+            }
+        }
+
+        /**
+         * Called once the body of the outstanding request was read.
+         */
+        void
+        on_body_read()
+        {
+            m_body_read = true;
+            maybe_probe();
+        }
+
+        /**
+         * Probe the socket for the peer disconnecting if a request is outstanding.
+         */
+        void
+        maybe_probe()
+        {
+            if (m_probing || m_reading || m_closing || !m_handling || !m_body_read)
+                return;
+
+            m_probing = true;
+            boost::beast::get_lowest_layer(derived().stream()).socket().async_wait(
+                boost::asio::socket_base::wait_read,
+                boost::asio::bind_allocator(
+                    allocator(),
+                    boost::beast::bind_front_handler(
+                        &connection::on_probe,
+                        derived().shared_from_this()
+                    )
+                )
+            );
+        }
+
+        void
+        on_probe(const malloy::error_code ec)
+        {
+            m_probing = false;
+
+            // The socket was closed or the response was queued meanwhile
+            if (ec || m_reading || m_closing || !m_handling)
+                return;
+
+            // Readable without any data means that the peer closed (or reset) the connection
+            auto& socket = boost::beast::get_lowest_layer(derived().stream()).socket();
+            malloy::error_code peek_ec;
+            std::array<char, 1> data;
+            std::size_t size = 0;
+            malloy::error_code mode_ec;
+            socket.non_blocking(true, mode_ec);
+            if (!mode_ec) {
+                size = socket.receive(boost::asio::buffer(data), boost::asio::socket_base::message_peek, peek_ec);
+                socket.non_blocking(false, mode_ec);
+            }
+
+            // The socket is of no use in an unknown mode
+            if (mode_ec) {
+                m_logger->error("on_probe(): could not switch blocking mode: {}", mode_ec.message());
+                return on_peer_closed();
+            }
+
+            // Spurious wake-up
+            if (peek_ec == boost::asio::error::would_block)
+                return maybe_probe();
+
+            // The peer sent more data (e.g. a pipelined request) which can't be probed past without reading it
+            if (!peek_ec && size > 0)
+                return;
+
+            // The peer shut down sending (or closed the connection). The socket remains readable, hence probing stops
+            // either way. A reset is reported as a different error.
+            if (peek_ec == boost::asio::error::eof && !cfg.cancel_on_half_close) {
+                m_logger->debug("peer half-closed while request was outstanding");
+                return;
+            }
+
+            on_peer_closed();
+        }
+
+        /**
+         * Cancel the outstanding request after the peer disconnected.
+         */
+        void
+        on_peer_closed()
+        {
+            m_logger->info("peer disconnected while request was outstanding");
+
+            m_peer_closed = true;
+            m_closing = true;
+            if (const auto gen = m_outstanding.lock())
+                gen->cancel();
+
+            // This also aborts the writes in progress
+            malloy::error_code ec;
+            boost::beast::get_lowest_layer(derived().stream()).socket().close(ec);
+        }
+
+        /**
+         * Upgrade to a websocket connection.
+         *
+         * @param gen The upgrade request.
+         */
+        void
+        do_upgrade(std::shared_ptr<request_generator> gen)
+        {
+            m_logger->info("upgrading HTTP connection to WS connection");
+
+            // Create a websocket connection, transferring ownership
+            // of both the socket and the HTTP request.
+            boost::beast::get_lowest_layer(derived().stream()).expires_never();
+            auto ws_connection = server::websocket::connection::make(
+                m_logger,
+                malloy::websocket::stream{derived().release_stream()},
+                cfg.agent_string
+            );
+
+            // Hand over to router
+            m_router->websocket(*m_doc_root, gen, ws_connection);
+        }
+
+        /**
+         * Queue a response for writing.
+         *
+         * @note This may be called from outside of the connection's strand.
+         *
+         * @param w The response.
+         */
+        void
+        queue_write(pending_write&& w)
+        {
+            // The handler is allocated from the pool in case it can't be invoked right away
+            boost::asio::dispatch(
+                derived().m_stream.get_executor(),
+                boost::asio::bind_allocator(
+                    allocator(),
+                    [self = derived().shared_from_this(), w = std::move(w)]() mutable {
+                        self->on_queue_write(std::move(w));
+                    }
+                )
+            );
+        }
+
+        void
+        on_queue_write(pending_write&& w)
+        {
+            // Nobody is listening anymore
+            if (m_peer_closed) {
+                if (w.written)
+                    notify_written(std::move(w.written), boost::asio::error::operation_aborted);
+                return;
+            }
+
+            if (w.last) {
+                w.request_time = m_request_time;
+                w.write_observer = std::exchange(m_write_observer, nullptr);
+                w.close |= !m_keep_alive;
+
+                // The handler responded without reading (all of) the body: The remaining bytes can't be told apart
+                // from the next request.
+                w.close |= !m_body_read;
+
+                m_closing |= w.close;
+                m_handling = false;
             }
+
+            m_writes.emplace_back(std::move(w));
+            if (m_writing == 0)
+                write_queued();
+
+            // Read ahead
+            maybe_read();
         }
 
+        /**
+         * Write the queued responses.
+         *
+         * @details Consecutive canned responses are written with a single gather write.
+         */
         void
-        on_write(bool close, boost::beast::error_code ec, std::size_t bytes_transferred)
+        write_queued()
+        {
+            // Messages are serialized by beast one at a time
+            if (const auto& w = m_writes.front(); w.write) {
+                m_writing = 1;
+                return w.write(*this, w.response);
+            }
+
+            m_write_buffers.clear();
+            for (const auto& w : m_writes) {
+                if (w.write)
+                    break;
+
+                m_write_buffers.insert(std::end(m_write_buffers), std::cbegin(w.buffers), std::cend(w.buffers));
+                m_writing++;
+
+                if (w.close)
+                    break;
+            }
+
+            // The buffers are passed as a span, asio would copy a vector
+            boost::asio::async_write(
+                derived().m_stream,
+                std::span<const boost::asio::const_buffer>{ m_write_buffers },
+                boost::asio::bind_allocator(
+                    allocator(),
+                    boost::beast::bind_front_handler(
+                        &connection::on_write,
+                        derived().shared_from_this()
+                    )
+                )
+            );
+        }
+
+#if defined(__linux__)
+        /**
+         * Write a file response.
+         *
+         * @details The header is serialized by beast, the body is sent with `sendfile(2)` directly from the file
+         *          descriptor (i.e. without being copied into userspace).
+         *
+         * @param msg The response.
+         */
+        template<class Body, class Fields>
+        void
+        do_write_file(std::shared_ptr<boost::beast::http::response<Body, Fields>> msg)
+        {
+            using serializer_t = boost::beast::http::serializer<false, Body, Fields>;
+
+            auto sr = std::allocate_shared<serializer_t>(allocator(), *msg);
+            boost::beast::http::async_write_header(
+                derived().m_stream,
+                *sr,
+                [self = derived().shared_from_this(), msg, sr](malloy::error_code ec, const std::size_t header_bytes) {
+                    if (ec || sr->is_done())
+                        return self->on_write(ec, header_bytes);
+
+                    // Continue from the current position of the file (just like beast's writer). Ranges of files
+                    // report positions relative to the range, the descriptor needs the absolute one.
+                    auto& file = msg->body().file();
+                    std::uint64_t offset = 0;
+                    if constexpr (requires { file.native_pos(ec); })
+                        offset = file.native_pos(ec);
+                    else
+                        offset = file.pos(ec);
+                    if (ec)
+                        return self->on_write(ec, header_bytes);
+
+                    // The socket isn't covered by the timeout of the stream, hence the idle timeout (same duration)
+                    malloy::tcp::async_sendfile(
+                        self->m_stream.socket(),
+                        file.native_handle(),
+                        offset,
+                        *msg->payload_size(),
+                        std::chrono::seconds(30),
+                        [self, msg, sr, header_bytes](const malloy::error_code ec, const std::uint64_t body_bytes) {
+                            // Drop a client which stopped reading (this also aborts a read in progress)
+                            if (ec == boost::asio::error::timed_out) {
+                                self->m_closing = true;
+                                malloy::error_code close_ec;
+                                self->m_stream.socket().close(close_ec);
+                            }
+
+                            self->on_write(ec, header_bytes + body_bytes);
+                        }
+                    );
+                }
+            );
+        }
+#endif
+
+        /**
+         * Notify the writer of a response part.
+         *
+         * @details This is posted so that the writer can queue the next part right away.
+         */
+        void
+        notify_written(std::function<void(malloy::error_code)>&& written, const malloy::error_code ec)
+        {
+            boost::asio::post(
+                derived().m_stream.get_executor(),
+                [written = std::move(written), ec] {
+                    written(ec);
+                }
+            );
+        }
+
+        /**
+         * Discard the queued responses which will not be written anymore.
+         *
+         * @param ec The error to notify writers of response parts of.
+         */
+        void
+        discard_writes(const malloy::error_code ec)
+        {
+            for (auto& w : m_writes) {
+                if (w.written)
+                    notify_written(std::move(w.written), ec);
+            }
+            m_writes.clear();
+        }
+
+        /**
+         * Read the next request if allowed.
+         */
+        void
+        maybe_read()
+        {
+            if (m_reading || m_handling || m_closing || m_upgrade)
+                return;
+
+            // The handler of a request with a body reads it from m_buffer
+            if (!m_read_ahead && !m_writes.empty())
+                return;
+
+            // Apply backpressure
+            if (m_writes.size() >= std::max<std::size_t>(cfg.pipeline_limit, 1))
+                return;
+
+            do_read();
+        }
+
+        void
+        on_write(boost::beast::error_code ec, std::size_t bytes_transferred)
         {
             m_logger->trace("on_write(): bytes written: {}", bytes_transferred);
 
+            // We're done with the written responses so delete them, notifying their observers
+            const auto now = std::chrono::steady_clock::now();
+            const bool single = (m_writing == 1);
+            bool close = false;
+            for (; m_writing > 0; m_writing--) {
+                pending_write& w = m_writes.front();
+                const std::size_t bytes = single ? bytes_transferred : boost::asio::buffer_size(w.buffers);
+                if (w.written)
+                    notify_written(std::move(w.written), ec);
+
+                if (!w.last)
+                    m_partial_bytes += bytes;
+                else if (w.write_observer)
+                    w.write_observer(w.status, std::exchange(m_partial_bytes, 0) + bytes, now - w.request_time);
+
+                close = w.close;
+                m_writes.pop_front();
+            }
+
             // Check for errors
             if (ec) {
                 m_logger->error("on_write(): {}", ec.message());
+                discard_writes(ec);
                 return;
             }
 
             if (close) {
                 // This means we should close the connection, usually because
                 // the response indicated the "Connection: close" semantic.
+                discard_writes(boost::asio::error::operation_aborted);
                 return do_close();
             }
 
-            // We're done with the response so delete it
-            m_response = { };
+            // Write the next responses
+            if (!m_writes.empty())
+                write_queued();
+
+            // Hand over the stream
+            else if (m_upgrade)
+                return do_upgrade(std::exchange(m_upgrade, nullptr));
+
+            // The peer closed its end of the connection
+            else if (m_closing)
+                return do_close();
 
             // Read another request
-            do_read();
+            maybe_read();
         }
 
         /**
@@ -1,6 +1,7 @@
 #include "connection_detector.hpp"
 #include "connection_plain.hpp"
 #include "../routing/router.hpp"
+#include "../routing/router_handle.hpp"
 
 #if MALLOY_FEATURE_TLS
     #include "connection_tls.hpp"
@@ -15,6 +16,10 @@ using namespace malloy::server::http;
  *
  * @details This is needed to break the dependency cycle between connection and router.
  *
+ *          The router is loaded from the handle for every request (by the `Host` header of the request) and is
+ *          retained by the request generator. Hence a request which is still in flight when a new router is published
+ *          (e.g. while reading its body, in a coroutine or on an offload pool) completes on the router it started on.
+ *
  * @sa connection
  */
 template<typename Derived>
@@ -22,6 +27,7 @@ class router_adaptor :
     public connection<Derived>::handler
 {
     using router_t = std::shared_ptr<malloy::server::router>;
+    using router_handle_t = std::shared_ptr<malloy::server::router_handle>;
 
 public:
     using http_conn_t = const connection_t&;
@@ -30,11 +36,11 @@ public:
     /**
      * Constructor.
      *
-     * @param router The router.
+     * @param handle The router handle.
      */
     explicit
-    router_adaptor(router_t router) :
-        m_router{ std::move(router) }
+    router_adaptor(router_handle_t handle) :
+        m_handle{ std::move(handle) }
     {
     }
 
@@ -65,13 +71,15 @@ public:
     }
 
 private:
-    router_t m_router;
+    router_handle_t m_handle;
 
     template<bool isWebsocket>
     void
     handle(const std::filesystem::path& root, const req_t& req, auto conn)
     {
-        m_router->handle_request<isWebsocket, Derived>(root, req, conn);
+        router_t r = m_handle->load(std::string_view{req->header()[malloy::http::field::host]});
+        req->retain(r);
+        r->handle_request<isWebsocket, Derived>(root, req, conn);
     }
 };
 
@@ -80,15 +88,19 @@ connection_detector::connection_detector(
     boost::asio::ip::tcp::socket&& socket,
     std::shared_ptr<boost::asio::ssl::context> ctx,
     std::shared_ptr<const std::filesystem::path> doc_root,
-    std::shared_ptr<malloy::server::router> router,
-    std::string agent_string
+    std::shared_ptr<malloy::server::router_handle> router,
+    std::string agent_string,
+    const std::size_t pipeline_limit,
+    const bool cancel_on_half_close
 ) :
     m_logger(std::move(logger)),
     m_stream(std::move(socket)),
     m_ctx(std::move(ctx)),
     m_doc_root(std::move(doc_root)),
     m_router(std::move(router)),
-    m_agent_string{std::move(agent_string)}
+    m_agent_string{std::move(agent_string)},
+    m_pipeline_limit{pipeline_limit},
+    m_cancel_on_half_close{cancel_on_half_close}
 {
     // Sanity check logger
     if (!m_logger)
@@ -152,6 +164,8 @@ connection_detector::on_detect(boost::beast::error_code ec, [[maybe_unused]] boo
         );
     }([this](auto&& conn) {
         conn->cfg.agent_string = m_agent_string;
+        conn->cfg.pipeline_limit = m_pipeline_limit;
+        conn->cfg.cancel_on_half_close = m_cancel_on_half_close;
         conn->run();
     });
 }
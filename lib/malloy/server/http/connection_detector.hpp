@@ -18,7 +18,7 @@ namespace spdlog
 
 namespace malloy::server
 {
-    class router;
+    class router_handle;
 }
 
 namespace malloy::server::http
@@ -40,14 +40,19 @@ namespace malloy::server::http
          * @param ctx
          * @param doc_root
          * @param router
+         * @param agent_string
+         * @param pipeline_limit
+         * @param cancel_on_half_close
          */
         connection_detector(
             std::shared_ptr<spdlog::logger> logger,
             boost::asio::ip::tcp::socket&& socket,
             std::shared_ptr<boost::asio::ssl::context> ctx,
             std::shared_ptr<const std::filesystem::path> doc_root,
-            std::shared_ptr<malloy::server::router> router,
-            std::string agent_string
+            std::shared_ptr<malloy::server::router_handle> router,
+            std::string agent_string,
+            std::size_t pipeline_limit,
+            bool cancel_on_half_close
         );
 
         /**
@@ -62,8 +67,10 @@ namespace malloy::server::http
         std::shared_ptr<boost::asio::ssl::context> m_ctx;
         boost::beast::flat_buffer m_buffer;
         std::shared_ptr<const std::filesystem::path> m_doc_root;
-        std::shared_ptr<malloy::server::router> m_router;
+        std::shared_ptr<malloy::server::router_handle> m_router;
         std::string m_agent_string;
+        std::size_t m_pipeline_limit;
+        bool m_cancel_on_half_close;
 
         void
         on_detect(boost::beast::error_code ec, bool result);
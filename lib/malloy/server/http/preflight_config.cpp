@@ -2,23 +2,38 @@
 
 using namespace malloy::server::http;
 
+namespace
+{
+
+    template<typename Range, typename Func>
+    [[nodiscard]]
+    std::string
+    join(const Range& range, const Func& to_string)
+    {
+        std::string str;
+        for (const auto& item : range) {
+            if (!str.empty())
+                str += ", ";
+            str += to_string(item);
+        }
+
+        return str;
+    }
+
+}
+
 void
 preflight_config::setup_response(
     malloy::http::response<>& resp,
-    const std::span<malloy::http::method> methods
+    const std::span<const malloy::http::method> methods
 ) const
 {
-    // Create a string representing all supported methods
-    std::string methods_string;
-    for (const auto& method : methods) {
-        methods_string += boost::beast::http::to_string(method);
-        if (&method != &methods.back())
-            methods_string += ", ";
-    }
-
-    //resp.set(malloy::http::field::content_type, "text/html");
     resp.base().set("Access-Control-Allow-Origin", origin);
-    resp.base().set("Access-Control-Allow-Methods", methods_string);
-    //resp.base().set("Access-Control-Allow-Headers", "Content-Type");
-    //resp.base().set("Access-Control-Max-Age", "60");
-}
\ No newline at end of file
+    resp.base().set("Access-Control-Allow-Methods", join(methods, [](const auto m) { return boost::beast::http::to_string(m); }));
+    if (!allowed_headers.empty())
+        resp.base().set("Access-Control-Allow-Headers", join(allowed_headers, [](const auto& h) -> const std::string& { return h; }));
+    if (allow_credentials)
+        resp.base().set("Access-Control-Allow-Credentials", "true");
+    if (max_age)
+        resp.base().set("Access-Control-Max-Age", std::to_string(max_age->count()));
+}
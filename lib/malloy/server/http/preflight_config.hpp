@@ -2,7 +2,11 @@
 
 #include "../../core/http/response.hpp"
 
+#include <chrono>
+#include <optional>
 #include <span>
+#include <string>
+#include <vector>
 
 namespace malloy::server::http
 {
@@ -11,6 +15,21 @@ namespace malloy::server::http
     {
         std::string origin = "http://127.0.0.1:8080";
 
+        /**
+         * The request headers the client may use (`Access-Control-Allow-Headers`). Omitted if empty.
+         */
+        std::vector<std::string> allowed_headers;
+
+        /**
+         * Whether the client may include credentials (`Access-Control-Allow-Credentials`).
+         */
+        bool allow_credentials = false;
+
+        /**
+         * How long the client may cache the preflight response (`Access-Control-Max-Age`). Omitted if not set.
+         */
+        std::optional<std::chrono::seconds> max_age;
+
         /**
          * Setup a response.
          *
@@ -23,7 +42,7 @@ namespace malloy::server::http
         void
         setup_response(
             malloy::http::response<>& resp,
-            std::span<malloy::http::method> methods
+            std::span<const malloy::http::method> methods
         ) const;
     };
 
@@ -1,5 +1,6 @@
 #include "listener.hpp"
 #include "http/connection_detector.hpp"
+#include "routing/router_handle.hpp"
 
 #include <boost/asio/strand.hpp>
 #include <spdlog/logger.h>
@@ -13,9 +14,11 @@ listener::listener(
     boost::asio::io_context& ioc,
     std::shared_ptr<boost::asio::ssl::context> tls_ctx,
     const boost::asio::ip::tcp::endpoint& endpoint,
-    std::shared_ptr<server::router> router,
+    std::shared_ptr<server::router_handle> router,
     std::shared_ptr<const std::filesystem::path> http_doc_root,
-    std::string agent_string
+    std::string agent_string,
+    const std::size_t pipeline_limit,
+    const bool cancel_on_half_close
 ) :
     m_logger(std::move(logger)),
     m_connection_logger(std::move(connection_logger)),
@@ -24,7 +27,9 @@ listener::listener(
     m_acceptor(boost::asio::make_strand(ioc)),
     m_router(std::move(router)),
     m_doc_root(std::move(http_doc_root)),
-    m_agent_string{std::move(agent_string)}
+    m_agent_string{std::move(agent_string)},
+    m_pipeline_limit{pipeline_limit},
+    m_cancel_on_half_close{cancel_on_half_close}
 {
     boost::beast::error_code ec;
 
@@ -63,6 +68,23 @@ listener::listener(
     }
 }
 
+boost::asio::ip::tcp::endpoint
+listener::local_endpoint() const
+{
+    boost::beast::error_code ec;
+    auto endpoint = m_acceptor.local_endpoint(ec);
+    if (ec)
+        return { };
+
+    return endpoint;
+}
+
+std::shared_ptr<router>
+listener::router() const noexcept
+{
+    return m_router->load();
+}
+
 // Start accepting incoming connections
 void
 listener::run()
@@ -124,7 +146,9 @@ listener::on_accept(boost::beast::error_code ec, boost::asio::ip::tcp::socket so
         m_tls_ctx,
         m_doc_root,
         m_router,
-        m_agent_string
+        m_agent_string,
+        m_pipeline_limit,
+        m_cancel_on_half_close
     );
 
     // Run the HTTP connection
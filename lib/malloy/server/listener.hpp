@@ -25,6 +25,7 @@ namespace spdlog
 namespace malloy::server
 {
     class router;
+    class router_handle;
 
     /**
       * @brief Accepts incoming connections.
@@ -41,9 +42,11 @@ namespace malloy::server
          * @param ioc The I/O context to use.
          * @param tls_ctx The TLS context to use.
          * @param endpoint The enpoint to use.
-         * @param router The router to use.
+         * @param router The handle through which to obtain the router.
          * @param http_doc_root The path to the HTTP doc root.
          * @param agent_string The HTTP agent string field value.
+         * @param pipeline_limit The maximum number of pipelined requests per connection.
+         * @param cancel_on_half_close Whether a client half-closing the connection cancels the outstanding request.
          */
         listener(
             std::shared_ptr<spdlog::logger> logger,
@@ -51,9 +54,11 @@ namespace malloy::server
             boost::asio::io_context& ioc,
             std::shared_ptr<boost::asio::ssl::context> tls_ctx,
             const boost::asio::ip::tcp::endpoint& endpoint,
-            std::shared_ptr<malloy::server::router> router,
+            std::shared_ptr<malloy::server::router_handle> router,
             std::shared_ptr<const std::filesystem::path> http_doc_root,
-            std::string agent_string
+            std::string agent_string,
+            std::size_t pipeline_limit,
+            bool cancel_on_half_close
         );
 
         /**
@@ -97,13 +102,33 @@ namespace malloy::server
         run();
 
         /**
-         * Get the router.
+         * Get the local endpoint the listener is bound to.
+         *
+         * @details This reveals the actual port if the listener was bound to port 0.
+         *
+         * @return The endpoint. Default constructed if the listener is not bound.
+         */
+        [[nodiscard]]
+        boost::asio::ip::tcp::endpoint
+        local_endpoint() const;
+
+        /**
+         * Get the current router.
          *
          * @return The router.
          */
         [[nodiscard]]
         std::shared_ptr<malloy::server::router>
-        router() const noexcept
+        router() const noexcept;
+
+        /**
+         * Get the handle through which the router can be replaced.
+         *
+         * @return The router handle.
+         */
+        [[nodiscard]]
+        std::shared_ptr<malloy::server::router_handle>
+        router_handle() const noexcept
         {
             return m_router;
         }
@@ -114,9 +139,11 @@ namespace malloy::server
         boost::asio::io_context& m_io_ctx;
         std::shared_ptr<boost::asio::ssl::context> m_tls_ctx;
         boost::asio::ip::tcp::acceptor m_acceptor;
-        std::shared_ptr<malloy::server::router> m_router;
+        std::shared_ptr<malloy::server::router_handle> m_router;
         std::shared_ptr<const std::filesystem::path> m_doc_root;
         std::string m_agent_string;
+        std::size_t m_pipeline_limit;
+        bool m_cancel_on_half_close;
 
         /**
          * Start accepting incoming requests.
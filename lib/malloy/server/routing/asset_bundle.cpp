@@ -0,0 +1,402 @@
+#include "asset_bundle.hpp"
+#include "../../core/http/compression.hpp"
+#include "../../core/http/generator.hpp"
+#include "../../core/http/utils.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace malloy::server;
+using namespace malloy::http;
+
+namespace
+{
+
+    /**
+     * Reads a file into memory.
+     */
+    [[nodiscard]]
+    shared_buffer_body::value_type
+    read_file(const std::filesystem::path& path)
+    {
+        std::ifstream file{ path, std::ios::binary };
+        if (!file)
+            throw std::filesystem::filesystem_error("cannot open file", path, std::make_error_code(std::errc::io_error));
+
+        auto content = std::make_shared<std::string>(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{ });
+        if (file.bad())
+            throw std::filesystem::filesystem_error("cannot read file", path, std::make_error_code(std::errc::io_error));
+
+        return shared_buffer_body::value_type{ std::shared_ptr<const std::string>{ std::move(content) } };
+    }
+
+#if !defined(_WIN32)
+    /**
+     * A file mapped into memory.
+     */
+    struct mapping
+    {
+        void* addr = nullptr;
+        std::size_t size = 0;
+
+        mapping(void* addr_, const std::size_t size_) :
+            addr{ addr_ },
+            size{ size_ }
+        {
+        }
+
+        mapping(const mapping&) = delete;
+        mapping& operator=(const mapping&) = delete;
+
+        ~mapping()
+        {
+            ::munmap(addr, size);
+        }
+    };
+
+    /**
+     * Gets the identity & state of a file.
+     */
+    template<typename FileId>
+    [[nodiscard]]
+    FileId
+    to_file_id(const struct stat& st)
+    {
+        return {
+            .dev = static_cast<std::uint64_t>(st.st_dev),
+            .ino = static_cast<std::uint64_t>(st.st_ino),
+            .size = static_cast<std::uint64_t>(st.st_size),
+            .mtime = static_cast<std::int64_t>(st.st_mtime)
+        };
+    }
+
+    /**
+     * Maps a file into memory.
+     *
+     * @param id Set to the identity & state of the mapped file.
+     */
+    template<typename FileId>
+    [[nodiscard]]
+    shared_buffer_body::value_type
+    map_file(const std::filesystem::path& path, FileId& id)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::filesystem::filesystem_error("cannot open file", path, std::error_code{ errno, std::system_category() });
+
+        struct stat st{ };
+        if (::fstat(fd, &st) != 0) {
+            const std::error_code ec{ errno, std::system_category() };
+            ::close(fd);
+            throw std::filesystem::filesystem_error("cannot stat file", path, ec);
+        }
+        id = to_file_id<FileId>(st);
+
+        // Empty files can't be mapped
+        if (st.st_size == 0) {
+            ::close(fd);
+            return { };
+        }
+
+        void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        const std::error_code ec{ errno, std::system_category() };
+        ::close(fd);
+        if (addr == MAP_FAILED)
+            throw std::filesystem::filesystem_error("cannot map file", path, ec);
+
+        auto m = std::make_shared<const mapping>(addr, static_cast<std::size_t>(st.st_size));
+        const std::string_view data{ static_cast<const char*>(m->addr), m->size };
+
+        return shared_buffer_body::value_type{ std::move(m), data };
+    }
+#endif
+
+    /**
+     * Builds the fingerprinted path of an asset (e.g. `js/app.0123456789abcdef.js`).
+     */
+    [[nodiscard]]
+    std::string
+    fingerprint(const std::string_view path, const std::string_view etag)
+    {
+        // The hash part of the ETag
+        std::string_view hash = etag;
+        if (hash.size() >= 2 && hash.front() == '"' && hash.back() == '"')
+            hash = hash.substr(1, hash.size() - 2);
+        hash = hash.substr(0, hash.find('-'));
+
+        const auto slash = path.rfind('/');
+        const auto dot = path.rfind('.');
+        const bool has_ext = dot != std::string_view::npos && (slash == std::string_view::npos || dot > slash + 1);
+        const std::size_t split = has_ext ? dot : path.size();
+
+        std::string str;
+        str.reserve(path.size() + 1 + hash.size());
+        str += path.substr(0, split);
+        str += '.';
+        str += hash;
+        str += path.substr(split);
+
+        return str;
+    }
+
+    /**
+     * Holds a compressed variant (if any).
+     */
+    [[nodiscard]]
+    shared_buffer_body::value_type
+    hold(std::string&& compressed)
+    {
+        if (compressed.empty())
+            return { };
+
+        return shared_buffer_body::value_type{ std::make_shared<const std::string>(std::move(compressed)) };
+    }
+
+}
+
+void
+asset_bundle::asset::set_variants(shared_buffer_body::value_type gzip_, shared_buffer_body::value_type deflate_)
+{
+    gzip = std::move(gzip_);
+    deflate = std::move(deflate_);
+    etag_gzip = gzip.empty() ? std::string{ } : compression::coded_etag(etag, compression::coding::gzip);
+    etag_deflate = deflate.empty() ? std::string{ } : compression::coded_etag(etag, compression::coding::deflate);
+}
+
+asset_bundle::asset_bundle(std::filesystem::path root) :
+    asset_bundle{ std::move(root), config{ } }
+{
+}
+
+asset_bundle::asset_bundle(std::filesystem::path root, config cfg) :
+    m_root{ std::move(root) },
+    m_cfg{ std::move(cfg) }
+{
+    m_snapshot = build(nullptr);
+}
+
+asset_bundle::asset_bundle(const std::span<const embedded_resource> resources) :
+    asset_bundle{ resources, config{ } }
+{
+}
+
+asset_bundle::asset_bundle(const std::span<const embedded_resource> resources, config cfg) :
+    m_cfg{ std::move(cfg) }
+{
+    auto snap = std::make_shared<snapshot>();
+
+    for (const embedded_resource& res : resources) {
+        auto a = std::make_shared<asset>();
+        a->path = res.path;
+        a->mime_type = res.mime_type;
+        a->etag = res.etag;
+        a->fingerprinted_path = fingerprint(a->path, a->etag);
+
+        // Static data, no owner needed
+        a->identity = shared_buffer_body::value_type{ nullptr, res.identity };
+        a->set_variants(
+            res.gzip.empty() ? shared_buffer_body::value_type{ } : shared_buffer_body::value_type{ nullptr, res.gzip },
+            res.deflate.empty() ? shared_buffer_body::value_type{ } : shared_buffer_body::value_type{ nullptr, res.deflate }
+        );
+
+        snap->by_fingerprint.emplace(a->fingerprinted_path, a);
+        snap->by_path.emplace(a->path, std::move(a));
+    }
+
+    m_snapshot = std::move(snap);
+}
+
+void
+asset_bundle::reload()
+{
+    // Embedded resources can't change
+    if (m_root.empty())
+        return;
+
+    auto snap = build(current().get());
+
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    m_snapshot = std::move(snap);
+}
+
+std::shared_ptr<const asset_bundle::asset>
+asset_bundle::find(std::string_view rel_path) const
+{
+    const auto snap = current();
+
+    while (rel_path.starts_with('/'))
+        rel_path.remove_prefix(1);
+
+    std::string key{ rel_path };
+    if (key.empty() || key.ends_with('/'))
+        key += m_cfg.index;
+
+    if (const auto it = snap->by_path.find(key); it != std::end(snap->by_path))
+        return it->second;
+    if (const auto it = snap->by_fingerprint.find(key); it != std::end(snap->by_fingerprint))
+        return it->second;
+
+    return nullptr;
+}
+
+std::optional<std::string>
+asset_bundle::url_for(std::string_view rel_path) const
+{
+    while (rel_path.starts_with('/'))
+        rel_path.remove_prefix(1);
+
+    const auto snap = current();
+    const auto it = snap->by_path.find(std::string{ rel_path });
+    if (it == std::end(snap->by_path))
+        return std::nullopt;
+
+    return it->second->fingerprinted_path;
+}
+
+asset_bundle::response_type
+asset_bundle::respond(const request_header& req, std::string_view rel_path) const
+{
+    while (rel_path.starts_with('/'))
+        rel_path.remove_prefix(1);
+
+    const auto a = find(rel_path);
+    if (!a)
+        return generator::not_found(rel_path);
+
+    const bool fingerprinted = (rel_path == a->fingerprinted_path);
+    const bool has_variants = !a->gzip.empty() || !a->deflate.empty();
+
+    // Pick the representation
+    const auto accept_encoding = req.find(field::accept_encoding);
+    const auto coding = compression::negotiate(
+        accept_encoding == std::end(req) ? std::string_view{ } : std::string_view{ accept_encoding->value() },
+        !a->gzip.empty(),
+        !a->deflate.empty()
+    );
+
+    const auto set_common = [&](auto& resp) {
+        resp.set(field::etag, a->etag_of(coding));
+        if (has_variants)
+            resp.set(field::vary, "Accept-Encoding");
+        if (fingerprinted && !m_cfg.fingerprinted_cache_control.empty())
+            resp.set(field::cache_control, m_cfg.fingerprinted_cache_control);
+    };
+
+    // Conditional request (the client may hold any of the representations)
+    if (const auto it = req.find(field::if_none_match); it != std::end(req)) {
+        const std::string_view inm = it->value();
+        const bool match =
+            etag_matches(inm, a->etag) ||
+            (!a->etag_gzip.empty() && etag_matches(inm, a->etag_gzip)) ||
+            (!a->etag_deflate.empty() && etag_matches(inm, a->etag_deflate));
+        if (match) {
+            response<> resp{ status::not_modified };
+            set_common(resp);
+
+            return resp;
+        }
+    }
+
+    response<shared_buffer_body> resp{ status::ok };
+    resp.set(field::content_type, a->mime_type);
+    set_common(resp);
+    switch (coding) {
+        case compression::coding::gzip:
+            resp.set(field::content_encoding, compression::to_string(coding));
+            resp.body() = a->gzip;
+            break;
+
+        case compression::coding::deflate:
+            resp.set(field::content_encoding, compression::to_string(coding));
+            resp.body() = a->deflate;
+            break;
+
+        default:
+            resp.body() = a->identity;
+            break;
+    }
+    resp.prepare_payload();
+
+    return resp;
+}
+
+std::size_t
+asset_bundle::size() const
+{
+    return current()->by_path.size();
+}
+
+std::shared_ptr<const asset_bundle::snapshot>
+asset_bundle::current() const
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    return m_snapshot;
+}
+
+std::shared_ptr<const asset_bundle::snapshot>
+asset_bundle::build(const snapshot* prev) const
+{
+    auto snap = std::make_shared<snapshot>();
+    if (prev)
+        snap->modified_in_place = prev->modified_in_place;
+
+    for (const auto& dir_entry : std::filesystem::recursive_directory_iterator{ m_root, std::filesystem::directory_options::follow_directory_symlink }) {
+        if (!dir_entry.is_regular_file())
+            continue;
+
+        const std::filesystem::path& path = dir_entry.path();
+
+        auto a = std::make_shared<asset>();
+        a->path = path.lexically_relative(m_root).generic_string();
+
+#if !defined(_WIN32)
+        if (m_cfg.store == storage::mmap) {
+            // A mapped file which was modified in place (rather than replaced) might be truncated again
+            if (prev && !snap->modified_in_place.contains(a->path)) {
+                const auto it = prev->mapped.find(a->path);
+                struct stat st{ };
+                if (it != std::end(prev->mapped) && ::stat(path.c_str(), &st) == 0) {
+                    const auto id = to_file_id<file_id>(st);
+                    if (id.dev == it->second.dev && id.ino == it->second.ino && id != it->second)
+                        snap->modified_in_place.emplace(a->path);
+                }
+            }
+
+            if (snap->modified_in_place.contains(a->path))
+                a->identity = read_file(path);
+            else {
+                file_id id;
+                a->identity = map_file(path, id);
+                snap->mapped.emplace(a->path, id);
+            }
+        }
+        else
+            a->identity = read_file(path);
+#else
+        a->identity = read_file(path);
+#endif
+
+        auto prepared = compression::precompress(path, a->identity.view(), m_cfg.min_compress_size);
+        a->mime_type = prepared.mime_type;
+        a->etag = std::move(prepared.etag);
+        a->fingerprinted_path = fingerprint(a->path, a->etag);
+        a->set_variants(hold(std::move(prepared.gzip)), hold(std::move(prepared.deflate)));
+
+        snap->by_fingerprint.emplace(a->fingerprinted_path, a);
+        snap->by_path.emplace(a->path, std::move(a));
+    }
+
+    return snap;
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include "embedded_resource.hpp"
+#include "../../core/http/compression.hpp"
+#include "../../core/http/response.hpp"
+#include "../../core/http/shared_buffer_body.hpp"
+
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+
+namespace malloy::server
+{
+
+    /**
+     * A bundle of static assets served from memory.
+     *
+     * @details All files below a root directory are loaded (or mapped) into memory once. For each file, a strong
+     *          ETag, the MIME type and gzip & deflate compressed variants (for compressible types) are computed up
+     *          front. Every asset is also reachable through a fingerprinted path which contains a hash of its content
+     *          (e.g. `js/app.0123456789abcdef.js`) and is served with a far-future `Cache-Control` header.
+     *
+     *          Responses refer to the immutable buffers of the bundle, hence serving doesn't access the filesystem nor
+     *          copy the content. The representation is negotiated with `Accept-Encoding`. Every representation has
+     *          its own strong ETag (see @ref compression::coded_etag()); an `If-None-Match` matching any of them
+     *          yields `304 Not Modified`.
+     *
+     *          @ref reload() rebuilds the bundle and swaps it in atomically: Responses are served from either the old
+     *          or the new bundle, never a mix of both.
+     *
+     *          A bundle can also be created from resources embedded into the binary at build time (see
+     *          @ref embedded_resource). Such a bundle refers to the constant data directly and doesn't access the
+     *          filesystem at all.
+     *
+     *          The bundle is thread-safe.
+     *
+     * @sa router::add_file_serving()
+     */
+    class asset_bundle
+    {
+    public:
+        using request_header = boost::beast::http::request_header<>;
+        using response_type = std::variant<malloy::http::response<malloy::http::shared_buffer_body>, malloy::http::response<boost::beast::http::string_body>>;
+
+        /**
+         * How the content of the files is held.
+         */
+        enum class storage
+        {
+            memory,     ///< Read into memory.
+
+            /**
+             * Mapped into memory (falls back to reading where not supported).
+             *
+             * @warning Mapped files must be replaced by renaming a new file over them, not rewritten in place:
+             *          Accessing the mapping of a truncated file raises `SIGBUS`. @ref reload() detects files which
+             *          were modified in place (same inode, different size or modification time) and reads them into
+             *          memory from then on.
+             */
+            mmap,
+        };
+
+        /**
+         * Bundle configuration.
+         */
+        struct config
+        {
+            storage store = storage::memory;                                            ///< How to hold the content of the files.
+            std::size_t min_compress_size = 256;                                        ///< Smaller files are not compressed.
+            std::string index = "index.html";                                           ///< The file served for directory paths.
+            std::string fingerprinted_cache_control = "public, max-age=31536000, immutable";    ///< Cache-Control of fingerprinted paths.
+        };
+
+        /**
+         * An asset.
+         */
+        struct asset
+        {
+            std::string path;                                           ///< The path relative to the root.
+            std::string fingerprinted_path;                             ///< The fingerprinted path relative to the root.
+            std::string_view mime_type;                                 ///< The MIME type.
+            std::string etag;                                           ///< The strong entity tag of the content.
+            std::string etag_gzip;                                      ///< The strong entity tag of the gzip compressed content (empty if none).
+            std::string etag_deflate;                                   ///< The strong entity tag of the deflate compressed content (empty if none).
+            malloy::http::shared_buffer_body::value_type identity;      ///< The content.
+            malloy::http::shared_buffer_body::value_type gzip;          ///< The gzip compressed content (empty if not worth it).
+            malloy::http::shared_buffer_body::value_type deflate;       ///< The deflate compressed content (empty if not worth it).
+
+            /**
+             * Gets the entity tag of a representation.
+             *
+             * @param c The coding of the representation.
+             * @return The entity tag (empty if there's no such representation).
+             */
+            [[nodiscard]]
+            const std::string&
+            etag_of(const malloy::http::compression::coding c) const noexcept
+            {
+                switch (c) {
+                    case malloy::http::compression::coding::gzip:       return etag_gzip;
+                    case malloy::http::compression::coding::deflate:    return etag_deflate;
+                    default:                                            return etag;
+                }
+            }
+
+            /**
+             * Sets the compressed representations and derives their entity tags.
+             *
+             * @param gzip_ The gzip compressed content (empty if none).
+             * @param deflate_ The deflate compressed content (empty if none).
+             */
+            void
+            set_variants(malloy::http::shared_buffer_body::value_type gzip_, malloy::http::shared_buffer_body::value_type deflate_);
+        };
+
+        /**
+         * Constructor.
+         *
+         * @details This loads the bundle.
+         *
+         * @throw std::filesystem::filesystem_error if the root directory can't be read.
+         *
+         * @param root The root directory.
+         */
+        explicit
+        asset_bundle(std::filesystem::path root);
+
+        /**
+         * Constructor.
+         *
+         * @details This loads the bundle.
+         *
+         * @throw std::filesystem::filesystem_error if the root directory can't be read.
+         *
+         * @param root The root directory.
+         * @param cfg The configuration.
+         */
+        asset_bundle(std::filesystem::path root, config cfg);
+
+        /**
+         * Constructor.
+         *
+         * @details The bundle refers to the embedded data (which is neither copied nor compressed again).
+         *
+         * @param resources The embedded resources.
+         */
+        explicit
+        asset_bundle(std::span<const embedded_resource> resources);
+
+        /**
+         * Constructor.
+         *
+         * @details The bundle refers to the embedded data (which is neither copied nor compressed again). The
+         *          storage and compression settings of the configuration don't apply.
+         *
+         * @param resources The embedded resources.
+         * @param cfg The configuration.
+         */
+        asset_bundle(std::span<const embedded_resource> resources, config cfg);
+
+        asset_bundle(const asset_bundle& other) = delete;
+        asset_bundle(asset_bundle&& other) noexcept = delete;
+        ~asset_bundle() = default;
+
+        asset_bundle& operator=(const asset_bundle& rhs) = delete;
+        asset_bundle& operator=(asset_bundle&& rhs) noexcept = delete;
+
+        /**
+         * Rebuilds the bundle from the root directory.
+         *
+         * @details The current bundle is served until the new one is complete. If loading fails, the current bundle
+         *          is kept. Bundles of embedded resources are left unchanged.
+         *
+         * @throw std::filesystem::filesystem_error if the root directory can't be read.
+         */
+        void
+        reload();
+
+        /**
+         * Looks up an asset.
+         *
+         * @param rel_path The plain or fingerprinted path relative to the root. Directory paths (including the empty
+         *                 path) refer to the index file of the directory.
+         * @return The asset (if any).
+         */
+        [[nodiscard]]
+        std::shared_ptr<const asset>
+        find(std::string_view rel_path) const;
+
+        /**
+         * Gets the fingerprinted path of an asset.
+         *
+         * @param rel_path The path relative to the root.
+         * @return The fingerprinted path relative to the root (if the asset exists).
+         */
+        [[nodiscard]]
+        std::optional<std::string>
+        url_for(std::string_view rel_path) const;
+
+        /**
+         * Creates the response to a request for an asset.
+         *
+         * @param req The request header.
+         * @param rel_path The plain or fingerprinted path relative to the root.
+         * @return The response.
+         */
+        [[nodiscard]]
+        response_type
+        respond(const request_header& req, std::string_view rel_path) const;
+
+        /**
+         * Gets the number of assets.
+         *
+         * @return The number of assets.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const;
+
+        /**
+         * Gets the root directory.
+         *
+         * @return The root directory (empty for bundles of embedded resources).
+         */
+        [[nodiscard]]
+        const std::filesystem::path&
+        root() const noexcept
+        {
+            return m_root;
+        }
+
+    private:
+        /**
+         * Identifies the state of a mapped file.
+         */
+        struct file_id
+        {
+            std::uint64_t dev = 0;
+            std::uint64_t ino = 0;
+            std::uint64_t size = 0;
+            std::int64_t mtime = 0;
+
+            [[nodiscard]]
+            bool
+            operator==(const file_id&) const noexcept = default;
+        };
+
+        /**
+         * The assets of a bundle, keyed by plain and fingerprinted path.
+         */
+        struct snapshot
+        {
+            std::unordered_map<std::string, std::shared_ptr<const asset>> by_path;
+            std::unordered_map<std::string, std::shared_ptr<const asset>> by_fingerprint;
+            std::unordered_map<std::string, file_id> mapped;        // Path -> state of the file when it was mapped
+            std::unordered_set<std::string> modified_in_place;      // Paths which are read instead of mapped
+        };
+
+        const std::filesystem::path m_root;
+        const config m_cfg;
+        mutable std::mutex m_lock;              // protects m_snapshot
+        std::shared_ptr<const snapshot> m_snapshot;
+
+        [[nodiscard]]
+        std::shared_ptr<const snapshot>
+        current() const;
+
+        /**
+         * Builds a snapshot from the root directory.
+         *
+         * @param prev The previous snapshot (if any).
+         */
+        [[nodiscard]]
+        std::shared_ptr<const snapshot>
+        build(const snapshot* prev) const;
+    };
+
+}
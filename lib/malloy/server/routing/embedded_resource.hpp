@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string_view>
+
+namespace malloy::server
+{
+
+    /**
+     * A static resource embedded into the binary.
+     *
+     * @details Tables of embedded resources are generated at build time by the `malloy_embed_resources()` CMake
+     *          function. All members refer to constant data with static storage duration.
+     *
+     * @sa asset_bundle
+     */
+    struct embedded_resource
+    {
+        std::string_view path;          ///< The path relative to the embedded directory.
+        std::string_view mime_type;     ///< The MIME type.
+        std::string_view etag;          ///< The strong entity tag of the content (including the quotes).
+        std::string_view identity;      ///< The content.
+        std::string_view gzip;          ///< The gzip compressed content (empty if not worth it).
+        std::string_view deflate;       ///< The deflate compressed content (empty if not worth it).
+    };
+
+}
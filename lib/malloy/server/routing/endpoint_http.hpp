@@ -1,6 +1,7 @@
 #pragma once
 
 #include "endpoint.hpp"
+#include "route_captures.hpp"
 #include "../http/connection_t.hpp"
 #include "../http/request_generator_t.hpp"
 #include "../../core/http/generator.hpp"
@@ -57,6 +58,40 @@ namespace malloy::server
             return method == req.method();
         }
 
+        /**
+         * Checks whether this endpoint would match the specified request and retrieves the captures.
+         *
+         * The default implementation does not capture anything.
+         *
+         * @param req The request to check.
+         * @param captures The captures. Only valid if the endpoint matches.
+         * @return Whether this endpoint matches the request.
+         */
+        [[nodiscard]]
+        virtual
+        bool
+        matches_with_captures(const req_header_t& req, route_captures& captures) const
+        {
+            captures.clear();
+
+            return matches(req);
+        }
+
+        /**
+         * Checks whether this endpoint has a handler.
+         *
+         * Requests to endpoints without a handler are answered with a `500 Internal Server Error` response.
+         *
+         * @return Whether this endpoint has a handler.
+         */
+        [[nodiscard]]
+        virtual
+        bool
+        has_handler() const noexcept
+        {
+            return true;
+        }
+
         /**
          * Handle the request and return the corresponding response.
          *
@@ -67,6 +102,24 @@ namespace malloy::server
         virtual
         handle_retr
         handle(const req_t& req, const http::connection_t& conn) const = 0;
+
+        /**
+         * Handle the request using the captures obtained while matching.
+         *
+         * The default implementation ignores the captures.
+         *
+         * @param req The request.
+         * @param conn The connection.
+         * @param captures The captures obtained while matching the request target against this endpoint.
+         * @return The response for the specified request.
+         */
+        [[nodiscard]]
+        virtual
+        handle_retr
+        handle_with_captures(const req_t& req, const http::connection_t& conn, const route_captures&) const
+        {
+            return handle(req, conn);
+        }
     };
 
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "endpoint_http.hpp"
+#include "response_cache.hpp"
+#include "single_flight.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace malloy::server
+{
+
+    /**
+     * An HTTP endpoint coalescing concurrent identical requests to another endpoint.
+     *
+     * @details Only the leading request of a flight is handed to the wrapped endpoint. The writer of the wrapped
+     *          endpoint is expected to complete the flight.
+     *
+     * @sa single_flight
+     */
+    struct endpoint_http_coalescing :
+        endpoint_http
+    {
+        std::unique_ptr<endpoint_http> inner;
+        std::shared_ptr<single_flight> flight;
+        std::vector<std::string> vary;
+
+        [[nodiscard]]
+        bool
+        matches(const req_header_t& req) const override
+        {
+            return inner->matches(req);
+        }
+
+        [[nodiscard]]
+        bool
+        matches_with_captures(const req_header_t& req, route_captures& captures) const override
+        {
+            return inner->matches_with_captures(req, captures);
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle(const req_t& req, const http::connection_t& conn) const override
+        {
+            if (!lead(req, conn))
+                return std::nullopt;
+
+            return inner->handle(req, conn);
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle_with_captures(const req_t& req, const http::connection_t& conn, const route_captures& captures) const override
+        {
+            if (!lead(req, conn))
+                return std::nullopt;
+
+            return inner->handle_with_captures(req, conn, captures);
+        }
+
+    private:
+        [[nodiscard]]
+        bool
+        lead(const req_t& req, const http::connection_t& conn) const
+        {
+            const auto& header = std::visit([](const auto& gen) -> const req_header_t& { return gen->header(); }, req);
+
+            return flight->join(response_cache::make_key(header, vary), req, conn);
+        }
+    };
+
+}
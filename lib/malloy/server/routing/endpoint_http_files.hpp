@@ -1,11 +1,16 @@
 #pragma once
 
+#include "asset_bundle.hpp"
 #include "endpoint_http.hpp"
+#include "../../core/http/file_cache.hpp"
+#include "../../core/http/range.hpp"
 #include "../../core/http/request.hpp"
+#include "../../core/http/shared_buffer_body.hpp"
 #include "../../core/http/utils.hpp"
 #include "../../core/type_traits.hpp"
 
 #include <filesystem>
+#include <memory>
 
 namespace malloy::server
 {
@@ -16,16 +21,31 @@ namespace malloy::server
      *          base is appended to a base path on the filesystem. e.g. /content/img.svg
      *          with a resource path of / and a base path of /var/www/content would
      *          result in the file at /var/www/content/content/img.svg being served.
+     *
+     *          If a file cache is set, the files are served from the descriptors kept open by the cache (and
+     *          base_path is ignored).
+     *
+     *          If an asset bundle is set, the files are served from memory (and base_path is ignored). The
+     *          Cache-Control header set by the bundle for fingerprinted paths takes precedence.
      */
     class endpoint_http_files :
         public endpoint_http
     {
-        using write_func = writer_t<boost::beast::http::file_body, boost::beast::http::string_body>;
+        using write_func = writer_t<
+            boost::beast::http::file_body,
+            malloy::http::file_range_body,
+            malloy::http::shared_file_body,
+            malloy::http::shared_file_range_body,
+            malloy::http::shared_buffer_body,
+            boost::beast::http::string_body
+        >;
 
     public:
         std::string resource_base;
         std::filesystem::path base_path;
         std::string cache_control;
+        std::shared_ptr<malloy::http::file_cache> cache;
+        std::shared_ptr<asset_bundle> bundle;
 
         write_func writer;
 
@@ -45,12 +65,22 @@ namespace malloy::server
                     malloy::http::request<> req_clone{ req };
                     malloy::http::chop_resource(req_clone, resource_base);
 
-                    // Create response
-                    auto resp = malloy::http::generator::file(req_clone, base_path);
-                    std::visit([this]<typename Resp>(Resp& resp){ resp.set(malloy::http::field::cache_control, cache_control); }, resp);  // Add Cache-Control header
-
-                    // Send
-                    writer(req, std::move(resp), conn);
+                    // Create response & send
+                    const auto send = [this, &req, &conn]<typename Resp>(Resp&& resp) {
+                        resp.set(malloy::http::field::cache_control, cache_control);    // Add Cache-Control header
+                        writer(req, std::forward<Resp>(resp), conn);
+                    };
+                    if (bundle) {
+                        std::visit([this, &req, &conn]<typename Resp>(Resp&& resp) {
+                            if (!cache_control.empty() && resp.find(malloy::http::field::cache_control) == resp.end())
+                                resp.set(malloy::http::field::cache_control, cache_control);
+                            writer(req, std::forward<Resp>(resp), conn);
+                        }, bundle->respond(req_clone, malloy::http::resource_string(req_clone)));
+                    }
+                    else if (cache)
+                        std::visit(send, malloy::http::generator::file(req_clone, *cache));
+                    else
+                        std::visit(send, malloy::http::generator::file(req_clone, base_path));
                     });
                 },
                 req
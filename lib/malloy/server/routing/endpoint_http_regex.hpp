@@ -2,11 +2,24 @@
 
 #include "endpoint_http.hpp"
 #include "type_traits.hpp"
+#include "../../core/awaitable.hpp"
+#include "../../core/error.hpp"
 #include "../../core/http/response.hpp"
 #include "../../core/type_traits.hpp"
 
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <concepts>
+#include <exception>
 #include <functional>
 #include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <cassert>
 
 namespace malloy::server
@@ -19,7 +32,18 @@ namespace malloy::server
         matches_resource(const boost::beast::http::request_header<>& req) const = 0;
     };
 
-    template<typename Response, concepts::request_filter Handler, bool WantsCapture>
+    /**
+     * An HTTP endpoint matching the request target against a regular expression.
+     *
+     * @tparam Response The response type (a variant of responses).
+     * @tparam Handler The request filter.
+     * @tparam WantsCapture Whether the handler receives the captures of the regex.
+     * @tparam Captures The type in which the handler receives the captures. Either @ref route_captures or
+     *                  `std::vector<std::string>`.
+     * @tparam Async Whether the handler is a coroutine (returning `malloy::awaitable<Response>`). Such handlers are
+     *               spawned on the strand of the connection and cancelled if the client disconnects.
+     */
+    template<typename Response, concepts::request_filter Handler, bool WantsCapture, typename Captures = std::vector<std::string>, bool Async = false>
     class endpoint_http_regex :
         public endpoint_http, public resource_matcher
     {
@@ -27,11 +51,13 @@ namespace malloy::server
         template<typename Derived>
         using req_gen_t = std::shared_ptr<typename http::connection<Derived>::request_generator>;
 
+        using handler_retr_t = std::conditional_t<Async, malloy::awaitable<Response>, Response>;
+
         template<typename Req>
         using handler_t = std::conditional_t<
             WantsCapture,
-            std::function<Response(const Req&, const std::vector<std::string>&)>,
-            std::function<Response(const Req&)>
+            std::function<handler_retr_t(const Req&, const Captures&)>,
+            std::function<handler_retr_t(const Req&)>
         >;
 
 
@@ -60,6 +86,29 @@ namespace malloy::server
             return endpoint_http::matches(req);
         }
 
+        [[nodiscard]]
+        bool
+        matches_with_captures(const req_header_t& req, route_captures& captures) const override
+        {
+            captures.clear();
+
+            // Method (cheap, hence first)
+            if (!endpoint_http::matches(req))
+                return false;
+
+            // Resource
+            if constexpr (WantsCapture)
+                return capture(req.target(), captures);
+            else
+                return matches_resource(req);
+        }
+
+        [[nodiscard]]
+        bool
+        has_handler() const noexcept override
+        {
+            return static_cast<bool>(handler);
+        }
 
         [[nodiscard]]
         handle_retr
@@ -68,7 +117,35 @@ namespace malloy::server
             if (handler) {
                 std::visit(
                     [this, conn]<typename Generator>(Generator && gen) {
-                        this->visit_bodies(std::forward<Generator>(gen), conn);
+                        // The captures are not known yet
+                        route_captures captures;
+                        if constexpr (WantsCapture) {
+                            if (!capture(gen->header().target(), captures)) {
+                                throw std::logic_error{
+                                    R"(endpoint_http_regex passed request which does not match: )" +
+                                    std::string{gen->header().target()} };
+                            }
+                        }
+
+                        this->visit_bodies(std::forward<Generator>(gen), conn, captures);
+                    },
+                    gens
+                );
+
+                return std::nullopt;
+            }
+            else
+                return malloy::http::generator::server_error("no valid handler available.");
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle_with_captures(const req_t& gens, const http::connection_t& conn, const route_captures& captures) const override
+        {
+            if (handler) {
+                std::visit(
+                    [this, conn, &captures]<typename Generator>(Generator && gen) {
+                        this->visit_bodies(std::forward<Generator>(gen), conn, captures);
                     },
                     gens
                 );
@@ -78,41 +155,93 @@ namespace malloy::server
             else
                 return malloy::http::generator::server_error("no valid handler available.");
         }
+
     private:
+        /**
+         * Matches a target against the regex and retrieves the captures.
+         *
+         * @param target The target.
+         * @param captures The captures (views into the target).
+         * @return Whether the target matches.
+         */
+        [[nodiscard]]
+        bool
+        capture(const std::string_view target, route_captures& captures) const
+        {
+            return regex_capture(resource_base, target, captures);
+        }
+
         void
-        handle_req(const auto& req, const http::connection_t& conn) const
+        handle_req(const auto& req, const http::connection_t& conn, const route_captures& captures) const
         {
             if constexpr (WantsCapture) {
-                std::smatch url_matches;
-                std::string url{ req.target() };
-                std::regex_match(url, url_matches, resource_base);
-
-                if (url_matches.empty()) {
-                    throw std::logic_error{
-                        R"(endpoint_http_regex passed request which does not match: )" +
-                        std::string{req.target()} };
-                }
-
-                std::vector<std::string> matches{// match_results[0] is the
-                                                 // input
-                                                 // string
-                                                 url_matches.begin() + 1,
-                                                 url_matches.end() };
-
-                writer(req, handler(req, matches), conn);
+                if constexpr (std::same_as<Captures, route_captures>)
+                    writer(req, handler(req, captures), conn);
+                else
+                    writer(req, handler(req, Captures(std::cbegin(captures), std::cend(captures))), conn);
             }
             else
                 writer(req, handler(req), conn);
         }
 
-        void
-        visit_bodies(const auto& gen, const http::connection_t& conn) const
+        /**
+         * Reads the body and handles the request in a coroutine.
+         *
+         * @note The generator is kept alive as the captures are views into its header.
+         */
+        malloy::awaitable<void>
+        handle_req_async(const auto gen, const http::connection_t conn, const route_captures captures) const
         {
             using body_t = typename Handler::request_type::body_type;
-            gen->template body<body_t>(
-                [this, conn](const auto& req) {
-                    this->handle_req(req, conn);
-                }, [&gen, this](auto& body) { filter.setup_body(gen->header(), body); });
+
+            malloy::error_code ec;
+            const auto req = co_await gen->template body<body_t>(
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec),
+                [&gen, this](auto& body) { filter.setup_body(gen->header(), body); }
+            );
+            if (ec)
+                co_return;
+
+            if constexpr (WantsCapture) {
+                if constexpr (std::same_as<Captures, route_captures>)
+                    writer(req, co_await handler(req, captures), conn);
+                else
+                    writer(req, co_await handler(req, Captures(std::cbegin(captures), std::cend(captures))), conn);
+            }
+            else
+                writer(req, co_await handler(req), conn);
+        }
+
+        void
+        visit_bodies(const auto& gen, const http::connection_t& conn, const route_captures& captures) const
+        {
+            if constexpr (Async) {
+                std::visit(
+                    [&, this](const auto& c) {
+                        // Exceptions are propagated just like those of synchronous handlers (unless cancelled)
+                        boost::asio::co_spawn(
+                            c->stream().get_executor(),
+                            handle_req_async(gen, conn, captures),
+                            boost::asio::bind_cancellation_slot(
+                                gen->cancellation_slot(),
+                                [stop = gen->stop_token()](const std::exception_ptr& e) {
+                                    if (e && !stop.stop_requested())
+                                        std::rethrow_exception(e);
+                                }
+                            )
+                        );
+                    },
+                    conn
+                );
+            }
+            else {
+                // The captures are views into the header of the generator which outlives the body callback
+                using body_t = typename Handler::request_type::body_type;
+                gen->template body<body_t>(
+                    [this, conn, captures](const auto& req) {
+                        this->handle_req(req, conn, captures);
+                    }, [&gen, this](auto& body) { filter.setup_body(gen->header(), body); });
+            }
         }
     };
 
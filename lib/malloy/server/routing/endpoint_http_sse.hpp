@@ -0,0 +1,55 @@
+#pragma once
+
+#include "endpoint_http.hpp"
+#include "../sse/stream.hpp"
+
+#include <functional>
+#include <memory>
+#include <regex>
+
+namespace malloy::server
+{
+
+    /**
+     * An HTTP endpoint turning `GET` requests into Server-Sent Events streams.
+     *
+     * @sa router::add_sse()
+     */
+    struct endpoint_http_sse :
+        endpoint_http
+    {
+        using stream_factory_t = std::function<std::shared_ptr<sse::stream>(const req_header_t&, const http::connection_t&)>;
+
+        std::regex resource_base;
+        sse::stream::handler_t handler;
+        stream_factory_t make_stream;
+
+        [[nodiscard]]
+        bool
+        matches(const req_header_t& req) const override
+        {
+            if (!endpoint_http::matches(req))
+                return false;
+
+            return std::regex_match(req.target().begin(), req.target().end(), resource_base);
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle(const req_t& req, const http::connection_t& conn) const override
+        {
+            std::visit(
+                [&, this](const auto& gen) {
+                    malloy::http::request<> r;
+                    r.base() = gen->header();
+
+                    handler(r, make_stream(gen->header(), conn));
+                },
+                req
+            );
+
+            return std::nullopt;
+        }
+    };
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "endpoint_http.hpp"
+#include "streaming_request.hpp"
+
+#include <functional>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace malloy::server
+{
+
+    /**
+     * An HTTP endpoint whose handler reads the request body in chunks.
+     *
+     * @details The handler is invoked once the request header was received. It reads the body through
+     *          @ref streaming_request::read_some() and sends the response through @ref streaming_request::respond()
+     *          (or @ref streaming_request::respond_chunked()).
+     *
+     * @sa router::add_streaming()
+     */
+    struct endpoint_http_streaming :
+        endpoint_http
+    {
+        using handler_t = std::function<void(streaming_request)>;
+        using writer_t = std::function<void(const req_header_t&, streaming_request::response_type&&, const http::connection_t&)>;
+        using chunked_writer_t = std::function<std::shared_ptr<http::chunked_response>(const req_header_t&, streaming_request::chunked_header_type&&, const http::connection_t&)>;
+
+        std::regex resource_base;
+        handler_t handler;
+        writer_t writer;
+        chunked_writer_t chunked_writer;
+
+        [[nodiscard]]
+        bool
+        matches(const req_header_t& req) const override
+        {
+            if (!endpoint_http::matches(req))
+                return false;
+
+            return std::regex_match(req.target().begin(), req.target().end(), resource_base);
+        }
+
+        [[nodiscard]]
+        bool
+        matches_with_captures(const req_header_t& req, route_captures& captures) const override
+        {
+            captures.clear();
+
+            // Method (cheap, hence first)
+            if (!endpoint_http::matches(req))
+                return false;
+
+            return regex_capture(resource_base, req.target(), captures);
+        }
+
+        [[nodiscard]]
+        bool
+        has_handler() const noexcept override
+        {
+            return static_cast<bool>(handler);
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle(const req_t& req, const http::connection_t& conn) const override
+        {
+            // The captures are not known yet
+            const req_header_t& header = std::visit([](const auto& gen) -> const req_header_t& { return gen->header(); }, req);
+            route_captures captures;
+            if (!matches_with_captures(header, captures))
+                throw std::logic_error{ "endpoint_http_streaming passed request which does not match: " + std::string{header.target()} };
+
+            return handle_with_captures(req, conn, captures);
+        }
+
+        [[nodiscard]]
+        handle_retr
+        handle_with_captures(const req_t& req, const http::connection_t& conn, const route_captures& captures) const override
+        {
+            if (!handler)
+                return malloy::http::generator::server_error("no valid handler available.");
+
+            std::visit(
+                [&, this](const auto& gen) {
+                    // The header (and therefore the captures) live as long as the generator
+                    std::shared_ptr<const req_header_t> header{ gen, &gen->header() };
+
+                    handler(streaming_request{
+                        header,
+                        captures,
+                        [gen](streaming_request::read_handler_t h) {
+                            gen->read_some(std::move(h));
+                        },
+                        [this, header, conn](streaming_request::response_type&& resp) {
+                            writer(*header, std::move(resp), conn);
+                        },
+                        [this, header, conn](streaming_request::chunked_header_type&& resp) {
+                            return chunked_writer(*header, std::move(resp), conn);
+                        },
+                        gen->stop_token()
+                    });
+                },
+                req
+            );
+
+            return std::nullopt;
+        }
+    };
+
+}
@@ -0,0 +1,151 @@
+#include "offload_pool.hpp"
+
+#include <algorithm>
+#include <deque>
+
+using namespace malloy::server;
+
+namespace
+{
+
+    /**
+     * The pool & index of the worker running on the calling thread (if any).
+     */
+    thread_local const offload_pool* t_pool = nullptr;
+    thread_local std::size_t t_index = 0;
+
+}
+
+struct offload_pool::worker
+{
+    std::mutex lock;                                        // protects queues
+    std::vector<std::deque<std::function<void()>>> queues;  // One per lane
+};
+
+offload_pool::offload_pool(config cfg) :
+    m_name{ std::move(cfg.name) },
+    m_lanes(std::max<std::size_t>(cfg.num_lanes, 1))
+{
+    const std::size_t num_threads = std::max<std::size_t>(cfg.num_threads > 0 ? cfg.num_threads : std::thread::hardware_concurrency(), 1);
+
+    m_workers.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; i++) {
+        auto w = std::make_unique<worker>();
+        w->queues.resize(m_lanes.size());
+        m_workers.emplace_back(std::move(w));
+    }
+
+    m_threads.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; i++)
+        m_threads.emplace_back(&offload_pool::run, this, i);
+}
+
+offload_pool::~offload_pool()
+{
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_sleep_lock);
+
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void
+offload_pool::submit(std::size_t lane, std::function<void()> job)
+{
+    lane = std::min(lane, m_lanes.size() - 1);
+
+    // Keep jobs submitted by a worker on that worker
+    const std::size_t index = (t_pool == this) ? t_index : m_next.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+    // Count the job before it can be taken (and uncounted) by a worker
+    m_lanes[lane].depth.fetch_add(1, std::memory_order_relaxed);
+    {
+        // Synchronize with workers going to sleep
+        std::lock_guard lock(m_sleep_lock);
+
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_workers[index]->lock);
+
+        m_workers[index]->queues[lane].emplace_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+offload_pool::lane_stats
+offload_pool::stats(const std::size_t lane) const
+{
+    return {
+        .depth = m_lanes[lane].depth.load(std::memory_order_relaxed),
+        .executed = m_lanes[lane].executed.load(std::memory_order_relaxed)
+    };
+}
+
+void
+offload_pool::run(const std::size_t index)
+{
+    t_pool = this;
+    t_index = index;
+
+    for (;;) {
+        std::function<void()> job;
+        std::size_t lane = 0;
+        if (!take(index, job, lane)) {
+            std::unique_lock lock(m_sleep_lock);
+            m_wake.wait(lock, [this] { return m_stopping || m_queued.load(std::memory_order_relaxed) > 0; });
+
+            // Drain the queues before stopping
+            if (m_stopping && m_queued.load(std::memory_order_relaxed) == 0)
+                return;
+
+            continue;
+        }
+
+        job();
+        m_lanes[lane].executed.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool
+offload_pool::take(const std::size_t index, std::function<void()>& job, std::size_t& lane)
+{
+    const std::size_t count = m_workers.size();
+
+    for (lane = 0; lane < m_lanes.size(); lane++) {
+        // Own queue first (oldest job), then steal from the others (newest job)
+        for (std::size_t i = 0; i < count; i++) {
+            auto& w = *m_workers[(index + i) % count];
+
+            // Acquire mutex
+            std::lock_guard lock(w.lock);
+
+            auto& queue = w.queues[lane];
+            if (queue.empty())
+                continue;
+
+            if (i == 0) {
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            else {
+                job = std::move(queue.back());
+                queue.pop_back();
+            }
+
+            m_lanes[lane].depth.fetch_sub(1, std::memory_order_relaxed);
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+
+            return true;
+        }
+    }
+
+    return false;
+}
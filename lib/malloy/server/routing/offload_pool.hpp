@@ -0,0 +1,238 @@
+#pragma once
+
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace malloy::server
+{
+
+    /**
+     * A thread pool to offload CPU-heavy route handlers to.
+     *
+     * @details Jobs are queued in priority lanes: A worker only takes a job from a lane once all lanes of higher
+     *          priority (lower index) are empty. Every worker has its own queue per lane. Jobs submitted from a worker
+     *          are queued on that worker, others are distributed round-robin. Idle workers steal from the queues of
+     *          the other workers.
+     *
+     *          The depth of each lane and the number of jobs executed are tracked for metrics.
+     *
+     *          The pool is thread-safe.
+     *
+     * @sa router::add()
+     */
+    class offload_pool
+    {
+    public:
+        /**
+         * Pool configuration.
+         */
+        struct config
+        {
+            std::string name = "default";       ///< The name of the pool (used as metrics label).
+            std::size_t num_threads = 0;        ///< The number of worker threads. 0 uses the number of hardware threads.
+            std::size_t num_lanes = 2;          ///< The number of priority lanes.
+        };
+
+        /**
+         * Offload policy of a route.
+         */
+        struct policy
+        {
+            std::shared_ptr<offload_pool> pool;     ///< The pool to run the handler on.
+            std::size_t lane = 0;                   ///< The priority lane (0 being the highest priority).
+        };
+
+        /**
+         * Statistics of a lane.
+         */
+        struct lane_stats
+        {
+            std::size_t depth = 0;                  ///< The number of queued jobs.
+            std::uint64_t executed = 0;             ///< The number of jobs executed so far.
+        };
+
+        /**
+         * Constructor.
+         *
+         * @details This starts the workers.
+         *
+         * @param cfg The configuration.
+         */
+        explicit
+        offload_pool(config cfg);
+
+        offload_pool(const offload_pool& other) = delete;
+        offload_pool(offload_pool&& other) noexcept = delete;
+
+        /**
+         * Destructor.
+         *
+         * @details The queued jobs are executed before the workers are joined.
+         */
+        ~offload_pool();
+
+        offload_pool& operator=(const offload_pool& rhs) = delete;
+        offload_pool& operator=(offload_pool&& rhs) noexcept = delete;
+
+        /**
+         * Submits a job.
+         *
+         * @param lane The lane. Lanes beyond the last one are clamped.
+         * @param job The job.
+         */
+        void
+        submit(std::size_t lane, std::function<void()> job);
+
+        /**
+         * Runs a function on the pool.
+         *
+         * @details The completion handler is invoked on its associated executor (e.g. the strand of a connection).
+         *          If cancellation is requested before the function was started, it is skipped and the operation
+         *          completes with `operation_aborted`.
+         *
+         * @param lane The lane.
+         * @param func The function.
+         * @param token The completion token (e.g. a callback or `boost::asio::use_awaitable`). The completion
+         *              signature is `void(std::exception_ptr, R)` where `R` is the result type of the function.
+         */
+        template<typename Func, typename CompletionToken>
+        auto
+        async_run(const std::size_t lane, Func&& func, CompletionToken&& token)
+        {
+            using result_t = std::invoke_result_t<std::decay_t<Func>&>;
+
+            return boost::asio::async_initiate<CompletionToken, void(std::exception_ptr, result_t)>(
+                [this, lane](auto handler, auto func) {
+                    using handler_t = decltype(handler);
+                    using func_t = decltype(func);
+
+                    struct operation
+                    {
+                        handler_t handler;
+                        func_t func;
+                        boost::asio::executor_work_guard<boost::asio::associated_executor_t<handler_t>> work;
+                        std::atomic<bool> abandoned = false;
+                    };
+                    auto work = boost::asio::make_work_guard(handler);
+                    auto op = std::make_shared<operation>(std::move(handler), std::move(func), std::move(work));
+
+                    // Abandon the function if cancelled before it was started
+                    if (auto slot = boost::asio::get_associated_cancellation_slot(op->handler); slot.is_connected()) {
+                        slot.assign([op = std::weak_ptr<operation>{op}](boost::asio::cancellation_type) {
+                            if (const auto o = op.lock())
+                                o->abandoned = true;
+                        });
+                    }
+
+                    submit(lane, [op] {
+                        std::exception_ptr e;
+                        std::optional<result_t> result;
+                        if (op->abandoned)
+                            e = std::make_exception_ptr(boost::system::system_error(boost::asio::error::operation_aborted));
+                        else {
+                            try {
+                                result.emplace(op->func());
+                            }
+                            catch (...) {
+                                e = std::current_exception();
+                            }
+                        }
+
+                        // Complete on the executor of the handler
+                        auto ex = op->work.get_executor();
+                        boost::asio::dispatch(ex, [op, e, result = std::move(result)]() mutable {
+                            op->work.reset();
+                            std::move(op->handler)(e, result ? std::move(*result) : result_t{ });
+                        });
+                    });
+                },
+                token,
+                std::forward<Func>(func)
+            );
+        }
+
+        /**
+         * Gets the name of the pool.
+         *
+         * @return The name.
+         */
+        [[nodiscard]]
+        const std::string&
+        name() const noexcept
+        {
+            return m_name;
+        }
+
+        /**
+         * Gets the number of lanes.
+         *
+         * @return The number of lanes.
+         */
+        [[nodiscard]]
+        std::size_t
+        lanes() const noexcept
+        {
+            return m_lanes.size();
+        }
+
+        /**
+         * Gets the statistics of a lane.
+         *
+         * @param lane The lane.
+         * @return The statistics.
+         */
+        [[nodiscard]]
+        lane_stats
+        stats(std::size_t lane) const;
+
+    private:
+        struct worker;
+
+        struct alignas(64) lane_counters
+        {
+            std::atomic<std::size_t> depth{0};
+            std::atomic<std::uint64_t> executed{0};
+        };
+
+        std::string m_name;
+        std::vector<lane_counters> m_lanes;
+        std::vector<std::unique_ptr<worker>> m_workers;
+        std::vector<std::thread> m_threads;
+        std::atomic<std::size_t> m_next{0};         // Round-robin distribution of external submissions
+        std::atomic<std::size_t> m_queued{0};
+        std::mutex m_sleep_lock;                    // protects m_stopping & sleeping
+        std::condition_variable m_wake;
+        bool m_stopping = false;
+
+        void
+        run(std::size_t index);
+
+        /**
+         * Takes the next job, preferring higher priority lanes and the queues of the given worker.
+         *
+         * @return Whether a job was taken.
+         */
+        [[nodiscard]]
+        bool
+        take(std::size_t index, std::function<void()>& job, std::size_t& lane);
+    };
+
+}
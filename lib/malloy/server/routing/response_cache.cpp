@@ -0,0 +1,284 @@
+#include "response_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+
+using namespace malloy::server;
+
+namespace
+{
+
+    /**
+     * Checks whether a response may be stored.
+     */
+    [[nodiscard]]
+    bool
+    is_storable(const response_cache::response_type& resp)
+    {
+        if (resp.result() != malloy::http::status::ok)
+            return false;
+
+        const auto it = resp.find(malloy::http::field::cache_control);
+        if (it == std::end(resp))
+            return true;
+
+        return std::string_view{it->value()}.find("no-store") == std::string_view::npos;
+    }
+
+    /**
+     * Checks whether a serialized response may be stored.
+     */
+    [[nodiscard]]
+    bool
+    is_storable(const malloy::http::canned_response& resp)
+    {
+        if (resp.status() != static_cast<unsigned>(malloy::http::status::ok))
+            return false;
+
+        // Look for the Cache-Control field (skipping the status line)
+        std::string_view header = resp.header();
+        for (auto eol = header.find("\r\n"); eol != std::string_view::npos; eol = header.find("\r\n")) {
+            header.remove_prefix(eol + 2);
+            const std::string_view line = header.substr(0, header.find("\r\n"));
+
+            constexpr std::string_view name = "cache-control:";
+            const bool matches = line.size() >= name.size() && std::equal(
+                std::cbegin(name), std::cend(name),
+                std::cbegin(line),
+                [](const char a, const char b) { return a == std::tolower(static_cast<unsigned char>(b)); }
+            );
+            if (matches && line.find("no-store") != std::string_view::npos)
+                return false;
+        }
+
+        return true;
+    }
+
+}
+
+response_cache::response_cache(const std::size_t max_bytes) :
+    m_max_bytes{max_bytes}
+{
+}
+
+std::string
+response_cache::make_key(const malloy::http::method method, const std::string_view target, const std::span<const std::string_view> values)
+{
+    const std::string_view method_str{boost::beast::http::to_string(method)};
+
+    std::size_t size = method_str.size() + 1 + target.size();
+    for (const auto& value : values)
+        size += 1 + value.size();
+
+    // Header field values can't contain line feeds
+    std::string key;
+    key.reserve(size);
+    key += method_str;
+    key += ' ';
+    key += target;
+    for (const auto& value : values) {
+        key += '\n';
+        key += value;
+    }
+
+    return key;
+}
+
+std::string
+response_cache::make_key(const request_header& header, const std::span<const std::string> vary)
+{
+    std::vector<std::string_view> values;
+    values.reserve(vary.size());
+    for (const auto& name : vary) {
+        const auto it = header.find(name);
+        values.emplace_back(it == std::end(header) ? std::string_view{ } : std::string_view{it->value()});
+    }
+
+    return make_key(header.method(), header.target(), values);
+}
+
+response_cache::canned_type
+response_cache::get(const std::string_view key, const clock::time_point now)
+{
+    // Acquire mutex
+    std::unique_lock lock(m_lock);
+
+    const auto it = m_index.find(key);
+    if (it == std::end(m_index))
+        return nullptr;
+
+    entry& e = *it->second;
+
+    // Expired
+    if (now >= e.expires) {
+        erase(it->second);
+        return nullptr;
+    }
+
+    // Stale: The first caller revalidates
+    if (now >= e.stale && !e.revalidating) {
+        e.revalidating = true;
+        return nullptr;
+    }
+
+    // Mark as most recently used
+    m_entries.splice(std::begin(m_entries), m_entries, it->second);
+
+    canned_type resp = e.response;
+    const auto age = std::chrono::duration_cast<std::chrono::seconds>(now - e.stored).count();
+    lock.unlock();
+
+    // Only the Age field is added, the stored response is shared
+    std::array<char, 32> buf;
+    auto end = std::copy_n("Age: ", 5, std::begin(buf));
+    end = std::to_chars(end, std::end(buf) - 2, age).ptr;
+    *end++ = '\r';
+    *end++ = '\n';
+
+    return malloy::http::canned_response::make(std::move(resp), std::string_view{ std::begin(buf), end });
+}
+
+bool
+response_cache::put(const std::string_view key, canned_type resp, const policy& pol, const clock::time_point now)
+{
+    if (!resp || !is_storable(*resp)) {
+        abandon(key);
+        return false;
+    }
+
+    entry e;
+    e.key = key;
+    e.bytes = key.size() + resp->header().size() + resp->body().size();
+    e.response = std::move(resp);
+    e.tags = pol.tags;
+    e.stored = now;
+    e.stale = now + pol.ttl;
+    e.expires = e.stale + pol.stale_while_revalidate;
+
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    // Replace existing response
+    if (const auto it = m_index.find(key); it != std::end(m_index))
+        erase(it->second);
+
+    if (e.bytes > m_max_bytes)
+        return false;
+
+    // Evict least recently used responses
+    while (m_bytes + e.bytes > m_max_bytes)
+        erase(std::prev(std::end(m_entries)));
+
+    m_bytes += e.bytes;
+    m_entries.emplace_front(std::move(e));
+    m_index.emplace(m_entries.front().key, std::begin(m_entries));
+
+    return true;
+}
+
+bool
+response_cache::put(const std::string_view key, const response_type& resp, const policy& pol, const clock::time_point now)
+{
+    if (!is_storable(resp)) {
+        abandon(key);
+        return false;
+    }
+
+    return put(key, malloy::http::canned_response::make(resp), pol, now);
+}
+
+bool
+response_cache::claim(const void* owner)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    if (!m_owner)
+        m_owner = owner;
+
+    return m_owner == owner;
+}
+
+void
+response_cache::abandon(const std::string_view key)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    if (const auto it = m_index.find(key); it != std::end(m_index))
+        it->second->revalidating = false;
+}
+
+bool
+response_cache::invalidate(const std::string_view key)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    const auto it = m_index.find(key);
+    if (it == std::end(m_index))
+        return false;
+
+    erase(it->second);
+
+    return true;
+}
+
+std::size_t
+response_cache::invalidate_tag(const std::string_view tag)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    // Invalidation is rare compared to lookups, hence no tag index is maintained
+    std::size_t count = 0;
+    for (auto it = std::begin(m_entries); it != std::end(m_entries); ) {
+        const auto next = std::next(it);
+        if (std::find(std::cbegin(it->tags), std::cend(it->tags), tag) != std::cend(it->tags)) {
+            erase(it);
+            count++;
+        }
+        it = next;
+    }
+
+    return count;
+}
+
+void
+response_cache::clear()
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    m_index.clear();
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+std::size_t
+response_cache::size() const
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    return m_entries.size();
+}
+
+std::size_t
+response_cache::bytes() const
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    return m_bytes;
+}
+
+void
+response_cache::erase(const entries_t::iterator it)
+{
+    m_bytes -= it->bytes;
+    m_index.erase(it->key);
+    m_entries.erase(it);
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "../../core/http/canned_response.hpp"
+#include "../../core/http/response.hpp"
+#include "../../core/http/types.hpp"
+
+#include <boost/beast/http/message.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace malloy::server
+{
+
+    /**
+     * A response cache.
+     *
+     * @details Responses are stored by key (see @ref make_key()). A cached response is fresh for the TTL of its
+     *          entry. Once the TTL expired, the response is stale for the stale-while-revalidate period: The first
+     *          lookup of a stale response misses (so that the caller generates a new response), every other lookup
+     *          during that period is served the stale response until a new one was stored. Responses are evicted in
+     *          least-recently-used order once the cache grows beyond its size limit.
+     *
+     *          Responses can be invalidated explicitly, either by key or by tag.
+     *
+     *          Responses are stored serialized (see @ref malloy::http::canned_response). A hit shares the stored
+     *          response and only adds the `Age` field as a separate buffer.
+     *
+     *          Keys are built from the target as seen by the router the route was added to (i.e. relative to the
+     *          resource base of a sub-router). A cache can therefore only be used by the routes of a single router
+     *          (see @ref claim()).
+     *
+     *          The cache is thread-safe.
+     *
+     * @sa router::add()
+     */
+    class response_cache
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+        using response_type = malloy::http::response<>;
+        using canned_type = std::shared_ptr<const malloy::http::canned_response>;
+        using request_header = boost::beast::http::request_header<>;
+
+        /**
+         * Cache policy of a route.
+         */
+        struct policy
+        {
+            /**
+             * The cache to use.
+             */
+            std::shared_ptr<response_cache> cache;
+
+            /**
+             * How long a response is fresh.
+             */
+            clock::duration ttl = std::chrono::seconds{1};
+
+            /**
+             * How long a response may be served after it went stale while a new one is being generated.
+             */
+            clock::duration stale_while_revalidate = clock::duration::zero();
+
+            /**
+             * The names of the request header fields which are part of the key (in addition to method & target).
+             */
+            std::vector<std::string> vary{ };
+
+            /**
+             * The tags of the responses (for invalidation).
+             */
+            std::vector<std::string> tags{ };
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param max_bytes The maximum size of all cached responses (headers and bodies).
+         */
+        explicit
+        response_cache(std::size_t max_bytes);
+
+        response_cache(const response_cache& other) = delete;
+        response_cache(response_cache&& other) noexcept = delete;
+        ~response_cache() = default;
+
+        response_cache& operator=(const response_cache& rhs) = delete;
+        response_cache& operator=(response_cache&& rhs) noexcept = delete;
+
+        /**
+         * Builds a key.
+         *
+         * @param method The request method.
+         * @param target The request target.
+         * @param values The values of the request header fields the response varies on.
+         * @return The key.
+         */
+        [[nodiscard]]
+        static
+        std::string
+        make_key(malloy::http::method method, std::string_view target, std::span<const std::string_view> values = { });
+
+        /**
+         * Builds the key of a request.
+         *
+         * @param header The request header.
+         * @param vary The names of the request header fields the response varies on.
+         * @return The key.
+         */
+        [[nodiscard]]
+        static
+        std::string
+        make_key(const request_header& header, std::span<const std::string> vary);
+
+        /**
+         * Looks up a response.
+         *
+         * @details A miss obliges the caller to either @ref put() a new response or to @ref abandon() the key. Until
+         *          then, other lookups are served the stale response (if any).
+         *
+         * @param key The key.
+         * @param now The current time.
+         * @return The response including the `Age` field (if fresh, or stale while another caller is revalidating
+         *         it), otherwise `nullptr`.
+         */
+        [[nodiscard]]
+        canned_type
+        get(std::string_view key, clock::time_point now = clock::now());
+
+        /**
+         * Stores a response.
+         *
+         * @details Only `200 OK` responses are stored, unless they carry `Cache-Control: no-store`.
+         *
+         * @param key The key.
+         * @param resp The response.
+         * @param pol The policy to apply.
+         * @param now The current time.
+         * @return Whether the response was stored.
+         */
+        bool
+        put(std::string_view key, canned_type resp, const policy& pol, clock::time_point now = clock::now());
+
+        /**
+         * Stores a response.
+         *
+         * @details Convenience overload serializing the response first.
+         *
+         * @param key The key.
+         * @param resp The response.
+         * @param pol The policy to apply.
+         * @param now The current time.
+         * @return Whether the response was stored.
+         */
+        bool
+        put(std::string_view key, const response_type& resp, const policy& pol, clock::time_point now = clock::now());
+
+        /**
+         * Binds the cache to its owner.
+         *
+         * @details The first owner claiming the cache owns it. Further claims by the same owner succeed.
+         *
+         * @param owner The owner (e.g. a router).
+         * @return Whether the cache is owned by the owner.
+         */
+        bool
+        claim(const void* owner);
+
+        /**
+         * Gives up revalidating a response after @ref get() missed.
+         *
+         * @param key The key.
+         */
+        void
+        abandon(std::string_view key);
+
+        /**
+         * Removes a response.
+         *
+         * @param key The key.
+         * @return Whether a response was removed.
+         */
+        bool
+        invalidate(std::string_view key);
+
+        /**
+         * Removes all responses with a tag.
+         *
+         * @param tag The tag.
+         * @return The number of responses removed.
+         */
+        std::size_t
+        invalidate_tag(std::string_view tag);
+
+        /**
+         * Removes all responses.
+         */
+        void
+        clear();
+
+        /**
+         * Gets the number of cached responses.
+         *
+         * @return The number of cached responses.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const;
+
+        /**
+         * Gets the size of all cached responses.
+         *
+         * @return The size in bytes.
+         */
+        [[nodiscard]]
+        std::size_t
+        bytes() const;
+
+    private:
+        struct entry
+        {
+            std::string key;
+            canned_type response;
+            std::vector<std::string> tags;
+            std::size_t bytes = 0;
+            clock::time_point stored;
+            clock::time_point stale;            // End of the TTL
+            clock::time_point expires;          // End of the stale-while-revalidate period
+            bool revalidating = false;
+        };
+
+        struct key_hash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]]
+            std::size_t
+            operator()(std::string_view str) const noexcept
+            {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        using entries_t = std::list<entry>;     // Most recently used first
+
+        mutable std::mutex m_lock;              // protects everything below
+        std::size_t m_max_bytes;
+        const void* m_owner = nullptr;
+        std::size_t m_bytes = 0;
+        entries_t m_entries;
+        std::unordered_map<std::string, entries_t::iterator, key_hash, std::equal_to<>> m_index;
+
+        void
+        erase(entries_t::iterator it);
+    };
+
+}
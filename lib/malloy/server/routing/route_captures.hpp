@@ -0,0 +1,169 @@
+#pragma once
+
+#include <boost/container/small_vector.hpp>
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <regex>
+#include <string_view>
+#include <system_error>
+
+namespace malloy::server
+{
+
+    /**
+     * The values captured while matching a request target against a route.
+     *
+     * @details These are the values of the `{param}` segments of indexed routes or the capture groups of regex
+     *          routes. Each capture is a view into the target of the request header. Hence captures remain valid as
+     *          long as the request generator does (i.e. for the entire duration of the route handler).
+     *
+     *          Up to `inline_capacity` captures are stored without any heap allocation.
+     */
+    class route_captures
+    {
+    public:
+        static constexpr std::size_t inline_capacity = 8;
+
+        using container_type = boost::container::small_vector<std::string_view, inline_capacity>;
+        using value_type     = std::string_view;
+        using size_type      = std::size_t;
+        using const_iterator = typename container_type::const_iterator;
+
+        /**
+         * Appends a capture.
+         *
+         * @param value The captured value.
+         */
+        void
+        push_back(const std::string_view value)
+        {
+            m_values.push_back(value);
+        }
+
+        /**
+         * Removes the last capture.
+         */
+        void
+        pop_back()
+        {
+            m_values.pop_back();
+        }
+
+        /**
+         * Removes all captures.
+         */
+        void
+        clear() noexcept
+        {
+            m_values.clear();
+        }
+
+        [[nodiscard]]
+        bool
+        empty() const noexcept
+        {
+            return m_values.empty();
+        }
+
+        [[nodiscard]]
+        size_type
+        size() const noexcept
+        {
+            return m_values.size();
+        }
+
+        [[nodiscard]]
+        std::string_view
+        operator[](const size_type i) const noexcept
+        {
+            return m_values[i];
+        }
+
+        /**
+         * Gets a capture with bounds checking.
+         *
+         * @throws std::out_of_range if the index is out of range.
+         */
+        [[nodiscard]]
+        std::string_view
+        at(const size_type i) const
+        {
+            return m_values.at(i);
+        }
+
+        /**
+         * Converts a capture to a number.
+         *
+         * @details The conversion is performed via `std::from_chars()`. The entire capture must be consumed for the
+         *          conversion to succeed.
+         *
+         * @tparam T The arithmetic type.
+         * @param i The index of the capture.
+         * @return The converted value. Empty if the index is out of range or if the conversion failed.
+         */
+        template<typename T>
+            requires std::integral<T> || std::floating_point<T>
+        [[nodiscard]]
+        std::optional<T>
+        get(const size_type i) const noexcept
+        {
+            if (i >= m_values.size())
+                return std::nullopt;
+
+            const std::string_view str = m_values[i];
+            T value{ };
+            const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+            if (ec != std::errc{} || ptr != str.data() + str.size())
+                return std::nullopt;
+
+            return value;
+        }
+
+        [[nodiscard]]
+        const_iterator
+        begin() const noexcept
+        {
+            return m_values.begin();
+        }
+
+        [[nodiscard]]
+        const_iterator
+        end() const noexcept
+        {
+            return m_values.end();
+        }
+
+    private:
+        container_type m_values;
+    };
+
+    /**
+     * Matches a target against a regex and appends the capture groups.
+     *
+     * @param regex The regex.
+     * @param target The target.
+     * @param captures The captures to append to (views into the target).
+     * @return Whether the target matches.
+     */
+    [[nodiscard]]
+    inline
+    bool
+    regex_capture(const std::regex& regex, const std::string_view target, route_captures& captures)
+    {
+        // Reuse the storage of the match results across requests
+        thread_local std::match_results<std::string_view::const_iterator> results;
+
+        if (!std::regex_match(std::cbegin(target), std::cend(target), results, regex))
+            return false;
+
+        // match_results[0] is the input string
+        for (std::size_t i = 1; i < results.size(); i++)
+            captures.push_back(target.substr(results.position(i), results.length(i)));
+
+        return true;
+    }
+
+}
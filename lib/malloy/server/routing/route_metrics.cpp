@@ -0,0 +1,238 @@
+#include "route_metrics.hpp"
+#include "offload_pool.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+using namespace malloy::server;
+
+namespace
+{
+
+    constexpr std::size_t shard_count = 8;
+
+    /**
+     * Gets the shard the calling thread records to.
+     */
+    [[nodiscard]]
+    std::size_t
+    thread_shard() noexcept
+    {
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+
+        return shard;
+    }
+
+    /**
+     * Escapes a Prometheus label value.
+     */
+    [[nodiscard]]
+    std::string
+    escape_label(const std::string_view str)
+    {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (const char c : str) {
+            switch (c) {
+                case '\\': escaped += R"(\\)"; break;
+                case '"':  escaped += R"(\")"; break;
+                case '\n': escaped += R"(\n)"; break;
+                default:   escaped += c; break;
+            }
+        }
+
+        return escaped;
+    }
+
+    void
+    render_counter(std::string& out, std::string_view name, std::string_view help, const auto& rows, const auto& value)
+    {
+        fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} counter\n", name, help, name);
+        for (const auto& [labels, snap] : rows)
+            fmt::format_to(std::back_inserter(out), "{}{{{}}} {}\n", name, labels, value(snap));
+    }
+
+}
+
+struct route_metrics::slot
+{
+    struct alignas(64) shard
+    {
+        std::atomic<std::uint64_t> requests{0};
+        std::array<std::atomic<std::uint64_t>, 5> responses{ };
+        std::atomic<std::uint64_t> bytes_in{0};
+        std::atomic<std::uint64_t> bytes_out{0};
+        std::atomic<std::uint64_t> latency_sum_us{0};
+        std::array<std::atomic<std::uint64_t>, histogram_buckets + 1> latency{ };
+    };
+
+    malloy::http::method method;
+    std::string route;
+    std::array<shard, shard_count> shards;
+};
+
+route_metrics::route_metrics() = default;
+
+route_metrics::~route_metrics() = default;
+
+std::size_t
+route_metrics::add_route(const malloy::http::method method, std::string route)
+{
+    auto s = std::make_unique<slot>();
+    s->method = method;
+    s->route = std::move(route);
+    m_slots.emplace_back(std::move(s));
+
+    return m_slots.size() - 1;
+}
+
+void
+route_metrics::add_child(std::string prefix, std::shared_ptr<const route_metrics> child)
+{
+    m_children.emplace_back(std::move(prefix), std::move(child));
+}
+
+void
+route_metrics::add_pool(std::shared_ptr<const offload_pool> pool)
+{
+    if (std::find(std::cbegin(m_pools), std::cend(m_pools), pool) == std::cend(m_pools))
+        m_pools.emplace_back(std::move(pool));
+}
+
+void
+route_metrics::record_request(const std::size_t slot, const std::uint64_t bytes_in) noexcept
+{
+    auto& shard = m_slots[slot]->shards[thread_shard()];
+    shard.requests.fetch_add(1, std::memory_order_relaxed);
+    shard.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+}
+
+void
+route_metrics::record_response(const std::size_t slot, const unsigned status, const std::uint64_t bytes_out, const std::chrono::steady_clock::duration latency) noexcept
+{
+    const auto us = static_cast<std::uint64_t>(std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0));
+
+    auto& shard = m_slots[slot]->shards[thread_shard()];
+    if (status >= 100 && status < 600)
+        shard.responses[status / 100 - 1].fetch_add(1, std::memory_order_relaxed);
+    shard.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    shard.latency_sum_us.fetch_add(us, std::memory_order_relaxed);
+    shard.latency[histogram_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+}
+
+route_metrics::snapshot
+route_metrics::read(const std::size_t slot) const
+{
+    snapshot snap;
+    for (const auto& shard : m_slots[slot]->shards) {
+        snap.requests += shard.requests.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < snap.responses.size(); i++)
+            snap.responses[i] += shard.responses[i].load(std::memory_order_relaxed);
+        snap.bytes_in += shard.bytes_in.load(std::memory_order_relaxed);
+        snap.bytes_out += shard.bytes_out.load(std::memory_order_relaxed);
+        snap.latency_sum_us += shard.latency_sum_us.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < snap.latency.size(); i++)
+            snap.latency[i] += shard.latency[i].load(std::memory_order_relaxed);
+    }
+
+    return snap;
+}
+
+std::size_t
+route_metrics::histogram_bucket(const std::uint64_t us) noexcept
+{
+    if (us < histogram_sub_buckets)
+        return static_cast<std::size_t>(us);
+
+    // Exponent & linear sub-bucket within [2^exp, 2^(exp+1))
+    const auto exp = static_cast<std::size_t>(std::bit_width(us) - 1);
+    const auto sub = static_cast<std::size_t>(us >> (exp - 2)) & (histogram_sub_buckets - 1);
+
+    return std::min(histogram_sub_buckets * (exp - 1) + sub, histogram_buckets);
+}
+
+std::uint64_t
+route_metrics::histogram_bucket_bound(const std::size_t bucket) noexcept
+{
+    if (bucket < histogram_sub_buckets)
+        return bucket + 1;
+
+    const std::size_t exp = bucket / histogram_sub_buckets + 1;
+    const std::size_t sub = bucket % histogram_sub_buckets;
+
+    return (std::uint64_t{1} << exp) + (sub + 1) * (std::uint64_t{1} << (exp - 2));
+}
+
+std::string
+route_metrics::render() const
+{
+    // Merge all shards of all routes (including sub-routers)
+    std::vector<std::pair<std::string, snapshot>> rows;
+    std::vector<const offload_pool*> pools;     // Might be shared between routers
+    const auto collect = [&rows, &pools](const auto& self, const route_metrics& metrics, const std::string& prefix) -> void {
+        for (const auto& pool : metrics.m_pools) {
+            if (std::find(std::cbegin(pools), std::cend(pools), pool.get()) == std::cend(pools))
+                pools.emplace_back(pool.get());
+        }
+        for (std::size_t i = 0; i < metrics.m_slots.size(); i++) {
+            const auto& s = *metrics.m_slots[i];
+            const std::string_view method = (s.method == malloy::http::method::unknown) ? "*" : std::string_view{boost::beast::http::to_string(s.method)};   // Any method
+            rows.emplace_back(
+                fmt::format(R"(method="{}",route="{}")", method, escape_label(prefix + s.route)),
+                metrics.read(i)
+            );
+        }
+        for (const auto& [child_prefix, child] : metrics.m_children)
+            self(self, *child, prefix + child_prefix);
+    };
+    collect(collect, *this, "");
+
+    std::string out;
+    render_counter(out, "malloy_http_requests_total", "Number of HTTP requests received.", rows, [](const snapshot& s) { return s.requests; });
+    render_counter(out, "malloy_http_request_bytes_total", "Number of HTTP request body bytes received.", rows, [](const snapshot& s) { return s.bytes_in; });
+    render_counter(out, "malloy_http_response_bytes_total", "Number of HTTP response bytes written.", rows, [](const snapshot& s) { return s.bytes_out; });
+
+    // Responses by status class
+    out += "# HELP malloy_http_responses_total Number of HTTP responses written.\n";
+    out += "# TYPE malloy_http_responses_total counter\n";
+    for (const auto& [labels, snap] : rows) {
+        for (std::size_t i = 0; i < snap.responses.size(); i++)
+            fmt::format_to(std::back_inserter(out), "malloy_http_responses_total{{{},code=\"{}xx\"}} {}\n", labels, i + 1, snap.responses[i]);
+    }
+
+    // Latency
+    out += "# HELP malloy_http_request_duration_seconds Time from receiving the request header until the response was written.\n";
+    out += "# TYPE malloy_http_request_duration_seconds histogram\n";
+    for (const auto& [labels, snap] : rows) {
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < histogram_buckets; i++) {
+            cumulative += snap.latency[i];
+            fmt::format_to(std::back_inserter(out), "malloy_http_request_duration_seconds_bucket{{{},le=\"{}\"}} {}\n", labels, static_cast<double>(histogram_bucket_bound(i)) / 1e6, cumulative);
+        }
+        cumulative += snap.latency.back();
+        fmt::format_to(std::back_inserter(out), "malloy_http_request_duration_seconds_bucket{{{},le=\"+Inf\"}} {}\n", labels, cumulative);
+        fmt::format_to(std::back_inserter(out), "malloy_http_request_duration_seconds_sum{{{}}} {}\n", labels, static_cast<double>(snap.latency_sum_us) / 1e6);
+        fmt::format_to(std::back_inserter(out), "malloy_http_request_duration_seconds_count{{{}}} {}\n", labels, cumulative);
+    }
+
+    // Offload pools
+    if (!pools.empty()) {
+        std::vector<std::pair<std::string, offload_pool::lane_stats>> lanes;
+        for (const auto* pool : pools) {
+            for (std::size_t i = 0; i < pool->lanes(); i++)
+                lanes.emplace_back(fmt::format(R"(pool="{}",lane="{}")", escape_label(pool->name()), i), pool->stats(i));
+        }
+
+        out += "# HELP malloy_offload_queue_depth Number of jobs queued in an offload pool lane.\n";
+        out += "# TYPE malloy_offload_queue_depth gauge\n";
+        for (const auto& [labels, stats] : lanes)
+            fmt::format_to(std::back_inserter(out), "malloy_offload_queue_depth{{{}}} {}\n", labels, stats.depth);
+        render_counter(out, "malloy_offload_jobs_total", "Number of jobs executed by an offload pool lane.", lanes, [](const offload_pool::lane_stats& s) { return s.executed; });
+    }
+
+    return out;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "../../core/http/types.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace malloy::server
+{
+    class offload_pool;
+
+    /**
+     * Per-route request metrics.
+     *
+     * @details Each route gets a slot holding request & response counters, byte counters and a latency histogram.
+     *          The histogram uses HDR-style log-linear buckets: Every power of two (in microseconds) is split into
+     *          `histogram_sub_buckets` equally sized buckets, giving a constant relative error.
+     *
+     *          Recording never blocks: Every slot consists of several cache-line aligned shards of relaxed atomic
+     *          counters. Each thread records to its own shard. The shards are only merged when the metrics are read.
+     *
+     * @note Slots (and children) must be added before recording starts, i.e. while the router is being set up.
+     */
+    class route_metrics
+    {
+    public:
+        static constexpr std::size_t histogram_sub_buckets = 4;
+        static constexpr std::size_t histogram_max_exponent = 26;                                           // Up to ~134 s
+        static constexpr std::size_t histogram_buckets = histogram_sub_buckets * histogram_max_exponent;   // Excluding +Inf
+
+        /**
+         * The merged metrics of a route.
+         */
+        struct snapshot
+        {
+            std::uint64_t requests = 0;                                     ///< Number of requests received.
+            std::array<std::uint64_t, 5> responses{ };                      ///< Number of responses sent per status class (1xx to 5xx).
+            std::uint64_t bytes_in = 0;                                     ///< Request body bytes received (as announced by the client).
+            std::uint64_t bytes_out = 0;                                    ///< Response bytes written (including the header).
+            std::uint64_t latency_sum_us = 0;                               ///< Sum of all latencies in microseconds.
+            std::array<std::uint64_t, histogram_buckets + 1> latency{ };    ///< Latency histogram (non-cumulative, last bucket is +Inf).
+        };
+
+        route_metrics();
+        route_metrics(const route_metrics& other) = delete;
+        route_metrics(route_metrics&& other) noexcept = delete;
+        ~route_metrics();
+
+        route_metrics& operator=(const route_metrics& rhs) = delete;
+        route_metrics& operator=(route_metrics&& rhs) noexcept = delete;
+
+        /**
+         * Adds a slot for a route.
+         *
+         * @param method The method of the route.
+         * @param route The route (used as label).
+         * @return The slot.
+         */
+        std::size_t
+        add_route(malloy::http::method method, std::string route);
+
+        /**
+         * Adds the metrics of a sub-router.
+         *
+         * @param prefix The resource base of the sub-router. This is prepended to the route labels of the child.
+         * @param child The metrics of the sub-router.
+         */
+        void
+        add_child(std::string prefix, std::shared_ptr<const route_metrics> child);
+
+        /**
+         * Adds an offload pool whose lanes are to be rendered alongside the routes.
+         *
+         * @param pool The pool.
+         */
+        void
+        add_pool(std::shared_ptr<const offload_pool> pool);
+
+        /**
+         * Records a request.
+         *
+         * @param slot The slot.
+         * @param bytes_in The size of the request body.
+         */
+        void
+        record_request(std::size_t slot, std::uint64_t bytes_in) noexcept;
+
+        /**
+         * Records a response once it was written.
+         *
+         * @param slot The slot.
+         * @param status The response status code.
+         * @param bytes_out The number of bytes written.
+         * @param latency The time between receiving the request header and completing the write.
+         */
+        void
+        record_response(std::size_t slot, unsigned status, std::uint64_t bytes_out, std::chrono::steady_clock::duration latency) noexcept;
+
+        /**
+         * Merges the shards of a slot.
+         *
+         * @param slot The slot.
+         * @return The metrics.
+         */
+        [[nodiscard]]
+        snapshot
+        read(std::size_t slot) const;
+
+        /**
+         * Renders the metrics of all routes and offload pools (including those of sub-routers) in the Prometheus
+         * text format.
+         *
+         * @return The metrics.
+         */
+        [[nodiscard]]
+        std::string
+        render() const;
+
+        /**
+         * Gets the histogram bucket of a latency.
+         *
+         * @param us The latency in microseconds.
+         * @return The bucket.
+         */
+        [[nodiscard]]
+        static
+        std::size_t
+        histogram_bucket(std::uint64_t us) noexcept;
+
+        /**
+         * Gets the (exclusive) upper bound of a histogram bucket.
+         *
+         * @param bucket The bucket.
+         * @return The upper bound in microseconds.
+         */
+        [[nodiscard]]
+        static
+        std::uint64_t
+        histogram_bucket_bound(std::size_t bucket) noexcept;
+
+    private:
+        struct slot;
+
+        std::vector<std::unique_ptr<slot>> m_slots;
+        std::vector<std::pair<std::string, std::shared_ptr<const route_metrics>>> m_children;
+        std::vector<std::shared_ptr<const offload_pool>> m_pools;
+    };
+
+}
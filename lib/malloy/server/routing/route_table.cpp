@@ -0,0 +1,387 @@
+#include "route_table.hpp"
+
+#include <algorithm>
+
+using namespace malloy::server;
+
+namespace
+{
+
+    /**
+     * Inserts an identifier into a sorted list of identifiers.
+     */
+    void
+    insert_sorted(std::vector<std::size_t>& ids, const std::size_t id)
+    {
+        ids.insert(std::upper_bound(std::begin(ids), std::end(ids), id), id);
+    }
+
+    /**
+     * Checks whether a character is a valid `{param}` name character.
+     */
+    [[nodiscard]]
+    constexpr
+    bool
+    is_param_name_char(const char c) noexcept
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    /**
+     * Returns the length of the `{param}` segment starting at the beginning of the string (or zero).
+     */
+    [[nodiscard]]
+    std::size_t
+    param_length(const std::string_view str)
+    {
+        if (!str.starts_with('{'))
+            return 0;
+
+        const auto end = str.find('}');
+        if (end == std::string_view::npos || end == 1)
+            return 0;
+
+        if (!std::all_of(std::cbegin(str) + 1, std::cbegin(str) + end, is_param_name_char))
+            return 0;
+
+        // A parameter must span the entire segment
+        if (end + 1 < str.size() && str[end + 1] != '/')
+            return 0;
+
+        return end + 1;
+    }
+
+    /**
+     * Normalizes the groups of a regular expression up to the end of the current group (see
+     * `route_table::normalize()`).
+     *
+     * @param regex The regular expression. The normalized part is removed.
+     * @param alternation Set if the current group contains an alternation.
+     * @return The normalized part.
+     */
+    [[nodiscard]]
+    std::string
+    normalize_groups(std::string_view& regex, bool& alternation)
+    {
+        std::string out;
+        while (!regex.empty() && regex.front() != ')') {
+            const char c = regex.front();
+
+            // Escape sequence
+            if (c == '\\' && regex.size() > 1) {
+                out.append(regex.substr(0, 2));
+                regex.remove_prefix(2);
+                continue;
+            }
+
+            // Bracket expression (parentheses are literal characters within)
+            if (c == '[') {
+                std::size_t i = 1;
+                if (i < regex.size() && regex[i] == '^')
+                    i++;
+                if (i < regex.size() && regex[i] == ']')
+                    i++;
+                while (i < regex.size() && regex[i] != ']')
+                    i += (regex[i] == '\\') ? 2 : 1;
+                i = std::min(i + 1, regex.size());
+
+                out.append(regex.substr(0, i));
+                regex.remove_prefix(i);
+                continue;
+            }
+
+            // Group
+            if (c == '(') {
+                regex.remove_prefix(1);
+
+                std::string_view assertion;
+                if (regex.starts_with("?:"))
+                    regex.remove_prefix(2);
+                else if (regex.starts_with("?=") || regex.starts_with("?!")) {
+                    assertion = regex.substr(0, 2);
+                    regex.remove_prefix(2);
+                }
+
+                bool inner_alternation = false;
+                const std::string inner = normalize_groups(regex, inner_alternation);
+                if (regex.starts_with(')'))
+                    regex.remove_prefix(1);
+
+                // A group can be dropped unless it is quantified or contains an alternation
+                const bool quantified = !regex.empty() && std::string_view{ "*+?{" }.find(regex.front()) != std::string_view::npos;
+                if (!assertion.empty())
+                    out.append("(").append(assertion).append(inner).append(")");
+                else if (quantified || inner_alternation)
+                    out.append("(?:").append(inner).append(")");
+                else
+                    out.append(inner);
+                continue;
+            }
+
+            if (c == '|')
+                alternation = true;
+
+            out += c;
+            regex.remove_prefix(1);
+        }
+
+        return out;
+    }
+
+}
+
+std::optional<std::string>
+route_table::to_pattern(std::string_view target)
+{
+    // Router targets are matched as a whole, anchors are therefore redundant
+    if (target.starts_with('^'))
+        target.remove_prefix(1);
+    if (target.ends_with('$'))
+        target.remove_suffix(1);
+
+    if (!target.starts_with('/'))
+        return std::nullopt;
+
+    for (std::size_t i = 0; i < target.size(); i++) {
+        const char c = target[i];
+
+        // Parameter
+        if (c == '{' && target[i-1] == '/') {
+            const std::size_t len = param_length(target.substr(i));
+            if (len == 0)
+                return std::nullopt;
+            i += len - 1;
+            continue;
+        }
+
+        // Regex meta characters
+        constexpr std::string_view meta = R"(.[]{}()*+?|\^$)";
+        if (meta.find(c) != std::string_view::npos)
+            return std::nullopt;
+    }
+
+    return std::string{target};
+}
+
+std::string
+route_table::to_regex(std::string_view pattern)
+{
+    std::string regex;
+    regex.reserve(pattern.size());
+
+    while (!pattern.empty()) {
+        if (const std::size_t len = param_length(pattern); len > 0) {
+            regex += "([^/?#]+)";
+            pattern.remove_prefix(len);
+        }
+        else {
+            regex += pattern.front();
+            pattern.remove_prefix(1);
+        }
+    }
+
+    return regex;
+}
+
+std::string
+route_table::normalize(std::string_view target)
+{
+    // Anchors are redundant
+    if (target.starts_with('^'))
+        target.remove_prefix(1);
+    if (target.ends_with('$') && !target.ends_with("\\$"))
+        target.remove_suffix(1);
+
+    const auto pattern = to_pattern(target);
+    const std::string regex = pattern ? to_regex(*pattern) : std::string{ target };
+
+    std::string_view rest = regex;
+    std::string normalized;
+    bool alternation = false;
+    while (true) {
+        normalized += normalize_groups(rest, alternation);
+        if (rest.empty())
+            break;
+
+        // Unbalanced parenthesis
+        normalized += rest.front();
+        rest.remove_prefix(1);
+    }
+
+    return normalized;
+}
+
+std::string_view
+route_table::literal_prefix(std::string_view regex)
+{
+    // An alternation may start with anything
+    if (regex.find('|') != std::string_view::npos)
+        return { };
+
+    if (regex.starts_with('^'))
+        regex.remove_prefix(1);
+
+    constexpr std::string_view meta = R"(.[]{}()*+?|\^$)";
+    const std::size_t len = std::min(regex.find_first_of(meta), regex.size());
+
+    // A quantifier might make the preceding character optional
+    if (len > 0 && len < regex.size()) {
+        const char c = regex[len];
+        if (c == '?' || c == '*' || c == '{')
+            return regex.substr(0, len - 1);
+    }
+
+    return regex.substr(0, len);
+}
+
+bool
+route_table::insert(std::string_view pattern, const std::size_t id)
+{
+    if (pattern.empty())
+        return false;
+
+    // Literal routes go into the hash map
+    if (pattern.find('{') == std::string_view::npos) {
+        insert_literal(pattern, id);
+        return true;
+    }
+
+    if (!m_root)
+        m_root = std::make_unique<node>();
+
+    // Walk & extend the tree
+    node* n = m_root.get();
+    while (!pattern.empty()) {
+        // Parameter
+        if (const std::size_t len = param_length(pattern); len > 0) {
+            if (!n->param_child) {
+                n->param_child = std::make_unique<node>();
+                n->param_child->param = true;
+            }
+            n = n->param_child.get();
+            pattern.remove_prefix(len);
+            continue;
+        }
+
+        // Literal
+        auto literal_len = std::min(pattern.find("/{"), pattern.size());
+        if (literal_len < pattern.size())
+            literal_len++;    // Include the slash
+        n = &insert_edge(*n, pattern.substr(0, literal_len));
+        pattern.remove_prefix(literal_len);
+    }
+
+    insert_sorted(n->ids, id);
+
+    return true;
+}
+
+void
+route_table::insert_literal(const std::string_view path, const std::size_t id)
+{
+    auto it = m_literals.find(path);
+    if (it == std::end(m_literals))
+        it = m_literals.emplace(std::string{path}, std::vector<std::size_t>{}).first;
+
+    insert_sorted(it->second, id);
+}
+
+bool
+route_table::insert_prefix(const std::string_view prefix, const std::size_t id)
+{
+    if (!m_root)
+        m_root = std::make_unique<node>();
+
+    node& n = insert_edge(*m_root, prefix);
+    if (!n.ids.empty())
+        return false;
+
+    n.ids.emplace_back(id);
+
+    return true;
+}
+
+void
+route_table::insert_shared_prefix(const std::string_view prefix, const std::size_t id)
+{
+    if (!m_root)
+        m_root = std::make_unique<node>();
+
+    insert_sorted(insert_edge(*m_root, prefix).ids, id);
+}
+
+std::optional<std::pair<std::size_t, std::size_t>>
+route_table::find_prefix(const std::string_view path) const
+{
+    if (!m_root)
+        return std::nullopt;
+
+    std::optional<std::pair<std::size_t, std::size_t>> best;
+    const node* n = m_root.get();
+    std::size_t consumed = 0;
+    while (n) {
+        if (!n->ids.empty())
+            best = { n->ids.front(), consumed };
+
+        const std::string_view rest = path.substr(consumed);
+        if (rest.empty())
+            break;
+
+        const node* next = nullptr;
+        for (const auto& child : n->children) {
+            if (rest.starts_with(child->label)) {
+                next = child.get();
+                consumed += child->label.size();
+                break;
+            }
+        }
+        n = next;
+    }
+
+    return best;
+}
+
+route_table::node&
+route_table::insert_edge(node& n, std::string_view str)
+{
+    node* current = &n;
+    while (!str.empty()) {
+        // Look for a child sharing the first character
+        auto it = std::find_if(
+            std::begin(current->children),
+            std::end(current->children),
+            [c = str.front()](const auto& child) {
+                return child->label.front() == c;
+            }
+        );
+
+        // None: Add a new leaf
+        if (it == std::end(current->children)) {
+            auto leaf = std::make_unique<node>();
+            leaf->label = str;
+            current->children.emplace_back(std::move(leaf));
+            return *current->children.back();
+        }
+
+        // Length of the common prefix
+        const std::string& label = (*it)->label;
+        const auto common = static_cast<std::size_t>(std::mismatch(
+            std::cbegin(label), std::cend(label),
+            std::cbegin(str), std::cend(str)
+        ).first - std::cbegin(label));
+
+        // Split the edge if only partially shared
+        if (common < label.size()) {
+            auto mid = std::make_unique<node>();
+            mid->label = label.substr(0, common);
+            (*it)->label.erase(0, common);
+            mid->children.emplace_back(std::move(*it));
+            *it = std::move(mid);
+        }
+
+        current = it->get();
+        str.remove_prefix(common);
+    }
+
+    return *current;
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "route_captures.hpp"
+
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace malloy::server
+{
+
+    /**
+     * An index mapping request targets to route identifiers.
+     *
+     * @details Literal paths are looked up in a hash map. Paths containing `{param}` segments are stored in a
+     *          radix tree which is walked once per lookup. Hence the cost of a lookup depends on the length of the
+     *          request target rather than on the number of routes.
+     *
+     *          A `{param}` segment matches one or more characters up to (but excluding) the next `/`, `?` or `#`.
+     *
+     *          The table also provides a longest-prefix lookup which is used to dispatch to sub-routers.
+     *
+     * @note Identifiers are expected to reflect insertion order. If multiple routes match, the one with the lowest
+     *       identifier wins.
+     */
+    class route_table
+    {
+    public:
+        /**
+         * Identifier returned when nothing matched.
+         */
+        static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+        /**
+         * The result of a successful lookup.
+         */
+        struct match
+        {
+            std::size_t id = npos;                      ///< The route identifier.
+            route_captures params;                      ///< The values of the `{param}` segments (views into the looked-up path).
+        };
+
+        route_table() = default;
+        route_table(const route_table& other) = delete;
+        route_table(route_table&& other) noexcept = default;
+        ~route_table() = default;
+
+        route_table& operator=(const route_table& rhs) = delete;
+        route_table& operator=(route_table&& rhs) noexcept = default;
+
+        /**
+         * Converts a router target to an indexable route pattern.
+         *
+         * @details A target is indexable if it is a path consisting of literal characters and `{param}` segments
+         *          only. As router targets are matched as a whole, a leading `^` and a trailing `$` are dropped.
+         *          Any other regex meta character makes the target non-indexable.
+         *
+         * @param target The router target.
+         * @return The pattern (if indexable).
+         */
+        [[nodiscard]]
+        static
+        std::optional<std::string>
+        to_pattern(std::string_view target);
+
+        /**
+         * Converts a route pattern to an equivalent regular expression.
+         *
+         * @details Each `{param}` segment is converted to a capturing group.
+         *
+         * @param pattern The pattern as returned by `to_pattern()`.
+         * @return The regular expression.
+         */
+        [[nodiscard]]
+        static
+        std::string
+        to_regex(std::string_view pattern);
+
+        /**
+         * Normalizes a router target for comparison.
+         *
+         * @details Equivalent spellings of a target normalize to the same string: Anchors are dropped, `{param}`
+         *          segments are converted to regular expressions and groups are dropped unless they are quantified
+         *          or contain an alternation (in which case they are made non-capturing). For example, `/users/\d+`,
+         *          `/users/(\d+)` and `^/users/(?:\d+)$` normalize to the same string, as do `/users/{id}` and
+         *          `/users/([^/?#]+)`.
+         *
+         * @param target The router target.
+         * @return The normalized target.
+         */
+        [[nodiscard]]
+        static
+        std::string
+        normalize(std::string_view target);
+
+        /**
+         * Determines the literal prefix of a regular expression.
+         *
+         * @details Every string matched by the regular expression (as a whole) starts with this prefix. A leading
+         *          `^` is dropped. The prefix is empty if the expression contains an alternation.
+         *
+         * @param regex The regular expression.
+         * @return The literal prefix.
+         */
+        [[nodiscard]]
+        static
+        std::string_view
+        literal_prefix(std::string_view regex);
+
+        /**
+         * Adds a route pattern.
+         *
+         * @param pattern The pattern as returned by `to_pattern()`.
+         * @param id The route identifier.
+         * @return Whether the pattern was added.
+         */
+        bool
+        insert(std::string_view pattern, std::size_t id);
+
+        /**
+         * Adds a literal path.
+         *
+         * @details In contrast to `insert()`, no `{param}` segments are recognized.
+         *
+         * @param path The literal path.
+         * @param id The route identifier.
+         */
+        void
+        insert_literal(std::string_view path, std::size_t id);
+
+        /**
+         * Adds a literal prefix for use with `find_prefix()`.
+         *
+         * @param prefix The prefix.
+         * @param id The identifier.
+         * @return Whether the prefix was added. This fails if the same prefix was already added.
+         */
+        bool
+        insert_prefix(std::string_view prefix, std::size_t id);
+
+        /**
+         * Adds a literal prefix for use with `for_each_prefix()`.
+         *
+         * @details In contrast to `insert_prefix()`, the same prefix may be added multiple times.
+         *
+         * @param prefix The prefix. May be empty in which case it is a prefix of every path.
+         * @param id The identifier.
+         */
+        void
+        insert_shared_prefix(std::string_view prefix, std::size_t id);
+
+        /**
+         * Checks whether the table is empty.
+         *
+         * @return Whether the table is empty.
+         */
+        [[nodiscard]]
+        bool
+        empty() const noexcept
+        {
+            return m_literals.empty() && !m_root;
+        }
+
+        /**
+         * Looks up the route with the lowest identifier matching a path.
+         *
+         * @param path The path.
+         * @param accept Predicate invoked with the identifier of each route matching the path. Routes for which this
+         *               returns `false` are skipped.
+         * @return The match (if any).
+         */
+        template<std::predicate<std::size_t> Accept>
+        [[nodiscard]]
+        std::optional<match>
+        find(std::string_view path, Accept&& accept) const
+        {
+            match best;
+
+            // Literal fast path
+            if (const auto it = m_literals.find(path); it != std::cend(m_literals)) {
+                for (const std::size_t id : it->second) {
+                    if (id < best.id && accept(id)) {
+                        best.id = id;
+                        break;
+                    }
+                }
+            }
+
+            // Parametrized routes
+            if (m_root) {
+                route_captures params;
+                find_node(*m_root, path, accept, params, best);
+            }
+
+            if (best.id == npos)
+                return std::nullopt;
+
+            return best;
+        }
+
+        /**
+         * Looks up the longest prefix of a path.
+         *
+         * @param path The path.
+         * @return The identifier and the length of the longest matching prefix (if any).
+         */
+        [[nodiscard]]
+        std::optional<std::pair<std::size_t, std::size_t>>
+        find_prefix(std::string_view path) const;
+
+        /**
+         * Visits all prefixes of a path.
+         *
+         * @details The identifiers are visited from the shortest to the longest prefix. Identifiers of the same prefix
+         *          are visited in ascending order.
+         *
+         * @param path The path.
+         * @param visit Invoked with the identifier of each prefix of the path.
+         */
+        template<std::invocable<std::size_t> Visitor>
+        void
+        for_each_prefix(const std::string_view path, Visitor&& visit) const
+        {
+            const node* n = m_root.get();
+            std::size_t consumed = 0;
+            while (n) {
+                for (const std::size_t id : n->ids)
+                    visit(id);
+
+                const std::string_view rest = path.substr(consumed);
+                if (rest.empty())
+                    break;
+
+                const node* next = nullptr;
+                for (const auto& child : n->children) {
+                    if (rest.starts_with(child->label)) {
+                        next = child.get();
+                        consumed += child->label.size();
+                        break;
+                    }
+                }
+                n = next;
+            }
+        }
+
+    private:
+        struct node
+        {
+            std::string label;                              // Literal part of the edge leading to this node
+            bool param = false;                             // Whether this node represents a `{param}` segment
+            std::vector<std::unique_ptr<node>> children;    // Literal children (distinct first label character)
+            std::unique_ptr<node> param_child;
+            std::vector<std::size_t> ids;                   // Routes terminating at this node
+        };
+
+        struct string_hash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]]
+            std::size_t
+            operator()(std::string_view str) const noexcept
+            {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        std::unordered_map<std::string, std::vector<std::size_t>, string_hash, std::equal_to<>> m_literals;
+        std::unique_ptr<node> m_root;
+
+        [[nodiscard]]
+        static
+        node&
+        insert_edge(node& n, std::string_view str);
+
+        [[nodiscard]]
+        static
+        constexpr
+        bool
+        is_param_terminator(const char c) noexcept
+        {
+            return c == '/' || c == '?' || c == '#';
+        }
+
+        template<typename Accept>
+        static
+        void
+        find_node(const node& n, std::string_view path, Accept& accept, route_captures& params, match& best)
+        {
+            // Consume this node's edge
+            if (n.param) {
+                std::size_t len = 0;
+                while (len < path.size() && !is_param_terminator(path[len]))
+                    len++;
+                if (len == 0)
+                    return;
+
+                params.push_back(path.substr(0, len));
+                find_children(n, path.substr(len), accept, params, best);
+                params.pop_back();
+            }
+            else {
+                if (!path.starts_with(n.label))
+                    return;
+
+                find_children(n, path.substr(n.label.size()), accept, params, best);
+            }
+        }
+
+        template<typename Accept>
+        static
+        void
+        find_children(const node& n, std::string_view path, Accept& accept, route_captures& params, match& best)
+        {
+            // Routes terminating here
+            if (path.empty()) {
+                for (const std::size_t id : n.ids) {
+                    if (id >= best.id)
+                        break;
+                    if (accept(id)) {
+                        best.id = id;
+                        best.params = params;
+                        break;
+                    }
+                }
+                return;
+            }
+
+            // Literal child
+            for (const auto& child : n.children) {
+                if (child->label.front() == path.front()) {
+                    find_node(*child, path, accept, params, best);
+                    break;
+                }
+            }
+
+            // Parameter child
+            if (n.param_child)
+                find_node(*n.param_child, path, accept, params, best);
+        }
+    };
+
+}
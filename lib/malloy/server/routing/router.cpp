@@ -2,7 +2,10 @@
 #include "endpoint_http_files.hpp"
 #include "endpoint_http_redirect.hpp"
 
+#include <boost/container/small_vector.hpp>
+
 #include <algorithm>
+#include <charconv>
 #include <stdexcept>
 
 using namespace malloy::server;
@@ -28,10 +31,17 @@ router::set_logger(std::shared_ptr<spdlog::logger> logger)
 }
 
 bool
-router::add_http_endpoint(std::unique_ptr<endpoint_http>&& ep)
+router::add_http_endpoint(std::unique_ptr<endpoint_http>&& ep, std::string route, const std::string_view pattern)
 {
     try {
+        const std::size_t id = m_endpoints_http.size();
+        if (m_metrics)
+            m_metrics->add_route(ep->method, route);
+        m_endpoints_http_routes.emplace_back(std::move(route));
         m_endpoints_http.emplace_back(std::move(ep));
+
+        if (pattern.empty() || !m_endpoints_http_index.insert(pattern, id))
+            m_endpoints_http_unindexed.emplace_back(id);
     } catch (const std::exception& e) {
         return log_or_throw(e, spdlog::level::critical, "could not add HTTP endpoint: {}", e.what());
     } catch (...) {
@@ -41,10 +51,142 @@ router::add_http_endpoint(std::unique_ptr<endpoint_http>&& ep)
     return true;
 }
 
+std::size_t
+router::find_http_endpoint(const request_header& header, route_captures& captures) const
+{
+    std::size_t id = route_table::npos;
+
+    // Indexed endpoints
+    auto match = m_endpoints_http_index.find(
+        header.target(),
+        [&](const std::size_t i) {
+            return m_endpoints_http[i]->endpoint_http::matches(header);    // The resource is already known to match
+        }
+    );
+    if (match) {
+        id = match->id;
+        captures = std::move(match->params);
+    }
+
+    // Remaining endpoints which were added before the indexed match (if any)
+    route_captures candidate;
+    for (const std::size_t i : m_endpoints_http_unindexed) {
+        if (i >= id)
+            break;
+
+        if (m_endpoints_http[i]->matches_with_captures(header, candidate)) {
+            id = i;
+            captures = std::move(candidate);
+            break;
+        }
+    }
+
+    return id;
+}
+
+void
+router::add_offload_pool(std::shared_ptr<const offload_pool> pool)
+{
+    if (std::find(std::cbegin(m_offload_pools), std::cend(m_offload_pools), pool) != std::cend(m_offload_pools))
+        return;
+
+    if (m_metrics)
+        m_metrics->add_pool(pool);
+    m_offload_pools.emplace_back(std::move(pool));
+}
+
+void
+router::enable_metrics()
+{
+    if (m_metrics)
+        return;
+
+    m_metrics = std::make_shared<route_metrics>();
+    for (std::size_t i = 0; i < m_endpoints_http.size(); i++)
+        m_metrics->add_route(m_endpoints_http[i]->method, m_endpoints_http_routes[i]);
+    for (const auto& pool : m_offload_pools)
+        m_metrics->add_pool(pool);
+
+    for (const auto& [resource, sub] : m_sub_routers) {
+        sub->enable_metrics();
+        m_metrics->add_child(resource, sub->m_metrics);
+    }
+}
+
+void
+router::meter_request(const request_header& header, const std::size_t id, const http::connection_t& connection) const
+{
+    // Request size as announced by the client
+    std::uint64_t bytes_in = 0;
+    if (const auto it = header.find(malloy::http::field::content_length); it != std::end(header)) {
+        const std::string_view value{it->value()};
+        std::from_chars(value.data(), value.data() + value.size(), bytes_in);
+    }
+    m_metrics->record_request(id, bytes_in);
+
+    // Record the response once it was written. The metrics are shared so that they outlive this router.
+    std::visit(
+        [metrics = m_metrics, id](const auto& c) {
+            if (!c)
+                return;
+
+            c->observe_write([metrics, id](const unsigned status, const std::size_t bytes, const std::chrono::steady_clock::duration latency) {
+                metrics->record_response(id, status, bytes, latency);
+            });
+        },
+        connection
+    );
+}
+
+bool
+router::add_metrics(const std::string_view target)
+{
+    enable_metrics();
+
+    return add(
+        malloy::http::method::get,
+        target,
+        [metrics = std::shared_ptr<const route_metrics>{m_metrics}](const auto&) {
+            response_type resp{ malloy::http::status::ok };
+            resp.set(malloy::http::field::content_type, "text/plain; version=0.0.4");
+            resp.body() = metrics->render();
+            resp.prepare_payload();
+
+            return resp;
+        }
+    );
+}
+
+bool
+router::process_policies(const request_header& header, const http::connection_t& connection) const
+{
+    // Collect the policies whose resource prefix matches
+    boost::container::small_vector<std::size_t, 16> candidates;
+    m_policies_index.for_each_prefix(
+        header.target(),
+        [&candidates](const std::size_t id) {
+            candidates.push_back(id);
+        }
+    );
+
+    // Policies are evaluated in the order in which they were added
+    std::sort(std::begin(candidates), std::end(candidates));
+
+    return std::any_of(
+        std::cbegin(candidates),
+        std::cend(candidates),
+        [&](const std::size_t id) {
+            return m_policies[id].process(header, connection);
+        }
+    );
+}
+
 bool
 router::add_websocket_endpoint(std::unique_ptr<endpoint_websocket>&& ep)
 {
     try {
+        const std::size_t id = m_endpoints_websocket.size();
+        m_endpoints_websocket_index.insert_literal(ep->resource, id);
         m_endpoints_websocket.emplace_back(std::move(ep));
     } catch (const std::exception& e) {
         return log_or_throw(e, spdlog::level::critical, "could not add WebSocket endpoint: {}", e.what());
@@ -84,7 +226,16 @@ router::add_subrouter(std::string resource, std::unique_ptr<router> sub_router)
 
     // Add router
     try {
-        m_sub_routers.try_emplace(std::move(resource), std::move(sub_router));
+        if (!m_sub_routers_index.insert_prefix(resource, m_sub_routers.size())) {
+            if (m_logger)
+                m_logger->error("a router for \"{}\" already exists. not adding router.", resource);
+            return false;
+        }
+        if (m_metrics) {
+            sub_router->enable_metrics();
+            m_metrics->add_child(resource, sub_router->m_metrics);
+        }
+        m_sub_routers.emplace_back(std::move(resource), std::move(sub_router));
     } catch (const std::exception& e) {
         return log_or_throw(e, spdlog::level::critical, "could not add router: {}", e.what());
     }
@@ -101,16 +252,51 @@ router::add_subrouter(std::string resource, router&& sub)
 void
 router::set_server_string(std::string_view str)
 {
-    // Nothing to do if the string is the same
-    if (str == m_server_str)
+    // Nothing to do if the view refers to the same string (an equal string stored elsewhere must still be adopted as
+    // the previous one might not outlive this router)
+    if (str.data() == m_server_str.data() && str.size() == m_server_str.size())
         return;
 
     // Assign to this router and propagate through all sub-routers
     m_server_str = str;
+    m_unknown_request = make_unknown_request(m_server_str);
+    m_no_handler = make_no_handler(m_server_str);
+    for (const auto& flight : m_flights)
+        flight->set_unavailable(make_unavailable(m_server_str));
+    clear_preflight_responses();
     for (const auto& [_, sub] : m_sub_routers)
         sub->set_server_string(str);
 }
 
+std::shared_ptr<const malloy::http::canned_response>
+router::make_unknown_request(const std::string_view server_str)
+{
+    auto resp = malloy::http::generator::bad_request("unknown request");
+    resp.set(malloy::http::field::server, server_str);
+
+    return malloy::http::canned_response::make(std::move(resp));
+}
+
+std::shared_ptr<const malloy::http::canned_response>
+router::make_no_handler(const std::string_view server_str)
+{
+    auto resp = malloy::http::generator::server_error("no valid handler available.");
+    resp.set(malloy::http::field::server, server_str);
+
+    return malloy::http::canned_response::make(std::move(resp));
+}
+
+std::shared_ptr<const malloy::http::canned_response>
+router::make_unavailable(const std::string_view server_str)
+{
+    malloy::http::response<> resp{ malloy::http::status::service_unavailable };
+    resp.body() = "service unavailable";
+    resp.set(malloy::http::field::server, server_str);
+    resp.prepare_payload();
+
+    return malloy::http::canned_response::make(std::move(resp));
+}
+
 bool
 router::add_preflight(const std::string_view target, http::preflight_config cfg)
 {
@@ -118,39 +304,95 @@ router::add_preflight(const std::string_view target, http::preflight_config cfg)
     if (m_logger)
         m_logger->trace("adding preflight: {}", target);
 
+    // Build preflight
+    auto preflight = std::make_shared<preflight_entry>();
+    preflight->cfg = std::move(cfg);
+
     // Add
-    return add(
+    const bool added = add(
         malloy::http::method::options,
         target,
-        [cfg = std::move(cfg), this](const auto& req) {
-            // Look for matching endpoints
-            std::vector<const endpoint_http*> endpoints;
-            for (const auto& endpt : m_endpoints_http) {
-                const auto* matcher = dynamic_cast<const resource_matcher*>(endpt.get());
-                if (matcher && matcher->matches_resource(req)) {
-                    endpoints.emplace_back(endpt.get());
-                }
-            }
-
-            // Assemble list of methods
-            std::vector<malloy::http::method> methods;
-            methods.resize(endpoints.size());
-            std::transform(
-                std::cbegin(endpoints),
-                std::cend(endpoints),
-                std::begin(methods),
-                [](const auto& ep) {
-                    return ep->method;
-                }
-            );
-
-            // Generate response
-            malloy::http::response resp{ malloy::http::status::ok };
-            cfg.setup_response(resp, methods);
-
-            return resp;
+        [this, preflight](const auto& req) {
+            return preflight_response(*preflight, req.target());
         }
     );
+    if (added)
+        m_preflights.emplace_back(std::move(preflight));
+
+    return added;
+}
+
+std::optional<std::regex>
+router::compile_target(const std::string_view target) const
+{
+    try {
+        // Targets consisting of literal and {param} segments only are indexed
+        if (const auto pattern = route_table::to_pattern(target))
+            return std::regex{route_table::to_regex(*pattern)};
+
+        return std::regex{target.cbegin(), target.cend()};
+    }
+    catch (const std::regex_error& e) {
+        if (m_logger)
+            m_logger->error("invalid route target supplied \"{}\": {}", target, e.what());
+        return std::nullopt;
+    }
+}
+
+void
+router::add_route_method(const std::string_view target, const method_type method)
+{
+    // Preflight endpoints are not routes in this sense
+    if (method == malloy::http::method::options)
+        return;
+
+    auto regex = compile_target(target);
+    if (!regex)
+        return;
+
+    m_route_methods.emplace_back(std::move(*regex), method);
+    clear_preflight_responses();
+}
+
+std::shared_ptr<const malloy::http::canned_response>
+router::preflight_response(preflight_entry& preflight, const std::string_view target) const
+{
+    // Methods of the routes matching the target
+    std::uint64_t set = 0;      // There are less than 64 methods
+    std::vector<method_type> methods;
+    for (const auto& route : m_route_methods) {
+        const std::uint64_t bit = std::uint64_t{1} << static_cast<unsigned>(route.method);
+        if ((set & bit) || !std::regex_match(target.cbegin(), target.cend(), route.resource))
+            continue;
+
+        set |= bit;
+        methods.emplace_back(route.method);
+    }
+
+    // Acquire mutex
+    std::lock_guard lock(preflight.lock);
+
+    auto& resp = preflight.responses[set];
+    if (!resp) {
+        response_type r{ malloy::http::status::ok };
+        preflight.cfg.setup_response(r, methods);
+        r.set(malloy::http::field::server, m_server_str);
+
+        resp = malloy::http::canned_response::make(std::move(r));
+    }
+
+    return resp;
+}
+
+void
+router::clear_preflight_responses()
+{
+    for (const auto& preflight : m_preflights) {
+        // Acquire mutex
+        std::lock_guard lock(preflight->lock);
+
+        preflight->responses.clear();
+    }
 }
 
 bool
@@ -182,7 +424,46 @@ router::add_redirect(const malloy::http::status status, std::string&& resource_o
     ep->status = status;
 
     // Add
-    return add_http_endpoint(std::move(ep));
+    const std::string route = ep->resource_old;
+    return add_http_endpoint(std::move(ep), route);
+}
+
+bool
+router::add_sse(std::string&& resource, sse::stream::handler_t&& handler, const sse::stream::policy pol)
+{
+    // Log
+    if (m_logger)
+        m_logger->trace("adding SSE endpoint at {}", resource);
+
+    // Check handler
+    if (!handler) {
+        if (m_logger)
+            m_logger->warn("route has invalid handler. ignoring.");
+
+        return false;
+    }
+
+    // Build regex
+    auto regex = compile_target(resource);
+    if (!regex)
+        return false;
+
+    // Create endpoint
+    auto ep = std::make_unique<endpoint_http_sse>();
+    ep->method = malloy::http::method::get;
+    ep->resource_base = std::move(*regex);
+    ep->handler = std::move(handler);
+    ep->make_stream = [this, pol](const request_header& req, const http::connection_t& conn) {
+        return sse::stream::make(conn, req, m_server_str, pol);
+    };
+
+    // Add
+    const auto pattern = route_table::to_pattern(resource).value_or("");
+    if (!add_http_endpoint(std::move(ep), resource, pattern))
+        return false;
+    add_route_method(resource, malloy::http::method::get);
+
+    return true;
 }
 
 bool
@@ -1,9 +1,22 @@
 #pragma once
 
+#include "asset_bundle.hpp"
+#include "embedded_resource.hpp"
 #include "endpoint_http.hpp"
 #include "endpoint_http_regex.hpp"
+#include "endpoint_http_sse.hpp"
+#include "endpoint_http_coalescing.hpp"
 #include "endpoint_http_files.hpp"
+#include "endpoint_http_streaming.hpp"
 #include "endpoint_websocket.hpp"
+#include "offload_pool.hpp"
+#include "response_cache.hpp"
+#include "route_captures.hpp"
+#include "route_metrics.hpp"
+#include "route_table.hpp"
+#include "single_flight.hpp"
+#include "static_router.hpp"
+#include "streaming_request.hpp"
 #include "type_traits.hpp"
 #include "../http/connection.hpp"
 #include "../http/connection_plain.hpp"
@@ -19,18 +32,25 @@
     #include "../http/connection_tls.hpp"
 #endif
 
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/version.hpp>
 #include <spdlog/logger.h>
 
 #include <concepts>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <span>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace spdlog
@@ -92,6 +112,25 @@ namespace malloy::server
                 connection
             );
         }
+
+        /**
+         * Send a canned response.
+         *
+         * @param req The request to which we're responding.
+         * @param resp The response.
+         * @param connection The connection.
+         */
+        inline
+        void
+        send_response(const boost::beast::http::request_header<>& req, const std::shared_ptr<const malloy::http::canned_response>& resp, const http::connection_t& connection, std::string_view)
+        {
+            std::visit(
+                [&](auto& c) {
+                    c->do_write(resp, req);
+                },
+                connection
+            );
+        }
     }    // namespace detail
 
     /**
@@ -160,9 +199,12 @@ namespace malloy::server
         class policy_store
         {
         public:
-            policy_store(std::string reg, std::unique_ptr<abstract_req_validator> validator) :
+            /**
+             * @throws std::regex_error if the resource is not a valid regular expression.
+             */
+            policy_store(const std::string& reg, std::unique_ptr<abstract_req_validator> validator) :
                 m_validator{std::move(validator)},
-                m_raw_reg{std::move(reg)}
+                m_reg{reg}
             {
             }
 
@@ -177,24 +219,48 @@ namespace malloy::server
             }
 
         private:
+            [[nodiscard]]
             bool
-            matches(std::string_view url) const
+            matches(const std::string_view url) const
             {
-                if (!m_compiled_reg)
-                    compile_match_expr();
-                std::string surl{url.begin(), url.end()}; // Must be null terminated
-                return std::regex_match(surl, *m_compiled_reg);
+                return std::regex_match(std::cbegin(url), std::cend(url), m_reg);
             }
 
-            void
-            compile_match_expr() const
+            std::unique_ptr<abstract_req_validator> m_validator;
+            std::regex m_reg;
+        };
+
+        class abstract_static_router
+        {
+        public:
+            virtual
+            ~abstract_static_router() = default;
+
+            virtual
+            bool
+            handle(const http::request_generator_t& gen, const http::connection_t& conn) const = 0;
+        };
+
+        template<typename StaticRouter, typename Writer>
+        class static_router_impl :
+            public abstract_static_router
+        {
+        public:
+            static_router_impl(StaticRouter routes, Writer writer) :
+                m_routes{std::move(routes)},
+                m_writer{std::move(writer)}
             {
-                m_compiled_reg = std::regex{m_raw_reg};
             }
 
-            std::unique_ptr<abstract_req_validator> m_validator;
-            mutable std::optional<std::regex> m_compiled_reg;
-            std::string m_raw_reg;
+            bool
+            handle(const http::request_generator_t& gen, const http::connection_t& conn) const override
+            {
+                return m_routes.handle(gen, conn, m_writer);
+            }
+
+        private:
+            StaticRouter m_routes;
+            Writer m_writer;
         };
 
     public:
@@ -294,7 +360,8 @@ namespace malloy::server
          * @tparam ExtraInfo a type that satisfies request_filter. Used to provide additional customisation of request handling. 
          *  Must satisfy request_filter @ref route_concepts
          * @tparam Func invoked on a request to the specified target with the specified method. 
-         *  Must satisfy route_handler @ref route_concepts
+         *  Must satisfy route_handler @ref route_concepts. Coroutines (returning `malloy::awaitable<...>`) are
+         *  spawned on the strand of the connection.
          * @param method The HTTP method.
          * @param target The resource path (regex).
          * @param handler The handler to generate the response.
@@ -307,21 +374,34 @@ namespace malloy::server
         add(const method_type method, const std::string_view target, Func&& handler, ExtraInfo&& extra)
         {
             using func_t = std::decay_t<Func>;
+            using request_t = typename std::decay_t<ExtraInfo>::request_type;
 
-            constexpr bool uses_captures = std::invocable<func_t, const request_type&, const std::vector<std::string>&>;
+            constexpr bool uses_captures        = std::invocable<func_t, const request_t&, const route_captures&>;
+            constexpr bool uses_legacy_captures = std::invocable<func_t, const request_t&, const std::vector<std::string>&>;
 
             if constexpr (uses_captures) {
                 return add_regex_endpoint<
-                        uses_captures,
-                        std::invoke_result_t<func_t, const request_type&, const std::vector<std::string>&>
+                        true,
+                        std::invoke_result_t<func_t, const request_t&, const route_captures&>,
+                        route_captures
+                    >(
+                        method, target, std::forward<Func>(handler), std::forward<ExtraInfo>(extra)
+                    );
+            }
+            else if constexpr (uses_legacy_captures) {
+                return add_regex_endpoint<
+                        true,
+                        std::invoke_result_t<func_t, const request_t&, const std::vector<std::string>&>,
+                        std::vector<std::string>
                     >(
                         method, target, std::forward<Func>(handler), std::forward<ExtraInfo>(extra)
                     );
             }
             else {
                 return add_regex_endpoint<
-                        uses_captures,
-                        std::invoke_result_t<func_t, const request_type&>
+                        false,
+                        std::invoke_result_t<func_t, const request_t&>,
+                        route_captures
                     >(
                         method, target, std::forward<Func>(handler), std::forward<ExtraInfo>(extra)
                     );
@@ -335,9 +415,320 @@ namespace malloy::server
             return add(method, target, std::forward<Func>(handler), detail::default_route_filter{});
         }
 
+        /**
+         * Add an HTTP regex endpoint whose responses are cached.
+         *
+         * @details Responses are cached by method, target and the request header fields listed in the policy. A cached
+         *          response is served without invoking the handler.
+         *
+         *          The target is the one seen by this router (i.e. relative to its resource base if this is a
+         *          sub-router). A cache can therefore not be shared with the routes of another router.
+         *
+         * @tparam Func invoked on a request to the specified target with the specified method (unless cached).
+         *  Must satisfy route_handler @ref route_concepts and return a `malloy::http::response<>`. Legacy
+         *  `std::vector<std::string>` captures are not supported.
+         * @param method The HTTP method.
+         * @param target The resource path (regex).
+         * @param handler The handler to generate the response.
+         * @param policy The cache policy.
+         * @return Whether adding the route was successful.
+         *
+         * @sa response_cache
+         */
+        template<concepts::route_handler<request_type> Func>
+        bool
+        add(const method_type method, const std::string_view target, Func&& handler, response_cache::policy policy)
+        {
+            using func_t = std::decay_t<Func>;
+
+            constexpr bool uses_captures = std::invocable<const func_t&, const request_type&, const route_captures&>;
+            if constexpr (uses_captures)
+                static_assert(std::same_as<std::invoke_result_t<const func_t&, const request_type&, const route_captures&>, response_type>, "cached handlers must return a response<>");
+            else
+                static_assert(std::same_as<std::invoke_result_t<const func_t&, const request_type&>, response_type>, "cached handlers must return a response<>");
+
+            // Check cache
+            if (!policy.cache) {
+                if (m_logger)
+                    m_logger->warn("route has no cache. ignoring.");
+                return false;
+            }
+            if (!policy.cache->claim(this)) {
+                if (m_logger)
+                    m_logger->warn("cache is used by another router. ignoring.");
+                return false;
+            }
+
+            return add(
+                method,
+                target,
+                [this, handler = std::forward<Func>(handler), policy = std::move(policy)](const request_type& req, const route_captures& captures) -> std::shared_ptr<const malloy::http::canned_response> {
+                    const std::string key = response_cache::make_key(req.base(), policy.vary);
+                    if (auto resp = policy.cache->get(key))
+                        return resp;
+
+                    // Generate (and store) the response
+                    response_type resp;
+                    try {
+                        if constexpr (uses_captures)
+                            resp = handler(req, captures);
+                        else
+                            resp = handler(req);
+                    }
+                    catch (...) {
+                        policy.cache->abandon(key);
+                        throw;
+                    }
+                    if (!malloy::http::has_field(resp, malloy::http::field::server))
+                        resp.set(malloy::http::field::server, m_server_str);
+                    auto canned = malloy::http::canned_response::make(std::move(resp));
+                    policy.cache->put(key, canned, policy);
+
+                    return canned;
+                }
+            );
+        }
+
+        /**
+         * Add an HTTP regex endpoint coalescing concurrent identical requests.
+         *
+         * @details Requests arriving while an identical request (same target and values of the request header fields
+         *          listed in the policy) is being handled do not invoke the handler. Instead, they are answered with the
+         *          response of the request in flight. That response is serialized once and shared by all of them.
+         *          They are answered with `503 Service Unavailable` if the request in flight goes away without a
+         *          response (e.g. its client disconnected) or the timeout of the policy elapses.
+         *
+         * @tparam Func invoked on a request to the specified target (unless coalesced).
+         *  Must satisfy route_handler @ref route_concepts and return a `malloy::http::response<>`. Legacy
+         *  `std::vector<std::string>` captures are not supported.
+         * @param method The HTTP method. Must be `GET`.
+         * @param target The resource path (regex).
+         * @param handler The handler to generate the response.
+         * @param policy The coalescing policy.
+         * @return Whether adding the route was successful.
+         *
+         * @sa single_flight
+         */
+        template<concepts::route_handler<request_type> Func>
+        bool
+        add(const method_type method, const std::string_view target, Func&& handler, single_flight::policy policy)
+        {
+            using func_t = std::decay_t<Func>;
+
+            constexpr bool uses_captures = std::invocable<const func_t&, const request_type&, const route_captures&>;
+            if constexpr (uses_captures)
+                static_assert(std::same_as<std::invoke_result_t<const func_t&, const request_type&, const route_captures&>, response_type>, "coalesced handlers must return a response<>");
+            else
+                static_assert(std::same_as<std::invoke_result_t<const func_t&, const request_type&>, response_type>, "coalesced handlers must return a response<>");
+
+            // Log
+            if (m_logger)
+                m_logger->trace("adding coalescing route: {}", target);
+
+            // Only safe methods can be coalesced
+            if (method != malloy::http::method::get) {
+                if (m_logger)
+                    m_logger->error("only GET routes can be coalesced. not adding route \"{}\".", target);
+                return false;
+            }
+
+            auto flight = std::make_shared<single_flight>(policy.timeout, make_unavailable(m_server_str));
+
+            // Build endpoint
+            auto ep = make_regex_endpoint<true, response_type, route_captures>(
+                method,
+                target,
+                [handler = std::forward<Func>(handler), flight, vary = policy.vary](const request_type& req, const route_captures& captures) -> response_type {
+                    try {
+                        if constexpr (uses_captures)
+                            return handler(req, captures);
+                        else
+                            return handler(req);
+                    }
+                    catch (...) {
+                        // Don't leave the parked requests hanging
+                        flight->complete(
+                            response_cache::make_key(req.base(), vary),
+                            malloy::http::canned_response::make(malloy::http::generator::server_error("internal server error"))
+                        );
+                        throw;
+                    }
+                },
+                detail::default_route_filter{ }
+            );
+            if (!ep)
+                return false;
+
+            // Send the response of the leader to all parked requests
+            ep->writer = [this, flight, vary = policy.vary](const request_header& req, std::variant<response_type>&& resp, const http::connection_t& conn) {
+                auto& r = std::get<response_type>(resp);
+                if (!malloy::http::has_field(r, malloy::http::field::server))
+                    r.set(malloy::http::field::server, m_server_str);
+                const auto canned = malloy::http::canned_response::make(std::move(r));
+
+                detail::send_response(req, canned, conn, m_server_str);
+                flight->complete(response_cache::make_key(req, vary), canned);
+            };
+
+            auto coalescing = std::make_unique<endpoint_http_coalescing>();
+            coalescing->method = method;
+            coalescing->inner = std::move(ep);
+            coalescing->flight = flight;
+            coalescing->vary = std::move(policy.vary);
+
+            // Add route
+            if (!add_http_endpoint(std::move(coalescing), std::string{target}, route_table::to_pattern(target).value_or("")))
+                return false;
+            add_route_method(target, method);
+
+            // The unavailable response is rebuilt if the server string changes
+            m_flights.emplace_back(std::move(flight));
+
+            return true;
+        }
+
+        /**
+         * Add an HTTP regex endpoint whose handler runs on an offload pool.
+         *
+         * @details The handler is run on a worker of the pool (in the lane of the policy) instead of an I/O thread.
+         *          The response is handed back to the strand of the connection for writing. The handler is skipped
+         *          if the client disconnected before it was started.
+         *
+         * @tparam Func invoked on a worker of the pool on a request to the specified target with the specified
+         *  method. Must satisfy route_handler @ref route_concepts and must not be a coroutine. Legacy
+         *  `std::vector<std::string>` captures are not supported.
+         * @param method The HTTP method.
+         * @param target The resource path (regex or pattern).
+         * @param handler The handler to generate the response.
+         * @param policy The offload policy.
+         * @return Whether adding the route was successful.
+         *
+         * @sa offload_pool
+         */
+        template<concepts::route_handler<request_type> Func>
+        bool
+        add(const method_type method, const std::string_view target, Func&& handler, offload_pool::policy policy)
+        {
+            using func_t = std::decay_t<Func>;
+
+            constexpr bool uses_captures = std::invocable<const func_t&, const request_type&, const route_captures&>;
+            using result_t = decltype([] {
+                if constexpr (uses_captures)
+                    return std::type_identity<std::invoke_result_t<const func_t&, const request_type&, const route_captures&>>{ };
+                else
+                    return std::type_identity<std::invoke_result_t<const func_t&, const request_type&>>{ };
+            }())::type;
+            static_assert(!concepts::detail::awaitable_result<result_t>::value, "offloaded handlers must not be coroutines");
+
+            // Check pool
+            if (!policy.pool) {
+                if (m_logger)
+                    m_logger->warn("route has no offload pool. ignoring.");
+                return false;
+            }
+            add_offload_pool(policy.pool);
+
+            return add(
+                method,
+                target,
+                [handler = std::forward<Func>(handler), policy = std::move(policy)](const request_type& req, const route_captures& captures) -> malloy::awaitable<result_t> {
+                    co_return co_await policy.pool->async_run(
+                        policy.lane,
+                        [&]() -> result_t {
+                            if constexpr (uses_captures)
+                                return handler(req, captures);
+                            else
+                                return handler(req);
+                        },
+                        boost::asio::use_awaitable
+                    );
+                }
+            );
+        }
+
+        /**
+         * Add an HTTP endpoint whose handler reads the request body in chunks.
+         *
+         * @details The handler is invoked as soon as the request header was received. It reads the body chunk by
+         *          chunk via @ref streaming_request::read_some() (the next chunk is only read from the connection once
+         *          requested) and eventually sends the response via @ref streaming_request::respond(). Hence the
+         *          memory used per request is bounded by the chunk size rather than by the size of the body.
+         *
+         *          Large responses can likewise be streamed via @ref streaming_request::respond_chunked().
+         *
+         * @param method The HTTP method.
+         * @param target The resource path (regex or pattern, see @ref add()).
+         * @param handler The handler.
+         * @return Whether adding the route was successful.
+         */
+        template<std::invocable<streaming_request> Func>
+        bool
+        add_streaming(const method_type method, const std::string_view target, Func&& handler)
+        {
+            // Log
+            if (m_logger)
+                m_logger->trace("adding streaming route: {}", target);
+
+            // Build regex
+            auto regex = compile_target(target);
+            if (!regex)
+                return false;
+
+            // Build endpoint
+            auto ep = std::make_unique<endpoint_http_streaming>();
+            ep->method = method;
+            ep->resource_base = std::move(*regex);
+            ep->handler = std::forward<Func>(handler);
+            ep->writer = [this](const request_header& req, response_type&& resp, const http::connection_t& conn) {
+                detail::send_response(req, std::move(resp), conn, m_server_str);
+            };
+            ep->chunked_writer = [this](const request_header& req, streaming_request::chunked_header_type&& header, const http::connection_t& conn) {
+                if (!malloy::http::has_field(header, malloy::http::field::server))
+                    header.set(malloy::http::field::server, m_server_str);
+                return http::chunked_response::make(conn, req, std::move(header));
+            };
+
+            // Add route
+            if (!add_http_endpoint(std::move(ep), std::string{target}, route_table::to_pattern(target).value_or("")))
+                return false;
+            add_route_method(target, method);
+
+            return true;
+        }
+
+        /**
+         * Add a CORS preflight endpoint.
+         *
+         * @details The allowed methods are those of all routes matching the target of the preflight request. The
+         *          response is serialized once per distinct set of allowed methods, handling a preflight request
+         *          therefore only matches the routes and sends a canned response. The serialized responses are
+         *          discarded whenever a route is added.
+         *
+         * @param target The resource path (regex or pattern).
+         * @param cfg The preflight configuration.
+         * @return Whether adding the preflight was successful.
+         */
         bool
         add_preflight(std::string_view target, http::preflight_config cfg);
 
+        /**
+         * Add a metrics endpoint.
+         *
+         * @details This enables the collection of per-route metrics on this router and all of its sub-routers (both
+         *          existing and future ones). For every HTTP route the number of requests & responses (by status
+         *          class), the request & response sizes and a latency histogram are collected.
+         *
+         *          A `GET` request to the target is answered with the metrics of all routes in the Prometheus text
+         *          exposition format.
+         *
+         * @note Static routes and WebSocket routes are not metered.
+         *
+         * @param target The resource path (regex).
+         * @return Whether adding the endpoint was successful.
+         */
+        bool
+        add_metrics(std::string_view target);
+
         /**
          * Add an HTTP file-servinc location.
          *
@@ -363,7 +754,8 @@ namespace malloy::server
             ep->writer        = make_endpt_writer_callback();
 
             // Add
-            return add_http_endpoint(std::move(ep));
+            const std::string route = ep->resource_base;
+            return add_http_endpoint(std::move(ep), route);
         }
 
         /**
@@ -383,6 +775,158 @@ namespace malloy::server
             );
         }
 
+        /**
+         * Add an HTTP file-serving location served from a file cache.
+         *
+         * @details The files are looked up in the cache, hence the filesystem is only accessed for files which are
+         *          not cached yet (see @ref malloy::http::file_cache).
+         *
+         * @tparam CacheControl
+         * @param resource
+         * @param cache The cache of the files (its base path is the storage base path).
+         * @param cc
+         * @return Whether adding the file serving was successful.
+         */
+        template<malloy::concepts::callable_string CacheControl>
+        bool
+        add_file_serving(std::string resource, std::shared_ptr<malloy::http::file_cache> cache, const CacheControl& cc)
+        {
+            if (!cache) {
+                if (m_logger)
+                    m_logger->warn("file serving location has no cache. ignoring.");
+                return false;
+            }
+
+            // Log
+            if (m_logger)
+                m_logger->trace("adding cached file serving location: {} -> {}", resource, cache->base_path().string());
+
+            // Create endpoint
+            auto ep = std::make_unique<endpoint_http_files>();
+            ep->resource_base = resource;
+            ep->base_path     = cache->base_path();
+            ep->cache_control = cc();
+            ep->cache         = std::move(cache);
+            ep->writer        = make_endpt_writer_callback();
+
+            // Add
+            const std::string route = ep->resource_base;
+            return add_http_endpoint(std::move(ep), route);
+        }
+
+        /**
+         * Add an HTTP file-serving location served from a file cache.
+         *
+         * @param resource
+         * @param cache The cache of the files (its base path is the storage base path).
+         * @return Whether adding the file serving was successful.
+         */
+        bool
+        add_file_serving(std::string resource, std::shared_ptr<malloy::http::file_cache> cache)
+        {
+            return add_file_serving(
+                std::move(resource),
+                std::move(cache),
+                []() -> std::string { return ""; }
+            );
+        }
+
+        /**
+         * Add an HTTP file-serving location served from an asset bundle.
+         *
+         * @details The files are served from memory (see @ref asset_bundle). The Cache-Control header returned by
+         *          the callable is used for all paths which aren't fingerprinted.
+         *
+         * @tparam CacheControl
+         * @param resource
+         * @param bundle The asset bundle.
+         * @param cc
+         * @return Whether adding the file serving was successful.
+         */
+        template<malloy::concepts::callable_string CacheControl>
+        bool
+        add_file_serving(std::string resource, std::shared_ptr<asset_bundle> bundle, const CacheControl& cc)
+        {
+            if (!bundle) {
+                if (m_logger)
+                    m_logger->warn("file serving location has no bundle. ignoring.");
+                return false;
+            }
+
+            // Log
+            if (m_logger)
+                m_logger->trace("adding asset bundle serving location: {} -> {}", resource, bundle->root().string());
+
+            // Create endpoint
+            auto ep = std::make_unique<endpoint_http_files>();
+            ep->resource_base = resource;
+            ep->base_path     = bundle->root();
+            ep->cache_control = cc();
+            ep->bundle        = std::move(bundle);
+            ep->writer        = make_endpt_writer_callback();
+
+            // Add
+            const std::string route = ep->resource_base;
+            return add_http_endpoint(std::move(ep), route);
+        }
+
+        /**
+         * Add an HTTP file-serving location served from an asset bundle.
+         *
+         * @param resource
+         * @param bundle The asset bundle.
+         * @return Whether adding the file serving was successful.
+         */
+        bool
+        add_file_serving(std::string resource, std::shared_ptr<asset_bundle> bundle)
+        {
+            return add_file_serving(
+                std::move(resource),
+                std::move(bundle),
+                []() -> std::string { return ""; }
+            );
+        }
+
+        /**
+         * Add an HTTP file-serving location served from resources embedded into the binary.
+         *
+         * @details The resources are served from constant data (see @ref embedded_resource and
+         *          `malloy_embed_resources()`), hence serving doesn't access the filesystem.
+         *
+         * @tparam CacheControl
+         * @param resource
+         * @param resources The embedded resources.
+         * @param cc
+         * @return Whether adding the file serving was successful.
+         */
+        template<malloy::concepts::callable_string CacheControl>
+        bool
+        add_file_serving(std::string resource, const std::span<const embedded_resource> resources, const CacheControl& cc)
+        {
+            return add_file_serving(
+                std::move(resource),
+                std::make_shared<asset_bundle>(resources),
+                cc
+            );
+        }
+
+        /**
+         * Add an HTTP file-serving location served from resources embedded into the binary.
+         *
+         * @param resource
+         * @param resources The embedded resources.
+         * @return Whether adding the file serving was successful.
+         */
+        bool
+        add_file_serving(std::string resource, const std::span<const embedded_resource> resources)
+        {
+            return add_file_serving(
+                std::move(resource),
+                resources,
+                []() -> std::string { return ""; }
+            );
+        }
+
         /**
          * Adds an HTTP redirection rule.
          *
@@ -404,16 +948,63 @@ namespace malloy::server
         bool
         add_websocket(std::string&& resource, typename websocket::connection::handler_t&& handler);
 
+        /**
+         * Add a Server-Sent Events endpoint.
+         *
+         * @details `GET` requests to the resource are answered with an event stream. The handler receives the stream
+         *          once the response header was queued. It keeps the stream (e.g. by subscribing it to an
+         *          @ref sse::channel) for as long as events are to be sent.
+         *
+         * @param resource The resource. Matched like the target of @ref add() (e.g. `/events/{room}`).
+         * @param handler The handler for new streams.
+         * @param pol The policy of the streams.
+         * @return Whether adding the endpoint was successful.
+         */
+        bool
+        add_sse(std::string&& resource, sse::stream::handler_t&& handler, sse::stream::policy pol = { });
+
+        /**
+         * Add a set of routes known at compile time.
+         *
+         * @details Dispatching within a static router is fully inlined.
+         *
+         *          The routes are registered for preflights (see @ref add_preflight()) just like the routes added by
+         *          @ref add().
+         *
+         * @note Unlike all other endpoints, which are matched in the order in which they were added, static routers
+         *       are checked before any other endpoint of this router. A static route therefore takes precedence over
+         *       a matching route even if that was added earlier.
+         *
+         * @param routes The static router.
+         */
+        template<typename... Routes>
+        void
+        add_static(static_router<Routes...> routes)
+        {
+            if (m_logger)
+                m_logger->trace("adding static router with {} routes", sizeof...(Routes));
+
+            auto writer = [this](const auto& header, auto&& resp, const auto& conn) { detail::send_response(header, std::forward<decltype(resp)>(resp), conn, m_server_str); };
+
+            m_static_routers.emplace_back(std::make_unique<static_router_impl<static_router<Routes...>, decltype(writer)>>(std::move(routes), std::move(writer)));
+
+            (add_route_method(Routes::pattern, Routes::method), ...);
+        }
+
         /**
          * Add an access policy for a specific resource.
          *
          * A policy allow restricting access to any resource registered on this router.
          *
-         * @param resource The resource path.
+         * @details The resource is compiled once. Policies are indexed by the literal prefix of their resource so
+         *          that a request only evaluates the policies which can apply to its target.
+         *
+         * @param resource The resource path (regex).
          * @param policy The policy.
+         * @return Whether adding the policy was successful.
          */
         template<concepts::request_validator Policy>
-        void
+        bool
         add_policy(const std::string& resource, Policy&& policy)
         {
             if (m_logger)
@@ -422,7 +1013,17 @@ namespace malloy::server
             using policy_t = std::decay_t<Policy>;
             auto writer = [this](const auto& header, auto&& resp, auto&& conn) { detail::send_response(header, std::forward<decltype(resp)>(resp), std::forward<decltype(conn)>(conn), m_server_str); };
 
-            m_policies.emplace_back(resource, std::make_unique<req_validator_impl<policy_t, decltype(writer)>>(std::forward<Policy>(policy), std::move(writer)));
+            try {
+                m_policies.emplace_back(resource, std::make_unique<req_validator_impl<policy_t, decltype(writer)>>(std::forward<Policy>(policy), std::move(writer)));
+            }
+            catch (const std::regex_error& e) {
+                if (m_logger)
+                    m_logger->error("invalid policy resource supplied \"{}\": {}", resource, e.what());
+                return false;
+            }
+            m_policies_index.insert_shared_prefix(route_table::literal_prefix(resource), m_policies.size() - 1);
+
+            return true;
         }
 
         /**
@@ -458,12 +1059,9 @@ namespace malloy::server
                     return;
             }
 
-            // Check sub-routers
-            for (const auto& [resource_base, router] : m_sub_routers) {
-                // Check match
-                const auto res_str = malloy::http::resource_string(req->header());
-                if (!res_str.starts_with(resource_base))
-                    continue;
+            // Check sub-routers (longest matching resource base wins)
+            if (const auto sub = m_sub_routers_index.find_prefix(malloy::http::resource_string(req->header()))) {
+                const auto& [resource_base, router] = m_sub_routers[sub->first];
 
                 // Chop request resource path
                 malloy::http::chop_resource(req->header(), resource_base);
@@ -494,33 +1092,104 @@ namespace malloy::server
         }
 
     private:
+        struct route_method
+        {
+            std::regex resource;
+            method_type method;
+        };
+
+        struct preflight_entry
+        {
+            http::preflight_config cfg;
+            std::mutex lock;        // protects responses
+            std::unordered_map<std::uint64_t, std::shared_ptr<const malloy::http::canned_response>> responses;   // Set of allowed methods (bitmask) -> response
+        };
+
         std::shared_ptr<spdlog::logger> m_logger{nullptr};
-        std::unordered_map<std::string, std::unique_ptr<router>> m_sub_routers;
+        std::vector<std::pair<std::string, std::unique_ptr<router>>> m_sub_routers;
+        route_table m_sub_routers_index;                                // Resource base -> index into m_sub_routers
+        std::vector<std::unique_ptr<abstract_static_router>> m_static_routers;
         std::vector<std::unique_ptr<endpoint_http>> m_endpoints_http;
+        route_table m_endpoints_http_index;                             // Indexable targets -> index into m_endpoints_http
+        std::vector<std::size_t> m_endpoints_http_unindexed;            // Indices of endpoints which need to be checked one by one
+        std::vector<std::string> m_endpoints_http_routes;               // Route of every endpoint (for metrics)
+        std::shared_ptr<route_metrics> m_metrics;                       // Slot == index into m_endpoints_http (if enabled)
         std::vector<std::unique_ptr<endpoint_websocket>> m_endpoints_websocket;
+        route_table m_endpoints_websocket_index;                        // Resource -> index into m_endpoints_websocket
+        std::vector<route_method> m_route_methods;                      // Resource & method of every route (for preflights)
+        std::vector<std::shared_ptr<preflight_entry>> m_preflights;
+        std::vector<std::shared_ptr<const offload_pool>> m_offload_pools;  // Pools of the routes (for metrics)
+        std::vector<std::shared_ptr<single_flight>> m_flights;          // Tables of the coalescing routes
         std::vector<policy_store> m_policies;                           // Access policies for resources
+        route_table m_policies_index;                                   // Literal resource prefix -> index into m_policies
         std::string_view m_server_str;
+        std::shared_ptr<const malloy::http::canned_response> m_unknown_request = make_unknown_request(m_server_str);
+        std::shared_ptr<const malloy::http::canned_response> m_no_handler = make_no_handler(m_server_str);
 
         friend class routing_context;
+        friend class router_handle;
+        friend class vhost_table;
 
         router(std::shared_ptr<spdlog::logger> logger, std::string_view m_server_str);
 
         void
         set_server_string(std::string_view str);
 
+        /**
+         * Builds the response to requests which no route matches.
+         *
+         * @param server_str The server string.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<const malloy::http::canned_response>
+        make_unknown_request(std::string_view server_str);
+
+        /**
+         * Builds the response to requests to endpoints without a handler.
+         *
+         * @param server_str The server string.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<const malloy::http::canned_response>
+        make_no_handler(std::string_view server_str);
+
+        /**
+         * Builds the response to parked requests of abandoned flights of coalescing routes.
+         *
+         * @param server_str The server string.
+         * @return The response.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<const malloy::http::canned_response>
+        make_unavailable(std::string_view server_str);
+
         template<typename Derived>
         [[nodiscard]]
         bool
         is_handled_by_policies(const req_generator<Derived>& req, const http::connection_t& connection)
         {
-            return std::any_of(
-                std::cbegin(m_policies),
-                std::cend(m_policies),
-                [&](const policy_store& policy) {
-                    return policy.process(req->header(), connection);
-            });
+            if (m_policies.empty())
+                return false;
+
+            return process_policies(req->header(), connection);
         }
 
+        /**
+         * Evaluates the policies which can apply to a request (in insertion order).
+         *
+         * @param header The request header.
+         * @param connection The connection.
+         * @return Whether a policy handled the request.
+         */
+        [[nodiscard]]
+        bool
+        process_policies(const request_header& header, const http::connection_t& connection) const;
+
         /**
          * Handle an HTTP request.
          *
@@ -545,16 +1214,26 @@ namespace malloy::server
                 );
             }
 
-            const auto& header = req->header();
+            // Check static routes
+            for (const auto& routes : m_static_routers) {
+                if (routes->handle(req, connection))
+                    return;
+            }
 
             // Check routes
-            for (const auto& ep : m_endpoints_http) {
-                // Check match
-                if (!ep->matches(header))
-                    continue;
+            route_captures captures;
+            if (const std::size_t id = find_http_endpoint(req->header(), captures); id != route_table::npos) {
+                if (m_metrics)
+                    meter_request(req->header(), id, connection);
+
+                const auto& ep = m_endpoints_http[id];
+                if (!ep->has_handler()) {
+                    detail::send_response(req->header(), m_no_handler, connection, m_server_str);
+                    return;
+                }
 
                 // Generate the response for the request
-                auto resp = ep->handle(req, connection);
+                auto resp = ep->handle_with_captures(req, connection, captures);
                 if (resp) {
                     // Send the response
                     detail::send_response(req->header(), std::move(*resp), connection, m_server_str);
@@ -565,7 +1244,7 @@ namespace malloy::server
             }
 
             // If we end up where we have no meaningful way of handling this request
-            detail::send_response(req->header(), malloy::http::generator::bad_request("unknown request"), connection, m_server_str);
+            detail::send_response(req->header(), m_unknown_request, connection, m_server_str);
         }
 
         /**
@@ -589,16 +1268,14 @@ namespace malloy::server
             );
 
             // Check routes
-            for (const auto& ep : m_endpoints_websocket) {
-                // Check match
-                if (ep->resource != res_string)
-                    continue;
-
-                // Validate route handler
-                if (!ep->handler) {
-                    m_logger->warn("websocket route with resource path \"{}\" has no valid handler assigned.");
-                    continue;
+            const auto match = m_endpoints_websocket_index.find(
+                res_string,
+                [this](const std::size_t id) {
+                    return static_cast<bool>(m_endpoints_websocket[id]->handler);
                 }
+            );
+            if (match) {
+                const auto& ep = m_endpoints_websocket[match->id];
 
                 malloy::http::request req;
                 req.base() = gen->header();
@@ -612,6 +1289,7 @@ namespace malloy::server
         template<
             bool UsesCaptures,
             typename Body,
+            typename Captures,
             concepts::request_filter ExtraInfo,
             typename Func>
         bool
@@ -621,28 +1299,70 @@ namespace malloy::server
             if (m_logger)
                 m_logger->trace("adding route: {}", target);
 
-            // Build regex
-            std::regex regex;
-            try {
-                regex = std::regex{target.cbegin(), target.cend()};
-            }
-            catch (const std::regex_error& e) {
-                if (m_logger)
-                    m_logger->error("invalid route target supplied \"{}\": {}", target, e.what());
+            // Build endpoint
+            auto ep = make_regex_endpoint<UsesCaptures, Body, Captures>(method, target, std::forward<Func>(handler), std::forward<ExtraInfo>(extra));
+            if (!ep)
                 return false;
-            }
+            ep->writer = make_endpt_writer_callback();
+
+            // Add route
+            if (!add_http_endpoint(std::move(ep), std::string{target}, route_table::to_pattern(target).value_or("")))
+                return false;
+            add_route_method(target, method);
+
+            return true;
+        }
 
-            constexpr bool wrapped = malloy::concepts::is_variant<Body>;
-            using bodies_t = std::conditional_t<wrapped, Body, std::variant<Body>>;
+        /**
+         * Builds an HTTP regex endpoint (without writer).
+         *
+         * @return The endpoint or `nullptr` on failure.
+         */
+        template<
+            bool UsesCaptures,
+            typename Body,
+            typename Captures,
+            concepts::request_filter ExtraInfo,
+            typename Func>
+        auto
+        make_regex_endpoint(method_type method, std::string_view target, Func&& handler, ExtraInfo&& extra)
+        {
+            // Coroutine handlers
+            using result_t = concepts::detail::awaitable_result<Body>;
+            using response_t = typename result_t::type;
+
+            constexpr bool wrapped = malloy::concepts::is_variant<response_t>;
+            using bodies_t = std::conditional_t<wrapped, response_t, std::variant<response_t>>;
+            using endpoint_t = endpoint_http_regex<bodies_t, std::decay_t<ExtraInfo>, UsesCaptures, Captures, result_t::value>;
+
+            // Build regex
+            auto regex = compile_target(target);
+            if (!regex)
+                return std::unique_ptr<endpoint_t>{ };
+
+            // Check handler (an empty std::function would otherwise be wrapped into a valid handler below)
+            if constexpr (malloy::concepts::is<std::decay_t<Func>, std::function>) {
+                if (!handler) {
+                    if (m_logger)
+                        m_logger->warn("route has invalid handler. ignoring.");
+                    return std::unique_ptr<endpoint_t>{ };
+                }
+            }
 
             // Build endpoint
-            auto ep = std::make_unique<endpoint_http_regex<bodies_t, std::decay_t<ExtraInfo>, UsesCaptures>>();
-            ep->resource_base = std::move(regex);
+            auto ep = std::make_unique<endpoint_t>();
+            ep->resource_base = std::move(*regex);
             ep->method = method;
             ep->filter = std::forward<ExtraInfo>(extra);
             if constexpr (wrapped) {
                 ep->handler = std::move(handler);
             }
+            else if constexpr (result_t::value) {
+                ep->handler =
+                    [w = std::forward<Func>(handler)](const auto&... args) -> malloy::awaitable<bodies_t> {
+                        co_return bodies_t{co_await w(args...)};
+                    };
+            }
             else {
                 ep->handler =
                     [w = std::forward<Func>(handler)](auto&&... args) {
@@ -654,25 +1374,106 @@ namespace malloy::server
             if (!ep->handler) {
                 if (m_logger)
                     m_logger->warn("route has invalid handler. ignoring.");
-                return false;
+                return std::unique_ptr<endpoint_t>{ };
             }
 
-            ep->writer = make_endpt_writer_callback();
-
-            // Add route
-            return add_http_endpoint(std::move(ep));
+            return ep;
         }
 
+        /**
+         * Compiles a route target.
+         *
+         * @details Targets consisting of literal and {param} segments only are converted to their regex. Any other
+         *          target is a regex itself.
+         *
+         * @param target The route target.
+         * @return The regex (if the target is valid).
+         */
+        [[nodiscard]]
+        std::optional<std::regex>
+        compile_target(std::string_view target) const;
+
+        /**
+         * Registers the method of a route for preflights.
+         *
+         * @details This discards the responses of all preflights as the allowed methods might have changed.
+         *
+         * @param target The route target.
+         * @param method The route method.
+         */
+        void
+        add_route_method(std::string_view target, method_type method);
+
+        /**
+         * Gets the response of a preflight to a request.
+         *
+         * @details The response is built on first use of its set of allowed methods.
+         *
+         * @param preflight The preflight.
+         * @param target The target of the request.
+         * @return The response.
+         */
+        [[nodiscard]]
+        std::shared_ptr<const malloy::http::canned_response>
+        preflight_response(preflight_entry& preflight, std::string_view target) const;
+
+        /**
+         * Discards the responses of all preflights.
+         */
+        void
+        clear_preflight_responses();
+
         /**
          * Adds an HTTP endpoint.
          *
          * @note This uses @ref log_or_throw() internally and might therefore throw if no logger is available.
          *
          * @param ep The endpoint to add.
+         * @param route The route of the endpoint (used as metrics label).
+         * @param pattern The route pattern under which to index the endpoint. If empty, the endpoint is not indexed
+         *                and will be matched via `endpoint_http::matches()` instead.
          * @return Whether adding the endpoint was successful.
          */
         bool
-        add_http_endpoint(std::unique_ptr<endpoint_http>&& ep);
+        add_http_endpoint(std::unique_ptr<endpoint_http>&& ep, std::string route, std::string_view pattern = { });
+
+        /**
+         * Finds the first endpoint (in insertion order) matching a request.
+         *
+         * @details The captures obtained while matching are handed to the endpoint so that it does not have to
+         *          match the request target again.
+         *
+         * @param header The request header.
+         * @param captures The captures of the matching endpoint (views into the request target).
+         * @return The index of the endpoint or `route_table::npos` if none matches.
+         */
+        [[nodiscard]]
+        std::size_t
+        find_http_endpoint(const request_header& header, route_captures& captures) const;
+
+        /**
+         * Registers the offload pool of a route for metrics.
+         *
+         * @param pool The pool.
+         */
+        void
+        add_offload_pool(std::shared_ptr<const offload_pool> pool);
+
+        /**
+         * Enables the collection of per-route metrics on this router and all of its sub-routers.
+         */
+        void
+        enable_metrics();
+
+        /**
+         * Records a request to an endpoint and arranges for the response to be recorded once it was written.
+         *
+         * @param header The request header.
+         * @param id The index of the endpoint.
+         * @param connection The connection.
+         */
+        void
+        meter_request(const request_header& header, std::size_t id, const http::connection_t& connection) const;
 
         /**
          * Adds a WebSocket endpoint.
@@ -0,0 +1,29 @@
+#include "router_handle.hpp"
+#include "router.hpp"
+
+using namespace malloy::server;
+
+router_handle::router_handle(std::string server_str) :
+    m_server_str{std::move(server_str)}
+{
+}
+
+bool
+router_handle::publish(std::shared_ptr<router> r)
+{
+    if (!r)
+        return false;
+
+    // The string is owned by this handle which outlives all routers published through it
+    r->set_server_string(m_server_str);
+
+    m_router.store(std::move(r), std::memory_order_release);
+
+    return true;
+}
+
+void
+router_handle::publish_vhosts(std::shared_ptr<const vhost_table> vhosts)
+{
+    m_vhosts.store(std::move(vhosts), std::memory_order_release);
+}
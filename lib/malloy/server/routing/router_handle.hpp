@@ -0,0 +1,113 @@
+#pragma once
+
+#include "vhost_table.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace malloy::server
+{
+    class router;
+
+    /**
+     * The point through which a running server obtains its top-level router.
+     *
+     * @details This allows replacing the entire routing table of a running server without restarting it (and hence
+     *          without dropping any connections). Publishing is read-copy-update: A new router is built separately
+     *          and then published atomically. Every request loads the router which is current at the time the request
+     *          arrives and keeps it alive until the request was handled. Hence in-flight requests finish on the old
+     *          router while new requests use the new one. Loading the router does not involve any mutex.
+     *
+     * @note A router must not be modified after it was published.
+     */
+    class router_handle
+    {
+    public:
+        /**
+         * Constructor.
+         *
+         * @param server_str The server string to apply to published routers.
+         */
+        explicit
+        router_handle(std::string server_str);
+
+        router_handle(const router_handle& other) = delete;
+        router_handle(router_handle&& other) noexcept = delete;
+        ~router_handle() = default;
+
+        router_handle& operator=(const router_handle& rhs) = delete;
+        router_handle& operator=(router_handle&& rhs) noexcept = delete;
+
+        /**
+         * Gets the server string applied to published routers.
+         *
+         * @return The server string.
+         */
+        [[nodiscard]]
+        std::string_view
+        server_string() const noexcept
+        {
+            return m_server_str;
+        }
+
+        /**
+         * Gets the current router.
+         *
+         * @return The current router.
+         */
+        [[nodiscard]]
+        std::shared_ptr<router>
+        load() const noexcept
+        {
+            return m_router.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Gets the current router of a host.
+         *
+         * @param host The value of the `Host` header of the request.
+         * @return The router of the virtual host (if any), the current router otherwise.
+         */
+        [[nodiscard]]
+        std::shared_ptr<router>
+        load(const std::string_view host) const
+        {
+            if (const auto vhosts = m_vhosts.load(std::memory_order_acquire)) {
+                if (auto r = vhosts->find(host))
+                    return r;
+            }
+
+            return load();
+        }
+
+        /**
+         * Publishes a new router.
+         *
+         * @note The router should be built in place (i.e. not be moved after adding routes) as endpoints refer to
+         *       the router they were added to.
+         *
+         * @param r The router.
+         * @return Whether the router was published.
+         */
+        bool
+        publish(std::shared_ptr<router> r);
+
+        /**
+         * Publishes new virtual hosts.
+         *
+         * @details Requests for hosts which are not in the table are handled by the current router.
+         *
+         * @param vhosts The virtual hosts (may be `nullptr` to remove all virtual hosts).
+         */
+        void
+        publish_vhosts(std::shared_ptr<const vhost_table> vhosts);
+
+    private:
+        std::string m_server_str;
+        std::atomic<std::shared_ptr<router>> m_router;
+        std::atomic<std::shared_ptr<const vhost_table>> m_vhosts;
+    };
+
+}
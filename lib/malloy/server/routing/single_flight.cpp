@@ -0,0 +1,182 @@
+#include "single_flight.hpp"
+
+#include <boost/asio/post.hpp>
+
+using namespace malloy::server;
+
+single_flight::leader::leader(std::weak_ptr<single_flight> table_, std::string key_, const std::uint64_t id_) :
+    table{ std::move(table_) },
+    key{ std::move(key_) },
+    id{ id_ }
+{
+}
+
+single_flight::leader::~leader()
+{
+    abandon();
+}
+
+void
+single_flight::leader::abandon()
+{
+    if (const auto t = table.lock())
+        t->abandon(key, id);
+    table.reset();
+}
+
+single_flight::single_flight(const clock::duration timeout, std::shared_ptr<const malloy::http::canned_response> unavailable) :
+    m_timeout{ timeout },
+    m_unavailable{ std::move(unavailable) }
+{
+    if (!m_unavailable) {
+        malloy::http::response<> resp{ malloy::http::status::service_unavailable };
+        resp.body() = "service unavailable";
+        resp.prepare_payload();
+        m_unavailable = malloy::http::canned_response::make(std::move(resp));
+    }
+}
+
+bool
+single_flight::join(const std::string_view key, const http::request_generator_t& req, const http::connection_t& conn)
+{
+    std::uint64_t id = 0;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_lock);
+
+        const auto it = m_flights.find(key);
+        if (it != std::end(m_flights)) {
+            it->second.waiters.emplace_back(req, conn);
+            if (!it->second.timer)
+                start_timer(key, it->second, conn);
+            return false;
+        }
+
+        id = m_next_id++;
+        m_flights.emplace(key, flight{ .id = id });
+    }
+
+    // Tie the flight to the leader
+    auto l = std::make_shared<leader>(weak_from_this(), std::string{key}, id);
+    std::visit(
+        [&l](const auto& gen) {
+            if (auto slot = gen->cancellation_slot(); slot.is_connected()) {
+                slot.assign([weak = std::weak_ptr{ l }](boost::asio::cancellation_type) {
+                    if (const auto p = weak.lock())
+                        p->abandon();
+                });
+            }
+            gen->retain(std::move(l));
+        },
+        req
+    );
+
+    return true;
+}
+
+std::size_t
+single_flight::complete(const std::string_view key, const std::shared_ptr<const malloy::http::canned_response>& resp)
+{
+    flight f;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_lock);
+
+        const auto it = m_flights.find(key);
+        if (it == std::end(m_flights))
+            return 0;
+
+        f = std::move(it->second);
+        m_flights.erase(it);
+    }
+
+    const std::size_t count = f.waiters.size();
+    land(std::move(f), resp);
+
+    return count;
+}
+
+void
+single_flight::set_unavailable(std::shared_ptr<const malloy::http::canned_response> unavailable)
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    m_unavailable = std::move(unavailable);
+}
+
+std::size_t
+single_flight::size() const
+{
+    // Acquire mutex
+    std::lock_guard lock(m_lock);
+
+    return m_flights.size();
+}
+
+void
+single_flight::abandon(const std::string_view key, const std::uint64_t id)
+{
+    flight f;
+    std::shared_ptr<const malloy::http::canned_response> unavailable;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_lock);
+
+        const auto it = m_flights.find(key);
+        if (it == std::end(m_flights) || it->second.id != id)
+            return;
+
+        f = std::move(it->second);
+        m_flights.erase(it);
+        unavailable = m_unavailable;
+    }
+
+    land(std::move(f), unavailable);
+}
+
+void
+single_flight::start_timer(const std::string_view key, flight& f, const http::connection_t& conn)
+{
+    if (m_timeout <= clock::duration::zero())
+        return;
+
+    std::visit(
+        [&](const auto& c) {
+            if (c)
+                f.timer = std::make_shared<boost::asio::steady_timer>(c->stream().get_executor(), m_timeout);
+        },
+        conn
+    );
+    if (!f.timer)
+        return;
+
+    f.timer->async_wait([weak = weak_from_this(), key = std::string{key}, id = f.id](const malloy::error_code ec) {
+        if (ec)
+            return;
+        if (const auto t = weak.lock())
+            t->abandon(key, id);
+    });
+}
+
+void
+single_flight::land(flight&& f, const std::shared_ptr<const malloy::http::canned_response>& resp)
+{
+    // Timers are not thread-safe, cancel on the executor of the timer
+    if (f.timer) {
+        const auto executor = f.timer->get_executor();
+        boost::asio::post(executor, [timer = std::move(f.timer)] { timer->cancel(); });
+    }
+
+    // Send outside of the lock
+    for (const auto& w : f.waiters) {
+        std::visit(
+            [&resp](const auto& gen, const auto& c) {
+                if (c)
+                    c->do_write(resp, gen->header());
+            },
+            w.req,
+            w.conn
+        );
+    }
+}
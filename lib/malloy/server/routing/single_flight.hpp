@@ -0,0 +1,201 @@
+#pragma once
+
+#include "../http/connection_t.hpp"
+#include "../http/request_generator_t.hpp"
+#include "../../core/http/canned_response.hpp"
+
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace malloy::server
+{
+
+    /**
+     * Coalesces concurrent identical requests.
+     *
+     * @details The first request for a key leads: It is handled as usual. Every request for the same key arriving
+     *          while the leader is being handled is parked without invoking the handler. Once the response of the
+     *          leader is known, it is sent to all parked requests. The response is shared (not copied) between them.
+     *
+     *          If the leader goes away without completing the flight (e.g. its body could not be read or its client
+     *          disconnected) or the timeout elapses, the parked requests are answered with the unavailable response
+     *          instead. This requires the table to be owned by a `std::shared_ptr`.
+     *
+     *          The table is thread-safe.
+     *
+     * @sa router::add()
+     */
+    class single_flight :
+        public std::enable_shared_from_this<single_flight>
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * Coalescing policy of a route.
+         */
+        struct policy
+        {
+            /**
+             * The names of the request header fields which are part of the key (in addition to method & target).
+             */
+            std::vector<std::string> vary{ };
+
+            /**
+             * How long requests are parked at most (counted from the first parked request of a flight). Zero disables
+             * the timeout.
+             */
+            clock::duration timeout = std::chrono::seconds{30};
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param timeout How long requests are parked at most. Zero disables the timeout.
+         * @param unavailable The response to parked requests of an abandoned flight. Defaults to
+         *                    `503 Service Unavailable`.
+         */
+        explicit
+        single_flight(
+            clock::duration timeout = std::chrono::seconds{30},
+            std::shared_ptr<const malloy::http::canned_response> unavailable = nullptr
+        );
+
+        single_flight(const single_flight& other) = delete;
+        single_flight(single_flight&& other) noexcept = delete;
+        ~single_flight() = default;
+
+        single_flight& operator=(const single_flight& rhs) = delete;
+        single_flight& operator=(single_flight&& rhs) noexcept = delete;
+
+        /**
+         * Joins the flight of a key.
+         *
+         * @details The flight is abandoned once the request generator of the leader is destroyed or cancelled
+         *          without the flight having been completed.
+         *
+         * @param key The key.
+         * @param req The request.
+         * @param conn The connection of the request.
+         * @return Whether the request leads (i.e. has to be handled). Otherwise it was parked.
+         */
+        [[nodiscard]]
+        bool
+        join(std::string_view key, const http::request_generator_t& req, const http::connection_t& conn);
+
+        /**
+         * Completes the flight of a key.
+         *
+         * @details The response is sent to all parked requests.
+         *
+         * @param key The key.
+         * @param resp The response.
+         * @return The number of parked requests the response was sent to.
+         */
+        std::size_t
+        complete(std::string_view key, const std::shared_ptr<const malloy::http::canned_response>& resp);
+
+        /**
+         * Replaces the response to parked requests of an abandoned flight.
+         *
+         * @param unavailable The response.
+         */
+        void
+        set_unavailable(std::shared_ptr<const malloy::http::canned_response> unavailable);
+
+        /**
+         * Gets the number of keys in flight.
+         *
+         * @return The number of keys.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const;
+
+    private:
+        struct waiter
+        {
+            http::request_generator_t req;
+            http::connection_t conn;
+        };
+
+        struct flight
+        {
+            std::uint64_t id = 0;
+            std::vector<waiter> waiters;
+            std::shared_ptr<boost::asio::steady_timer> timer;   // Deadline of the parked requests
+        };
+
+        /**
+         * Abandons the flight of its leader on destruction (unless completed meanwhile).
+         */
+        struct leader
+        {
+            std::weak_ptr<single_flight> table;
+            std::string key;
+            std::uint64_t id = 0;
+
+            leader(std::weak_ptr<single_flight> table, std::string key, std::uint64_t id);
+            leader(const leader& other) = delete;
+            leader(leader&& other) noexcept = delete;
+            ~leader();
+
+            leader& operator=(const leader& rhs) = delete;
+            leader& operator=(leader&& rhs) noexcept = delete;
+
+            void
+            abandon();
+        };
+
+        struct key_hash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]]
+            std::size_t
+            operator()(std::string_view str) const noexcept
+            {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        clock::duration m_timeout;
+        mutable std::mutex m_lock;      // protects everything below
+        std::shared_ptr<const malloy::http::canned_response> m_unavailable;
+        std::uint64_t m_next_id = 0;
+        std::unordered_map<std::string, flight, key_hash, std::equal_to<>> m_flights;
+
+        /**
+         * Abandons a flight.
+         *
+         * @param key The key.
+         * @param id The identifier of the flight (flights completed meanwhile are ignored).
+         */
+        void
+        abandon(std::string_view key, std::uint64_t id);
+
+        /**
+         * Starts the deadline of the parked requests of a flight.
+         *
+         * @note The caller must hold the lock.
+         */
+        void
+        start_timer(std::string_view key, flight& f, const http::connection_t& conn);
+
+        /**
+         * Ends a flight: Stops its deadline and sends a response to the parked requests.
+         */
+        static
+        void
+        land(flight&& f, const std::shared_ptr<const malloy::http::canned_response>& resp);
+    };
+
+}
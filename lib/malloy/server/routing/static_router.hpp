@@ -0,0 +1,313 @@
+#pragma once
+
+#include "../http/connection_t.hpp"
+#include "../http/request_generator_t.hpp"
+#include "../../core/http/request.hpp"
+#include "../../core/http/response.hpp"
+#include "../../core/http/types.hpp"
+#include "../../core/type_traits.hpp"
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace malloy::server
+{
+
+    /**
+     * A string literal usable as a template argument.
+     *
+     * @tparam N The size of the string literal (including the null terminator).
+     */
+    template<std::size_t N>
+    struct fixed_string
+    {
+        char data[N] = { };
+
+        consteval
+        fixed_string(const char (&str)[N])
+        {
+            std::copy_n(str, N, data);
+        }
+
+        [[nodiscard]]
+        constexpr
+        std::string_view
+        view() const noexcept
+        {
+            return { data, N - 1 };
+        }
+    };
+
+    namespace detail
+    {
+
+        [[nodiscard]]
+        constexpr
+        bool
+        is_static_param_terminator(const char c) noexcept
+        {
+            return c == '/' || c == '?' || c == '#';
+        }
+
+        /**
+         * Checks whether a route pattern is valid.
+         *
+         * @details Follows the same rules as @ref route_table::to_pattern(): The pattern must start with a slash and
+         *          consist of literal characters and `{param}` segments only.
+         */
+        [[nodiscard]]
+        consteval
+        bool
+        is_valid_static_pattern(std::string_view pattern)
+        {
+            if (!pattern.starts_with('/'))
+                return false;
+
+            for (std::size_t i = 0; i < pattern.size(); i++) {
+                const char c = pattern[i];
+
+                if (c == '}')
+                    return false;
+                if (c != '{')
+                    continue;
+
+                // A parameter must span the entire segment
+                if (pattern[i-1] != '/')
+                    return false;
+
+                const auto end = pattern.find('}', i);
+                if (end == std::string_view::npos || end == i + 1)
+                    return false;
+                for (std::size_t j = i + 1; j < end; j++) {
+                    const char n = pattern[j];
+                    if (!((n >= 'a' && n <= 'z') || (n >= 'A' && n <= 'Z') || (n >= '0' && n <= '9') || n == '_'))
+                        return false;
+                }
+                if (end + 1 < pattern.size() && pattern[end + 1] != '/')
+                    return false;
+
+                i = end;
+            }
+
+            return true;
+        }
+
+        [[nodiscard]]
+        consteval
+        std::size_t
+        static_param_count(const std::string_view pattern)
+        {
+            return static_cast<std::size_t>(std::count(std::cbegin(pattern), std::cend(pattern), '{'));
+        }
+
+        /**
+         * Matches a path against a (valid) route pattern.
+         *
+         * @param pattern The pattern.
+         * @param path The path.
+         * @param params The values of the `{param}` segments (views into the path).
+         * @return Whether the path matches.
+         */
+        template<std::size_t N>
+        [[nodiscard]]
+        constexpr
+        bool
+        match_static_pattern(std::string_view pattern, std::string_view path, std::array<std::string_view, N>& params) noexcept
+        {
+            [[maybe_unused]] std::size_t param = 0;
+            while (!pattern.empty()) {
+                // Parameter
+                if (pattern.front() == '{') {
+                    std::size_t len = 0;
+                    while (len < path.size() && !is_static_param_terminator(path[len]))
+                        len++;
+                    if (len == 0)
+                        return false;
+
+                    if constexpr (N > 0)
+                        params[param++] = path.substr(0, len);
+                    path.remove_prefix(len);
+                    pattern.remove_prefix(pattern.find('}') + 1);
+                    continue;
+                }
+
+                // Literal
+                const auto literal = pattern.substr(0, pattern.find('{'));
+                if (!path.starts_with(literal))
+                    return false;
+                path.remove_prefix(literal.size());
+                pattern.remove_prefix(literal.size());
+            }
+
+            return path.empty();
+        }
+
+    }
+
+    /**
+     * A route whose pattern is known at compile time.
+     *
+     * @details The pattern uses the same syntax as indexed targets of @ref router::add(): Literal characters and
+     *          `{param}` segments. It is validated at compile time and matched without any heap allocation.
+     *
+     *          The handler is invoked with the request and (optionally) a `std::array<std::string_view, N>` holding
+     *          the values of the `{param}` segments. It must return a response or a variant of responses.
+     *
+     * @tparam Method The HTTP method.
+     * @tparam Pattern The route pattern.
+     * @tparam Handler The handler type.
+     *
+     * @sa make_static_route()
+     * @sa static_router
+     */
+    template<malloy::http::method Method, fixed_string Pattern, typename Handler>
+    struct static_route
+    {
+        static_assert(detail::is_valid_static_pattern(Pattern.view()), "invalid static route pattern");
+
+        using request_type = malloy::http::request<>;
+        using params_type = std::array<std::string_view, detail::static_param_count(Pattern.view())>;
+
+        static constexpr malloy::http::method method = Method;
+        static constexpr std::string_view pattern = Pattern.view();
+        static constexpr bool uses_params = std::invocable<const Handler&, const request_type&, const params_type&>;
+
+        static_assert(
+            uses_params || std::invocable<const Handler&, const request_type&>,
+            "static route handler must be invocable with the request and optionally the parameters"
+        );
+
+        Handler handler;
+
+        /**
+         * Checks whether a request matches this route.
+         *
+         * @param m The request method.
+         * @param target The request target.
+         * @param params The values of the `{param}` segments.
+         * @return Whether the request matches.
+         */
+        [[nodiscard]]
+        static
+        constexpr
+        bool
+        matches(const malloy::http::method m, const std::string_view target, params_type& params) noexcept
+        {
+            return m == Method && detail::match_static_pattern(pattern, target, params);
+        }
+    };
+
+    /**
+     * Creates a static route.
+     *
+     * Example: `make_static_route<method::get, "/users/{id}">([](const auto& req, const auto& params) { ... })`
+     *
+     * @tparam Method The HTTP method.
+     * @tparam Pattern The route pattern.
+     * @param handler The handler.
+     * @return The route.
+     */
+    template<malloy::http::method Method, fixed_string Pattern, typename Handler>
+    [[nodiscard]]
+    constexpr
+    auto
+    make_static_route(Handler&& handler)
+    {
+        return static_route<Method, Pattern, std::decay_t<Handler>>{ std::forward<Handler>(handler) };
+    }
+
+    /**
+     * A router for a fixed set of routes known at compile time.
+     *
+     * @details Dispatching is a fold over the routes: Every route is matched by its compile-time pattern and the
+     *          handler is called directly. There is neither type erasure nor any heap allocation involved. Routes
+     *          are checked in the order in which they were supplied.
+     *
+     *          A static router is mounted on a regular router via @ref router::add_static().
+     *
+     * @tparam Routes The routes. Must be instances of @ref static_route.
+     */
+    template<typename... Routes>
+    class static_router
+    {
+    public:
+        constexpr
+        explicit
+        static_router(Routes... routes) :
+            m_routes{ std::move(routes)... }
+        {
+        }
+
+        /**
+         * Handles a request if any of the routes matches.
+         *
+         * @param gens The request generator.
+         * @param conn The connection.
+         * @param writer Invoked with the request header, the response and the connection to send the response.
+         * @return Whether a route matched the request.
+         */
+        template<typename Writer>
+        bool
+        handle(const http::request_generator_t& gens, const http::connection_t& conn, const Writer& writer) const
+        {
+            return std::visit(
+                [&](const auto& gen) {
+                    return std::apply(
+                        [&](const auto&... routes) {
+                            return (try_route(routes, gen, conn, writer) || ...);
+                        },
+                        m_routes
+                    );
+                },
+                gens
+            );
+        }
+
+    private:
+        std::tuple<Routes...> m_routes;
+
+        template<typename Route, typename Generator, typename Writer>
+        static
+        bool
+        try_route(const Route& route, const Generator& gen, const http::connection_t& conn, const Writer& writer)
+        {
+            typename Route::params_type params;
+            if (!Route::matches(gen->header().method(), gen->header().target(), params))
+                return false;
+
+            // The route outlives the request. The parameters are views into the header of the generator which outlives the
+            // body callback.
+            gen->template body<typename Route::request_type::body_type>(
+                [&route, params, conn, writer](const auto& req) {
+                    auto resp = [&] {
+                        if constexpr (Route::uses_params)
+                            return route.handler(req, params);
+                        else
+                            return route.handler(req);
+                    }();
+
+                    if constexpr (malloy::concepts::is_variant<decltype(resp)>) {
+                        std::visit(
+                            [&](auto&& r) {
+                                writer(req, std::move(r), conn);
+                            },
+                            std::move(resp)
+                        );
+                    }
+                    else
+                        writer(req, std::move(resp), conn);
+                }
+            );
+
+            return true;
+        }
+    };
+
+}
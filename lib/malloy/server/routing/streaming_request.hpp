@@ -0,0 +1,166 @@
+#pragma once
+
+#include "route_captures.hpp"
+#include "../http/chunked_response.hpp"
+#include "../../core/error.hpp"
+#include "../../core/http/response.hpp"
+
+#include <boost/asio/async_result.hpp>
+#include <boost/beast/http/message.hpp>
+
+#include <functional>
+#include <memory>
+#include <stop_token>
+#include <string_view>
+#include <utility>
+
+namespace malloy::server
+{
+
+    /**
+     * A request whose body is read in chunks by the route handler.
+     *
+     * @details The body is read on demand through @ref read_some(): Nothing is read from the connection until the
+     *          handler asks for the next chunk. The handler finally sends the response through @ref respond() or
+     *          streams it through @ref respond_chunked().
+     *
+     *          Copies refer to the same request.
+     *
+     * @sa router::add_streaming()
+     */
+    class streaming_request
+    {
+    public:
+        using header_type = boost::beast::http::request_header<>;
+        using response_type = malloy::http::response<>;
+        using read_handler_t = std::function<void(malloy::error_code, std::string_view)>;
+        using chunked_header_type = http::chunked_response::header_type;
+
+        /**
+         * Constructor.
+         *
+         * @note This is used by the router.
+         *
+         * @param header The request header.
+         * @param captures The captures of the route. These are views into the header.
+         * @param read Reads the next chunk of the body.
+         * @param respond Sends the response.
+         * @param respond_chunked Starts a chunked response.
+         * @param stop The stop token of the request.
+         */
+        streaming_request(
+            std::shared_ptr<const header_type> header,
+            route_captures captures,
+            std::function<void(read_handler_t)> read,
+            std::function<void(response_type&&)> respond,
+            std::function<std::shared_ptr<http::chunked_response>(chunked_header_type&&)> respond_chunked,
+            std::stop_token stop = { }
+        ) :
+            m_header{ std::move(header) },
+            m_captures{ std::move(captures) },
+            m_stop{ std::move(stop) },
+            m_read{ std::move(read) },
+            m_respond{ std::move(respond) },
+            m_respond_chunked{ std::move(respond_chunked) }
+        {
+        }
+
+        /**
+         * Gets the request header.
+         *
+         * @return The request header.
+         */
+        [[nodiscard]]
+        const header_type&
+        header() const noexcept
+        {
+            return *m_header;
+        }
+
+        /**
+         * Gets the captures of the route.
+         *
+         * @return The captures.
+         */
+        [[nodiscard]]
+        const route_captures&
+        captures() const noexcept
+        {
+            return m_captures;
+        }
+
+        /**
+         * Gets the stop token of the request.
+         *
+         * @details Stop is requested once the client disconnected while the request is outstanding. Work performed
+         *          on behalf of the request may then be abandoned.
+         *
+         * @return The stop token.
+         */
+        [[nodiscard]]
+        std::stop_token
+        stop_token() const noexcept
+        {
+            return m_stop;
+        }
+
+        /**
+         * Reads the next chunk of the body.
+         *
+         * @details The chunk remains valid until the next call. An empty chunk signals the end of the body.
+         *
+         * @param token The completion token (e.g. a callback or `boost::asio::use_awaitable`). The completion
+         *              signature is `void(malloy::error_code, std::string_view)`.
+         */
+        template<boost::asio::completion_token_for<void(malloy::error_code, std::string_view)> CompletionToken>
+        auto
+        read_some(CompletionToken&& token) const
+        {
+            return boost::asio::async_initiate<CompletionToken, void(malloy::error_code, std::string_view)>(
+                [read = m_read](auto handler) {
+                    // Completion handlers might be move-only
+                    auto h = std::make_shared<decltype(handler)>(std::move(handler));
+                    read([h](malloy::error_code ec, std::string_view chunk) {
+                        std::move(*h)(ec, chunk);
+                    });
+                },
+                token
+            );
+        }
+
+        /**
+         * Sends the response.
+         *
+         * @param resp The response.
+         */
+        void
+        respond(response_type&& resp) const
+        {
+            m_respond(std::move(resp));
+        }
+
+        /**
+         * Starts a chunked response.
+         *
+         * @details The body is written through the returned writer.
+         *
+         * @param header The response header.
+         * @return The writer.
+         */
+        [[nodiscard]]
+        std::shared_ptr<http::chunked_response>
+        respond_chunked(chunked_header_type header) const
+        {
+            return m_respond_chunked(std::move(header));
+        }
+
+    private:
+        std::shared_ptr<const header_type> m_header;
+        route_captures m_captures;
+        std::stop_token m_stop;
+        std::function<void(read_handler_t)> m_read;
+        std::function<void(response_type&&)> m_respond;
+        std::function<std::shared_ptr<http::chunked_response>(chunked_header_type&&)> m_respond_chunked;
+    };
+
+}
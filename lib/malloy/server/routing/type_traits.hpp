@@ -3,16 +3,43 @@
 #include <concepts> 
 #include <variant>
 
+#include "route_captures.hpp"
+#include "../../core/awaitable.hpp"
 #include "../../core/type_traits.hpp"
+#include "../../core/http/canned_response.hpp"
+
+#include <memory>
 
 namespace malloy::server::concepts
 {
     namespace detail
     {
+        /**
+         * Unwraps the result of an awaitable.
+         */
         template<typename T>
-        concept route_handler_retr =
+        struct awaitable_result
+        {
+            using type = T;
+            static constexpr bool value = false;
+        };
+
+        template<typename T, typename Executor>
+        struct awaitable_result<boost::asio::awaitable<T, Executor>>
+        {
+            using type = T;
+            static constexpr bool value = true;
+        };
+
+        template<typename T>
+        concept route_handler_sync_retr =
             malloy::concepts::is_container_of<T, malloy::http::response, std::variant> ||
-            malloy::concepts::is<T, malloy::http::response>;
+            malloy::concepts::is<T, malloy::http::response> ||
+            std::same_as<T, std::shared_ptr<const malloy::http::canned_response>>;
+
+        template<typename T>
+        concept route_handler_retr =
+            route_handler_sync_retr<typename awaitable_result<T>::type>;
 
         template<typename Func, typename... Args>
         concept route_handler_helper =
@@ -25,6 +52,7 @@ namespace malloy::server::concepts
     template<typename F, typename Req>
     concept route_handler =
         detail::route_handler_helper<F, const Req&> ||
+        detail::route_handler_helper<F, const Req&, const route_captures&> ||
         detail::route_handler_helper<F, const Req&, const std::vector<std::string>>;
 
     template<typename Func>
@@ -49,12 +77,26 @@ namespace malloy::server::concepts
  * @page route_concepts Route concepts 
  * @section route_handler 
  * @par A callback type for router::add. Requires either f(r) or f(r, v) where f is
- * the (non-const) type, r is a malloy::http::request<T> and v is
- * std::vector<std::string> holding the capture results of the regex expression.
+ * the (non-const) type, r is a malloy::http::request<T> and v is either
+ * malloy::server::route_captures or std::vector<std::string> holding the capture
+ * results of the regex expression.
+ *
+ * @par route_captures is preferred: The captures are views into the request target
+ * obtained while matching the route. The regex is therefore evaluated only once
+ * and no strings are allocated.
  * 
  * @par If the capture group parameter is omitted the matches will not be
  * extracted from the input regex.
  *
+ * @par Instead of a response, a handler may return a
+ * `std::shared_ptr<const malloy::http::canned_response>` (a response which was
+ * serialized up front) to send a constant response without any per-request
+ * processing.
+ *
+ * @par A handler may also be a coroutine returning `malloy::awaitable<R>` where
+ * R is any of the above. Such handlers are spawned on the strand of the
+ * connection, hence they don't block an I/O thread while suspended.
+ *
  * @section request_filter 
  * @par A filter type for processing requests before they are passed onto the
  * handler. Must satisfy std::move_constructible and the expression:
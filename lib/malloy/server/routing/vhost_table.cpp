@@ -0,0 +1,101 @@
+#include "vhost_table.hpp"
+#include "router.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+using namespace malloy::server;
+
+namespace
+{
+
+    constexpr std::size_t max_host_length = 253;
+
+    /**
+     * Normalizes a host name (lower case, no port, no trailing dot).
+     *
+     * @return The normalized host name (a view into the buffer) or an empty string if the host name is invalid.
+     */
+    [[nodiscard]]
+    std::string_view
+    normalize(std::string_view host, std::array<char, max_host_length>& buffer)
+    {
+        // Port (an IPv6 address is enclosed in brackets)
+        const std::size_t end = host.starts_with('[') ? host.find(']') : host.find(':');
+        if (end != std::string_view::npos)
+            host = host.substr(0, host.starts_with('[') ? end + 1 : end);
+
+        if (host.ends_with('.'))
+            host.remove_suffix(1);
+
+        if (host.size() > buffer.size())
+            return { };
+
+        std::transform(std::cbegin(host), std::cend(host), std::begin(buffer), [](const unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+
+        return { buffer.data(), host.size() };
+    }
+
+    /**
+     * The router of a virtual host together with the server string it refers to.
+     */
+    struct vhost
+    {
+        std::string server_str;
+        router r;
+    };
+
+}
+
+std::shared_ptr<router>
+vhost_table::add(std::string_view host, std::shared_ptr<spdlog::logger> logger, std::string server_str)
+{
+    // Wildcard
+    const bool wildcard = host.starts_with("*.");
+    if (wildcard)
+        host.remove_prefix(2);
+
+    std::array<char, max_host_length> buffer;
+    const std::string_view name = normalize(host, buffer);
+    if (name.empty())
+        return nullptr;
+
+    map_t& map = wildcard ? m_wildcards : m_exact;
+    if (map.contains(name))
+        return nullptr;
+
+    // Keep the server string alive for as long as the router is
+    auto v = std::make_shared<vhost>(std::move(server_str), router{std::move(logger)});
+    v->r.set_server_string(v->server_str);
+    std::shared_ptr<router> r{v, &v->r};
+
+    map.emplace(name, r);
+
+    return r;
+}
+
+std::shared_ptr<router>
+vhost_table::find(const std::string_view host) const
+{
+    std::array<char, max_host_length> buffer;
+    const std::string_view name = normalize(host, buffer);
+    if (name.empty())
+        return nullptr;
+
+    // Exact
+    if (const auto it = m_exact.find(name); it != std::end(m_exact))
+        return it->second;
+
+    // Wildcards (most specific first)
+    if (m_wildcards.empty())
+        return nullptr;
+    for (std::size_t pos = name.find('.'); pos != std::string_view::npos; pos = name.find('.', pos + 1)) {
+        if (const auto it = m_wildcards.find(name.substr(pos + 1)); it != std::end(m_wildcards))
+            return it->second;
+    }
+
+    return nullptr;
+}
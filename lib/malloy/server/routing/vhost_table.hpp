@@ -0,0 +1,87 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace spdlog
+{
+    class logger;
+}
+
+namespace malloy::server
+{
+    class router;
+
+    /**
+     * Routers of virtual hosts.
+     *
+     * @details Requests are dispatched by their `Host` header. A host is either an exact name (e.g. `example.com`)
+     *          or a wildcard (e.g. `*.example.com`) matching any subdomain. Exact names take precedence, the most
+     *          specific wildcard wins otherwise. Host names are matched case-insensitively and without port.
+     *
+     *          Every virtual host has its own router (and hence its own routes, policies, file serving locations
+     *          and server string).
+     *
+     * @note The table must not be modified after it was published.
+     *
+     * @sa router_handle
+     */
+    class vhost_table
+    {
+    public:
+        /**
+         * Adds a virtual host.
+         *
+         * @param host The host name (or wildcard).
+         * @param logger The logger of the router.
+         * @param server_str The server string of the router.
+         * @return The router of the virtual host or `nullptr` if the host name is invalid or was added before.
+         */
+        std::shared_ptr<router>
+        add(std::string_view host, std::shared_ptr<spdlog::logger> logger, std::string server_str);
+
+        /**
+         * Finds the router of a host.
+         *
+         * @param host The value of the `Host` header.
+         * @return The router (if any).
+         */
+        [[nodiscard]]
+        std::shared_ptr<router>
+        find(std::string_view host) const;
+
+        /**
+         * Gets the number of virtual hosts.
+         *
+         * @return The number of virtual hosts.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const noexcept
+        {
+            return m_exact.size() + m_wildcards.size();
+        }
+
+    private:
+        struct key_hash
+        {
+            using is_transparent = void;
+
+            [[nodiscard]]
+            std::size_t
+            operator()(std::string_view str) const noexcept
+            {
+                return std::hash<std::string_view>{}(str);
+            }
+        };
+
+        using map_t = std::unordered_map<std::string, std::shared_ptr<router>, key_hash, std::equal_to<>>;
+
+        map_t m_exact;          // Host name -> router
+        map_t m_wildcards;      // Domain (without the leading "*.") -> router
+    };
+
+}
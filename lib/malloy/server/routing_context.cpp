@@ -14,7 +14,9 @@ using namespace malloy::server;
 
 routing_context::routing_context(config cfg) :
     m_cfg{std::move(cfg)},
-    m_router{m_cfg.logger != nullptr ? m_cfg.logger->clone("router") : nullptr, m_cfg.agent_string}
+    m_router_handle{std::make_shared<malloy::server::router_handle>(m_cfg.agent_string)},
+    m_router{new malloy::server::router{m_cfg.logger != nullptr ? m_cfg.logger->clone("router") : nullptr, m_router_handle->server_string()}},
+    m_vhosts{std::make_shared<vhost_table>()}
 {
     m_cfg.validate();
 
@@ -23,6 +25,30 @@ routing_context::routing_context(config cfg) :
         m_cfg.connection_logger = spdlog::null_logger_mt("connection");
 }
 
+std::shared_ptr<malloy::server::router>
+routing_context::add_vhost(const std::string_view host, std::string server_str)
+{
+    // The virtual hosts were published by start()
+    if (!m_vhosts) {
+        if (m_cfg.logger)
+            m_cfg.logger->error("could not add virtual host \"{}\": virtual hosts must be added before start().", host);
+        return nullptr;
+    }
+
+    if (server_str.empty())
+        server_str = m_cfg.agent_string;
+
+    auto r = m_vhosts->add(
+        host,
+        m_cfg.logger != nullptr ? m_cfg.logger->clone("router | " + std::string{host}) : nullptr,
+        std::move(server_str)
+    );
+    if (!r && m_cfg.logger)
+        m_cfg.logger->error("could not add virtual host \"{}\".", host);
+
+    return r;
+}
+
 #if MALLOY_FEATURE_TLS
     bool
     routing_context::init_tls(
@@ -4,6 +4,8 @@
 #include "../core/detail/controller_run_result.hpp"
 #include "../server/listener.hpp"
 #include "../server/routing/router.hpp"
+#include "../server/routing/router_handle.hpp"
+#include "../server/routing/vhost_table.hpp"
 
 #include <memory>
 #include <filesystem>
@@ -65,6 +67,27 @@ namespace malloy::server
              * @details Set as the Server field in http headers
              */
             std::string agent_string{"malloy"};
+
+            /**
+             * The maximum number of requests per connection whose responses are queued for writing.
+             *
+             * @details Requests (without a body) are read while the responses to earlier requests are still being
+             *          written (HTTP/1.1 pipelining). Reading pauses once this many responses are queued.
+             *
+             * @note Requests are still handled one at a time (in order): The next request is read once the response to
+             *       the current one was queued. Only writing the responses overlaps with handling later requests.
+             */
+            std::size_t pipeline_limit = 16;
+
+            /**
+             * Whether a client shutting down its side of the connection while a request is outstanding is taken as a
+             * disconnect (i.e. the work performed on behalf of the request is cancelled).
+             *
+             * @details A half-closed connection can't be told apart from a closed one without writing to it. Disable
+             *          this for clients which half-close after sending their request: Work is then only cancelled if
+             *          the connection was reset.
+             */
+            bool cancel_on_half_close = true;
         };
 
         explicit routing_context(config cfg);
@@ -107,11 +130,10 @@ namespace malloy::server
          * @return The top-level router.
          */
         [[nodiscard]]
-        constexpr
         const malloy::server::router&
         router() const noexcept
         {
-            return m_router;
+            return *m_router;
         }
 
         /**
@@ -120,16 +142,48 @@ namespace malloy::server
          * @return The top-level router.
          */
         [[nodiscard]]
-        constexpr
         malloy::server::router&
         router() noexcept
         {
-            return m_router;
+            return *m_router;
+        }
+
+        /**
+         * Add a virtual host.
+         *
+         * @details Requests whose `Host` header matches the host are handled by the router of the virtual host
+         *          instead of the top-level router. The host is either an exact name (e.g. `example.com`) or a
+         *          wildcard (e.g. `*.example.com`).
+         *
+         * @note Virtual hosts must be added before `start()`.
+         *
+         * @param host The host name (or wildcard).
+         * @param server_str The server string of the virtual host. The agent string is used if empty.
+         * @return The router of the virtual host or `nullptr` if the host name is invalid, was added before or the
+         *         server was started already.
+         */
+        std::shared_ptr<malloy::server::router>
+        add_vhost(std::string_view host, std::string server_str = { });
+
+        /**
+         * Get the handle through which the top-level router can be replaced once the server is running.
+         *
+         * @details The router returned by `router()` is published through this handle by `start()`.
+         *
+         * @return The router handle.
+         */
+        [[nodiscard]]
+        std::shared_ptr<malloy::server::router_handle>
+        router_handle() const noexcept
+        {
+            return m_router_handle;
         }
 
     private:
         config m_cfg;
-        malloy::server::router m_router;
+        std::shared_ptr<malloy::server::router_handle> m_router_handle;
+        std::shared_ptr<malloy::server::router> m_router;      // Published by start() (endpoints refer to it, it is never moved)
+        std::shared_ptr<vhost_table> m_vhosts;                  // Null once started
         #if MALLOY_FEATURE_TLS
             std::unique_ptr<boost::asio::ssl::context> m_tls_ctx;
         #endif
@@ -143,6 +197,12 @@ namespace malloy::server
             ctrl.m_cfg.logger->debug("starting server.");
             auto ioc = std::make_unique<boost::asio::io_context>();
 
+            // Publish the router
+            ctrl.m_router_handle->publish(ctrl.m_router);
+            if (ctrl.m_vhosts->size() > 0)
+                ctrl.m_router_handle->publish_vhosts(std::move(ctrl.m_vhosts));
+            ctrl.m_vhosts.reset();      // Marks the context as started
+
             // Create the listener
             auto l = std::make_shared<malloy::server::listener>(
                 ctrl.m_cfg.logger->clone("listener"),
@@ -154,9 +214,11 @@ namespace malloy::server
                 nullptr,
 #endif
                 boost::asio::ip::tcp::endpoint{boost::asio::ip::make_address(ctrl.m_cfg.interface), ctrl.m_cfg.port},
-                std::make_shared<class router>(std::move(ctrl.m_router)),
+                ctrl.m_router_handle,
                 std::make_shared<std::filesystem::path>(ctrl.m_cfg.doc_root),
-                ctrl.m_cfg.agent_string);
+                ctrl.m_cfg.agent_string,
+                ctrl.m_cfg.pipeline_limit,
+                ctrl.m_cfg.cancel_on_half_close);
 
             // Run the listener
             l->run();
@@ -0,0 +1,93 @@
+#include "channel.hpp"
+
+#include <algorithm>
+
+using namespace malloy::server::sse;
+
+channel::channel(const std::size_t history) :
+    m_state{std::make_shared<state>()},
+    m_history_size{history}
+{
+}
+
+void
+channel::subscribe(std::shared_ptr<stream> s)
+{
+    if (!s)
+        return;
+
+    // Resume after the last event the client received
+    std::vector<std::shared_ptr<const std::string>> missed;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_state->lock);
+
+        if (!s->last_event_id().empty()) {
+            const auto it = std::find_if(std::cbegin(m_state->history), std::cend(m_state->history), [&s](const auto& e) {
+                return e.first == s->last_event_id();
+            });
+            if (it != std::cend(m_state->history)) {
+                for (auto e = std::next(it); e != std::cend(m_state->history); ++e)
+                    missed.emplace_back(e->second);
+            }
+        }
+
+        m_state->subscribers.emplace_back(s);
+    }
+
+    for (auto& ev : missed)
+        s->send(std::move(ev));
+
+    // Unsubscribe once closed (right away if closed already)
+    s->on_close([weak_state = std::weak_ptr{m_state}, ptr = s.get()] {
+        const auto st = weak_state.lock();
+        if (!st)
+            return;
+
+        // Acquire mutex
+        std::lock_guard lock(st->lock);
+
+        std::erase_if(st->subscribers, [ptr](const auto& sub) {
+            return sub.get() == ptr;
+        });
+    });
+}
+
+std::size_t
+channel::publish(const event& ev)
+{
+    // Serialize once for all subscribers
+    const auto data = ev.serialize();
+
+    std::vector<std::shared_ptr<stream>> subscribers;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_state->lock);
+
+        if (m_history_size > 0 && !ev.id.empty()) {
+            if (m_state->history.size() == m_history_size)
+                m_state->history.pop_front();
+            m_state->history.emplace_back(ev.id, data);
+        }
+
+        subscribers = m_state->subscribers;
+    }
+
+    // Sending may close a stream (which then unsubscribes)
+    std::size_t count = 0;
+    for (const auto& s : subscribers) {
+        if (s->send(data))
+            count++;
+    }
+
+    return count;
+}
+
+std::size_t
+channel::size() const
+{
+    // Acquire mutex
+    std::lock_guard lock(m_state->lock);
+
+    return m_state->subscribers.size();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "event.hpp"
+#include "stream.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace malloy::server::sse
+{
+
+    /**
+     * A Server-Sent Events channel.
+     *
+     * @details Events published to a channel are serialized once and the same buffer is written to every
+     *          subscribed stream. Streams are unsubscribed once they are closed.
+     *
+     *          The channel remembers the most recent events carrying an ID. A stream resuming after one of those
+     *          (i.e. whose client sent `Last-Event-ID`) is sent the events it missed when subscribing.
+     *
+     *          The channel is thread-safe. Events are sent without holding the channel's lock, hence the order in
+     *          which events published concurrently (or while a stream subscribes) reach a stream is unspecified.
+     */
+    class channel
+    {
+    public:
+        /**
+         * Constructor.
+         *
+         * @param history The number of events to remember for resuming streams.
+         */
+        explicit
+        channel(std::size_t history = 0);
+
+        channel(const channel& other) = delete;
+        channel(channel&& other) noexcept = delete;
+        ~channel() = default;
+
+        channel& operator=(const channel& rhs) = delete;
+        channel& operator=(channel&& rhs) noexcept = delete;
+
+        /**
+         * Subscribes a stream.
+         *
+         * @param s The stream.
+         */
+        void
+        subscribe(std::shared_ptr<stream> s);
+
+        /**
+         * Publishes an event to all subscribers.
+         *
+         * @param ev The event.
+         * @return The number of subscribers the event was queued for.
+         */
+        std::size_t
+        publish(const event& ev);
+
+        /**
+         * Gets the number of subscribers.
+         *
+         * @return The number of subscribers.
+         */
+        [[nodiscard]]
+        std::size_t
+        size() const;
+
+    private:
+        /**
+         * The state shared with the close handlers of the subscribed streams (which may outlive the channel).
+         */
+        struct state
+        {
+            std::mutex lock;                    // protects everything below
+            std::vector<std::shared_ptr<stream>> subscribers;
+            std::deque<std::pair<std::string, std::shared_ptr<const std::string>>> history;     // ID -> serialized event
+        };
+
+        std::shared_ptr<state> m_state;
+        std::size_t m_history_size;
+    };
+
+}
@@ -0,0 +1,59 @@
+#include "event.hpp"
+
+#include <string_view>
+
+using namespace malloy::server::sse;
+
+namespace
+{
+
+    /**
+     * Appends a field (truncated at the first line break).
+     */
+    void
+    append_field(std::string& out, const std::string_view name, const std::string_view value)
+    {
+        out += name;
+        out += ": ";
+        out += value.substr(0, value.find_first_of("\r\n"));
+        out += '\n';
+    }
+
+}
+
+std::shared_ptr<const std::string>
+event::serialize() const
+{
+    std::string out;
+    out.reserve(data.size() + type.size() + id.size() + comment.size() + 64);
+
+    if (!comment.empty())
+        append_field(out, "", comment);
+    if (!type.empty())
+        append_field(out, "event", type);
+    if (!id.empty())
+        append_field(out, "id", id);
+    if (retry)
+        append_field(out, "retry", std::to_string(retry->count()));
+
+    // Every line of the payload is a data field
+    if (!data.empty()) {
+        std::string_view rest{ data };
+        for (;;) {
+            const auto pos = rest.find('\n');
+            auto line = rest.substr(0, pos);
+            if (line.ends_with('\r'))
+                line.remove_suffix(1);
+
+            append_field(out, "data", line);
+            if (pos == std::string_view::npos)
+                break;
+            rest.remove_prefix(pos + 1);
+        }
+    }
+
+    // An empty line dispatches the event
+    out += '\n';
+
+    return std::make_shared<const std::string>(std::move(out));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace malloy::server::sse
+{
+
+    /**
+     * A Server-Sent Event.
+     *
+     * @details Empty fields are omitted. Line breaks in the data are sent as multiple `data` lines, line breaks in
+     *          any other field truncate it.
+     */
+    struct event
+    {
+        std::string data;                                   ///< The payload.
+        std::string type;                                   ///< The event type (`event` field).
+        std::string id;                                     ///< The event ID (`id` field). Used to resume streams.
+        std::optional<std::chrono::milliseconds> retry;     ///< The reconnection time to advise the client of.
+        std::string comment;                                ///< A comment (e.g. to keep idle connections alive).
+
+        /**
+         * Serializes the event.
+         *
+         * @return The wire representation.
+         */
+        [[nodiscard]]
+        std::shared_ptr<const std::string>
+        serialize() const;
+    };
+
+}
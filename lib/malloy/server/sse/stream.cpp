@@ -0,0 +1,164 @@
+#include "stream.hpp"
+#include "../http/connection_plain.hpp"
+#if MALLOY_FEATURE_TLS
+    #include "../http/connection_tls.hpp"
+#endif
+
+#include <boost/asio/dispatch.hpp>
+
+#include <sstream>
+
+using namespace malloy::server::sse;
+
+std::shared_ptr<stream>
+stream::make(http::connection_t conn, const malloy::http::request_header<>& req, const std::string_view server_str, policy pol)
+{
+    // The stream stays open for as long as the client wishes
+    std::visit(
+        [](const auto& c) {
+            auto& socket = boost::beast::get_lowest_layer(c->stream());
+            boost::asio::dispatch(socket.get_executor(), [c] {
+                boost::beast::get_lowest_layer(c->stream()).expires_never();
+            });
+        },
+        conn
+    );
+
+    auto s = std::make_shared<stream>(token{ }, std::move(conn), req, pol);
+
+    // Send the header. The body ends when the connection is closed.
+    malloy::http::response<>::header_type header;
+    header.result(malloy::http::status::ok);
+    header.version(req.version());
+    header.set(malloy::http::field::server, server_str);
+    header.set(malloy::http::field::content_type, "text/event-stream");
+    header.set(malloy::http::field::cache_control, "no-cache");
+    header.set(malloy::http::field::connection, "close");
+
+    std::ostringstream ss;
+    ss << header;
+    s->write(std::make_shared<const std::string>(std::move(ss).str()), false);
+
+    return s;
+}
+
+stream::stream(token, http::connection_t conn, const malloy::http::request_header<>& req, policy pol) :
+    m_conn{ std::move(conn) },
+    m_last_event_id{ req["Last-Event-ID"] },
+    m_policy{ pol }
+{
+}
+
+bool
+stream::send(const event& ev)
+{
+    return send(ev.serialize());
+}
+
+bool
+stream::send(std::shared_ptr<const std::string> ev)
+{
+    if (!m_open)
+        return false;
+
+    // The client can't keep up
+    if (m_pending >= m_policy.max_pending) {
+        m_dropped++;
+        if (m_policy.on_overflow == overflow_policy::disconnect)
+            abort();
+        return false;
+    }
+
+    write(std::move(ev), false);
+
+    return true;
+}
+
+void
+stream::close()
+{
+    if (set_closed())
+        write(std::make_shared<const std::string>(), true);
+}
+
+void
+stream::on_close(close_handler_t handler)
+{
+    if (!handler)
+        return;
+
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_close_handlers_lock);
+
+        if (m_open) {
+            m_close_handlers.emplace_back(std::move(handler));
+            return;
+        }
+    }
+
+    handler();
+}
+
+bool
+stream::set_closed()
+{
+    if (!m_open.exchange(false))
+        return false;
+
+    std::vector<close_handler_t> handlers;
+    {
+        // Acquire mutex
+        std::lock_guard lock(m_close_handlers_lock);
+
+        handlers = std::move(m_close_handlers);
+    }
+
+    for (const auto& handler : handlers)
+        handler();
+
+    return true;
+}
+
+void
+stream::write(std::shared_ptr<const std::string> data, const bool last)
+{
+    http::response_part part;
+    part.buffers = { boost::asio::buffer(*data) };
+    part.storage = std::move(data);
+    part.status = static_cast<unsigned>(malloy::http::status::ok);
+    part.last = last;
+    part.close = last;
+    if (!last) {
+        m_pending++;
+        part.written = [self = shared_from_this()](const malloy::error_code ec) {
+            self->m_pending--;
+            if (ec)
+                self->set_closed();
+        };
+    }
+
+    std::visit(
+        [&part](const auto& c) {
+            c->do_write_part(std::move(part));
+        },
+        m_conn
+    );
+}
+
+void
+stream::abort()
+{
+    set_closed();
+
+    // Closing the socket cancels the queued writes
+    std::visit(
+        [](const auto& c) {
+            auto& socket = boost::beast::get_lowest_layer(c->stream());
+            boost::asio::dispatch(socket.get_executor(), [c] {
+                boost::beast::get_lowest_layer(c->stream()).close();
+            });
+        },
+        m_conn
+    );
+}
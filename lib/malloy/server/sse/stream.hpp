@@ -0,0 +1,186 @@
+#pragma once
+
+#include "event.hpp"
+#include "../http/connection_t.hpp"
+#include "../../core/http/request.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace malloy::server::sse
+{
+
+    /**
+     * A Server-Sent Events stream to a single client.
+     *
+     * @details The stream takes over the HTTP connection it was created on: The response header is sent right away
+     *          and events are written as they are sent until the stream is closed.
+     *
+     *          Every stream bounds the number of events queued for writing. Events sent to a stream which reached
+     *          that bound are handled according to its overflow policy.
+     *
+     *          Streams are thread-safe.
+     *
+     * @sa channel
+     */
+    class stream :
+        public std::enable_shared_from_this<stream>
+    {
+        struct token { };
+
+    public:
+        using handler_t = std::function<void(const malloy::http::request<>&, const std::shared_ptr<stream>&)>;
+        using close_handler_t = std::function<void()>;
+
+        /**
+         * What to do with events sent to a stream which can't keep up.
+         */
+        enum class overflow_policy
+        {
+            drop,           ///< Drop the event.
+            disconnect,     ///< Disconnect the client (which may then resume the stream).
+        };
+
+        /**
+         * Stream policy.
+         */
+        struct policy
+        {
+            std::size_t max_pending = 64;                       ///< The maximum number of events queued for writing.
+            overflow_policy on_overflow = overflow_policy::drop;
+        };
+
+        /**
+         * Creates a stream.
+         *
+         * @param conn The connection.
+         * @param req The request to which we're responding.
+         * @param server_str The server string.
+         * @param pol The policy.
+         * @return The stream.
+         */
+        [[nodiscard]]
+        static
+        std::shared_ptr<stream>
+        make(http::connection_t conn, const malloy::http::request_header<>& req, std::string_view server_str, policy pol);
+
+        /**
+         * Constructor.
+         *
+         * @note Use @ref make() instead.
+         */
+        stream(token, http::connection_t conn, const malloy::http::request_header<>& req, policy pol);
+
+        /**
+         * Gets the ID of the last event the client received before reconnecting (`Last-Event-ID`).
+         *
+         * @return The event ID (empty if none).
+         */
+        [[nodiscard]]
+        const std::string&
+        last_event_id() const noexcept
+        {
+            return m_last_event_id;
+        }
+
+        /**
+         * Sends an event.
+         *
+         * @param ev The event.
+         * @return Whether the event was queued for writing.
+         */
+        bool
+        send(const event& ev);
+
+        /**
+         * Sends a serialized event.
+         *
+         * @details This allows sending the same buffer to many streams.
+         *
+         * @param ev The serialized event.
+         * @return Whether the event was queued for writing.
+         */
+        bool
+        send(std::shared_ptr<const std::string> ev);
+
+        /**
+         * Closes the stream once the queued events were written.
+         */
+        void
+        close();
+
+        /**
+         * Registers a handler invoked once the stream is closed.
+         *
+         * @details The stream is closed by @ref close(), by the client disconnecting or by the overflow policy. The
+         *          handler is invoked right away if the stream is closed already.
+         *
+         * @note The handler must not keep the stream alive.
+         *
+         * @param handler The handler.
+         */
+        void
+        on_close(close_handler_t handler);
+
+        /**
+         * Checks whether the stream is open.
+         *
+         * @return Whether the stream is open.
+         */
+        [[nodiscard]]
+        bool
+        is_open() const noexcept
+        {
+            return m_open;
+        }
+
+        /**
+         * Gets the number of events dropped so far.
+         *
+         * @return The number of dropped events.
+         */
+        [[nodiscard]]
+        std::size_t
+        dropped() const noexcept
+        {
+            return m_dropped;
+        }
+
+    private:
+        http::connection_t m_conn;
+        std::string m_last_event_id;
+        policy m_policy;
+        std::atomic<bool> m_open = true;
+        std::atomic<std::size_t> m_pending = 0;
+        std::atomic<std::size_t> m_dropped = 0;
+        std::mutex m_close_handlers_lock;       // protects m_close_handlers
+        std::vector<close_handler_t> m_close_handlers;
+
+        /**
+         * Marks the stream as closed and invokes the close handlers.
+         *
+         * @return Whether the stream was open.
+         */
+        bool
+        set_closed();
+
+        /**
+         * Queues a write.
+         */
+        void
+        write(std::shared_ptr<const std::string> data, bool last);
+
+        /**
+         * Closes the connection right away.
+         */
+        void
+        abort();
+    };
+
+}
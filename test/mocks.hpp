@@ -1,7 +1,19 @@
 #pragma once
 
+#include <malloy/core/error.hpp>
 #include <malloy/core/http/request.hpp>
 
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+
+#include <concepts>
+#include <filesystem>
+#include <fstream>
+#include <stop_token>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
 namespace malloy::mock::http
 {
 
@@ -21,6 +33,23 @@ namespace malloy::mock::http
                 return header_;
             }
 
+            std::stop_token stop_token() const
+            {
+                return {};
+            }
+
+            boost::asio::cancellation_slot cancellation_slot()
+            {
+                return {};
+            }
+
+            void retain(std::shared_ptr<const void> obj)
+            {
+                retained.emplace_back(std::move(obj));
+            }
+
+            std::vector<std::shared_ptr<const void>> retained;
+
             template<typename Body, std::invocable<malloy::http::request<Body>&&> Callback, typename Setup>
             void body(Callback&& done, Setup&& s)
             {
@@ -36,7 +65,63 @@ namespace malloy::mock::http
                 malloy::http::request<Body> req{boost::beast::http::request<Body>{header_}};
                 done(std::move(req));
             }
+
+            template<typename Body, typename CompletionToken, typename Setup>
+                requires (!std::invocable<CompletionToken, malloy::http::request<Body>&&>)
+            auto body(CompletionToken&& token, Setup&& s)
+            {
+                return boost::asio::async_initiate<CompletionToken, void(malloy::error_code, malloy::http::request<Body>)>(
+                    [this](auto handler, auto s) {
+                        malloy::http::request<Body> r;
+                        r.base() = header_;
+                        s(r.body());
+                        std::move(handler)(malloy::error_code{}, std::move(r));
+                    },
+                    token,
+                    std::forward<Setup>(s)
+                );
+            }
+
+            template<typename Handler>
+            void read_some(Handler&& handler)
+            {
+                handler(malloy::error_code{}, std::string_view{});
+            }
         };
     };
 
 }    // namespace malloy::mock::http
+
+namespace malloy::mock
+{
+
+    /**
+     * A temporary directory which is removed on destruction.
+     */
+    struct temp_dir
+    {
+        std::filesystem::path path;
+
+        explicit
+        temp_dir(const std::string_view name) :
+            path{ std::filesystem::temp_directory_path() / name }
+        {
+            std::filesystem::remove_all(path);
+            std::filesystem::create_directories(path);
+        }
+
+        ~temp_dir()
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(path, ec);
+        }
+
+        void
+        write(const std::string_view rel_path, const std::string_view content) const
+        {
+            std::filesystem::create_directories((path / rel_path).parent_path());
+            std::ofstream{ path / rel_path, std::ios::binary | std::ios::trunc } << content;
+        }
+    };
+
+}
@@ -12,8 +12,18 @@
 #include <iostream>
 #include <functional>
 #include <malloy/client/controller.hpp>
+#include <malloy/server/listener.hpp>
 #include <malloy/server/routing_context.hpp>
 
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
 namespace malloy::test
 {
     /**
@@ -51,4 +61,110 @@ namespace malloy::test
         auto server_session = start(std::move(s_ctrl));
         auto client_session = start(c_ctrl);
     }
+
+    /**
+     * A server listening on an ephemeral port of the loopback interface.
+     */
+    class server
+    {
+    public:
+        /**
+         * Constructor.
+         *
+         * @param setup Sets up the routing context (e.g. adds routes) before the server is started.
+         */
+        explicit
+        server(const std::function<void(malloy::server::routing_context&)>& setup) :
+            server{ [](malloy::server::routing_context::config&) { }, setup }
+        {
+        }
+
+        /**
+         * Constructor.
+         *
+         * @param configure Adjusts the configuration (e.g. limits). The interface & port must not be changed.
+         * @param setup Sets up the routing context (e.g. adds routes) before the server is started.
+         */
+        server(
+            const std::function<void(malloy::server::routing_context::config&)>& configure,
+            const std::function<void(malloy::server::routing_context&)>& setup
+        )
+        {
+            auto cfg = make_config();
+            configure(cfg);
+
+            malloy::server::routing_context ctrl{ cfg };
+            setup(ctrl);
+
+            // The routing context is not needed once the server was started
+            m_session.emplace(start(std::move(ctrl)));
+            m_port = m_session->ctrl()->local_endpoint().port();
+        }
+
+        /**
+         * Gets the port the server listens on.
+         */
+        [[nodiscard]]
+        std::uint16_t
+        port() const noexcept
+        {
+            return m_port;
+        }
+
+        /**
+         * Opens a connection to the server.
+         */
+        [[nodiscard]]
+        boost::asio::ip::tcp::socket
+        connect(boost::asio::io_context& ioc) const
+        {
+            boost::asio::ip::tcp::socket socket{ ioc };
+            socket.connect({ boost::asio::ip::make_address("127.0.0.1"), m_port });
+
+            return socket;
+        }
+
+        /**
+         * Sends raw requests on a new connection and reads the responses until the server closes the connection.
+         *
+         * @param requests The requests.
+         * @return The responses.
+         */
+        [[nodiscard]]
+        std::string
+        exchange(const std::string_view requests) const
+        {
+            boost::asio::io_context ioc;
+            auto socket = connect(ioc);
+            boost::asio::write(socket, boost::asio::buffer(requests));
+
+            std::string responses;
+            boost::system::error_code ec;
+            boost::asio::read(socket, boost::asio::dynamic_buffer(responses), ec);
+            CHECK_EQ(ec, boost::asio::error::eof);
+
+            return responses;
+        }
+
+    private:
+        std::optional<malloy::server::routing_context::session> m_session;
+        std::uint16_t m_port = 0;
+
+        [[nodiscard]]
+        static
+        malloy::server::routing_context::config
+        make_config()
+        {
+            malloy::controller::config general_cfg;
+            general_cfg.logger = spdlog::default_logger();
+            general_cfg.num_threads = 2;
+
+            malloy::server::routing_context::config cfg{general_cfg};
+            cfg.interface = "127.0.0.1";
+            cfg.port = 0;
+            cfg.connection_logger = spdlog::default_logger();
+
+            return cfg;
+        }
+    };
 }
@@ -0,0 +1,93 @@
+#include "../../test.hpp"
+
+#include <malloy/core/http/canned_response.hpp>
+#include <malloy/core/http/generator.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /**
+     * Number of allocations made through the global operator new (by any thread).
+     */
+    std::atomic<std::size_t> global_allocations = 0;
+}
+
+TEST_SUITE("allocations - connection")
+{
+
+    TEST_CASE("round-trip")
+    {
+        // The handler itself does not allocate. A single thread keeps the recycling of asio's handler memory
+        // deterministic.
+        const auto canned = malloy::http::canned_response::make(malloy::http::generator::ok());
+        malloy::test::server server{
+            [](malloy::server::routing_context::config& cfg) {
+                cfg.num_threads = 1;
+            },
+            [&](malloy::server::routing_context& ctrl) {
+                REQUIRE(ctrl.router().add(malloy::http::method::get, "/", [canned](const auto&) { return canned; }));
+            }
+        };
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+
+        // The response is read as is (the server adds nothing to canned responses)
+        const std::string_view request = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        std::vector<char> response(canned->header().size() + canned->body().size());
+        const auto round_trip = [&] {
+            boost::asio::write(socket, boost::asio::buffer(request));
+            boost::asio::read(socket, boost::asio::buffer(response));
+        };
+
+        for (int i = 0; i < 10; i++)
+            round_trip();
+
+        constexpr std::size_t count = 100;
+        const std::size_t before = global_allocations;
+        for (std::size_t i = 0; i < count; i++)
+            round_trip();
+        const std::size_t per_request = (global_allocations - before) / count;
+        MESSAGE("allocations per request: ", per_request);
+
+        // What remains is not under the control of the connection: 4 allocations are made by the header fields (beast's
+        // basic_fields uses the default allocator) as the request is parsed and its header is handed to the route,
+        // 1 by the stop source of the request. The rest is made by asio (Boost 1.74): Type-erasing the strand of the
+        // connection (for each operation) and handler memory its per-thread recycling doesn't cover.
+        // Any change of this count has to be deliberate.
+        CHECK_EQ(per_request, 35);
+    }
+
+}
+
+void*
+operator new(const std::size_t size)
+{
+    global_allocations++;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc{ };
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,380 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/core/http/compression.hpp>
+#include <malloy/core/http/utils.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/asset_bundle.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+using malloy::mock::temp_dir;
+
+namespace
+{
+    /**
+     * Decompresses raw deflate data.
+     */
+    [[nodiscard]]
+    std::string
+    inflate(const std::string_view data, const std::size_t size)
+    {
+        std::string out(size, '\0');
+
+        boost::beast::zlib::z_params zs;
+        zs.next_in = data.data();
+        zs.avail_in = data.size();
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+
+        boost::beast::zlib::inflate_stream is;
+        boost::beast::error_code ec;
+        is.write(zs, boost::beast::zlib::Flush::finish, ec);
+        CHECK((!ec || ec == boost::beast::zlib::error::end_of_stream));
+        out.resize(zs.total_out);
+
+        return out;
+    }
+
+    [[nodiscard]]
+    std::string
+    make_text(const std::size_t lines)
+    {
+        std::string str;
+        for (std::size_t i = 0; i < lines; ++i)
+            str += "<p>line " + std::to_string(i) + "</p>\n";
+
+        return str;
+    }
+
+    template<typename Resp>
+    [[nodiscard]]
+    const Resp&
+    as(const ms::asset_bundle::response_type& resp)
+    {
+        REQUIRE(std::holds_alternative<Resp>(resp));
+        return std::get<Resp>(resp);
+    }
+}
+
+TEST_SUITE("components - asset bundle")
+{
+
+    TEST_CASE("compression")
+    {
+        const std::string text = make_text(100);
+
+        SUBCASE("gzip")
+        {
+            const std::string gz = compression::gzip(text);
+            REQUIRE_GT(gz.size(), 18);
+            CHECK_LT(gz.size(), text.size());
+            CHECK_EQ(gz.substr(0, 3), std::string{ "\x1f\x8b\x08" });
+
+            // ISIZE trailer
+            const auto isize = static_cast<std::uint32_t>(static_cast<unsigned char>(gz[gz.size() - 4])) |
+                               static_cast<std::uint32_t>(static_cast<unsigned char>(gz[gz.size() - 3])) << 8 |
+                               static_cast<std::uint32_t>(static_cast<unsigned char>(gz[gz.size() - 2])) << 16 |
+                               static_cast<std::uint32_t>(static_cast<unsigned char>(gz[gz.size() - 1])) << 24;
+            CHECK_EQ(isize, text.size());
+
+            CHECK_EQ(inflate(std::string_view{ gz }.substr(10, gz.size() - 18), text.size()), text);
+        }
+
+        SUBCASE("deflate")
+        {
+            const std::string df = compression::deflate(text);
+            REQUIRE_GT(df.size(), 6);
+            CHECK_LT(df.size(), text.size());
+
+            // Valid zlib header
+            CHECK_EQ(static_cast<unsigned char>(df[0]), 0x78);
+            CHECK_EQ((static_cast<unsigned char>(df[0]) * 256 + static_cast<unsigned char>(df[1])) % 31, 0);
+
+            CHECK_EQ(inflate(std::string_view{ df }.substr(2, df.size() - 6), text.size()), text);
+        }
+
+        SUBCASE("empty input")
+        {
+            CHECK_EQ(inflate(std::string_view{ compression::gzip("") }.substr(10), 16), "");
+        }
+    }
+
+    TEST_CASE("precompress")
+    {
+        const std::string text = make_text(100);
+
+        const auto html = compression::precompress("index.html", text, 256);
+        CHECK_EQ(html.mime_type, "text/html");
+        CHECK_EQ(html.etag, make_etag(text));
+        CHECK_EQ(html.gzip, compression::gzip(text));
+        CHECK_EQ(html.deflate, compression::deflate(text));
+
+        // Too small, incompressible or not smaller
+        CHECK(compression::precompress("index.html", text, text.size() + 1).gzip.empty());
+        CHECK(compression::precompress("logo.png", text, 0).gzip.empty());
+        const auto tiny = compression::precompress("a.txt", "a", 0);
+        CHECK(tiny.gzip.empty());
+        CHECK(tiny.deflate.empty());
+    }
+
+    TEST_CASE("negotiation")
+    {
+        using enum compression::coding;
+
+        CHECK_EQ(compression::negotiate("", true, true), identity);
+        CHECK_EQ(compression::negotiate("gzip, deflate, br", true, true), gzip);
+        CHECK_EQ(compression::negotiate("gzip, deflate", false, true), deflate);
+        CHECK_EQ(compression::negotiate("gzip", false, true), identity);
+        CHECK_EQ(compression::negotiate("gzip;q=0.5, deflate", true, true), deflate);
+        CHECK_EQ(compression::negotiate("gzip;q=0, deflate;q=0", true, true), identity);
+        CHECK_EQ(compression::negotiate("GZIP ; Q=0.8", true, true), gzip);
+        CHECK_EQ(compression::negotiate("*", true, true), gzip);
+        CHECK_EQ(compression::negotiate("identity;q=1, gzip;q=0.5", true, true), identity);
+        CHECK_EQ(compression::negotiate("br", true, true), identity);
+
+        CHECK(compression::is_compressible("text/html"));
+        CHECK(compression::is_compressible("application/json"));
+        CHECK(compression::is_compressible("image/svg+xml"));
+        CHECK_FALSE(compression::is_compressible("image/png"));
+        CHECK_FALSE(compression::is_compressible("application/zip"));
+    }
+
+    TEST_CASE("entity tags")
+    {
+        const std::string etag = make_etag("hello");
+        CHECK_EQ(etag.front(), '"');
+        CHECK_EQ(etag.back(), '"');
+        CHECK_EQ(etag, make_etag("hello"));
+        CHECK_NE(etag, make_etag("hellp"));
+
+        CHECK(etag_matches(etag, etag));
+        CHECK(etag_matches("*", etag));
+        CHECK(etag_matches("W/" + etag, etag));
+        CHECK(etag_matches("\"other\", " + etag, etag));
+        CHECK_FALSE(etag_matches("\"other\"", etag));
+        CHECK_FALSE(etag_matches("", etag));
+
+        // Coded representations
+        CHECK_EQ(compression::coded_etag("\"abc-5\"", compression::coding::gzip), "\"abc-5-gzip\"");
+        CHECK_EQ(compression::coded_etag("\"abc-5\"", compression::coding::deflate), "\"abc-5-deflate\"");
+        CHECK_EQ(compression::coded_etag("\"abc-5\"", compression::coding::identity), "\"abc-5\"");
+    }
+
+    TEST_CASE("bundle")
+    {
+        temp_dir dir{ "malloy_test_asset_bundle" };
+        const std::string page = make_text(100);
+        dir.write("index.html", page);
+        dir.write("js/app.js", "let a = 1;");
+        dir.write("img/logo.png", std::string(1024, 'x'));
+        dir.write("docs/index.html", "<p>docs</p>");
+
+        ms::asset_bundle bundle{ dir.path };
+        REQUIRE_EQ(bundle.size(), 4);
+
+        SUBCASE("lookups")
+        {
+            const auto index = bundle.find("index.html");
+            REQUIRE(index);
+            CHECK_EQ(index->mime_type, "text/html");
+            CHECK_EQ(index->identity.view(), page);
+            CHECK_EQ(index->etag, make_etag(page));
+            CHECK_EQ(index->etag_gzip, compression::coded_etag(make_etag(page), compression::coding::gzip));
+            CHECK_EQ(index->etag_of(compression::coding::deflate), compression::coded_etag(make_etag(page), compression::coding::deflate));
+            CHECK_EQ(inflate(index->gzip.view().substr(10, index->gzip.size() - 18), page.size()), page);
+            CHECK_FALSE(index->deflate.empty());
+
+            // Directory paths
+            CHECK_EQ(bundle.find(""), index);
+            CHECK_EQ(bundle.find("/"), index);
+            CHECK_EQ(bundle.find("docs/")->path, "docs/index.html");
+
+            // Too small or incompressible
+            CHECK(bundle.find("js/app.js")->gzip.empty());
+            CHECK(bundle.find("js/app.js")->etag_gzip.empty());
+            CHECK(bundle.find("img/logo.png")->gzip.empty());
+
+            CHECK_FALSE(bundle.find("missing.html"));
+            CHECK_FALSE(bundle.find("../index.html"));
+            CHECK_FALSE(bundle.find("js"));
+        }
+
+        SUBCASE("fingerprinted paths")
+        {
+            const auto url = bundle.url_for("/js/app.js");
+            REQUIRE(url);
+            CHECK(url->starts_with("js/app."));
+            CHECK(url->ends_with(".js"));
+            CHECK_EQ(url->size(), std::string_view{ "js/app..js" }.size() + 16);
+            CHECK_EQ(bundle.find(*url), bundle.find("js/app.js"));
+
+            CHECK_FALSE(bundle.url_for("missing.js"));
+        }
+
+        SUBCASE("responses")
+        {
+            ms::asset_bundle::request_header req;
+            req.method(method::get);
+
+            // Identity
+            {
+                const auto& resp = as<response<shared_buffer_body>>(bundle.respond(req, "/index.html"));
+                CHECK_EQ(resp.result(), status::ok);
+                CHECK_EQ(resp[field::content_type], "text/html");
+                CHECK_EQ(resp[field::etag], make_etag(page));
+                CHECK_EQ(resp[field::vary], "Accept-Encoding");
+                CHECK_EQ(resp.count(field::content_encoding), 0);
+                CHECK_EQ(resp.count(field::cache_control), 0);
+                CHECK_EQ(resp.body().view(), page);
+                CHECK_EQ(resp[field::content_length], std::to_string(page.size()));
+            }
+
+            // Compressed (sharing the buffer of the bundle)
+            req.set(field::accept_encoding, "deflate, gzip");
+            {
+                const auto& resp = as<response<shared_buffer_body>>(bundle.respond(req, "/index.html"));
+                CHECK_EQ(resp[field::content_encoding], "gzip");
+                CHECK_EQ(resp[field::etag], bundle.find("index.html")->etag_gzip);
+                CHECK_EQ(resp.body().view().data(), bundle.find("index.html")->gzip.view().data());
+            }
+
+            // Fingerprinted
+            {
+                const auto url = bundle.url_for("index.html");
+                const auto& resp = as<response<shared_buffer_body>>(bundle.respond(req, *url));
+                CHECK_EQ(resp[field::cache_control], "public, max-age=31536000, immutable");
+            }
+
+            // Not modified (whichever representation the client holds)
+            for (const auto& etag : { make_etag(page), bundle.find("index.html")->etag_gzip, bundle.find("index.html")->etag_deflate }) {
+                req.set(field::if_none_match, etag);
+                const auto& resp = as<response<>>(bundle.respond(req, "/index.html"));
+                CHECK_EQ(resp.result(), status::not_modified);
+                CHECK_EQ(resp[field::etag], bundle.find("index.html")->etag_gzip);
+                CHECK(resp.body().empty());
+            }
+
+            // Missing
+            CHECK_EQ(as<response<>>(bundle.respond(req, "/missing.html")).result(), status::not_found);
+        }
+
+        SUBCASE("reload")
+        {
+            const auto old = bundle.find("js/app.js");
+            const auto old_url = bundle.url_for("js/app.js");
+
+            dir.write("js/app.js", "let a = 2;");
+            dir.write("js/new.js", "let b = 1;");
+            bundle.reload();
+
+            CHECK_EQ(bundle.size(), 5);
+            CHECK_EQ(bundle.find("js/app.js")->identity.view(), "let a = 2;");
+            CHECK_NE(bundle.url_for("js/app.js"), old_url);
+            CHECK_FALSE(bundle.find(*old_url));
+
+            // Assets handed out before are still valid
+            CHECK_EQ(old->identity.view(), "let a = 1;");
+        }
+    }
+
+#if !defined(_WIN32)
+    TEST_CASE("mapped bundle")
+    {
+        temp_dir dir{ "malloy_test_asset_bundle_mmap" };
+        const std::string page = make_text(100);
+        dir.write("index.html", page);
+        dir.write("empty.txt", "");
+
+        ms::asset_bundle bundle{ dir.path, { .store = ms::asset_bundle::storage::mmap } };
+        CHECK_EQ(bundle.find("index.html")->identity.view(), page);
+        CHECK(bundle.find("empty.txt")->identity.empty());
+
+        SUBCASE("replaced")
+        {
+            dir.write("index.html.tmp", "<p>new</p>");
+            std::filesystem::rename(dir.path / "index.html.tmp", dir.path / "index.html");
+            bundle.reload();
+
+            CHECK_EQ(bundle.find("index.html")->identity.view(), "<p>new</p>");
+        }
+
+        SUBCASE("modified in place")
+        {
+            // Rewritten (truncated) in place, hence read from now on
+            const std::string modified(4096, 'b');
+            dir.write("index.html", modified);
+            bundle.reload();
+            const auto index = bundle.find("index.html");
+            REQUIRE_EQ(index->identity.view(), modified);
+
+            // Accessing a mapping of the truncated file would raise SIGBUS
+            dir.write("index.html", "");
+            CHECK_EQ(index->identity.view(), modified);
+
+            bundle.reload();
+            CHECK(bundle.find("index.html")->identity.empty());
+        }
+    }
+#endif
+
+    TEST_CASE("file serving")
+    {
+        temp_dir dir{ "malloy_test_asset_bundle_serving" };
+        const std::string page = make_text(100);
+        dir.write("index.html", page);
+
+        auto bundle = std::make_shared<ms::asset_bundle>(dir.path);
+        const std::string url = "/assets/" + *bundle->url_for("index.html");
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            CHECK_FALSE(ctrl.router().add_file_serving("/none", std::shared_ptr<ms::asset_bundle>{ }));
+            REQUIRE(ctrl.router().add_file_serving("/assets", bundle, [] { return std::string{ "no-cache" }; }));
+        } };
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(
+            "GET /assets/ HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /assets/index.html?v=1 HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept-Encoding: gzip\r\n\r\n"
+            "GET " + url + " HTTP/1.1\r\nHost: 127.0.0.1\r\nIf-None-Match: " + make_etag(page) + "\r\n\r\n"
+            "GET /assets/missing.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        ));
+
+        boost::beast::flat_buffer buffer;
+
+        response<> plain;
+        boost::beast::http::read(socket, buffer, plain);
+        CHECK_EQ(plain.result(), status::ok);
+        CHECK_EQ(plain[field::cache_control], "no-cache");
+        CHECK_EQ(plain.body(), page);
+
+        response<> gzipped;
+        boost::beast::http::read(socket, buffer, gzipped);
+        CHECK_EQ(gzipped.result(), status::ok);
+        CHECK_EQ(gzipped[field::content_encoding], "gzip");
+        CHECK_EQ(inflate(std::string_view{ gzipped.body() }.substr(10, gzipped.body().size() - 18), page.size()), page);
+
+        response<> not_modified;
+        boost::beast::http::read(socket, buffer, not_modified);
+        CHECK_EQ(not_modified.result(), status::not_modified);
+        CHECK_EQ(not_modified[field::cache_control], "public, max-age=31536000, immutable");
+
+        response<> missing;
+        boost::beast::http::read(socket, buffer, missing);
+        CHECK_EQ(missing.result(), status::not_found);
+    }
+
+}
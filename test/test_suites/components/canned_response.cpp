@@ -0,0 +1,76 @@
+#include "../../test.hpp"
+
+#include <malloy/core/http/canned_response.hpp>
+#include <malloy/core/http/generator.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/buffer.hpp>
+
+using namespace malloy::http;
+
+TEST_SUITE("components - canned response")
+{
+
+    TEST_CASE("serialization")
+    {
+        auto resp = generator::bad_request("unknown request");
+        resp.set(field::server, "malloy");
+        const auto canned = canned_response::make(std::move(resp));
+
+        REQUIRE(canned);
+        CHECK_EQ(canned->status(), 400);
+        CHECK(canned->header().starts_with("HTTP/1.1 400 Bad Request\r\n"));
+        CHECK(canned->header().ends_with("\r\n\r\n"));
+        CHECK_NE(canned->header().find("Server: malloy\r\n"), std::string_view::npos);
+        CHECK_NE(canned->header().find("Content-Length: 15\r\n"), std::string_view::npos);
+        CHECK_EQ(canned->body(), "unknown request");
+    }
+
+    TEST_CASE("buffers")
+    {
+        response<> resp{ status::ok };
+        resp.body() = "ok";
+        const auto canned = canned_response::make(std::move(resp));
+
+        SUBCASE("GET")
+        {
+            const auto buffers = canned->buffers(false);
+            CHECK_EQ(boost::asio::buffer_size(buffers), canned->header().size() + 2);
+        }
+
+        SUBCASE("HEAD")
+        {
+            const auto buffers = canned->buffers(true);
+            CHECK_EQ(boost::asio::buffer_size(buffers), canned->header().size());
+        }
+    }
+
+    TEST_CASE("additional fields")
+    {
+        response<> resp{ status::ok };
+        resp.body() = "ok";
+        const auto base = canned_response::make(std::move(resp));
+        const auto canned = canned_response::make(canned_response::make(base, "Age: 1\r\n"), "X-Foo: bar\r\n");
+
+        CHECK_EQ(canned->status(), 200);
+        CHECK_EQ(canned->header(), base->header());
+        CHECK_EQ(canned->fields(), "Age: 1\r\nX-Foo: bar\r\n");
+
+        std::string serialized;
+        for (const auto& b : canned->buffers(false))
+            serialized.append(static_cast<const char*>(b.data()), b.size());
+
+        const std::string_view header = base->header();
+        CHECK_EQ(serialized, std::string{ header.substr(0, header.size() - 2) } + "Age: 1\r\nX-Foo: bar\r\n\r\nok");
+        CHECK_EQ(boost::asio::buffer_size(canned->buffers(true)), serialized.size() - 2);
+    }
+
+    TEST_CASE("route handler")
+    {
+        malloy::server::router r;
+        const auto health = canned_response::make(generator::ok());
+
+        CHECK(r.add(method::get, "/health", [health](const auto&) { return health; }));
+    }
+
+}
@@ -0,0 +1,83 @@
+#include "../../test.hpp"
+
+#include <malloy/server/http/chunked_response.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+namespace
+{
+    /**
+     * Writes a number of chunks, one after another.
+     */
+    void
+    write_chunks(std::shared_ptr<ms::http::chunked_response> resp, int remaining)
+    {
+        if (remaining == 0) {
+            boost::beast::http::fields trailers;
+            trailers.set("X-Checksum", "42");
+            resp->finish(std::move(trailers), [](malloy::error_code) { });
+            return;
+        }
+
+        auto chunk = "chunk" + std::to_string(remaining);
+        resp->write(std::move(chunk), [resp, remaining](malloy::error_code ec) {
+            if (!ec)
+                write_chunks(resp, remaining - 1);
+        });
+    }
+}
+
+TEST_SUITE("components - chunked response")
+{
+
+    TEST_CASE("chunks are written in order")
+    {
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            ctrl.router().add_streaming(method::get, "/export", [](ms::streaming_request req) {
+                response<>::header_type header;
+                header.result(status::ok);
+                header.set(field::content_type, "text/csv");
+                header.set(field::trailer, "X-Checksum");
+                write_chunks(req.respond_chunked(std::move(header)), 3);
+            });
+            ctrl.router().add(method::get, "/after", [](const auto&) {
+                response<> resp{ status::ok };
+                resp.body() = "after";
+                return resp;
+            });
+        } };
+
+        SUBCASE("HTTP/1.1")
+        {
+            const std::string responses = server.exchange(
+                "GET /export HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+                "GET /after HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n"
+            );
+
+            const auto body = responses.find("\r\n\r\n");
+            REQUIRE_NE(body, std::string::npos);
+            const std::string header = responses.substr(0, body);
+            CHECK_NE(header.find("Transfer-Encoding: chunked"), std::string::npos);
+            CHECK_NE(header.find("Server: malloy"), std::string::npos);
+
+            const std::string expected = "6\r\nchunk3\r\n6\r\nchunk2\r\n6\r\nchunk1\r\n0\r\nX-Checksum: 42\r\n\r\nHTTP/1.1 200 OK";
+            CHECK_EQ(responses.substr(body + 4, expected.size()), expected);
+            CHECK(responses.ends_with("after"));
+        }
+
+        SUBCASE("HTTP/1.0")
+        {
+            const std::string responses = server.exchange("GET /export HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n");
+
+            CHECK_EQ(responses.find("Transfer-Encoding"), std::string::npos);
+            CHECK(responses.ends_with("\r\n\r\nchunk3chunk2chunk1"));
+        }
+    }
+
+}
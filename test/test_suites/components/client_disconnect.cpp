@@ -0,0 +1,151 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/write.hpp>
+#include <boost/beast/http/read.hpp>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+
+using namespace malloy::http;
+using namespace std::chrono_literals;
+namespace ms = malloy::server;
+
+namespace
+{
+    /**
+     * An outstanding request whose handler waits for the client to disconnect.
+     */
+    struct outstanding
+    {
+        std::mutex lock;
+        std::optional<ms::streaming_request> req;
+        std::optional<std::stop_callback<std::function<void()>>> on_stop;
+        std::promise<void> handled;
+        std::promise<void> stopped;
+    };
+
+    /**
+     * Adds a route which consumes the body, then keeps the request outstanding.
+     */
+    void
+    add_report(ms::routing_context& ctrl, const std::shared_ptr<outstanding>& state)
+    {
+        ctrl.router().add_streaming(method::post, "/report", [state](ms::streaming_request req) {
+            req.read_some([state, req](malloy::error_code, std::string_view) {
+                req.read_some([state, req](malloy::error_code, std::string_view) {
+                    std::lock_guard lock(state->lock);
+                    state->req = req;
+                    state->on_stop.emplace(req.stop_token(), [state] { state->stopped.set_value(); });
+                    state->handled.set_value();
+                });
+            });
+        });
+    }
+
+    const std::string report = "POST /report HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 4\r\n\r\ndata";
+}
+
+TEST_SUITE("components - client disconnect")
+{
+
+    TEST_CASE("outstanding requests are cancelled when the client disconnects")
+    {
+        auto state = std::make_shared<outstanding>();
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            add_report(ctrl, state);
+        } };
+
+        {
+            boost::asio::io_context ioc;
+            auto socket = server.connect(ioc);
+            boost::asio::write(socket, boost::asio::buffer(report));
+
+            REQUIRE_EQ(state->handled.get_future().wait_for(5s), std::future_status::ready);
+            CHECK_FALSE(state->req->stop_token().stop_requested());
+        }
+
+        // The socket was closed
+        REQUIRE_EQ(state->stopped.get_future().wait_for(5s), std::future_status::ready);
+
+        // Responding to the abandoned request is a no-op
+        std::lock_guard lock(state->lock);
+        CHECK(state->req->stop_token().stop_requested());
+        state->req->respond(response<>{ status::ok });
+        state->on_stop.reset();
+        state->req.reset();
+    }
+
+    TEST_CASE("half-closing the connection")
+    {
+        auto state = std::make_shared<outstanding>();
+
+        // The request has to be released while the server is still running
+        const auto release = [&state] {
+            std::lock_guard lock(state->lock);
+            state->on_stop.reset();
+            state->req.reset();
+        };
+
+        SUBCASE("cancels by default")
+        {
+            malloy::test::server server{ [&](ms::routing_context& ctrl) {
+                add_report(ctrl, state);
+            } };
+
+            boost::asio::io_context ioc;
+            auto socket = server.connect(ioc);
+            boost::asio::write(socket, boost::asio::buffer(report));
+            REQUIRE_EQ(state->handled.get_future().wait_for(5s), std::future_status::ready);
+
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+            CHECK_EQ(state->stopped.get_future().wait_for(5s), std::future_status::ready);
+            release();
+        }
+
+        SUBCASE("doesn't cancel if disabled")
+        {
+            malloy::test::server server{
+                [](ms::routing_context::config& cfg) {
+                    cfg.cancel_on_half_close = false;
+                },
+                [&](ms::routing_context& ctrl) {
+                    add_report(ctrl, state);
+                }
+            };
+
+            boost::asio::io_context ioc;
+            auto socket = server.connect(ioc);
+            boost::asio::write(socket, boost::asio::buffer(report));
+            REQUIRE_EQ(state->handled.get_future().wait_for(5s), std::future_status::ready);
+
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+            CHECK_EQ(state->stopped.get_future().wait_for(200ms), std::future_status::timeout);
+
+            // The response still reaches the client
+            {
+                std::lock_guard lock(state->lock);
+                CHECK_FALSE(state->req->stop_token().stop_requested());
+                response<> resp{ status::ok };
+                resp.body() = "done";
+                state->req->respond(std::move(resp));
+            }
+
+            boost::beast::flat_buffer buffer;
+            response<> resp;
+            boost::beast::http::read(socket, buffer, resp);
+            CHECK_EQ(resp.result(), status::ok);
+            CHECK_EQ(resp.body(), "done");
+            release();
+        }
+    }
+
+}
@@ -0,0 +1,88 @@
+#include "../../test.hpp"
+
+#include <malloy/core/awaitable.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+using namespace malloy::http;
+using namespace std::chrono_literals;
+namespace ms = malloy::server;
+
+namespace
+{
+    /**
+     * Suspends the calling coroutine.
+     */
+    malloy::awaitable<void>
+    sleep(const std::chrono::milliseconds duration)
+    {
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, duration };
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+}
+
+TEST_SUITE("components - coroutine handlers")
+{
+
+    TEST_CASE("coroutine handlers")
+    {
+        malloy::test::server server{
+            [](ms::routing_context::config& cfg) {
+                cfg.num_threads = 1;
+            },
+            [&](ms::routing_context& ctrl) {
+                ctrl.router().add(method::get, "/slow", [](const auto&) -> malloy::awaitable<response<>> {
+                    co_await sleep(300ms);
+
+                    response<> resp{ status::ok };
+                    resp.body() = "slow";
+                    co_return resp;
+                });
+                ctrl.router().add(method::post, "/echo/{name}", [](const auto& req, const ms::route_captures& caps) -> malloy::awaitable<response<>> {
+                    co_await sleep(10ms);
+
+                    response<> resp{ status::ok };
+                    resp.body() = std::string{ caps.at(0) } + ":" + req.body();
+                    co_return resp;
+                });
+            }
+        };
+
+        SUBCASE("suspended handlers don't block the I/O thread")
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            std::vector<std::future<std::string>> responses;
+            for (int i = 0; i < 8; i++) {
+                responses.emplace_back(std::async(std::launch::async, [&server] {
+                    return server.exchange("GET /slow HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n");
+                }));
+            }
+            for (auto& resp : responses)
+                CHECK(resp.get().ends_with("\r\n\r\nslow"));
+
+            // All handlers were in flight at the same time on the single I/O thread
+            CHECK_LT(std::chrono::steady_clock::now() - start, 8 * 300ms / 2);
+        }
+
+        SUBCASE("body and captures")
+        {
+            const std::string response = server.exchange(
+                "POST /echo/malloy HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello"
+            );
+
+            CHECK(response.starts_with("HTTP/1.1 200 OK"));
+            CHECK(response.ends_with("\r\n\r\nmalloy:hello"));
+        }
+    }
+
+}
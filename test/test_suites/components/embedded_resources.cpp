@@ -0,0 +1,135 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/core/http/compression.hpp>
+#include <malloy/core/http/utils.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/asset_bundle.hpp>
+#include <malloy/server/routing/router.hpp>
+#include <malloy_embedded/test_resources.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+
+#include <algorithm>
+#include <string>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+namespace
+{
+    /**
+     * Decompresses gzip data.
+     */
+    [[nodiscard]]
+    std::string
+    gunzip(const std::string_view data, const std::size_t size)
+    {
+        REQUIRE_GT(data.size(), 18);
+
+        std::string out(size, '\0');
+
+        boost::beast::zlib::z_params zs;
+        zs.next_in = data.data() + 10;
+        zs.avail_in = data.size() - 18;
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+
+        boost::beast::zlib::inflate_stream is;
+        boost::beast::error_code ec;
+        is.write(zs, boost::beast::zlib::Flush::finish, ec);
+        out.resize(zs.total_out);
+
+        return out;
+    }
+
+    [[nodiscard]]
+    const ms::embedded_resource*
+    find(const std::string_view path)
+    {
+        const auto resources = malloy::embedded::test_resources();
+        const auto it = std::ranges::find(resources, path, &ms::embedded_resource::path);
+        return it == std::end(resources) ? nullptr : &*it;
+    }
+}
+
+TEST_SUITE("components - embedded resources")
+{
+
+    TEST_CASE("generated table")
+    {
+        REQUIRE_EQ(malloy::embedded::test_resources().size(), 2);
+
+        const auto index = find("index.html");
+        REQUIRE(index);
+        CHECK_EQ(index->mime_type, "text/html");
+        CHECK(index->identity.starts_with("<!DOCTYPE html>"));
+        CHECK_EQ(index->etag, make_etag(index->identity));
+        CHECK_EQ(gunzip(index->gzip, index->identity.size()), index->identity);
+        CHECK_FALSE(index->deflate.empty());
+
+        const auto app = find("js/app.js");
+        REQUIRE(app);
+        CHECK_EQ(app->mime_type, "application/javascript");
+        CHECK_EQ(app->identity, "console.log(\"embedded\");\n");
+        CHECK(app->gzip.empty());       // Too small
+    }
+
+    TEST_CASE("bundle")
+    {
+        const ms::asset_bundle bundle{ malloy::embedded::test_resources() };
+        CHECK_EQ(bundle.size(), 2);
+        CHECK(bundle.root().empty());
+
+        // Served from the embedded data
+        const auto index = bundle.find("/");
+        REQUIRE(index);
+        CHECK_EQ(index->identity.view().data(), find("index.html")->identity.data());
+        CHECK_EQ(index->gzip.view().data(), find("index.html")->gzip.data());
+
+        const auto url = bundle.url_for("js/app.js");
+        REQUIRE(url);
+        CHECK_EQ(bundle.find(*url), bundle.find("js/app.js"));
+    }
+
+    TEST_CASE("file serving")
+    {
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            REQUIRE(ctrl.router().add_file_serving("/static", malloy::embedded::test_resources()));
+        } };
+
+        const auto index = find("index.html");
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(
+            "GET /static/index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept-Encoding: gzip\r\n\r\n"
+            "GET /static/index.html HTTP/1.1\r\nHost: 127.0.0.1\r\nIf-None-Match: " + std::string{ index->etag } + "\r\n\r\n"
+            "GET /static/js/app.js HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        ));
+
+        boost::beast::flat_buffer buffer;
+
+        response<> gzipped;
+        boost::beast::http::read(socket, buffer, gzipped);
+        CHECK_EQ(gzipped.result(), status::ok);
+        CHECK_EQ(gzipped[field::content_encoding], "gzip");
+        CHECK_EQ(gzipped[field::etag], compression::coded_etag(index->etag, compression::coding::gzip));
+        CHECK_EQ(gunzip(gzipped.body(), index->identity.size()), index->identity);
+
+        response<> not_modified;
+        boost::beast::http::read(socket, buffer, not_modified);
+        CHECK_EQ(not_modified.result(), status::not_modified);
+
+        response<> app;
+        boost::beast::http::read(socket, buffer, app);
+        CHECK_EQ(app.result(), status::ok);
+        CHECK_EQ(app[field::content_type], "application/javascript");
+        CHECK_EQ(app.body(), "console.log(\"embedded\");\n");
+    }
+
+}
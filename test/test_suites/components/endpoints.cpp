@@ -66,4 +66,54 @@ TEST_SUITE("components - endpoints")
         CHECK(handler_called);
     }
 
+    TEST_CASE("An endpoint_http_regex with a handler that takes route_captures receives views into the request target")
+    {
+        const std::string input_url = "/content/thisisaword/42";
+        endpoint_http_regex<response<>, malloy::server::detail::default_route_filter, true, route_captures> endpt;
+        endpt.method = method::get;
+        endpt.resource_base = std::regex{R"(/content/(\w+)/(\d+))"};
+        endpt.writer = [](auto&&...){};
+
+        request_header<> reqh;
+        reqh.target(input_url);
+        reqh.method(method::get);
+
+        route_captures captures;
+        REQUIRE(endpt.matches_with_captures(reqh, captures));
+        REQUIRE_EQ(captures.size(), 2);
+        CHECK_EQ(captures[0], "thisisaword");
+        CHECK_EQ(captures[1], "42");
+
+        bool handler_called{false};
+        endpt.handler = [&](const auto&, const route_captures& results) {
+            CHECK_EQ(results.size(), 2);
+            CHECK_EQ(results[0], "thisisaword");
+            CHECK_EQ(results.get<int>(1), 42);
+            CHECK_FALSE(results.get<int>(0));
+            CHECK_FALSE(results.get<int>(2));
+            handler_called = true;
+
+            return generator::ok();
+        };
+
+        [[maybe_unused]] const auto rs = endpt.handle_with_captures(
+            std::make_shared<malloy::mock::http::connection::request_generator>(reqh),
+            http::connection_t{ std::shared_ptr<http::connection_plain>{nullptr} },
+            captures
+        );
+        CHECK(handler_called);
+
+        SUBCASE("method mismatch")
+        {
+            reqh.method(method::post);
+            CHECK_FALSE(endpt.matches_with_captures(reqh, captures));
+        }
+
+        SUBCASE("resource mismatch")
+        {
+            reqh.target("/content/thisisaword/abc");
+            CHECK_FALSE(endpt.matches_with_captures(reqh, captures));
+        }
+    }
+
 }
@@ -0,0 +1,274 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/core/http/file_cache.hpp>
+#include <malloy/core/http/generator.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+using namespace std::chrono_literals;
+namespace ms = malloy::server;
+using malloy::mock::temp_dir;
+
+namespace
+{
+    [[nodiscard]]
+    std::string
+    read_all(shared_file file)
+    {
+        malloy::error_code ec;
+        std::string str(file.size(ec), '\0');
+        std::size_t n = 0;
+        while (n < str.size()) {
+            const auto read = file.read(str.data() + n, str.size() - n, ec);
+            if (ec || read == 0)
+                break;
+            n += read;
+        }
+        str.resize(n);
+
+        return str;
+    }
+}
+
+TEST_SUITE("components - file cache")
+{
+
+    TEST_CASE("lookups")
+    {
+        temp_dir dir{ "malloy_test_file_cache_lookups" };
+        dir.write("index.html", "<html></html>");
+        dir.write("img/logo.svg", "<svg/>");
+
+        file_cache cache{ dir.path, { .max_entries = 16, .ttl = 1h, .watch = false } };
+
+        SUBCASE("existing files are cached")
+        {
+            const auto e = cache.get("/index.html");
+            REQUIRE(e->exists());
+            CHECK_EQ(e->size, 13);
+            CHECK_EQ(e->mime_type, "text/html");
+            CHECK_EQ(read_all(e->open()), "<html></html>");
+
+            CHECK_EQ(cache.get("index.html"), e);
+            CHECK_EQ(cache.get("img/logo.svg")->mime_type, "image/svg+xml");
+            CHECK_EQ(cache.size(), 2);
+        }
+
+        SUBCASE("missing files are cached")
+        {
+            const auto e = cache.get("missing.html");
+            CHECK_FALSE(e->exists());
+            CHECK_EQ(cache.get("missing.html"), e);
+            CHECK_EQ(cache.size(), 1);
+
+            // Directories aren't files
+            CHECK_FALSE(cache.get("img")->exists());
+        }
+
+        SUBCASE("paths escaping the base path are rejected")
+        {
+            CHECK_FALSE(cache.get("../etc/passwd")->exists());
+            CHECK_FALSE(cache.get("img/../index.html")->exists());
+            CHECK_EQ(cache.size(), 0);
+        }
+
+        SUBCASE("files are read independently of each other")
+        {
+            const auto e = cache.get("index.html");
+            auto a = e->open();
+            auto b = e->open();
+
+            malloy::error_code ec;
+            char buf[6] = { };
+            CHECK_EQ(a.read(buf, 6, ec), 6);
+            CHECK_EQ(std::string_view{ buf, 6 }, "<html>");
+
+            CHECK_EQ(read_all(b), "<html></html>");
+
+            b.seek(7, ec);
+            CHECK_EQ(b.read(buf, 6, ec), 6);
+            CHECK_EQ(std::string_view{ buf, 6 }, "/html>");
+
+            CHECK_EQ(a.pos(ec), 6);
+        }
+    }
+
+    TEST_CASE("expiry & eviction")
+    {
+        temp_dir dir{ "malloy_test_file_cache_expiry" };
+        dir.write("a.txt", "a");
+        dir.write("b.txt", "b");
+        dir.write("c.txt", "c");
+
+        const auto now = file_cache::clock::now();
+
+        SUBCASE("entries are looked up again once expired")
+        {
+            file_cache cache{ dir.path, { .max_entries = 16, .ttl = 10s, .watch = false } };
+
+            const auto e = cache.get("a.txt", now);
+            dir.write("a.txt", "aaa");
+            CHECK_EQ(cache.get("a.txt", now + 5s), e);
+
+            const auto e2 = cache.get("a.txt", now + 10s);
+            CHECK_NE(e2, e);
+            CHECK_EQ(e2->size, 3);
+
+            // Explicit invalidation
+            CHECK(cache.invalidate("a.txt"));
+            CHECK_FALSE(cache.invalidate("a.txt"));
+            CHECK_EQ(cache.size(), 0);
+        }
+
+        SUBCASE("least recently used entries are evicted")
+        {
+            file_cache cache{ dir.path, { .max_entries = 2, .ttl = 1h, .watch = false } };
+
+            const auto a = cache.get("a.txt", now);
+            const auto b = cache.get("b.txt", now);
+            CHECK_EQ(cache.get("a.txt", now), a);
+            std::ignore = cache.get("c.txt", now);
+
+            CHECK_EQ(cache.size(), 2);
+            CHECK_EQ(cache.get("a.txt", now), a);
+            CHECK_NE(cache.get("b.txt", now), b);
+        }
+    }
+
+#if defined(__linux__)
+    TEST_CASE("changes invalidate entries")
+    {
+        temp_dir dir{ "malloy_test_file_cache_watch" };
+        dir.write("index.html", "<html></html>");
+        dir.write("sub/page.html", "<p></p>");
+
+        file_cache cache{ dir.path, { .max_entries = 16, .ttl = 1h, .watch = true, .watch_interval = 1s } };
+
+        const auto now = file_cache::clock::now();
+        const auto index = cache.get("index.html", now);
+        const auto page = cache.get("sub/page.html", now);
+        const auto missing = cache.get("new.html", now);
+        REQUIRE_FALSE(missing->exists());
+
+        // Changes are processed once the watch interval passed
+        const auto later = now + 1s;
+
+        SUBCASE("modified")
+        {
+            dir.write("index.html", "<html><body></body></html>");
+            CHECK_EQ(cache.get("index.html", now), index);
+
+            const auto e = cache.get("index.html", later);
+            CHECK_NE(e, index);
+            CHECK_EQ(read_all(e->open()), "<html><body></body></html>");
+
+            // The old descriptor can still be read
+            CHECK(index->exists());
+        }
+
+        SUBCASE("created")
+        {
+            dir.write("new.html", "<html/>");
+            CHECK(cache.get("new.html", later)->exists());
+        }
+
+        SUBCASE("removed")
+        {
+            std::filesystem::remove(dir.path / "sub/page.html");
+            CHECK_FALSE(cache.get("sub/page.html", later)->exists());
+            CHECK_EQ(cache.get("index.html", later), index);
+        }
+
+        SUBCASE("directory renamed")
+        {
+            std::filesystem::rename(dir.path / "sub", dir.path / "moved");
+            CHECK_FALSE(cache.get("sub/page.html", later)->exists());
+            CHECK(cache.get("moved/page.html", later)->exists());
+        }
+    }
+#endif
+
+    TEST_CASE("generator")
+    {
+        temp_dir dir{ "malloy_test_file_cache_generator" };
+        dir.write("index.html", "<html></html>");
+
+        file_cache cache{ dir.path };
+
+        const auto ok = generator::file(cache, "/index.html");
+        REQUIRE(std::holds_alternative<response<shared_file_body>>(ok));
+        const auto& resp = std::get<response<shared_file_body>>(ok);
+        CHECK_EQ(resp.result(), status::ok);
+        CHECK_EQ(resp[field::content_type], "text/html");
+        CHECK_EQ(resp.body().size(), 13);
+
+        const auto missing = generator::file(cache, "/missing.html");
+        REQUIRE(std::holds_alternative<response<>>(missing));
+        CHECK_EQ(std::get<response<>>(missing).result(), status::not_found);
+
+        const auto bad = generator::file(cache, "/../index.html");
+        REQUIRE(std::holds_alternative<response<>>(bad));
+        CHECK_EQ(std::get<response<>>(bad).result(), status::bad_request);
+    }
+
+    TEST_CASE("file serving")
+    {
+        temp_dir dir{ "malloy_test_file_cache_serving" };
+        const std::string large(512 * 1024 + 5, 'x');
+        dir.write("large.bin", large);
+        dir.write("index.html", "<html></html>");
+
+        auto cache = std::make_shared<file_cache>(dir.path);
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            CHECK_FALSE(ctrl.router().add_file_serving("/none", std::shared_ptr<file_cache>{ }));
+            REQUIRE(ctrl.router().add_file_serving("/files", cache, [] { return std::string{ "max-age=60" }; }));
+        } };
+
+        // The same file several times (concurrently served from the same descriptor)
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(std::string{
+            "GET /files/large.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /files/large.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /files/index.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /files/missing.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        }));
+
+        boost::beast::flat_buffer buffer;
+        for (int i = 0; i < 2; ++i) {
+            boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+            parser.body_limit(large.size());
+            boost::beast::http::read(socket, buffer, parser);
+            CHECK_EQ(parser.get().result(), status::ok);
+            CHECK_EQ(parser.get()[field::cache_control], "max-age=60");
+            CHECK(parser.get().body() == large);
+        }
+
+        response<> index;
+        boost::beast::http::read(socket, buffer, index);
+        CHECK_EQ(index.result(), status::ok);
+        CHECK_EQ(index[field::content_type], "text/html");
+        CHECK_EQ(index.body(), "<html></html>");
+
+        response<> missing;
+        boost::beast::http::read(socket, buffer, missing);
+        CHECK_EQ(missing.result(), status::not_found);
+
+        CHECK_EQ(cache->size(), 3);
+    }
+
+}
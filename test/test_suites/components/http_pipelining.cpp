@@ -0,0 +1,73 @@
+#include "../../test.hpp"
+
+#include <malloy/core/http/canned_response.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <string>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+namespace
+{
+    [[nodiscard]]
+    std::string
+    get(std::string_view target, std::string_view extra_fields = { })
+    {
+        return "GET " + std::string{target} + " HTTP/1.1\r\nHost: 127.0.0.1\r\n" + std::string{extra_fields} + "\r\n";
+    }
+}
+
+TEST_SUITE("components - http pipelining")
+{
+
+    TEST_CASE("responses are written in request order")
+    {
+        auto canned = [] {
+            response<> resp{ status::ok };
+            resp.body() = "[canned]";
+            resp.prepare_payload();
+            return canned_response::make(std::move(resp));
+        }();
+
+        malloy::test::server server{
+            [](ms::routing_context::config& cfg) {
+                cfg.pipeline_limit = 2;
+            },
+            [&](ms::routing_context& ctrl) {
+                ctrl.router().add(method::get, "/canned", [canned](const auto&) { return canned; });
+                ctrl.router().add(method::get, "/{id}", [](const auto&, const ms::route_captures& caps) {
+                    response<> resp{ status::ok };
+                    resp.body() = "[" + std::string{caps.at(0)} + "]";
+                    resp.prepare_payload();
+                    return resp;
+                });
+                ctrl.router().add(method::post, "/echo", [](const auto& req) {
+                    response<> resp{ status::ok };
+                    resp.body() = "[" + req.body() + "]";
+                    resp.prepare_payload();
+                    return resp;
+                });
+            }
+        };
+
+        SUBCASE("mixed responses")
+        {
+            const std::string requests =
+                get("/1") + get("/canned") + get("/canned") + get("/2") + get("/canned") + get("/3") +
+                "POST /echo HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 4\r\n\r\nbody" +
+                get("/4", "Connection: close\r\n") +
+                get("/5");  // Not answered
+
+            const std::string responses = server.exchange(requests);
+
+            std::string bodies;
+            for (auto pos = responses.find('['); pos != std::string::npos; pos = responses.find('[', pos + 1))
+                bodies += responses.substr(pos, responses.find(']', pos) - pos + 1);
+
+            CHECK_EQ(bodies, "[1][canned][canned][2][canned][3][body][4]");
+        }
+    }
+
+}
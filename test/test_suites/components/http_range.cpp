@@ -0,0 +1,319 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/core/http/file_cache.hpp>
+#include <malloy/core/http/generator.hpp>
+#include <malloy/core/http/range.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+using malloy::mock::temp_dir;
+
+namespace
+{
+    [[nodiscard]]
+    std::string
+    make_content(const std::size_t size)
+    {
+        std::string str(size, '\0');
+        for (std::size_t i = 0; i < size; ++i)
+            str[i] = static_cast<char>('a' + (i % 26));
+
+        return str;
+    }
+
+    template<class FileBodyValue>
+    [[nodiscard]]
+    std::string
+    read_all(FileBodyValue& body)
+    {
+        malloy::error_code ec;
+        std::string str(body.size(), '\0');
+        std::size_t n = 0;
+        while (n < str.size()) {
+            const auto read = body.file().read(str.data() + n, str.size() - n, ec);
+            if (ec || read == 0)
+                break;
+            n += read;
+        }
+        str.resize(n);
+
+        return str;
+    }
+
+    [[nodiscard]]
+    boost::beast::http::request_header<>
+    make_request(const std::string_view range, const std::string_view if_range = { })
+    {
+        boost::beast::http::request_header<> req;
+        req.method(method::get);
+        req.target("/data.txt");
+        if (!range.empty())
+            req.set(field::range, range);
+        if (!if_range.empty())
+            req.set(field::if_range, if_range);
+
+        return req;
+    }
+}
+
+TEST_SUITE("components - http range")
+{
+
+    TEST_CASE("parsing")
+    {
+        using ranges = std::vector<byte_range>;
+
+        SUBCASE("single ranges")
+        {
+            CHECK_EQ(parse_range("bytes=0-99", 1000), ranges{ { 0, 99 } });
+            CHECK_EQ(parse_range("bytes=100-", 1000), ranges{ { 100, 999 } });
+            CHECK_EQ(parse_range("bytes=-100", 1000), ranges{ { 900, 999 } });
+            CHECK_EQ(parse_range("bytes=-2000", 1000), ranges{ { 0, 999 } });
+            CHECK_EQ(parse_range("bytes=900-5000", 1000), ranges{ { 900, 999 } });
+            CHECK_EQ(parse_range(" Bytes = 1-1 ", 1000), ranges{ { 1, 1 } });
+        }
+
+        SUBCASE("multiple ranges are sorted & coalesced")
+        {
+            CHECK_EQ(parse_range("bytes=500-599, 0-99", 1000), ranges{ { 0, 99 }, { 500, 599 } });
+            CHECK_EQ(parse_range("bytes=0-99,50-149,150-199", 1000), ranges{ { 0, 199 } });
+            CHECK_EQ(parse_range("bytes=0-9,,-10", 1000), ranges{ { 0, 9 }, { 990, 999 } });
+        }
+
+        SUBCASE("unsatisfiable")
+        {
+            CHECK_EQ(parse_range("bytes=1000-", 1000), ranges{ });
+            CHECK_EQ(parse_range("bytes=1000-1999, 2000-", 1000), ranges{ });
+            CHECK_EQ(parse_range("bytes=-0", 1000), ranges{ });
+            CHECK_EQ(parse_range("bytes=0-", 0), ranges{ });
+            CHECK_EQ(parse_range("bytes=1000-, 0-0", 1000), ranges{ { 0, 0 } });
+        }
+
+        SUBCASE("ignored")
+        {
+            CHECK_FALSE(parse_range("", 1000));
+            CHECK_FALSE(parse_range("items=0-9", 1000));
+            CHECK_FALSE(parse_range("bytes=", 1000));
+            CHECK_FALSE(parse_range("bytes=9-0", 1000));
+            CHECK_FALSE(parse_range("bytes=a-b", 1000));
+            CHECK_FALSE(parse_range("bytes=0-9;x", 1000));
+            CHECK_FALSE(parse_range("bytes=0-1,2-3,4-5", 1000, 2));
+        }
+
+        SUBCASE("If-Range")
+        {
+            CHECK(if_range_matches("\"abc\"", "\"abc\"", { }));
+            CHECK_FALSE(if_range_matches("\"abc\"", "\"abd\"", { }));
+            CHECK_FALSE(if_range_matches("W/\"abc\"", "\"abc\"", { }));
+            CHECK_FALSE(if_range_matches("\"abc\"", { }, "Sun, 06 Nov 1994 08:49:37 GMT"));
+            CHECK(if_range_matches("Sun, 06 Nov 1994 08:49:37 GMT", { }, "Sun, 06 Nov 1994 08:49:37 GMT"));
+            CHECK_FALSE(if_range_matches("Sun, 06 Nov 1994 08:49:38 GMT", { }, "Sun, 06 Nov 1994 08:49:37 GMT"));
+        }
+    }
+
+    TEST_CASE("file range")
+    {
+        temp_dir dir{ "malloy_test_http_range_file" };
+        dir.write("data.txt", "0123456789");
+
+        malloy::error_code ec;
+        boost::beast::file f;
+        f.open((dir.path / "data.txt").string().c_str(), boost::beast::file_mode::scan, ec);
+        REQUIRE_FALSE(ec);
+
+        file_range<boost::beast::file> range{ std::move(f), { 2, 5 }, ec };
+        REQUIRE_FALSE(ec);
+        CHECK_EQ(range.size(ec), 4);
+        CHECK_EQ(range.pos(ec), 0);
+        CHECK_EQ(range.native_pos(ec), 2);
+
+        char buf[10] = { };
+        CHECK_EQ(range.read(buf, sizeof(buf), ec), 4);
+        CHECK_EQ(std::string_view{ buf, 4 }, "2345");
+        CHECK_EQ(range.read(buf, sizeof(buf), ec), 0);
+
+        range.seek(1, ec);
+        CHECK_EQ(range.read(buf, 2, ec), 2);
+        CHECK_EQ(std::string_view{ buf, 2 }, "34");
+    }
+
+    TEST_CASE("generator")
+    {
+        temp_dir dir{ "malloy_test_http_range_generator" };
+        const std::string content = make_content(1000);
+        dir.write("data.txt", content);
+
+        file_cache cache{ dir.path };
+
+        SUBCASE("whole file")
+        {
+            auto resp = generator::file(make_request({ }), dir.path, "data.txt");
+            REQUIRE(std::holds_alternative<response<boost::beast::http::file_body>>(resp));
+            auto& r = std::get<response<boost::beast::http::file_body>>(resp);
+            CHECK_EQ(r.result(), status::ok);
+            CHECK_EQ(r[field::accept_ranges], "bytes");
+            CHECK(r[field::last_modified].ends_with(" GMT"));
+            CHECK_EQ(r.body().size(), content.size());
+        }
+
+        SUBCASE("single range")
+        {
+            auto resp = generator::file(make_request("bytes=100-199"), dir.path, "data.txt");
+            REQUIRE(std::holds_alternative<response<file_range_body>>(resp));
+            auto& r = std::get<response<file_range_body>>(resp);
+            CHECK_EQ(r.result(), status::partial_content);
+            CHECK_EQ(r[field::content_range], "bytes 100-199/1000");
+            CHECK_EQ(r[field::content_type], "text/plain");
+            CHECK_EQ(r.body().size(), 100);
+            CHECK_EQ(read_all(r.body()), content.substr(100, 100));
+        }
+
+        SUBCASE("single range from cache")
+        {
+            auto resp = generator::file(make_request("bytes=-10"), cache, "data.txt");
+            REQUIRE(std::holds_alternative<response<shared_file_range_body>>(resp));
+            auto& r = std::get<response<shared_file_range_body>>(resp);
+            CHECK_EQ(r.result(), status::partial_content);
+            CHECK_EQ(r[field::content_range], "bytes 990-999/1000");
+            CHECK_EQ(read_all(r.body()), content.substr(990));
+        }
+
+        SUBCASE("multiple ranges")
+        {
+            auto resp = generator::file(make_request("bytes=0-9, 500-509"), cache, "data.txt");
+            REQUIRE(std::holds_alternative<response<>>(resp));
+            const auto& r = std::get<response<>>(resp);
+            CHECK_EQ(r.result(), status::partial_content);
+
+            const std::string_view content_type = r[field::content_type];
+            REQUIRE(content_type.starts_with("multipart/byteranges; boundary="));
+            const std::string boundary{ content_type.substr(content_type.find('=') + 1) };
+
+            const std::string expected =
+                "--" + boundary + "\r\n"
+                "Content-Type: text/plain\r\n"
+                "Content-Range: bytes 0-9/1000\r\n"
+                "\r\n" +
+                content.substr(0, 10) + "\r\n"
+                "--" + boundary + "\r\n"
+                "Content-Type: text/plain\r\n"
+                "Content-Range: bytes 500-509/1000\r\n"
+                "\r\n" +
+                content.substr(500, 10) + "\r\n"
+                "--" + boundary + "--\r\n";
+            CHECK_EQ(r.body(), expected);
+        }
+
+        SUBCASE("unsatisfiable")
+        {
+            const auto resp = generator::file(make_request("bytes=1000-"), dir.path, "data.txt");
+            REQUIRE(std::holds_alternative<response<>>(resp));
+            const auto& r = std::get<response<>>(resp);
+            CHECK_EQ(r.result(), status::range_not_satisfiable);
+            CHECK_EQ(r[field::content_range], "bytes */1000");
+        }
+
+        SUBCASE("If-Range")
+        {
+            const auto full = generator::file(make_request({ }), dir.path, "data.txt");
+            const std::string modified{ std::get<response<boost::beast::http::file_body>>(full)[field::last_modified] };
+
+            const auto valid = generator::file(make_request("bytes=0-9", modified), dir.path, "data.txt");
+            CHECK(std::holds_alternative<response<file_range_body>>(valid));
+
+            const auto outdated = generator::file(make_request("bytes=0-9", "Thu, 01 Jan 1970 00:00:00 GMT"), dir.path, "data.txt");
+            CHECK(std::holds_alternative<response<boost::beast::http::file_body>>(outdated));
+
+            const auto etag = generator::file(make_request("bytes=0-9", "\"abc\""), dir.path, "data.txt");
+            CHECK(std::holds_alternative<response<boost::beast::http::file_body>>(etag));
+        }
+
+        SUBCASE("ignored")
+        {
+            // Not a GET request
+            auto req = make_request("bytes=0-9");
+            req.method(method::head);
+            CHECK(std::holds_alternative<response<boost::beast::http::file_body>>(generator::file(req, dir.path, "data.txt")));
+
+            // Malformed
+            CHECK(std::holds_alternative<response<boost::beast::http::file_body>>(generator::file(make_request("bytes=9-0"), dir.path, "data.txt")));
+        }
+
+        SUBCASE("without request")
+        {
+            // The overloads which can't see a Range header keep their response types
+            auto resp = generator::file(dir.path, "data.txt");
+            static_assert(std::variant_size_v<decltype(resp)> == 2);
+            REQUIRE(std::holds_alternative<response<boost::beast::http::file_body>>(resp));
+            CHECK_EQ(std::get<response<boost::beast::http::file_body>>(resp).body().size(), content.size());
+
+            auto cached = generator::file(cache, "data.txt");
+            static_assert(std::variant_size_v<decltype(cached)> == 2);
+            REQUIRE(std::holds_alternative<response<shared_file_body>>(cached));
+
+            const auto missing = generator::file(dir.path, "missing.txt");
+            REQUIRE(std::holds_alternative<response<>>(missing));
+            CHECK_EQ(std::get<response<>>(missing).result(), status::not_found);
+        }
+    }
+
+    TEST_CASE("file serving")
+    {
+        temp_dir dir{ "malloy_test_http_range_serving" };
+        const std::string content = make_content(256 * 1024);
+        dir.write("data.txt", content);
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            REQUIRE(ctrl.router().add_file_serving("/files", dir.path));
+            REQUIRE(ctrl.router().add_file_serving("/cached", std::make_shared<file_cache>(dir.path)));
+        } };
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(std::string{
+            "GET /files/data.txt HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=1000-200999\r\n\r\n"
+            "GET /cached/data.txt HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=-5\r\n\r\n"
+            "GET /cached/data.txt HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=0-0,10-10\r\n\r\n"
+            "GET /files/data.txt HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=300000-\r\n\r\n"
+        }));
+
+        boost::beast::flat_buffer buffer;
+
+        boost::beast::http::response_parser<boost::beast::http::string_body> large;
+        large.body_limit(content.size());
+        boost::beast::http::read(socket, buffer, large);
+        CHECK_EQ(large.get().result(), status::partial_content);
+        CHECK_EQ(large.get()[field::content_range], "bytes 1000-200999/262144");
+        CHECK(large.get().body() == content.substr(1000, 200000));
+
+        response<> suffix;
+        boost::beast::http::read(socket, buffer, suffix);
+        CHECK_EQ(suffix.result(), status::partial_content);
+        CHECK_EQ(suffix.body(), content.substr(content.size() - 5));
+
+        response<> multipart;
+        boost::beast::http::read(socket, buffer, multipart);
+        CHECK_EQ(multipart.result(), status::partial_content);
+        CHECK(multipart[field::content_type].starts_with("multipart/byteranges"));
+
+        response<> unsatisfiable;
+        boost::beast::http::read(socket, buffer, unsatisfiable);
+        CHECK_EQ(unsatisfiable.result(), status::range_not_satisfiable);
+        CHECK_EQ(unsatisfiable[field::content_range], "bytes */262144");
+    }
+
+}
@@ -0,0 +1,142 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/offload_pool.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace malloy::http;
+using namespace std::chrono_literals;
+namespace ms = malloy::server;
+
+TEST_SUITE("components - offload pool")
+{
+
+    TEST_CASE("higher priority lanes are served first")
+    {
+        ms::offload_pool pool{ { .name = "test", .num_threads = 1, .num_lanes = 2 } };
+
+        // Keep the worker busy while queueing
+        std::promise<void> release;
+        std::promise<void> blocked;
+        pool.submit(0, [&] {
+            blocked.set_value();
+            release.get_future().wait();
+        });
+        blocked.get_future().wait();
+
+        std::mutex lock;
+        std::vector<std::string> order;
+        std::promise<void> done;
+        pool.submit(1, [&] { std::lock_guard l(lock); order.emplace_back("low"); });
+        pool.submit(0, [&] { std::lock_guard l(lock); order.emplace_back("high"); });
+        pool.submit(1, [&] { std::lock_guard l(lock); order.emplace_back("low"); done.set_value(); });
+
+        CHECK_EQ(pool.stats(0).depth, 1);
+        CHECK_EQ(pool.stats(1).depth, 2);
+
+        release.set_value();
+        REQUIRE_EQ(done.get_future().wait_for(5s), std::future_status::ready);
+
+        CHECK_EQ(order, std::vector<std::string>{ "high", "low", "low" });
+        CHECK_EQ(pool.stats(1).depth, 0);
+    }
+
+    TEST_CASE("the queue depth doesn't wrap while jobs are submitted concurrently")
+    {
+        constexpr std::size_t submitters = 4;
+        constexpr std::size_t jobs = 2000;
+
+        ms::offload_pool pool{ { .name = "test", .num_threads = 4 } };
+
+        std::atomic<std::size_t> max_depth = 0;
+        std::atomic<std::size_t> executed = 0;
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < submitters; t++) {
+            threads.emplace_back([&] {
+                for (std::size_t i = 0; i < jobs; i++) {
+                    pool.submit(0, [&] {
+                        const std::size_t depth = pool.stats(0).depth;
+                        std::size_t max = max_depth.load();
+                        while (depth > max && !max_depth.compare_exchange_weak(max, depth)) { }
+                        executed++;
+                    });
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+
+        for (int i = 0; i < 500 && executed < submitters * jobs; i++)
+            std::this_thread::sleep_for(10ms);
+
+        REQUIRE_EQ(executed, submitters * jobs);
+        CHECK_LE(max_depth, submitters * jobs);
+        CHECK_EQ(pool.stats(0).depth, 0);
+    }
+
+    TEST_CASE("async_run completes on the executor of the handler")
+    {
+        ms::offload_pool pool{ { .name = "test", .num_threads = 2 } };
+        boost::asio::io_context ioc;
+
+        int result = 0;
+        std::thread::id completion_thread;
+        pool.async_run(1, [] { return 42; }, boost::asio::bind_executor(ioc, [&](std::exception_ptr e, int r) {
+            CHECK_FALSE(e);
+            result = r;
+            completion_thread = std::this_thread::get_id();
+        }));
+
+        std::exception_ptr error;
+        pool.async_run(0, []() -> int { throw std::runtime_error{ "oops" }; }, boost::asio::bind_executor(ioc, [&](std::exception_ptr e, int) {
+            error = e;
+        }));
+
+        ioc.run();
+
+        CHECK_EQ(result, 42);
+        CHECK_EQ(completion_thread, std::this_thread::get_id());
+        CHECK(error);
+    }
+
+    TEST_CASE("offloaded routes")
+    {
+        auto pool = std::make_shared<ms::offload_pool>(ms::offload_pool::config{ .name = "reports", .num_threads = 2 });
+
+        malloy::test::server server{
+            [](ms::routing_context::config& cfg) {
+                cfg.num_threads = 1;
+            },
+            [&](ms::routing_context& ctrl) {
+                REQUIRE(ctrl.router().add_metrics("/metrics"));
+                REQUIRE(ctrl.router().add(method::get, "/report/{id}", [](const auto&, const ms::route_captures& caps) {
+                    std::this_thread::sleep_for(50ms);    // CPU-heavy work
+
+                    response<> resp{ status::ok };
+                    resp.body() = "report " + std::string{ caps.at(0) };
+                    return resp;
+                }, ms::offload_pool::policy{ .pool = pool, .lane = 1 }));
+                CHECK_FALSE(ctrl.router().add(method::get, "/nopool", [](const auto&) { return response<>{ status::ok }; }, ms::offload_pool::policy{ }));
+            }
+        };
+
+        CHECK(server.exchange("GET /report/7 HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n").ends_with("\r\n\r\nreport 7"));
+
+        const std::string metrics = server.exchange("GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n");
+        CHECK_NE(metrics.find("malloy_offload_queue_depth{pool=\"reports\",lane=\"1\"} 0\n"), std::string::npos);
+        CHECK_NE(metrics.find("malloy_offload_jobs_total{pool=\"reports\",lane=\"1\"} 1\n"), std::string::npos);
+    }
+
+}
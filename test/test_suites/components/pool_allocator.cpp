@@ -0,0 +1,102 @@
+#include "../../test.hpp"
+
+#include <malloy/core/detail/pool_allocator.hpp>
+
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+using namespace malloy::detail;
+
+namespace
+{
+    /**
+     * Memory resource counting the allocations it forwards upstream.
+     */
+    class counting_resource :
+        public std::pmr::memory_resource
+    {
+    public:
+        std::size_t allocations = 0;
+
+    private:
+        void*
+        do_allocate(const std::size_t bytes, const std::size_t alignment) override
+        {
+            allocations++;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void
+        do_deallocate(void* p, const std::size_t bytes, const std::size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        [[nodiscard]]
+        bool
+        do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+}
+
+TEST_SUITE("components - pool allocator")
+{
+
+    TEST_CASE("pooled objects don't allocate upstream once warm")
+    {
+        counting_resource upstream;
+        auto pool = std::make_shared<std::pmr::unsynchronized_pool_resource>(&upstream);
+        const pool_allocator<std::byte> alloc{ pool };
+
+        // The per-request objects of a connection
+        const auto request = [&] {
+            auto header_parser = std::allocate_shared<boost::beast::http::request_parser<boost::beast::http::empty_body>>(alloc);
+            auto body_parser = std::allocate_shared<boost::beast::http::request_parser<boost::beast::http::string_body>>(alloc, std::move(*header_parser));
+            auto response = std::allocate_shared<boost::beast::http::response<boost::beast::http::string_body>>(alloc);
+        };
+
+        request();
+        const std::size_t warm = upstream.allocations;
+        CHECK_GT(warm, 0);
+
+        for (int i = 0; i < 1000; i++)
+            request();
+        CHECK_EQ(upstream.allocations, warm);
+    }
+
+    TEST_CASE("objects keep the resource alive")
+    {
+        auto pool = std::make_shared<std::pmr::unsynchronized_pool_resource>();
+        std::weak_ptr<std::pmr::unsynchronized_pool_resource> weak = pool;
+
+        auto obj = std::allocate_shared<int>(pool_allocator<int>{ std::move(pool) }, 42);
+        CHECK_FALSE(weak.expired());
+
+        obj.reset();
+        CHECK(weak.expired());
+    }
+
+    TEST_CASE("objects can be released on another thread")
+    {
+        const pool_allocator<int> alloc{ std::make_shared<locked_pool_resource>(std::pmr::pool_options{ }) };
+
+        std::vector<std::shared_ptr<int>> objs;
+        for (int i = 0; i < 1000; i++)
+            objs.emplace_back(std::allocate_shared<int>(alloc, i));
+
+        // Released while the connection keeps allocating
+        std::thread releaser{ [objs = std::move(objs)]() mutable { objs.clear(); } };
+        for (int i = 0; i < 1000; i++)
+            CHECK_EQ(*std::allocate_shared<int>(alloc, i), i);
+        releaser.join();
+    }
+
+}
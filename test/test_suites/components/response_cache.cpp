@@ -0,0 +1,170 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing/response_cache.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+using namespace malloy::server;
+using namespace std::chrono_literals;
+
+namespace
+{
+    [[nodiscard]]
+    response<>
+    make_response(std::string body)
+    {
+        response<> resp{ status::ok };
+        resp.body() = std::move(body);
+        resp.prepare_payload();
+
+        return resp;
+    }
+}
+
+TEST_SUITE("components - response cache")
+{
+
+    TEST_CASE("make_key")
+    {
+        request<> req{ method::get, "localhost", 80, "/foo" };
+        req.set(field::accept_encoding, "gzip");
+
+        SUBCASE("method & target")
+        {
+            CHECK_EQ(response_cache::make_key(req.base(), { }), response_cache::make_key(method::get, "/foo"));
+            CHECK_NE(response_cache::make_key(method::get, "/foo"), response_cache::make_key(method::head, "/foo"));
+        }
+
+        SUBCASE("vary")
+        {
+            const std::vector<std::string> vary{ "Accept-Encoding", "X-Missing" };
+            const std::string_view values[] = { "gzip", "" };
+            CHECK_EQ(response_cache::make_key(req.base(), vary), response_cache::make_key(method::get, "/foo", values));
+        }
+    }
+
+    TEST_CASE("ttl & stale-while-revalidate")
+    {
+        auto cache = std::make_shared<response_cache>(1024 * 1024);
+        const response_cache::policy pol{ .cache = cache, .ttl = 10s, .stale_while_revalidate = 5s };
+        const auto t0 = response_cache::clock::now();
+
+        CHECK_FALSE(cache->get("k", t0));
+        REQUIRE(cache->put("k", make_response("a"), pol, t0));
+
+        SUBCASE("fresh")
+        {
+            const auto resp = cache->get("k", t0 + 9s);
+            REQUIRE(resp);
+            CHECK_EQ(resp->body(), "a");
+            CHECK_EQ(resp->fields(), "Age: 9\r\n");
+        }
+
+        SUBCASE("stale")
+        {
+            // The first lookup revalidates, others get the stale response meanwhile
+            CHECK_FALSE(cache->get("k", t0 + 11s));
+            CHECK(cache->get("k", t0 + 12s));
+
+            REQUIRE(cache->put("k", make_response("b"), pol, t0 + 13s));
+            const auto resp = cache->get("k", t0 + 14s);
+            REQUIRE(resp);
+            CHECK_EQ(resp->body(), "b");
+        }
+
+        SUBCASE("abandoned revalidation")
+        {
+            CHECK_FALSE(cache->get("k", t0 + 11s));
+            cache->abandon("k");
+            CHECK_FALSE(cache->get("k", t0 + 12s));
+        }
+
+        SUBCASE("expired")
+        {
+            CHECK_FALSE(cache->get("k", t0 + 15s));
+            CHECK_EQ(cache->size(), 0);
+        }
+    }
+
+    TEST_CASE("storable responses")
+    {
+        auto cache = std::make_shared<response_cache>(1024 * 1024);
+        const response_cache::policy pol{ .cache = cache };
+
+        CHECK_FALSE(cache->put("a", response<>{ status::not_found }, pol));
+
+        auto resp = make_response("a");
+        resp.set(field::cache_control, "private, no-store");
+        CHECK_FALSE(cache->put("a", resp, pol));
+        CHECK_FALSE(cache->put("a", canned_response::make(resp), pol));
+
+        CHECK_EQ(cache->size(), 0);
+    }
+
+    TEST_CASE("lru eviction")
+    {
+        const auto body = std::string(100, 'x');
+        const auto entry_bytes = [&] {
+            response_cache c{ 1024 };
+            c.put("a", make_response(body), { });
+            return c.bytes();
+        }();
+
+        response_cache cache{ 3 * entry_bytes };
+        const auto t0 = response_cache::clock::now();
+        cache.put("a", make_response(body), { }, t0);
+        cache.put("b", make_response(body), { }, t0);
+        cache.put("c", make_response(body), { }, t0);
+        CHECK(cache.get("a", t0));    // "b" is now the least recently used
+
+        cache.put("d", make_response(body), { }, t0);
+        CHECK_EQ(cache.size(), 3);
+        CHECK(cache.get("a", t0));
+        CHECK_FALSE(cache.get("b", t0));
+        CHECK(cache.get("c", t0));
+        CHECK(cache.get("d", t0));
+
+        SUBCASE("too large")
+        {
+            CHECK_FALSE(cache.put("e", make_response(std::string(4 * entry_bytes, 'x')), { }, t0));
+        }
+    }
+
+    TEST_CASE("invalidation")
+    {
+        response_cache cache{ 1024 * 1024 };
+        response_cache::policy tagged;
+        tagged.tags = { "users" };
+
+        cache.put("a", make_response("a"), tagged);
+        cache.put("b", make_response("b"), tagged);
+        cache.put("c", make_response("c"), { });
+
+        CHECK(cache.invalidate("c"));
+        CHECK_FALSE(cache.invalidate("c"));
+        CHECK_EQ(cache.invalidate_tag("users"), 2);
+        CHECK_EQ(cache.size(), 0);
+        CHECK_EQ(cache.bytes(), 0);
+    }
+
+    TEST_CASE("router")
+    {
+        router r;
+        auto cache = std::make_shared<response_cache>(1024 * 1024);
+
+        CHECK(r.add(method::get, "/foo", [](const auto&) { return generator::ok(); }, response_cache::policy{ .cache = cache }));
+        CHECK(r.add(method::get, "/users/{id}", [](const auto&, const route_captures&) { return generator::ok(); }, response_cache::policy{ .cache = cache }));
+        CHECK_FALSE(r.add(method::get, "/bar", [](const auto&) { return generator::ok(); }, response_cache::policy{ }));
+
+        SUBCASE("other router")
+        {
+            router other;
+            CHECK_FALSE(other.add(method::get, "/foo", [](const auto&) { return generator::ok(); }, response_cache::policy{ .cache = cache }));
+        }
+    }
+
+}
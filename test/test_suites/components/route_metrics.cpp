@@ -0,0 +1,95 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing/route_metrics.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+using namespace malloy::server;
+
+TEST_SUITE("components - route metrics")
+{
+
+    TEST_CASE("histogram buckets")
+    {
+        SUBCASE("latencies fall into the bucket bounding them")
+        {
+            for (std::uint64_t us = 0; us < (1ULL << 27); us = us * 3 / 2 + 1) {
+                const std::size_t bucket = route_metrics::histogram_bucket(us);
+                if (bucket == route_metrics::histogram_buckets)
+                    continue;
+
+                CHECK_LT(us, route_metrics::histogram_bucket_bound(bucket));
+                if (bucket > 0)
+                    CHECK_GE(us, route_metrics::histogram_bucket_bound(bucket - 1));
+            }
+        }
+
+        SUBCASE("bounds are increasing")
+        {
+            for (std::size_t i = 1; i < route_metrics::histogram_buckets; i++)
+                CHECK_GT(route_metrics::histogram_bucket_bound(i), route_metrics::histogram_bucket_bound(i - 1));
+        }
+
+        SUBCASE("overflow")
+        {
+            CHECK_EQ(route_metrics::histogram_bucket(~std::uint64_t{0}), route_metrics::histogram_buckets);
+        }
+    }
+
+    TEST_CASE("record")
+    {
+        route_metrics m;
+        const std::size_t foo = m.add_route(method::get, "/foo");
+        const std::size_t bar = m.add_route(method::post, "/bar");
+
+        m.record_request(foo, 10);
+        m.record_request(foo, 20);
+        m.record_response(foo, 200, 100, std::chrono::milliseconds{3});
+        m.record_response(foo, 404, 50, std::chrono::milliseconds{1});
+
+        const auto s = m.read(foo);
+        CHECK_EQ(s.requests, 2);
+        CHECK_EQ(s.bytes_in, 30);
+        CHECK_EQ(s.bytes_out, 150);
+        CHECK_EQ(s.responses[1], 1);
+        CHECK_EQ(s.responses[3], 1);
+        CHECK_EQ(s.latency_sum_us, 4000);
+        CHECK_EQ(s.latency[route_metrics::histogram_bucket(3000)], 1);
+        CHECK_EQ(s.latency[route_metrics::histogram_bucket(1000)], 1);
+
+        CHECK_EQ(m.read(bar).requests, 0);
+    }
+
+    TEST_CASE("render")
+    {
+        route_metrics m;
+        const std::size_t foo = m.add_route(method::get, "/foo");
+        m.record_request(foo, 0);
+        m.record_response(foo, 200, 100, std::chrono::milliseconds{3});
+
+        auto child = std::make_shared<route_metrics>();
+        child->add_route(method::unknown, "/\"bar\"");
+        m.add_child("/api", child);
+
+        const std::string out = m.render();
+        CHECK_NE(out.find(R"(malloy_http_requests_total{method="GET",route="/foo"} 1)"), std::string::npos);
+        CHECK_NE(out.find(R"(malloy_http_responses_total{method="GET",route="/foo",code="2xx"} 1)"), std::string::npos);
+        CHECK_NE(out.find(R"(malloy_http_request_duration_seconds_count{method="GET",route="/foo"} 1)"), std::string::npos);
+        CHECK_NE(out.find(R"(malloy_http_request_duration_seconds_bucket{method="GET",route="/foo",le="+Inf"} 1)"), std::string::npos);
+        CHECK_NE(out.find(R"(malloy_http_requests_total{method="*",route="/api/\"bar\""} 0)"), std::string::npos);
+    }
+
+    TEST_CASE("router")
+    {
+        router r;
+        r.add(method::get, "/foo", [](const auto&) { return generator::ok(); });
+
+        CHECK(r.add_metrics("/metrics"));
+        CHECK(r.add_subrouter("/api", std::make_unique<router>()));
+    }
+
+}
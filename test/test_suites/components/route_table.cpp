@@ -0,0 +1,219 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing/route_table.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace malloy::server;
+
+namespace
+{
+    const auto accept_all = [](std::size_t) { return true; };
+}
+
+TEST_SUITE("components - route table")
+{
+
+    TEST_CASE("to_pattern")
+    {
+        SUBCASE("literal paths are indexable")
+        {
+            CHECK_EQ(route_table::to_pattern("/"), "/");
+            CHECK_EQ(route_table::to_pattern("/foo/bar"), "/foo/bar");
+            CHECK_EQ(route_table::to_pattern("^/foo$"), "/foo");
+        }
+
+        SUBCASE("parameters are indexable")
+        {
+            CHECK_EQ(route_table::to_pattern("/users/{id}"), "/users/{id}");
+            CHECK_EQ(route_table::to_pattern("/users/{id}/posts/{post_id}"), "/users/{id}/posts/{post_id}");
+        }
+
+        SUBCASE("regular expressions are not indexable")
+        {
+            CHECK_FALSE(route_table::to_pattern(""));
+            CHECK_FALSE(route_table::to_pattern("foo"));
+            CHECK_FALSE(route_table::to_pattern("/foo/\\w+"));
+            CHECK_FALSE(route_table::to_pattern("/foo/(\\d+)"));
+            CHECK_FALSE(route_table::to_pattern("/index.html"));
+            CHECK_FALSE(route_table::to_pattern("/foo?bar"));
+            CHECK_FALSE(route_table::to_pattern("/foo/a{2}"));
+            CHECK_FALSE(route_table::to_pattern("/foo/{id}x"));
+            CHECK_FALSE(route_table::to_pattern("/foo/{}"));
+        }
+    }
+
+    TEST_CASE("to_regex")
+    {
+        CHECK_EQ(route_table::to_regex("/foo"), "/foo");
+        CHECK_EQ(route_table::to_regex("/users/{id}/posts"), "/users/([^/?#]+)/posts");
+    }
+
+    TEST_CASE("find")
+    {
+        route_table t;
+        REQUIRE(t.empty());
+
+        CHECK(t.insert("/", 0));
+        CHECK(t.insert("/users", 1));
+        CHECK(t.insert("/users/{id}", 2));
+        CHECK(t.insert("/users/me", 3));
+        CHECK(t.insert("/users/{id}/posts/{post}", 4));
+        CHECK(t.insert("/users/{id}/profile", 5));
+        CHECK_FALSE(t.empty());
+
+        SUBCASE("literal")
+        {
+            const auto m = t.find("/users", accept_all);
+            REQUIRE(m);
+            CHECK_EQ(m->id, 1);
+            CHECK(m->params.empty());
+        }
+
+        SUBCASE("parameter")
+        {
+            const auto m = t.find("/users/42", accept_all);
+            REQUIRE(m);
+            CHECK_EQ(m->id, 2);
+            REQUIRE_EQ(m->params.size(), 1);
+            CHECK_EQ(m->params[0], "42");
+        }
+
+        SUBCASE("multiple parameters")
+        {
+            const auto m = t.find("/users/42/posts/abc", accept_all);
+            REQUIRE(m);
+            CHECK_EQ(m->id, 4);
+            REQUIRE_EQ(m->params.size(), 2);
+            CHECK_EQ(m->params[0], "42");
+            CHECK_EQ(m->params[1], "abc");
+        }
+
+        SUBCASE("lowest identifier wins")
+        {
+            const auto m = t.find("/users/me", accept_all);
+            REQUIRE(m);
+            CHECK_EQ(m->id, 2);
+        }
+
+        SUBCASE("predicate")
+        {
+            const auto m = t.find("/users/me", [](std::size_t id) { return id != 2; });
+            REQUIRE(m);
+            CHECK_EQ(m->id, 3);
+
+            CHECK_FALSE(t.find("/users", [](std::size_t) { return false; }));
+        }
+
+        SUBCASE("no match")
+        {
+            CHECK_FALSE(t.find("", accept_all));
+            CHECK_FALSE(t.find("/foo", accept_all));
+            CHECK_FALSE(t.find("/users/", accept_all));
+            CHECK_FALSE(t.find("/users/42?foo=bar", accept_all));
+            CHECK_FALSE(t.find("/users/42/posts", accept_all));
+            CHECK_FALSE(t.find("/users/42/profile/x", accept_all));
+        }
+    }
+
+    TEST_CASE("find_prefix")
+    {
+        route_table t;
+        CHECK(t.insert_prefix("/api", 0));
+        CHECK(t.insert_prefix("/api/v2", 1));
+        CHECK(t.insert_prefix("/static", 2));
+        CHECK_FALSE(t.insert_prefix("/api", 3));
+
+        SUBCASE("longest prefix wins")
+        {
+            const auto m = t.find_prefix("/api/v2/users");
+            REQUIRE(m);
+            CHECK_EQ(m->first, 1);
+            CHECK_EQ(m->second, 7);
+        }
+
+        SUBCASE("shorter prefix")
+        {
+            const auto m = t.find_prefix("/api/v1/users");
+            REQUIRE(m);
+            CHECK_EQ(m->first, 0);
+            CHECK_EQ(m->second, 4);
+        }
+
+        SUBCASE("exact")
+        {
+            const auto m = t.find_prefix("/static");
+            REQUIRE(m);
+            CHECK_EQ(m->first, 2);
+        }
+
+        SUBCASE("no match")
+        {
+            CHECK_FALSE(t.find_prefix("/"));
+            CHECK_FALSE(t.find_prefix("/ap"));
+            CHECK_FALSE(t.find_prefix("/foo"));
+        }
+    }
+
+    TEST_CASE("literal_prefix")
+    {
+        CHECK_EQ(route_table::literal_prefix("/restricted"), "/restricted");
+        CHECK_EQ(route_table::literal_prefix("^/admin(/.+)?$"), "/admin");
+        CHECK_EQ(route_table::literal_prefix("/files/\\d+"), "/files/");
+        CHECK_EQ(route_table::literal_prefix("/users?"), "/user");
+        CHECK_EQ(route_table::literal_prefix("/a*"), "/");
+        CHECK_EQ(route_table::literal_prefix("/a+"), "/a");
+        CHECK_EQ(route_table::literal_prefix(".*"), "");
+        CHECK_EQ(route_table::literal_prefix("/foo|/bar"), "");
+    }
+
+    TEST_CASE("normalize")
+    {
+        CHECK_EQ(route_table::normalize("/users/\\d+"), "/users/\\d+");
+        CHECK_EQ(route_table::normalize("/users/(\\d+)"), "/users/\\d+");
+        CHECK_EQ(route_table::normalize("^/users/(?:\\d+)$"), "/users/\\d+");
+        CHECK_EQ(route_table::normalize("/users/{id}"), route_table::normalize("/users/([^/?#]+)"));
+        CHECK_EQ(route_table::normalize("/users/{id}"), route_table::normalize("/users/{uid}"));
+
+        // Groups which matter are kept
+        CHECK_EQ(route_table::normalize("/a(/b)?"), "/a(?:/b)?");
+        CHECK_EQ(route_table::normalize("/(a|b)"), "/(?:a|b)");
+        CHECK_EQ(route_table::normalize("/a(?!b)"), "/a(?!b)");
+        CHECK_EQ(route_table::normalize("/[()]"), "/[()]");
+        CHECK_EQ(route_table::normalize("/\\(x\\)"), "/\\(x\\)");
+    }
+
+    TEST_CASE("for_each_prefix")
+    {
+        route_table t;
+
+        // 50 prefixes of which only a few apply to any given path
+        for (std::size_t i = 0; i < 50; i++)
+            t.insert_shared_prefix("/resource" + std::to_string(i), i);
+        t.insert_shared_prefix("", 50);
+        t.insert_shared_prefix("/resource1", 51);
+
+        std::vector<std::size_t> visited;
+        const auto visit = [&visited](const std::size_t id) { visited.emplace_back(id); };
+
+        SUBCASE("shortest prefix first")
+        {
+            t.for_each_prefix("/resource12/foo", visit);
+            CHECK_EQ(visited, std::vector<std::size_t>{ 50, 1, 51, 12 });
+        }
+
+        SUBCASE("exact")
+        {
+            t.for_each_prefix("/resource7", visit);
+            CHECK_EQ(visited, std::vector<std::size_t>{ 50, 7 });
+        }
+
+        SUBCASE("only the empty prefix")
+        {
+            t.for_each_prefix("/foo", visit);
+            CHECK_EQ(visited, std::vector<std::size_t>{ 50 });
+        }
+    }
+
+}
@@ -2,8 +2,16 @@
 #include "../../coroutine_executor.hpp"
 
 #include <malloy/server/routing/router.hpp>
+#include <malloy/server/routing/router_handle.hpp>
 #include <malloy/server/routing_context.hpp>
 
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+
+#include <chrono>
+#include <thread>
+
 using namespace malloy::http;
 using namespace malloy::server;
 
@@ -49,6 +57,197 @@ TEST_SUITE("components - router")
         }
     }
 
+    TEST_CASE("add [policy]")
+    {
+        router r;
+        const auto policy = [](const auto&) -> std::optional<response<>> { return std::nullopt; };
+
+        SUBCASE("valid")
+        {
+            CHECK(r.add_policy("/admin(/.+)?", policy));
+        }
+
+        SUBCASE("invalid regex")
+        {
+            CHECK_FALSE(r.add_policy("/admin(", policy));
+        }
+    }
+
+    TEST_CASE("add [preflight]")
+    {
+        router r;
+        REQUIRE(r.add(method::get, "/foo", [](const auto&) { return generator::ok(); }));
+
+        SUBCASE("valid")
+        {
+            CHECK(r.add_preflight("/foo", http::preflight_config{}));
+            CHECK(r.add(method::post, "/foo", [](const auto&) { return generator::ok(); }));
+        }
+
+        SUBCASE("invalid regex")
+        {
+            CHECK_FALSE(r.add_preflight("/foo(", http::preflight_config{}));
+        }
+    }
+
+    TEST_CASE("preflight response")
+    {
+        http::preflight_config cfg;
+        cfg.origin = "http://example.com";
+        const std::vector<method> methods{ method::get, method::post };
+
+        SUBCASE("defaults")
+        {
+            response<> resp{status::ok};
+            cfg.setup_response(resp, methods);
+
+            CHECK(resp["Access-Control-Allow-Origin"] == "http://example.com");
+            CHECK(resp["Access-Control-Allow-Methods"] == "GET, POST");
+            CHECK_EQ(resp.count("Access-Control-Allow-Headers"), 0);
+            CHECK_EQ(resp.count("Access-Control-Allow-Credentials"), 0);
+            CHECK_EQ(resp.count("Access-Control-Max-Age"), 0);
+        }
+
+        SUBCASE("caching & credentials")
+        {
+            cfg.allowed_headers = { "Content-Type", "Authorization" };
+            cfg.allow_credentials = true;
+            cfg.max_age = std::chrono::minutes(10);
+
+            response<> resp{status::ok};
+            cfg.setup_response(resp, methods);
+
+            CHECK(resp["Access-Control-Allow-Headers"] == "Content-Type, Authorization");
+            CHECK(resp["Access-Control-Allow-Credentials"] == "true");
+            CHECK(resp["Access-Control-Max-Age"] == "600");
+        }
+    }
+
+    TEST_CASE("preflight methods")
+    {
+        const auto ok = [](const auto&) { return generator::ok(); };
+
+        malloy::test::server server{ [&](routing_context& ctrl) {
+            auto& r = ctrl.router();
+            REQUIRE(r.add(method::get, "/users/(\\d+)", ok));
+            REQUIRE(r.add(method::get, "/items/{id}", ok));
+            REQUIRE(r.add(method::post, "/other", ok));
+
+            REQUIRE(r.add_preflight("/users/\\d+", http::preflight_config{}));
+            REQUIRE(r.add_preflight("/items/{item}", http::preflight_config{}));
+            REQUIRE(r.add_preflight("/api/.*", http::preflight_config{}));
+
+            // Added after the preflights
+            REQUIRE(r.add(method::put, "^/users/(?:\\d+)$", ok));
+            REQUIRE(r.add(method::patch, "/users/{id}", ok));
+            REQUIRE(r.add(method::delete_, "/items/([^/?#]+)", ok));
+            REQUIRE(r.add(method::post, "/api/orders", ok));
+            REQUIRE(r.add(method::patch, "/api/orders/{id}", ok));
+            REQUIRE(r.add(method::get, "/api/orders/{id}", ok));
+        } };
+
+        // The methods of the routes matching the target of each request
+        const std::vector<std::pair<std::string_view, std::string_view>> expected{
+            { "/users/42",      "GET, PUT, PATCH" },
+            { "/items/abc",     "GET, DELETE" },
+            { "/api/orders",    "POST" },
+            { "/api/orders/7",  "PATCH, GET" },
+            { "/api/other",     "" },
+            { "/users/43",      "GET, PUT, PATCH" },
+        };
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        std::string requests;
+        for (const auto& [target, _] : expected)
+            requests += "OPTIONS " + std::string{ target } + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        boost::asio::write(socket, boost::asio::buffer(requests));
+
+        boost::beast::flat_buffer buffer;
+        for (const auto& [target, methods] : expected) {
+            CAPTURE(target);
+            response<> resp;
+            boost::beast::http::read(socket, buffer, resp);
+            CHECK_EQ(resp.result(), status::ok);
+            CHECK_EQ(resp["Access-Control-Allow-Methods"], methods);
+            CHECK_EQ(resp[field::server], "malloy");
+        }
+    }
+
+    TEST_CASE("endpoint without handler")
+    {
+        router r;
+        CHECK_FALSE(r.add(method::get, "/foo", std::function<response<>(const request<>&)>{ }));
+        CHECK_FALSE(r.add(method::get, "/foo/{id}", std::function<response<>(const request<>&, const route_captures&)>{ }));
+    }
+
+    TEST_CASE("router handle")
+    {
+        router_handle handle{"malloy"};
+        CHECK_FALSE(handle.load());
+        CHECK_FALSE(handle.publish(nullptr));
+
+        auto first = std::make_shared<router>();
+        REQUIRE(handle.publish(first));
+        CHECK_EQ(handle.load(), first);
+        CHECK_EQ(first->server_string(), "malloy");
+
+        // A snapshot taken before publishing remains valid
+        const auto snapshot = handle.load();
+        auto second = std::make_shared<router>();
+        REQUIRE(handle.publish(second));
+        first.reset();
+        CHECK_EQ(handle.load(), second);
+        CHECK_EQ(snapshot->server_string(), "malloy");
+    }
+
+    TEST_CASE("replacing the router of a running server")
+    {
+        const auto respond = [](std::string body) {
+            return [body = std::move(body)](const auto&) {
+                response<> resp{ status::ok };
+                resp.body() = body;
+                return resp;
+            };
+        };
+
+        std::shared_ptr<malloy::server::router_handle> handle;
+        malloy::test::server server{ [&](routing_context& ctrl) {
+            handle = ctrl.router_handle();
+            REQUIRE(ctrl.router().add(method::get, "/", respond("old")));
+        } };
+
+        // The routing context is gone, its router lives on
+        std::weak_ptr<router> old = handle->load();
+        REQUIRE_FALSE(old.expired());
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::beast::flat_buffer buffer;
+        const std::string req = "GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+
+        boost::asio::write(socket, boost::asio::buffer(req));
+        response<> first;
+        boost::beast::http::read(socket, buffer, first);
+        CHECK_EQ(first.body(), "old");
+        CHECK_EQ(first[field::server], "malloy");
+
+        auto replacement = std::make_shared<router>();
+        REQUIRE(replacement->add(method::get, "/", respond("new")));
+        REQUIRE(handle->publish(std::move(replacement)));
+
+        // The old router is released once the requests handled by it are done (the connection does not hold it)
+        for (int i = 0; i < 100 && !old.expired(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        CHECK(old.expired());
+
+        boost::asio::write(socket, boost::asio::buffer(req));
+        response<> second;
+        boost::beast::http::read(socket, buffer, second);
+        CHECK_EQ(second.body(), "new");
+        CHECK_EQ(second[field::server], "malloy");
+    }
+
     TEST_CASE("add [redirect]")
     {
         router r;
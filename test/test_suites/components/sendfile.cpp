@@ -0,0 +1,201 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/core/tcp/sendfile.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+    #include <boost/asio/posix/stream_descriptor.hpp>
+
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+namespace
+{
+    [[nodiscard]]
+    std::string
+    make_payload(const std::size_t size)
+    {
+        std::string payload(size, '\0');
+        for (std::size_t i = 0; i < size; ++i)
+            payload[i] = static_cast<char>('a' + (i * 7) % 26);
+
+        return payload;
+    }
+
+    /**
+     * A connected pair of TCP sockets.
+     */
+    struct socket_pair
+    {
+        boost::asio::io_context ioc;
+        boost::asio::ip::tcp::socket client{ ioc };
+        boost::asio::ip::tcp::socket server{ ioc };
+
+        socket_pair()
+        {
+            boost::asio::ip::tcp::acceptor acceptor{ ioc, { boost::asio::ip::make_address("127.0.0.1"), 0 } };
+            client.connect(acceptor.local_endpoint());
+            acceptor.accept(server);
+        }
+    };
+}
+
+TEST_SUITE("components - sendfile")
+{
+
+#if defined(__linux__)
+    TEST_CASE("async_sendfile")
+    {
+        const std::string payload = make_payload(3 * 1024 * 1024 + 17);
+
+        SUBCASE("regular file")
+        {
+            const auto path = std::filesystem::temp_directory_path() / "malloy_test_sendfile.bin";
+            std::ofstream{ path, std::ios::binary } << payload;
+
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            REQUIRE(fd >= 0);
+
+            socket_pair sp;
+            malloy::error_code sent_ec;
+            std::uint64_t sent = 0;
+            malloy::tcp::async_sendfile(sp.server, fd, 5, payload.size() - 5, [&](const malloy::error_code ec, const std::uint64_t n) {
+                sent_ec = ec;
+                sent = n;
+                sp.server.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+            });
+
+            std::string received;
+            boost::asio::async_read(sp.client, boost::asio::dynamic_buffer(received), [](malloy::error_code, std::size_t) { });
+            sp.ioc.run();
+
+            ::close(fd);
+            std::filesystem::remove(path);
+
+            CHECK_FALSE(sent_ec);
+            CHECK_EQ(sent, payload.size() - 5);
+            CHECK(received == payload.substr(5));
+        }
+
+        SUBCASE("pipe")
+        {
+            int fds[2];
+            REQUIRE_EQ(::pipe(fds), 0);
+
+            socket_pair sp;
+            malloy::error_code sent_ec;
+            std::uint64_t sent = 0;
+            malloy::tcp::async_sendfile(sp.server, fds[0], 0, payload.size(), [&](const malloy::error_code ec, const std::uint64_t n) {
+                sent_ec = ec;
+                sent = n;
+                sp.server.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+            });
+
+            std::string received;
+            boost::asio::async_read(sp.client, boost::asio::dynamic_buffer(received), [](malloy::error_code, std::size_t) { });
+
+            // Feed the pipe while the transfer is in progress
+            std::thread feeder{ [&] {
+                boost::asio::posix::stream_descriptor writer{ sp.ioc, fds[1] };
+                boost::asio::write(writer, boost::asio::buffer(payload));
+            } };
+            sp.ioc.run();
+            feeder.join();
+
+            ::close(fds[0]);
+
+            CHECK_FALSE(sent_ec);
+            CHECK_EQ(sent, payload.size());
+            CHECK(received == payload);
+        }
+
+        SUBCASE("stalled reader")
+        {
+            const auto path = std::filesystem::temp_directory_path() / "malloy_test_sendfile_stalled.bin";
+            std::ofstream{ path, std::ios::binary } << payload;
+
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            REQUIRE(fd >= 0);
+
+            // The client never reads (and the buffers fill up quickly)
+            socket_pair sp;
+            sp.client.set_option(boost::asio::socket_base::receive_buffer_size{ 4096 });
+            sp.server.set_option(boost::asio::socket_base::send_buffer_size{ 4096 });
+            malloy::error_code sent_ec;
+            std::uint64_t sent = 0;
+            malloy::tcp::async_sendfile(sp.server, fd, 0, payload.size(), std::chrono::milliseconds{ 100 }, [&](const malloy::error_code ec, const std::uint64_t n) {
+                sent_ec = ec;
+                sent = n;
+            });
+            sp.ioc.run();
+
+            ::close(fd);
+            std::filesystem::remove(path);
+
+            CHECK_EQ(sent_ec, boost::asio::error::timed_out);
+            CHECK_LT(sent, payload.size());
+        }
+    }
+#endif
+
+    TEST_CASE("file serving")
+    {
+        malloy::mock::temp_dir dir{ "malloy_test_file_serving" };
+        const std::string large = make_payload(2 * 1024 * 1024 + 3);
+        const std::string small = "<html></html>";
+        dir.write("large.bin", large);
+        dir.write("small.html", small);
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            ctrl.router().add_file_serving("/files", dir.path);
+        } };
+
+        // Pipelined requests (the responses must not interleave)
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(std::string{
+            "GET /files/large.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /files/small.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "GET /files/missing.html HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+        }));
+
+        boost::beast::flat_buffer buffer;
+
+        boost::beast::http::response_parser<boost::beast::http::string_body> parser;
+        parser.body_limit(large.size());
+        boost::beast::http::read(socket, buffer, parser);
+        CHECK_EQ(parser.get().result(), status::ok);
+        CHECK(parser.get().body() == large);
+
+        response<> resp;
+        boost::beast::http::read(socket, buffer, resp);
+        CHECK_EQ(resp.result(), status::ok);
+        CHECK_EQ(resp[field::content_type], "text/html");
+        CHECK_EQ(resp.body(), small);
+
+        response<> missing;
+        boost::beast::http::read(socket, buffer, missing);
+        CHECK_EQ(missing.result(), status::not_found);
+    }
+
+}
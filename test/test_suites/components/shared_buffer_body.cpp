@@ -0,0 +1,97 @@
+#include "../../test.hpp"
+
+#include <malloy/core/http/filters/shared_buffer.hpp>
+#include <malloy/core/http/generator.hpp>
+#include <malloy/core/http/shared_buffer_body.hpp>
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <boost/beast/http/parser.hpp>
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+TEST_SUITE("components - shared buffer body")
+{
+
+    TEST_CASE("copies share the buffer")
+    {
+        const auto payload = std::make_shared<const std::string>("{\"sprite\": true}");
+
+        auto resp = generator::ok(payload, "application/json");
+        const auto copy = resp;
+
+        CHECK_EQ(copy.body().data(), payload->data());
+        CHECK_EQ(payload.use_count(), 3);
+        CHECK_EQ(resp[field::content_length], std::to_string(payload->size()));
+    }
+
+    TEST_CASE("views with an owner")
+    {
+        const auto owner = std::make_shared<const std::string>("0123456789");
+
+        shared_buffer_body::value_type body{ owner, std::string_view{ *owner }.substr(2, 3) };
+        CHECK_EQ(body.view(), "234");
+        CHECK_EQ(body.owner(), owner);
+    }
+
+    TEST_CASE("serialize")
+    {
+        response<shared_buffer_body> resp{ status::ok };
+        resp.body() = std::make_shared<const std::string>("hello");
+        resp.prepare_payload();
+
+        std::ostringstream ss;
+        ss << resp;
+
+        CHECK(ss.str().ends_with("Content-Length: 5\r\n\r\nhello"));
+    }
+
+    TEST_CASE("parse")
+    {
+        boost::beast::http::response_parser<shared_buffer_body> parser;
+        malloy::error_code ec;
+        const std::string raw = "HTTP/1.1 200 OK\r\nContent-Length: 11\r\n\r\nhello world";
+        std::string_view rest{ raw };
+        while (!ec && !rest.empty() && !parser.is_done())
+            rest.remove_prefix(parser.put(boost::asio::buffer(rest), ec));
+
+        REQUIRE_FALSE(ec);
+        REQUIRE(parser.is_done());
+        CHECK_EQ(parser.get().body().view(), "hello world");
+    }
+
+    TEST_CASE("router")
+    {
+        const auto payload = std::make_shared<const std::string>(64 * 1024, 'x');
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            ctrl.router().add(method::get, "/payload", [payload](const auto&) {
+                return generator::ok(payload, "application/octet-stream");
+            });
+            ctrl.router().add(method::post, "/echo", [](const request<shared_buffer_body>& req) {
+                return generator::ok(req.body(), "text/plain");
+            }, filters::shared_buffer_request{ });
+        } };
+
+        SUBCASE("shared payload")
+        {
+            for (int i = 0; i < 3; i++) {
+                const std::string resp = server.exchange("GET /payload HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n");
+                CHECK(resp.ends_with("\r\n\r\n" + *payload));
+            }
+        }
+
+        SUBCASE("request filter")
+        {
+            const std::string resp = server.exchange("POST /echo HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello");
+            CHECK(resp.ends_with("\r\n\r\nhello"));
+        }
+    }
+
+}
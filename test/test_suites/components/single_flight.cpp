@@ -0,0 +1,206 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/server/routing/endpoint_http_coalescing.hpp>
+#include <malloy/server/routing/router.hpp>
+#include <malloy/server/routing/single_flight.hpp>
+
+#include <boost/asio/write.hpp>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace malloy::http;
+using namespace malloy::server;
+
+namespace
+{
+    /**
+     * Endpoint counting how often it was handled.
+     */
+    struct counting_endpoint :
+        endpoint_http
+    {
+        mutable std::size_t handled = 0;
+
+        [[nodiscard]]
+        handle_retr
+        handle(const req_t&, const http::connection_t&) const override
+        {
+            handled++;
+            return std::nullopt;
+        }
+    };
+
+    [[nodiscard]]
+    endpoint_http::req_t
+    make_request(const std::string& target)
+    {
+        request_header<> header;
+        header.method(method::get);
+        header.target(target);
+
+        return std::make_shared<malloy::mock::http::connection::request_generator>(header);
+    }
+
+    const http::connection_t no_connection{ std::shared_ptr<http::connection_plain>{ nullptr } };
+}
+
+TEST_SUITE("components - single flight")
+{
+
+    TEST_CASE("join & complete")
+    {
+        single_flight flight;
+        const auto req = make_request("/foo");
+        const auto resp = canned_response::make(generator::ok());
+
+        CHECK(flight.join("a", req, no_connection));
+        CHECK_FALSE(flight.join("a", req, no_connection));
+        CHECK_FALSE(flight.join("a", req, no_connection));
+        CHECK(flight.join("b", req, no_connection));
+        CHECK_EQ(flight.size(), 2);
+
+        CHECK_EQ(flight.complete("a", resp), 2);
+        CHECK_EQ(flight.complete("a", resp), 0);
+        CHECK_EQ(flight.complete("b", resp), 0);
+        CHECK_EQ(flight.size(), 0);
+
+        // A new flight starts once the previous one completed
+        CHECK(flight.join("a", req, no_connection));
+    }
+
+    TEST_CASE("leader goes away")
+    {
+        auto flight = std::make_shared<single_flight>();
+        auto leader = std::make_shared<malloy::mock::http::connection::request_generator>(request_header<>{ });
+
+        REQUIRE(flight->join("a", leader, no_connection));
+        CHECK_FALSE(flight->join("a", make_request("/foo"), no_connection));
+        CHECK_EQ(flight->size(), 1);
+
+        SUBCASE("completed")
+        {
+            CHECK_EQ(flight->complete("a", canned_response::make(generator::ok())), 1);
+            const auto new_leader = make_request("/foo");
+            REQUIRE(flight->join("a", new_leader, no_connection));
+
+            // The old leader doesn't abandon the new flight
+            leader.reset();
+            CHECK_EQ(flight->size(), 1);
+        }
+
+        SUBCASE("abandoned")
+        {
+            leader.reset();
+            CHECK_EQ(flight->size(), 0);
+        }
+    }
+
+    TEST_CASE("parked requests are answered once the leader is gone")
+    {
+        const auto make_server = [](const std::chrono::milliseconds timeout) {
+            return std::make_unique<malloy::test::server>([timeout](malloy::server::routing_context& ctrl) {
+                REQUIRE(ctrl.router().add(method::get, "/slow", [](const auto&) { return generator::ok(); }, single_flight::policy{ .timeout = timeout }));
+            });
+        };
+
+        // The leader's body is never sent completely (requests are given some time to reach the server)
+        const auto lead = [](boost::asio::ip::tcp::socket& socket, const std::string_view target = "/slow") {
+            boost::asio::write(socket, boost::asio::buffer(
+                "GET " + std::string{ target } + " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 10\r\n\r\nabc"
+            ));
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 200 });
+        };
+
+        const auto park = [](boost::asio::ip::tcp::socket& socket, const std::string_view target = "/slow") {
+            boost::asio::write(socket, boost::asio::buffer(
+                "GET " + std::string{ target } + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            ));
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 50 });
+        };
+
+        const auto check_unavailable = [](boost::asio::ip::tcp::socket& socket) {
+            boost::beast::flat_buffer buffer;
+            response<> resp;
+            boost::beast::http::read(socket, buffer, resp);
+            CHECK_EQ(resp.result(), status::service_unavailable);
+            CHECK_EQ(resp[field::server], "malloy");
+        };
+
+        boost::asio::io_context ioc;
+
+        SUBCASE("connection dropped before the handler ran")
+        {
+            const auto server = make_server(std::chrono::seconds{ 30 });
+            auto leader = server->connect(ioc);
+            auto waiter = server->connect(ioc);
+
+            lead(leader);
+            park(waiter);
+            leader.close();
+            check_unavailable(waiter);
+        }
+
+        SUBCASE("timeout")
+        {
+            const auto server = make_server(std::chrono::milliseconds{ 100 });
+            auto leader = server->connect(ioc);
+            auto waiter = server->connect(ioc);
+
+            lead(leader);
+            park(waiter);
+            check_unavailable(waiter);
+        }
+
+        SUBCASE("route of a sub-router")
+        {
+            // The server string is only known once the sub-router was added
+            const malloy::test::server server{ [](malloy::server::routing_context& ctrl) {
+                auto sub = std::make_unique<router>();
+                REQUIRE(sub->add(method::get, "/slow", [](const auto&) { return generator::ok(); }, single_flight::policy{ .timeout = std::chrono::milliseconds{ 100 } }));
+                REQUIRE(ctrl.router().add_subrouter("/api", std::move(sub)));
+            } };
+            auto leader = server.connect(ioc);
+            auto waiter = server.connect(ioc);
+
+            lead(leader, "/api/slow");
+            park(waiter, "/api/slow");
+            check_unavailable(waiter);
+        }
+    }
+
+    TEST_CASE("coalescing endpoint")
+    {
+        auto inner = std::make_unique<counting_endpoint>();
+        const auto& counter = *inner;
+
+        endpoint_http_coalescing ep;
+        ep.inner = std::move(inner);
+        ep.flight = std::make_shared<single_flight>();
+
+        // The leaders are kept alive (a flight is abandoned once its leader is gone)
+        const auto foo = make_request("/foo");
+        const auto bar = make_request("/bar");
+        CHECK_FALSE(ep.handle(foo, no_connection));
+        CHECK_FALSE(ep.handle(make_request("/foo"), no_connection));
+        CHECK_FALSE(ep.handle(bar, no_connection));
+        CHECK_EQ(counter.handled, 2);
+
+        CHECK_EQ(ep.flight->complete(response_cache::make_key(method::get, "/foo"), canned_response::make(generator::ok())), 1);
+        CHECK_FALSE(ep.handle(foo, no_connection));
+        CHECK_EQ(counter.handled, 3);
+    }
+
+    TEST_CASE("router")
+    {
+        router r;
+
+        CHECK(r.add(method::get, "/foo", [](const auto&) { return generator::ok(); }, single_flight::policy{ }));
+        CHECK(r.add(method::get, "/users/{id}", [](const auto&, const route_captures&) { return generator::ok(); }, single_flight::policy{ .vary = { "Accept" } }));
+        CHECK_FALSE(r.add(method::post, "/bar", [](const auto&) { return generator::ok(); }, single_flight::policy{ }));
+    }
+
+}
@@ -0,0 +1,166 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+#include <malloy/server/sse/channel.hpp>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+TEST_SUITE("components - sse")
+{
+
+    TEST_CASE("event serialization")
+    {
+        SUBCASE("data only")
+        {
+            ms::sse::event ev;
+            ev.data = "hello";
+
+            CHECK_EQ(*ev.serialize(), "data: hello\n\n");
+        }
+
+        SUBCASE("all fields")
+        {
+            ms::sse::event ev;
+            ev.comment = "keep-alive";
+            ev.type = "update";
+            ev.id = "7";
+            ev.retry = std::chrono::milliseconds{ 1500 };
+            ev.data = "hello";
+
+            CHECK_EQ(*ev.serialize(), ": keep-alive\nevent: update\nid: 7\nretry: 1500\ndata: hello\n\n");
+        }
+
+        SUBCASE("multi-line data")
+        {
+            ms::sse::event ev;
+            ev.data = "one\r\ntwo\nthree";
+
+            CHECK_EQ(*ev.serialize(), "data: one\ndata: two\ndata: three\n\n");
+        }
+
+        SUBCASE("line breaks truncate other fields")
+        {
+            ms::sse::event ev;
+            ev.type = "update\nid: 666";
+            ev.data = "x";
+
+            CHECK_EQ(*ev.serialize(), "event: update\ndata: x\n\n");
+        }
+    }
+
+    TEST_CASE("events are published to subscribers")
+    {
+        ms::sse::channel channel{ 8 };
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            REQUIRE(ctrl.router().add_sse("/events", [&channel](const auto&, const auto& stream) {
+                channel.subscribe(stream);
+            }));
+        } };
+
+        // Published before the client (re)connects
+        for (const char* id : { "1", "2", "3" }) {
+            ms::sse::event ev;
+            ev.id = id;
+            ev.data = std::string{ "event" } + id;
+            channel.publish(ev);
+        }
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(std::string{ "GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\nLast-Event-ID: 1\r\n\r\n" }));
+
+        // Wait for the subscription
+        for (int i = 0; i < 100 && channel.size() == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+        REQUIRE_EQ(channel.size(), 1);
+
+        ms::sse::event live;
+        live.data = "live";
+        CHECK_EQ(channel.publish(live), 1);
+
+        std::string received;
+        boost::asio::read_until(socket, boost::asio::dynamic_buffer(received), "data: live\n\n");
+
+        const auto body = received.find("\r\n\r\n");
+        REQUIRE_NE(body, std::string::npos);
+        const std::string header = received.substr(0, body);
+        CHECK_NE(header.find("Content-Type: text/event-stream"), std::string::npos);
+        CHECK_NE(header.find("Cache-Control: no-cache"), std::string::npos);
+
+        // Only the events missed since the last event ID are replayed
+        CHECK_EQ(received.substr(body + 4), "id: 2\ndata: event2\n\nid: 3\ndata: event3\n\ndata: live\n\n");
+    }
+
+    TEST_CASE("resources are matched like other routes")
+    {
+        ms::router r;
+
+        CHECK(r.add_sse("/events/{room}", [](const auto&, const auto&) { }));
+        CHECK_FALSE(r.add_sse("/events/[", [](const auto&, const auto&) { }));
+    }
+
+    TEST_CASE("closed streams are unsubscribed")
+    {
+        ms::sse::channel channel;
+        std::shared_ptr<ms::sse::stream> stream;
+        std::mutex stream_lock;
+
+        // The stream can't keep up as soon as an event is sent
+        const ms::sse::stream::policy pol{ .max_pending = 0, .on_overflow = ms::sse::stream::overflow_policy::disconnect };
+
+        malloy::test::server server{ [&](ms::routing_context& ctrl) {
+            REQUIRE(ctrl.router().add_sse("/events/{room}", [&](const auto& req, const auto& s) {
+                CHECK_EQ(req.target(), "/events/lobby");
+                channel.subscribe(s);
+
+                std::lock_guard lock(stream_lock);
+                stream = s;
+            }, pol));
+        } };
+
+        boost::asio::io_context ioc;
+        auto socket = server.connect(ioc);
+        boost::asio::write(socket, boost::asio::buffer(std::string{ "GET /events/lobby HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n" }));
+
+        // Wait for the subscription
+        for (int i = 0; i < 100 && channel.size() == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+        REQUIRE_EQ(channel.size(), 1);
+
+        SUBCASE("closed")
+        {
+            std::lock_guard lock(stream_lock);
+            stream->close();
+            CHECK_EQ(channel.size(), 0);
+        }
+
+        SUBCASE("disconnected while publishing")
+        {
+            ms::sse::event ev;
+            ev.data = "dropped";
+            CHECK_EQ(channel.publish(ev), 0);
+            CHECK_EQ(channel.size(), 0);
+        }
+
+        SUBCASE("subscribed after closing")
+        {
+            std::lock_guard lock(stream_lock);
+            stream->close();
+            channel.subscribe(stream);
+            CHECK_EQ(channel.size(), 0);
+        }
+    }
+
+}
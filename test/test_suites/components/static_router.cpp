@@ -0,0 +1,160 @@
+#include "../../test.hpp"
+#include "../../mocks.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+#include <malloy/server/routing/static_router.hpp>
+
+#include <string>
+
+using namespace malloy::http;
+using namespace malloy::server;
+
+namespace
+{
+    template<typename StaticRouter>
+    bool
+    static_handle(const StaticRouter& routes, const method m, const std::string& url, std::string& body)
+    {
+        request_header<> reqh;
+        reqh.target(url);
+        reqh.method(m);
+
+        return routes.handle(
+            std::make_shared<malloy::mock::http::connection::request_generator>(reqh),
+            http::connection_t{ std::shared_ptr<http::connection_plain>{nullptr} },
+            [&body](const auto&, auto&& resp, const auto&) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(resp)>, response<>>)
+                    body = resp.body();
+            }
+        );
+    }
+
+    template<fixed_string Pattern, std::size_t N>
+    constexpr
+    bool
+    static_match(const std::string_view path, std::array<std::string_view, N>& params)
+    {
+        return detail::match_static_pattern(Pattern.view(), path, params);
+    }
+}
+
+TEST_SUITE("components - static router")
+{
+
+    TEST_CASE("pattern validation")
+    {
+        static_assert(detail::is_valid_static_pattern("/"));
+        static_assert(detail::is_valid_static_pattern("/foo/bar"));
+        static_assert(detail::is_valid_static_pattern("/users/{id}/posts/{post_id}"));
+        static_assert(!detail::is_valid_static_pattern(""));
+        static_assert(!detail::is_valid_static_pattern("foo"));
+        static_assert(!detail::is_valid_static_pattern("/foo/{id}x"));
+        static_assert(!detail::is_valid_static_pattern("/foo/x{id}"));
+        static_assert(!detail::is_valid_static_pattern("/foo/{}"));
+        static_assert(!detail::is_valid_static_pattern("/foo/{id"));
+        static_assert(!detail::is_valid_static_pattern("/foo/id}"));
+    }
+
+    TEST_CASE("matching is constexpr")
+    {
+        constexpr auto params = [] {
+            std::array<std::string_view, 2> p;
+            [[maybe_unused]] const bool matched = static_match<"/users/{id}/posts/{post}">("/users/42/posts/abc", p);
+            return p;
+        }();
+        static_assert(params[0] == "42");
+        static_assert(params[1] == "abc");
+
+        std::array<std::string_view, 1> p;
+        CHECK(static_match<"/users/{id}">("/users/42", p));
+        CHECK_FALSE(static_match<"/users/{id}">("/users/", p));
+        CHECK_FALSE(static_match<"/users/{id}">("/users/42/", p));
+        CHECK_FALSE(static_match<"/users/{id}">("/users/42?foo=bar", p));
+        CHECK_FALSE(static_match<"/users/{id}">("/user/42", p));
+    }
+
+    TEST_CASE("dispatch")
+    {
+        const static_router routes{
+            make_static_route<method::get, "/">([](const auto&) {
+                return generator::ok();
+            }),
+            make_static_route<method::get, "/users/{id}">([](const auto&, const auto& params) {
+                response resp{status::ok};
+                resp.body() = "user " + std::string{params[0]};
+                return resp;
+            }),
+            make_static_route<method::post, "/users/{id}">([](const auto&) {
+                response resp{status::ok};
+                resp.body() = "post";
+                return resp;
+            })
+        };
+
+        std::string body;
+
+        SUBCASE("parameter")
+        {
+            CHECK(static_handle(routes, method::get, "/users/42", body));
+            CHECK_EQ(body, "user 42");
+        }
+
+        SUBCASE("method")
+        {
+            CHECK(static_handle(routes, method::post, "/users/42", body));
+            CHECK_EQ(body, "post");
+        }
+
+        SUBCASE("no match")
+        {
+            CHECK_FALSE(static_handle(routes, method::get, "/foo", body));
+            CHECK_FALSE(static_handle(routes, method::delete_, "/users/42", body));
+            CHECK(body.empty());
+        }
+    }
+
+    TEST_CASE("add to router")
+    {
+        const auto body_of = [](const std::string_view body) {
+            return [body](const auto&) {
+                response resp{status::ok};
+                resp.body() = body;
+                return resp;
+            };
+        };
+
+        malloy::test::server server{ [&](routing_context& ctrl) {
+            auto& r = ctrl.router();
+            REQUIRE(r.add(method::get, "/users/{id}", body_of("regular")));
+            REQUIRE(r.add(method::get, "/other", body_of("other")));
+            REQUIRE(r.add_preflight("/users/{id}", http::preflight_config{}));
+
+            r.add_static(static_router{
+                make_static_route<method::get, "/users/{id}">([](const auto&, const auto& params) {
+                    response resp{status::ok};
+                    resp.body() = "static " + std::string{params[0]};
+                    return resp;
+                }),
+                make_static_route<method::put, "/users/{id}">(body_of("put"))
+            });
+        } };
+
+        const std::string responses = server.exchange(
+            "GET /users/42 HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "PUT /users/42 HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 0\r\n\r\n"
+            "GET /other HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n"
+            "OPTIONS /users/42 HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n"
+        );
+
+        // The static route takes precedence over the route added before it
+        CHECK_NE(responses.find("static 42"), std::string::npos);
+        CHECK_EQ(responses.find("regular"), std::string::npos);
+        CHECK_NE(responses.find("put"), std::string::npos);
+        CHECK_NE(responses.find("other"), std::string::npos);
+
+        // The static routes are known to preflights
+        CHECK_NE(responses.find("Access-Control-Allow-Methods: GET, PUT\r\n"), std::string::npos);
+    }
+
+}
@@ -0,0 +1,106 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+using namespace malloy::http;
+namespace ms = malloy::server;
+
+namespace
+{
+    /**
+     * Reads a body chunk by chunk and responds with the body size and whether the chunks were bounded.
+     */
+    struct body_counter :
+        std::enable_shared_from_this<body_counter>
+    {
+        ms::streaming_request req;
+        std::size_t size = 0;
+        std::size_t max_chunk = 0;
+
+        explicit body_counter(ms::streaming_request r) :
+            req{ std::move(r) }
+        {
+        }
+
+        void
+        read()
+        {
+            req.read_some([self = shared_from_this()](malloy::error_code ec, std::string_view chunk) {
+                if (ec)
+                    return self->req.respond(generator::bad_request(ec.message()));
+
+                // End of body
+                if (chunk.empty()) {
+                    response<> resp{ status::ok };
+                    resp.body() = "[" + std::string{self->req.captures().at(0)} + " " + std::to_string(self->size) + (self->max_chunk <= 16 * 1024 ? " bounded]" : " unbounded]");
+                    return self->req.respond(std::move(resp));
+                }
+
+                self->size += chunk.size();
+                self->max_chunk = std::max(self->max_chunk, chunk.size());
+                self->read();
+            });
+        }
+    };
+}
+
+TEST_SUITE("components - streaming request")
+{
+
+    TEST_CASE("router")
+    {
+        ms::router r;
+
+        CHECK(r.add_streaming(method::post, "/upload/{name}", [](ms::streaming_request) { }));
+        CHECK_FALSE(r.add_streaming(method::post, "/upload/[", [](ms::streaming_request) { }));
+    }
+
+    TEST_CASE("bodies are read in chunks")
+    {
+        malloy::test::server server{ [](ms::routing_context& ctrl) {
+            ctrl.router().add_streaming(method::post, "/upload/{name}", [](ms::streaming_request req) {
+                std::make_shared<body_counter>(std::move(req))->read();
+            });
+        } };
+
+        const std::string body(100'000, 'x');
+        const std::string requests =
+            "POST /upload/a HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body +
+            "POST /upload/b HTTP/1.1\r\nHost: 127.0.0.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n4\r\ndefg\r\n0\r\n\r\n" +
+            "POST /upload/c HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+
+        const std::string responses = server.exchange(requests);
+
+        CHECK_NE(responses.find("[a 100000 bounded]"), std::string::npos);
+        CHECK_NE(responses.find("[b 7 bounded]"), std::string::npos);
+        CHECK_NE(responses.find("[c 0 bounded]"), std::string::npos);
+    }
+
+    TEST_CASE("responding before the body was read closes the connection")
+    {
+        malloy::test::server server{ [](ms::routing_context& ctrl) {
+            ctrl.router().add_streaming(method::post, "/upload", [](ms::streaming_request req) {
+                req.respond(generator::bad_request("rejected"));
+            });
+            ctrl.router().add(method::get, "/smuggled", [](const auto&) { return generator::ok(); });
+        } };
+
+        // The unread body looks like a request
+        const std::string body = "GET /smuggled HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        const std::string requests =
+            "POST /upload HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body +
+            "GET /smuggled HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+
+        const std::string responses = server.exchange(requests);
+
+        CHECK(responses.starts_with("HTTP/1.1 400"));
+        CHECK_NE(responses.find("rejected"), std::string::npos);
+        CHECK_EQ(responses.find("HTTP/1.1", 1), std::string::npos);
+    }
+
+}
@@ -38,6 +38,14 @@ TEST_SUITE("components - utils - core - http")
             CHECK_EQ(output[1], "boundary=----WebKitFormBoundarynBjZTMv9eqwyCWhj");
         }
     }
+
+    TEST_CASE("optional whitespace trimming")
+    {
+        CHECK_EQ(http::trim_ows(""), "");
+        CHECK_EQ(http::trim_ows(" \t "), "");
+        CHECK_EQ(http::trim_ows("\t gzip ;q=0.5 \t"), "gzip ;q=0.5");
+        CHECK_EQ(http::trim_ows("\r\nfoo"), "\r\nfoo");
+    }
 }
 
 TEST_SUITE("components - core - utils - http - cookies")
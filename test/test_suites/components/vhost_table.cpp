@@ -0,0 +1,122 @@
+#include "../../test.hpp"
+
+#include <malloy/server/routing_context.hpp>
+#include <malloy/server/routing/router.hpp>
+#include <malloy/server/routing/router_handle.hpp>
+#include <malloy/server/routing/vhost_table.hpp>
+
+using namespace malloy::server;
+
+TEST_SUITE("components - vhost table")
+{
+
+    TEST_CASE("add")
+    {
+        vhost_table vhosts;
+
+        SUBCASE("valid")
+        {
+            CHECK(vhosts.add("example.com", nullptr, "example"));
+            CHECK(vhosts.add("*.example.com", nullptr, "example"));
+            CHECK_EQ(vhosts.size(), 2);
+        }
+
+        SUBCASE("duplicate")
+        {
+            CHECK(vhosts.add("example.com", nullptr, ""));
+            CHECK_FALSE(vhosts.add("Example.COM", nullptr, ""));
+        }
+
+        SUBCASE("invalid")
+        {
+            CHECK_FALSE(vhosts.add("", nullptr, ""));
+            CHECK_FALSE(vhosts.add("*.", nullptr, ""));
+        }
+    }
+
+    TEST_CASE("routing context")
+    {
+        malloy::controller::config general_cfg;
+        general_cfg.logger = spdlog::default_logger();
+        general_cfg.num_threads = 1;
+
+        routing_context::config cfg{ general_cfg };
+        cfg.interface = "127.0.0.1";
+        cfg.port = 0;
+        routing_context ctrl{ cfg };
+
+        CHECK(ctrl.add_vhost("example.com"));
+        CHECK_FALSE(ctrl.add_vhost("example.com"));
+
+        SUBCASE("after start")
+        {
+            [[maybe_unused]] auto session = start(std::move(ctrl));
+            CHECK_FALSE(ctrl.add_vhost("other.example.com"));
+        }
+    }
+
+    TEST_CASE("find")
+    {
+        vhost_table vhosts;
+        const auto exact = vhosts.add("example.com", nullptr, "exact");
+        const auto api = vhosts.add("api.example.com", nullptr, "api");
+        const auto any = vhosts.add("*.example.com", nullptr, "any");
+        const auto eu = vhosts.add("*.eu.example.com", nullptr, "eu");
+        const auto v6 = vhosts.add("[::1]", nullptr, "v6");
+
+        SUBCASE("exact")
+        {
+            CHECK_EQ(vhosts.find("example.com"), exact);
+            CHECK_EQ(vhosts.find("api.example.com"), api);
+        }
+
+        SUBCASE("normalization")
+        {
+            CHECK_EQ(vhosts.find("Example.COM"), exact);
+            CHECK_EQ(vhosts.find("example.com:8080"), exact);
+            CHECK_EQ(vhosts.find("example.com."), exact);
+            CHECK_EQ(vhosts.find("[::1]:8080"), v6);
+        }
+
+        SUBCASE("wildcard")
+        {
+            CHECK_EQ(vhosts.find("www.example.com"), any);
+            CHECK_EQ(vhosts.find("a.b.example.com"), any);
+            CHECK_EQ(vhosts.find("www.eu.example.com"), eu);
+        }
+
+        SUBCASE("none")
+        {
+            CHECK_FALSE(vhosts.find(""));
+            CHECK_FALSE(vhosts.find("example.org"));
+            CHECK_FALSE(vhosts.find("notexample.com"));
+        }
+
+        SUBCASE("server string")
+        {
+            CHECK_EQ(exact->server_string(), "exact");
+            CHECK_EQ(any->server_string(), "any");
+        }
+    }
+
+    TEST_CASE("router handle")
+    {
+        router_handle handle{ "malloy" };
+        const auto fallback = std::make_shared<router>();
+        handle.publish(fallback);
+
+        auto vhosts = std::make_shared<vhost_table>();
+        const auto example = vhosts->add("example.com", nullptr, "example");
+
+        CHECK_EQ(handle.load("example.com"), fallback);
+
+        handle.publish_vhosts(vhosts);
+        CHECK_EQ(handle.load("example.com"), example);
+        CHECK_EQ(handle.load("example.org"), fallback);
+        CHECK_EQ(handle.load(""), fallback);
+
+        handle.publish_vhosts(nullptr);
+        CHECK_EQ(handle.load("example.com"), fallback);
+    }
+
+}